@@ -0,0 +1,234 @@
+#include "AnalysisCache.h"
+
+#include <limits>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+namespace analyze
+{
+
+// Results of other versions are not reused, as the metrics may be computed differently
+static constexpr auto CacheHeader = "WebGraphBuilder analysis cache 1";
+static constexpr auto CacheFileExt = ".analysis";
+static constexpr size_t HashBlockBytes{ 1024 * 1024 };
+
+static std::string ToHex(const web_graph::ContentHash& hash)
+{
+	std::ostringstream out;
+	out << std::hex << std::setfill('0') << std::setw(16) << hash.high << std::setw(16) << hash.low;
+	return out.str();
+}
+
+static web_graph::ContentHash FromHex(const std::string& hex)
+{
+	if (hex.size() != 32)
+	{
+		throw std::invalid_argument{ "Invalid hash: " + hex };
+	}
+
+	return { std::stoull(hex.substr(16), nullptr, 16), std::stoull(hex.substr(0, 16), nullptr, 16) };
+}
+
+// Hashes of the blocks are chained, so the file is hashed without having it in memory
+static web_graph::ContentHash HashFile(const std::string& filePath)
+{
+	std::ifstream inFile{ filePath, std::ios::binary };
+	if (!inFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	web_graph::ContentHash hash;
+	std::string block(HashBlockBytes + 2 * sizeof(uint64_t), '\0');
+	while (inFile.read(block.data() + 2 * sizeof(uint64_t), HashBlockBytes) || inFile.gcount())
+	{
+		std::copy_n(reinterpret_cast<const char*>(&hash.low), sizeof(uint64_t), block.data());
+		std::copy_n(reinterpret_cast<const char*>(&hash.high), sizeof(uint64_t), block.data() + sizeof(uint64_t));
+		hash = web_graph::HashContent(std::string_view{ block }.substr(0, 2 * sizeof(uint64_t) + inFile.gcount()));
+	}
+
+	if (inFile.bad())
+	{
+		throw std::runtime_error{ "Failed to read file" };
+	}
+
+	return hash;
+}
+
+GraphFingerprint GetGraphFingerprint(const std::string& graphFilePath, bool hashContent)
+{
+	// Taken before the content, so a write during the hashing changes the time
+	GraphFingerprint fingerprint;
+	fingerprint.size = std::filesystem::file_size(graphFilePath);
+	fingerprint.writeTime = static_cast<int64_t>(std::filesystem::last_write_time(graphFilePath).time_since_epoch().count());
+	if (hashContent)
+	{
+		fingerprint.hash = HashFile(graphFilePath);
+	}
+
+	return fingerprint;
+}
+
+AnalysisCache::AnalysisCache(const std::string& graphFilePath)
+	: m_graphFilePath(graphFilePath)
+	, m_cacheFilePath(graphFilePath + CacheFileExt)
+{
+	Load();
+}
+
+bool AnalysisCache::Find(const std::string& params, GraphAnalysisResult& result)
+{
+	m_graph = GetGraphFingerprint(m_graphFilePath, false);
+	m_graphHashed = false;
+
+	bool valid{ !m_results.empty() && m_graph.size == m_cachedGraph.size };
+	if (valid && m_graph.writeTime != m_cachedGraph.writeTime)
+	{
+		// Rewritten or copied with the same size, the time is updated if the content is the same
+		m_graph = GetGraphFingerprint(m_graphFilePath, true);
+		m_graphHashed = true;
+		valid = m_graph.hash == m_cachedGraph.hash;
+		if (valid)
+		{
+			m_cachedGraph.writeTime = m_graph.writeTime;
+			Save();
+		}
+	}
+
+	if (valid)
+	{
+		m_graph.hash = m_cachedGraph.hash;
+		m_graphHashed = true;
+
+		auto it = std::find_if(m_results.begin(), m_results.end(), [&params](const auto& entry) { return entry.first == params; });
+		if (it != m_results.end())
+		{
+			result = it->second;
+			return true;
+		}
+	}
+
+	if (!m_graphHashed)
+	{
+		m_graph = GetGraphFingerprint(m_graphFilePath, true);
+		m_graphHashed = true;
+	}
+
+	return false;
+}
+
+void AnalysisCache::Store(const std::string& params, const GraphAnalysisResult& result)
+{
+	if (!m_graphHashed)
+	{
+		m_graph = GetGraphFingerprint(m_graphFilePath, true);
+		m_graphHashed = true;
+	}
+
+	if (m_graph.size != m_cachedGraph.size || !(m_graph.hash == m_cachedGraph.hash))
+	{
+		m_results.clear();
+	}
+
+	m_cachedGraph = m_graph;
+	auto it = std::find_if(m_results.begin(), m_results.end(), [&params](const auto& entry) { return entry.first == params; });
+	if (it != m_results.end())
+	{
+		it->second = result;
+	}
+	else
+	{
+		m_results.emplace_back(params, result);
+	}
+
+	Save();
+}
+
+// A missing or broken cache is an empty one
+void AnalysisCache::Load()
+{
+	std::ifstream inFile{ m_cacheFilePath };
+	std::string line;
+	if (!inFile.is_open() || !std::getline(inFile, line) || line != CacheHeader)
+	{
+		return;
+	}
+
+	try
+	{
+		GraphFingerprint cachedGraph;
+		std::vector<std::pair<std::string, GraphAnalysisResult>> results;
+		while (std::getline(inFile, line))
+		{
+			const size_t valuePos{ line.find(' ') };
+			const std::string name{ line.substr(0, valuePos) };
+			const std::string value{ valuePos != std::string::npos ? line.substr(valuePos + 1) : std::string{} };
+
+			if (name == "size") cachedGraph.size = std::stoull(value);
+			else if (name == "writeTime") cachedGraph.writeTime = std::stoll(value);
+			else if (name == "hash") cachedGraph.hash = FromHex(value);
+			else if (name == "params") results.emplace_back(value, GraphAnalysisResult{});
+			else if (results.empty()) return;
+			else if (name == "edgesIndex") results.back().second.edgesIndex = std::stod(value);
+			else if (name == "linksIndex") results.back().second.linksIndex = std::stod(value);
+			else if (name == "clusteringCoeff") results.back().second.clusteringCoeff = std::stod(value);
+			else if (name == "inductors") results.back().second.inductorNum = std::stoul(value);
+			else if (name == "collectors") results.back().second.collectorsNum = std::stoul(value);
+			else if (name == "mediators") results.back().second.mediatorsNum = std::stoul(value);
+			else return;
+		}
+
+		m_cachedGraph = cachedGraph;
+		m_results = std::move(results);
+	}
+	catch (const std::logic_error&)
+	{
+		// std::invalid_argument or std::out_of_range of a broken number
+	}
+}
+
+// Written aside and renamed, so a reader never sees a partial cache
+void AnalysisCache::Save() const
+{
+	const std::string tempFilePath{ m_cacheFilePath + ".tmp" };
+	std::ofstream outFile{ tempFilePath };
+	if (!outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	outFile << std::setprecision(std::numeric_limits<double>::max_digits10)
+		<< CacheHeader << '\n'
+		<< "size " << m_cachedGraph.size << '\n'
+		<< "writeTime " << m_cachedGraph.writeTime << '\n'
+		<< "hash " << ToHex(m_cachedGraph.hash) << '\n';
+
+	for (const auto& entry : m_results)
+	{
+		const GraphAnalysisResult& result = entry.second;
+		outFile
+			<< "params " << entry.first << '\n'
+			<< "edgesIndex " << result.edgesIndex << '\n'
+			<< "linksIndex " << result.linksIndex << '\n'
+			<< "clusteringCoeff " << result.clusteringCoeff << '\n'
+			<< "inductors " << result.inductorNum << '\n'
+			<< "collectors " << result.collectorsNum << '\n'
+			<< "mediators " << result.mediatorsNum << '\n';
+	}
+
+	outFile.close();
+	if (outFile.fail())
+	{
+		std::remove(tempFilePath.c_str());
+		throw std::runtime_error{ "Failed to write file" };
+	}
+
+	std::filesystem::rename(tempFilePath, m_cacheFilePath);
+}
+
+}// namespace analyze
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <utility>
+
+#include "Analyze.h"
+#include "ContentHash.h"
+
+namespace analyze
+{
+
+// Content of a graph file: its size, the time it was last written and the hash of its bytes
+struct GraphFingerprint
+{
+	uint64_t size{ 0 };
+	int64_t writeTime{ 0 };
+	web_graph::ContentHash hash;
+};
+
+// Results of the analysis of a graph file kept in a file next to it, one per set of the analysis parameters.
+// The results are valid while the graph has the same content: a graph of the same size and write time is
+// taken as unchanged without reading it, otherwise its bytes are hashed, which is still much faster than a parse.
+// The results of a changed graph are dropped on the next store
+class AnalysisCache
+{
+public:
+	explicit AnalysisCache(const std::string& graphFilePath);
+
+	// Result of the graph analyzed with the parameters, false if there is none or the graph has changed
+	bool Find(const std::string& params, GraphAnalysisResult& result);
+	// Stores the result of the graph as it was when Find was called, so a graph changed during
+	// the analysis is not taken for the analyzed one
+	void Store(const std::string& params, const GraphAnalysisResult& result);
+
+private:
+	void Load();
+	void Save() const;
+
+private:
+	const std::string m_graphFilePath;
+	const std::string m_cacheFilePath;
+
+	// Of the cached results and of the graph as it is now
+	GraphFingerprint m_cachedGraph;
+	GraphFingerprint m_graph;
+	bool m_graphHashed{ false };
+
+	std::vector<std::pair<std::string, GraphAnalysisResult>> m_results;
+};
+
+GraphFingerprint GetGraphFingerprint(const std::string& graphFilePath, bool hashContent);
+
+}// namespace analyze
@@ -0,0 +1,243 @@
+#include "AnalysisOutput.h"
+
+#include <limits>
+#include <memory>
+#include <future>
+#include <cstdio>
+#include <charconv>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Parallel.h"
+
+namespace analyze
+{
+
+static constexpr size_t RowsPerBatch{ 1 << 16 };
+static constexpr auto NodeMetricsCsvHeader =
+	"url,inbound_links,outbound_links,inbound_neighbours,outbound_neighbours,type,local_links_index\n";
+
+const char* ToString(NodeType type) noexcept
+{
+	switch (type)
+	{
+	case NodeType::Inductor: return "inductor";
+	case NodeType::Collector: return "collector";
+	case NodeType::Mediator: return "mediator";
+	default: return "unknown";
+	}
+}
+
+// The types of the nodes are not applicable to an undirected analysis
+static std::string ToJsonNodesNum(const GraphAnalysisResult& result, size_t nodesNum)
+{
+	return result.options.directed ? std::to_string(nodesNum) : "null";
+}
+
+std::string ToJson(const GraphAnalysisResult& result)
+{
+	std::ostringstream out;
+	out << std::setprecision(std::numeric_limits<double>::max_digits10)
+		<< "{\n"
+		<< "    \"edges_index\": " << result.edgesIndex << ",\n"
+		<< "    \"links_index\": " << result.linksIndex << ",\n"
+		<< "    \"clustering_coeff\": " << result.clusteringCoeff << ",\n"
+		<< "    \"inductors\": " << ToJsonNodesNum(result, result.inductorNum) << ",\n"
+		<< "    \"collectors\": " << ToJsonNodesNum(result, result.collectorsNum) << ",\n"
+		<< "    \"mediators\": " << ToJsonNodesNum(result, result.mediatorsNum) << ",\n"
+		<< "    \"options\": { "
+		<< "\"weighted\": " << (result.options.weighted ? "true" : "false") << ", "
+		<< "\"directed\": " << (result.options.directed ? "true" : "false") << " }\n"
+		<< "}\n";
+
+	return out.str();
+}
+
+std::string ToJson(const DegreeDistributions& distributions)
+{
+	std::ostringstream out;
+	out << std::setprecision(std::numeric_limits<double>::max_digits10) << "{";
+
+	for (size_t kind{ 0 }; kind < distributions.size(); ++kind)
+	{
+		const DegreeDistribution& distribution = distributions[kind];
+		const PowerLawFit& fit = distribution.fit;
+		out << (kind ? ",\n" : "\n")
+			<< "    \"" << ToString(static_cast<DegreeKind>(kind)) << "\": {\n"
+			<< "        \"power_law\": { "
+			<< "\"alpha\": " << fit.alpha << ", "
+			<< "\"alpha_error\": " << fit.alphaError << ", "
+			<< "\"min_degree\": " << fit.minDegree << ", "
+			<< "\"tail_nodes\": " << fit.tailNodesNum << ", "
+			<< "\"ks_distance\": " << fit.ksDistance << " },\n"
+			<< "        \"log_bins\": [";
+
+		for (size_t bin{ 0 }; bin < distribution.logBinNodesNum.size(); ++bin)
+		{
+			out << (bin ? ",\n" : "\n")
+				<< "            { \"min_degree\": " << (size_t{ 1 } << bin)
+				<< ", \"max_degree\": " << (size_t{ 2 } << bin) - 1
+				<< ", \"nodes\": " << distribution.logBinNodesNum[bin] << " }";
+		}
+
+		out << (distribution.logBinNodesNum.empty() ? "],\n" : "\n        ],\n")
+			<< "        \"degrees\": [";
+
+		bool first{ true };
+		for (size_t degree{ 0 }; degree < distribution.nodesNum.size(); ++degree)
+		{
+			if (distribution.nodesNum[degree])
+			{
+				out << (first ? "" : ", ") << '[' << degree << ", " << distribution.nodesNum[degree] << ']';
+				first = false;
+			}
+		}
+
+		out << "]\n"
+			<< "    }";
+	}
+
+	out << "\n}\n";
+	return out.str();
+}
+
+// Quoted as RFC 4180 says if the url has a separator, a quote or a line break
+static void AppendCsvField(std::string& out, const std::string& value)
+{
+	if (value.find_first_of(",\"\r\n") == std::string::npos)
+	{
+		out += value;
+		return;
+	}
+
+	out += '"';
+	for (char c : value)
+	{
+		if (c == '"')
+		{
+			out += '"';
+		}
+
+		out += c;
+	}
+
+	out += '"';
+}
+
+template<typename Number>
+static void AppendNumber(std::string& out, Number value)
+{
+	char buffer[32];
+	const auto result = std::to_chars(std::begin(buffer), std::end(buffer), value);
+	out.append(buffer, result.ptr);
+}
+
+static void AppendRow(std::string& out, const web_graph::WebPageNode& node, const NodeMetrics& metrics)
+{
+	AppendCsvField(out, web_graph::GetNodeUrl(node));
+	out += ',';
+	AppendNumber(out, metrics.inboundLinksNum);
+	out += ',';
+	AppendNumber(out, metrics.outboundLinksNum);
+	out += ',';
+	AppendNumber(out, metrics.inboundNeighboursNum);
+	out += ',';
+	AppendNumber(out, metrics.outboundNeighboursNum);
+	out += ',';
+	out += ToString(metrics.type);
+	out += ',';
+	// Shortest form which reads back to the same double
+	AppendNumber(out, metrics.localLinksIndex);
+	out += '\n';
+}
+
+static void WriteAll(std::FILE* file, const std::vector<std::string>& parts, const std::string& filePath)
+{
+	for (const std::string& part : parts)
+	{
+		if (std::fwrite(part.data(), 1, part.size(), file) != part.size())
+		{
+			throw std::runtime_error{ "Failed to write file " + filePath };
+		}
+	}
+}
+
+void WriteNodeMetricsCsv(
+	const web_graph::GraphView& view,
+	const std::vector<NodeMetrics>& nodeMetrics,
+	const std::string& filePath,
+	size_t threadsNum)
+{
+	using namespace web_graph;
+
+	std::vector<const WebPageNode*> nodes(GetNodeIdBound(view.GetGraph()));
+	for (const auto& node : GetNodes(view.GetGraph()))
+	{
+		if (view.IsActive(*node.second))
+		{
+			nodes[GetNodeId(*node.second)] = node.second.get();
+		}
+	}
+
+	std::unique_ptr<std::FILE, int(*)(std::FILE*)> file{ std::fopen(filePath.c_str(), "wb"), &std::fclose };
+	if (!file)
+	{
+		throw std::runtime_error{ "Failed to open file " + filePath };
+	}
+
+	// The rows are written in large blocks anyway, the stream buffer only has to hold the header
+	std::setvbuf(file.get(), nullptr, _IOFBF, 1 << 20);
+	WriteAll(file.get(), { NodeMetricsCsvHeader }, filePath);
+
+	threadsNum = std::max<size_t>(threadsNum, 1);
+	const size_t batchNodesNum{ RowsPerBatch * threadsNum };
+	std::vector<std::string> parts(threadsNum);
+	std::vector<std::string> writtenParts(threadsNum);
+	std::future<void> writing;
+	for (size_t batchBegin{ 0 }; batchBegin < nodes.size(); batchBegin += batchNodesNum)
+	{
+		// A batch smaller than threadsNum is split into fewer parts, the others are left empty
+		for (std::string& part : parts)
+		{
+			part.clear();
+		}
+
+		const size_t batchSize{ std::min(batchNodesNum, nodes.size() - batchBegin) };
+		common::ParallelFor(threadsNum, batchSize, [&](size_t begin, size_t end, size_t part)
+		{
+			std::string& out = parts[part];
+			for (size_t id{ batchBegin + begin }; id < batchBegin + end; ++id)
+			{
+				if (nodes[id])
+				{
+					AppendRow(out, *nodes[id], nodeMetrics[id]);
+				}
+			}
+		});
+
+		if (writing.valid())
+		{
+			writing.get();
+		}
+
+		std::swap(parts, writtenParts);
+		writing = std::async(std::launch::async, [&file, &writtenParts, &filePath]
+		{
+			WriteAll(file.get(), writtenParts, filePath);
+		});
+	}
+
+	if (writing.valid())
+	{
+		writing.get();
+	}
+
+	if (std::fclose(file.release()) != 0)
+	{
+		throw std::runtime_error{ "Failed to write file " + filePath };
+	}
+}
+
+}// namespace analyze
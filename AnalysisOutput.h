@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Analyze.h"
+#include "DegreeDistribution.h"
+
+namespace analyze
+{
+
+const char* ToString(NodeType type) noexcept;
+
+// Global metrics as a JSON object, doubles are written with all of their digits.
+// The node types of an undirected analysis are null
+std::string ToJson(const GraphAnalysisResult& result);
+// Distributions by kind: the power law fit, the log bins and the num of nodes of every degree seen as [degree, nodes]
+std::string ToJson(const DegreeDistributions& distributions);
+
+// Metrics of the active nodes as a CSV table keyed by url, one row per node in the order of the node ids:
+// url,inbound_links,outbound_links,inbound_neighbours,outbound_neighbours,type,local_links_index
+// Batches of rows are formatted on up to threadsNum threads while the previous batch is written
+void WriteNodeMetricsCsv(
+	const web_graph::GraphView& view,
+	const std::vector<NodeMetrics>& nodeMetrics,
+	const std::string& filePath,
+	size_t threadsNum);
+
+}// namespace analyze
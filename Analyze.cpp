@@ -5,8 +5,10 @@
 #include <functional>
 #include <cassert>
 #include <random>
+#include <stdexcept>
 
 #include "Common.h"
+#include "Parallel.h"
 
 namespace analyze
 {
@@ -42,42 +44,180 @@ void ForEachInGraph(const web_graph::WebGraph& graph, Functor&& func)
 	}
 }*/
 
-double CalcEdgesIndex(const web_graph::WebGraph& graph)
+// Node filters the metric kernels are instantiated with,
+// the unmasked one lets the compiler drop all the checks
+struct AllNodes
+{
+	bool operator()(const web_graph::WebPageNode&) const noexcept { return true; }
+};
+
+struct ActiveNodes
+{
+	bool operator()(const web_graph::WebPageNode& node) const noexcept
+	{
+		return mask.Test(web_graph::GetNodeId(node));
+	}
+
+	const web_graph::NodeMask& mask;
+};
+
+template<typename Kernel>
+auto RunKernel(const web_graph::GraphView& view, Kernel&& kernel)
+{
+	return view.IsMasked() ? kernel(ActiveNodes{ view.GetMask() }) : kernel(AllNodes{});
+}
+
+// Num of links to or from active neighbours, counting multiple links
+template<typename Filter>
+size_t GetNodeLinksNum(const web_graph::NodeLinks& links, const Filter& isActive)
+{
+	size_t result{ 0 };
+	for (const auto& linkInfo : links)
+	{
+		if (isActive(*linkInfo.first))
+		{
+			result += linkInfo.second;
+		}
+	}
+
+	return result;
+}
+
+// Num of distinct active neighbours
+template<typename Filter>
+size_t GetNeighboursNum(const web_graph::NodeLinks& links, const Filter& isActive)
+{
+	size_t result{ 0 };
+	for (const auto& linkInfo : links)
+	{
+		result += isActive(*linkInfo.first);
+	}
+
+	return result;
+}
+
+size_t GetNeighboursNum(const web_graph::NodeLinks& links, const AllNodes&) noexcept
+{
+	return links.size();
+}
+
+template<typename Filter>
+bool HasNeighbours(const web_graph::NodeLinks& links, const Filter& isActive)
+{
+	for (const auto& linkInfo : links)
+	{
+		if (isActive(*linkInfo.first))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool HasNeighbours(const web_graph::NodeLinks& links, const AllNodes&) noexcept
+{
+	return !links.empty();
+}
+
+double CalcEdgesIndex(const web_graph::GraphView& view)
 {
 	using namespace web_graph;
 
-	double nodesWithOneOrMoreInOutLinksNum{ 0 };
-	const Nodes& nodes = GetNodes(graph);
-	for (const auto& node : nodes)
+	if (!view.GetNodesNum())
 	{
-		if (!common::NodeMarkedAsDeleted(*node.second))
+		return 0.0;
+	}
+
+	const size_t nodesWithOneOrMoreInOutLinksNum = RunKernel(view, [&](const auto& isActive)
+	{
+		size_t result{ 0 };
+		for (const auto& node : GetNodes(view.GetGraph()))
 		{
-			if (!GetInboundNodeLinks(*node.second).empty() ||
-				!GetOutboundNodeLinks(*node.second).empty())
+			if (isActive(*node.second) &&
+				(HasNeighbours(GetInboundNodeLinks(*node.second), isActive) ||
+				HasNeighbours(GetOutboundNodeLinks(*node.second), isActive)))
 			{
-				++nodesWithOneOrMoreInOutLinksNum;
+				++result;
 			}
 		}
+
+		return result;
+	});
+
+	return static_cast<double>(nodesWithOneOrMoreInOutLinksNum) / view.GetNodesNum();
+}
+
+double CalcEdgesIndex(const web_graph::WebGraph& graph)
+{
+	return CalcEdgesIndex(common::MakeActiveView(graph));
+}
+
+double CalcEdgesIndex(const web_graph::CompressedGraph& graph)
+{
+	using namespace web_graph;
+
+	if (!graph.GetNodesNum())
+	{
+		return 0.0;
+	}
+
+	size_t nodesWithOneOrMoreInOutLinksNum{ 0 };
+	for (NodeId node{ 0 }; node < graph.GetNodesNum(); ++node)
+	{
+		if (!graph.GetInboundLinks(node).empty() || !graph.GetOutboundLinks(node).empty())
+		{
+			++nodesWithOneOrMoreInOutLinksNum;
+		}
 	}
 
-	return nodesWithOneOrMoreInOutLinksNum / nodes.size();
+	return static_cast<double>(nodesWithOneOrMoreInOutLinksNum) / graph.GetNodesNum();
 }
 
 ////
 
 double CalcLinksIndex(size_t linksNum, size_t nodesNum) noexcept
 {
-	return nodesNum >= 1?
+	return nodesNum > 1?
 		static_cast<double>(linksNum) / (nodesNum * (nodesNum - 1)) : 0;
 }
 
+double CalcLinksIndex(const web_graph::GraphView& view)
+{
+	return CalcLinksIndex(view.GetLinksNum(), view.GetNodesNum());
+}
+
 double CalcLinksIndex(const web_graph::WebGraph& graph)
 {
-	using namespace web_graph;
-	return CalcLinksIndex(GetLinksNum(graph), GetNodesNum(graph));
+	return CalcLinksIndex(common::MakeActiveView(graph));
 }
 
-double CalcLinkIndexForNode(const web_graph::WebPageNode& node)
+double CalcLinksIndex(const web_graph::CompressedGraph& graph)
+{
+	return CalcLinksIndex(graph.GetLinksNum(), graph.GetNodesNum());
+}
+
+// Distinct neighbours and links of a list, a compressed one is decoded in one pass
+struct LinksNum
+{
+	size_t neighboursNum{ 0 };
+	size_t linksNum{ 0 };
+};
+
+LinksNum GetLinksNum(const web_graph::CompressedGraph::Links& links) noexcept
+{
+	LinksNum result;
+	for (const auto& link : links)
+	{
+		++result.neighboursNum;
+		result.linksNum += link.count;
+	}
+
+	return result;
+}
+
+template<typename Filter>
+double CalcLinkIndexForNode(const web_graph::WebPageNode& node, const Filter& isActive)
 {
 	// link index of subgraph comprised the node and it's adjacent nodes
 
@@ -85,61 +225,70 @@ double CalcLinkIndexForNode(const web_graph::WebPageNode& node)
 
 	const NodeLinks& inLinks = GetInboundNodeLinks(node);
 	const NodeLinks& outLinks = GetOutboundNodeLinks(node);
-	const size_t subgraphNodesNum{ inLinks.size() + outLinks.size() + 1 };
+	const size_t subgraphNodesNum{
+		GetNeighboursNum(inLinks, isActive) + GetNeighboursNum(outLinks, isActive) + 1 };
+	const size_t subgraphLinksNum{
+		GetNodeLinksNum(inLinks, isActive) + GetNodeLinksNum(outLinks, isActive) };
 
-	size_t subgraphLinksNum{ 0 };
+	return CalcLinksIndex(subgraphLinksNum, subgraphNodesNum);
+}
 
-	for (const auto& inNodeLinksInfo : inLinks)
-	{
-		subgraphLinksNum += inNodeLinksInfo.second;
-	}
+double CalcClusteringCoeff(const web_graph::GraphView& view)
+{
+	using namespace web_graph;
 
-	for (const auto& outNodeLinksInfo : outLinks)
+	return RunKernel(view, [&](const auto& isActive)
 	{
-		subgraphLinksNum += outNodeLinksInfo.second;
-	}
+		size_t nodesWithTotalLinksNotLessThan2_Num{ 0 };
+		double linkIndexSum{ 0.0 };
 
-	return CalcLinksIndex(subgraphLinksNum, subgraphNodesNum);
+		for (const auto& node : GetNodes(view.GetGraph()))
+		{
+			if (isActive(*node.second) &&
+				GetNeighboursNum(GetInboundNodeLinks(*node.second), isActive) +
+				GetNeighboursNum(GetOutboundNodeLinks(*node.second), isActive) >= 2)
+			{
+				++nodesWithTotalLinksNotLessThan2_Num;
+
+				linkIndexSum += CalcLinkIndexForNode(*node.second, isActive);
+			}
+		}
+
+		return nodesWithTotalLinksNotLessThan2_Num?
+			linkIndexSum / nodesWithTotalLinksNotLessThan2_Num :
+			0.0;
+	});
 }
 
 double CalcClusteringCoeff(const web_graph::WebGraph& graph)
+{
+	return CalcClusteringCoeff(common::MakeActiveView(graph));
+}
+
+double CalcClusteringCoeff(const web_graph::CompressedGraph& graph)
 {
 	using namespace web_graph;
 
 	size_t nodesWithTotalLinksNotLessThan2_Num{ 0 };
 	double linkIndexSum{ 0.0 };
 
-	const Nodes& nodes = GetNodes(graph);
-	for (const auto& node : nodes)
+	for (NodeId node{ 0 }; node < graph.GetNodesNum(); ++node)
 	{
-		if (!common::NodeMarkedAsDeleted(*node.second))
+		const LinksNum in{ GetLinksNum(graph.GetInboundLinks(node)) };
+		const LinksNum out{ GetLinksNum(graph.GetOutboundLinks(node)) };
+		if (in.neighboursNum + out.neighboursNum >= 2)
 		{
-			if (GetInboundNodeLinks(*node.second).size() +
-				GetOutboundNodeLinks(*node.second).size() >= 2)
-			{
-				++nodesWithTotalLinksNotLessThan2_Num;
+			++nodesWithTotalLinksNotLessThan2_Num;
 
-				linkIndexSum += CalcLinkIndexForNode(*node.second);
-			}
+			linkIndexSum += CalcLinksIndex(in.linksNum + out.linksNum, in.neighboursNum + out.neighboursNum + 1);
 		}
 	}
 
 	return nodesWithTotalLinksNotLessThan2_Num?
-		static_cast<double>(linkIndexSum) / nodesWithTotalLinksNotLessThan2_Num :
+		linkIndexSum / nodesWithTotalLinksNotLessThan2_Num :
 		0.0;
 }
 
-size_t GetNodeLinksNum(const web_graph::NodeLinks& links)
-{
-	size_t result{ 0 };
-	for (const auto& linkInfo : links)
-	{
-		result += linkInfo.second;
-	}
-
-	return result;
-}
-
 bool IsInductor(size_t inboundLinksNum, size_t outboundLinksNum) noexcept
 {
 	return inboundLinksNum * 1.5 <= outboundLinksNum;
@@ -151,20 +300,24 @@ bool IsCollector(size_t inboundLinksNum, size_t outboundLinksNum) noexcept
 }
 
 void GetNodesTypesNum(
-	const web_graph::WebGraph & graph,
+	const web_graph::GraphView& view,
 	size_t & inductorsNum,
 	size_t & collectorsNum,
 	size_t & mediatorsNum)
 {
 	using namespace web_graph;
 
-	const Nodes& nodes = GetNodes(graph);
-	for (const auto& node : nodes)
+	RunKernel(view, [&](const auto& isActive)
 	{
-		if (!common::NodeMarkedAsDeleted(*node.second))
+		for (const auto& node : GetNodes(view.GetGraph()))
 		{
-			size_t inboundLinksNum{ GetNodeLinksNum(GetInboundNodeLinks(*node.second)) };
-			size_t outboundLinksNum{ GetNodeLinksNum(GetOutboundNodeLinks(*node.second)) };
+			if (!isActive(*node.second))
+			{
+				continue;
+			}
+
+			size_t inboundLinksNum{ GetNodeLinksNum(GetInboundNodeLinks(*node.second), isActive) };
+			size_t outboundLinksNum{ GetNodeLinksNum(GetOutboundNodeLinks(*node.second), isActive) };
 
 			if (IsInductor(inboundLinksNum, outboundLinksNum))
 			{
@@ -179,10 +332,241 @@ void GetNodesTypesNum(
 				++mediatorsNum;
 			}
 		}
+
+		return 0;
+	});
+}
+
+void GetNodesTypesNum(
+	const web_graph::WebGraph & graph,
+	size_t & inductorsNum,
+	size_t & collectorsNum,
+	size_t & mediatorsNum)
+{
+	GetNodesTypesNum(common::MakeActiveView(graph), inductorsNum, collectorsNum, mediatorsNum);
+}
+
+void GetNodesTypesNum(
+	const web_graph::CompressedGraph& graph,
+	size_t & inductorsNum,
+	size_t & collectorsNum,
+	size_t & mediatorsNum)
+{
+	using namespace web_graph;
+
+	for (NodeId node{ 0 }; node < graph.GetNodesNum(); ++node)
+	{
+		const size_t inboundLinksNum{ GetLinksNum(graph.GetInboundLinks(node)).linksNum };
+		const size_t outboundLinksNum{ GetLinksNum(graph.GetOutboundLinks(node)).linksNum };
+
+		if (IsInductor(inboundLinksNum, outboundLinksNum))
+		{
+			++inductorsNum;
+		}
+		else if (IsCollector(inboundLinksNum, outboundLinksNum))
+		{
+			++collectorsNum;
+		}
+		else
+		{
+			++mediatorsNum;
+		}
 	}
 }
 
+// Link counting policies of the analysis kernel. Every combination of them and of the node filter
+// is instantiated on its own, so each loop does only the work its way of counting needs
+
+// Multiple links between two nodes count as many links
+struct Weighted
+{
+	template<typename Filter>
+	static LinksNum Count(const web_graph::NodeLinks& links, const Filter& isActive)
+	{
+		LinksNum result;
+		for (const auto& linkInfo : links)
+		{
+			if (isActive(*linkInfo.first))
+			{
+				++result.neighboursNum;
+				result.linksNum += linkInfo.second;
+			}
+		}
+
+		return result;
+	}
+
+	static LinksNum Count(const web_graph::NodeLinks& links, const AllNodes& isActive)
+	{
+		return { links.size(), GetNodeLinksNum(links, isActive) };
+	}
+
+	// Links both ways between the node and a neighbour stay separate links
+	static size_t JoinDirections(size_t linksNum, size_t) noexcept
+	{
+		return linksNum;
+	}
+};
+
+// Multiple links count as one, the lists of an unmasked view are not even walked
+struct Unweighted
+{
+	template<typename Filter>
+	static LinksNum Count(const web_graph::NodeLinks& links, const Filter& isActive)
+	{
+		const size_t neighboursNum{ GetNeighboursNum(links, isActive) };
+		return { neighboursNum, neighboursNum };
+	}
+
+	static size_t JoinDirections(size_t linksNum, size_t mutualNeighboursNum) noexcept
+	{
+		return linksNum - mutualNeighboursNum;
+	}
+};
+
+// Degrees of a node as the policies count them
+struct NodeDegrees
+{
+	size_t inboundLinksNum{ 0 };
+	size_t outboundLinksNum{ 0 };
+	size_t linksNum{ 0 };
+	size_t neighboursNum{ 0 };
+};
+
+// Inbound and outbound neighbours are told apart, a neighbour linked both ways is counted twice
+struct Directed
+{
+	static constexpr bool HasNodeTypes{ true };
+
+	template<typename Weight, typename Filter>
+	static NodeDegrees GetDegrees(const web_graph::WebPageNode& node, const Filter& isActive)
+	{
+		const LinksNum in{ Weight::Count(web_graph::GetInboundNodeLinks(node), isActive) };
+		const LinksNum out{ Weight::Count(web_graph::GetOutboundNodeLinks(node), isActive) };
+		return { in.linksNum, out.linksNum, in.linksNum + out.linksNum, in.neighboursNum + out.neighboursNum };
+	}
+
+	static double CalcLinksIndex(size_t linksNum, size_t nodesNum) noexcept
+	{
+		return analyze::CalcLinksIndex(linksNum, nodesNum);
+	}
+};
+
+// Every neighbour is counted once. The links of a node have no direction, so there are no inductors and
+// collectors to tell apart
+struct Undirected
+{
+	static constexpr bool HasNodeTypes{ false };
+
+	template<typename Weight, typename Filter>
+	static NodeDegrees GetDegrees(const web_graph::WebPageNode& node, const Filter& isActive)
+	{
+		const web_graph::NodeLinks& inLinks = web_graph::GetInboundNodeLinks(node);
+		const web_graph::NodeLinks& outLinks = web_graph::GetOutboundNodeLinks(node);
+		const LinksNum in{ Weight::Count(inLinks, isActive) };
+		const LinksNum out{ Weight::Count(outLinks, isActive) };
+
+		size_t mutualNeighboursNum{ 0 };
+		const auto& smaller = inLinks.size() < outLinks.size() ? inLinks : outLinks;
+		const auto& larger = inLinks.size() < outLinks.size() ? outLinks : inLinks;
+		for (const auto& linkInfo : smaller)
+		{
+			mutualNeighboursNum += isActive(*linkInfo.first) && larger.count(linkInfo.first);
+		}
+
+		// A self link is mutual with itself but has both of its ends at the node, so it is not joined
+		const bool hasSelfLink{ outLinks.count(&node) != 0 };
+		const size_t linksNum{ Weight::JoinDirections(in.linksNum + out.linksNum, mutualNeighboursNum - hasSelfLink) };
+		return { linksNum, linksNum, linksNum, in.neighboursNum + out.neighboursNum - mutualNeighboursNum };
+	}
+
+	static double CalcLinksIndex(size_t linksNum, size_t nodesNum) noexcept
+	{
+		return 2 * analyze::CalcLinksIndex(linksNum, nodesNum);
+	}
+};
+
+// All the metrics in one pass over the nodes, summed in the same order as the separate metrics do
+template<typename Weight, typename Direction, typename Filter>
+GraphAnalysisResult AnalyzeKernel(const web_graph::GraphView& view, const Filter& isActive)
+{
+	using namespace web_graph;
+
+	GraphAnalysisResult result{};
+	size_t linkEndsNum{ 0 };
+	size_t nodesWithOneOrMoreInOutLinksNum{ 0 };
+	size_t nodesWithTotalLinksNotLessThan2_Num{ 0 };
+	double linkIndexSum{ 0.0 };
+	for (const auto& node : GetNodes(view.GetGraph()))
+	{
+		if (!isActive(*node.second))
+		{
+			continue;
+		}
+
+		const NodeDegrees degrees{ Direction::template GetDegrees<Weight>(*node.second, isActive) };
+		linkEndsNum += degrees.linksNum;
+		nodesWithOneOrMoreInOutLinksNum += degrees.neighboursNum > 0;
+		if (degrees.neighboursNum >= 2)
+		{
+			++nodesWithTotalLinksNotLessThan2_Num;
+			linkIndexSum += Direction::CalcLinksIndex(degrees.linksNum, degrees.neighboursNum + 1);
+		}
+
+		if constexpr (Direction::HasNodeTypes)
+		{
+			if (IsInductor(degrees.inboundLinksNum, degrees.outboundLinksNum))
+			{
+				++result.inductorNum;
+			}
+			else if (IsCollector(degrees.inboundLinksNum, degrees.outboundLinksNum))
+			{
+				++result.collectorsNum;
+			}
+			else
+			{
+				++result.mediatorsNum;
+			}
+		}
+	}
+
+	// Every link is counted at both of its ends, a self link too
+	result.linksIndex = Direction::CalcLinksIndex(linkEndsNum / 2, view.GetNodesNum());
+	result.edgesIndex = view.GetNodesNum() ?
+		static_cast<double>(nodesWithOneOrMoreInOutLinksNum) / view.GetNodesNum() : 0.0;
+	result.clusteringCoeff = nodesWithTotalLinksNotLessThan2_Num ?
+		linkIndexSum / nodesWithTotalLinksNotLessThan2_Num : 0.0;
+
+	return result;
+}
+
+template<typename Weight, typename Direction>
+GraphAnalysisResult RunAnalysisKernel(const web_graph::GraphView& view)
+{
+	return RunKernel(view, [&](const auto& isActive) { return AnalyzeKernel<Weight, Direction>(view, isActive); });
+}
+
+GraphAnalysisResult Analyze(const web_graph::GraphView& view, const AnalysisOptions& options)
+{
+	GraphAnalysisResult result{ options.weighted ?
+		(options.directed ? RunAnalysisKernel<Weighted, Directed>(view) : RunAnalysisKernel<Weighted, Undirected>(view)) :
+		(options.directed ? RunAnalysisKernel<Unweighted, Directed>(view) : RunAnalysisKernel<Unweighted, Undirected>(view)) };
+	result.options = options;
+
+	return result;
+}
+
+GraphAnalysisResult Analyze(const web_graph::GraphView& view)
+{
+	return Analyze(view, AnalysisOptions{});
+}
+
 GraphAnalysisResult Analyze(const web_graph::WebGraph& graph)
+{
+	return Analyze(common::MakeActiveView(graph));
+}
+
+GraphAnalysisResult Analyze(const web_graph::CompressedGraph& graph)
 {
 	GraphAnalysisResult result{};
 	result.linksIndex = CalcLinksIndex(graph);
@@ -193,6 +577,109 @@ GraphAnalysisResult Analyze(const web_graph::WebGraph& graph)
 	return result;
 }
 
+template<typename Filter>
+NodeMetrics CalcNodeMetrics(const web_graph::WebPageNode& node, const Filter& isActive)
+{
+	using namespace web_graph;
+
+	const NodeLinks& inLinks = GetInboundNodeLinks(node);
+	const NodeLinks& outLinks = GetOutboundNodeLinks(node);
+
+	NodeMetrics metrics;
+	metrics.inboundLinksNum = GetNodeLinksNum(inLinks, isActive);
+	metrics.outboundLinksNum = GetNodeLinksNum(outLinks, isActive);
+	metrics.inboundNeighboursNum = GetNeighboursNum(inLinks, isActive);
+	metrics.outboundNeighboursNum = GetNeighboursNum(outLinks, isActive);
+
+	if (IsInductor(metrics.inboundLinksNum, metrics.outboundLinksNum))
+	{
+		metrics.type = NodeType::Inductor;
+	}
+	else if (IsCollector(metrics.inboundLinksNum, metrics.outboundLinksNum))
+	{
+		metrics.type = NodeType::Collector;
+	}
+
+	metrics.localLinksIndex = CalcLinksIndex(metrics.inboundLinksNum + metrics.outboundLinksNum,
+		metrics.inboundNeighboursNum + metrics.outboundNeighboursNum + 1);
+
+	return metrics;
+}
+
+std::vector<NodeMetrics> CalcNodeMetrics(const web_graph::GraphView& view, size_t threadsNum)
+{
+	using namespace web_graph;
+
+	std::vector<const WebPageNode*> nodes;
+	nodes.reserve(view.GetNodesNum());
+	for (const auto& node : GetNodes(view.GetGraph()))
+	{
+		if (view.IsActive(*node.second))
+		{
+			nodes.push_back(node.second.get());
+		}
+	}
+
+	std::vector<NodeMetrics> result(GetNodeIdBound(view.GetGraph()));
+	RunKernel(view, [&](const auto& isActive)
+	{
+		common::ParallelFor(threadsNum, nodes.size(), [&](size_t begin, size_t end, size_t)
+		{
+			for (size_t i{ begin }; i < end; ++i)
+			{
+				result[GetNodeId(*nodes[i])] = CalcNodeMetrics(*nodes[i], isActive);
+			}
+		});
+
+		return 0;
+	});
+
+	return result;
+}
+
+GraphAnalysisResult Analyze(const web_graph::GraphView& view, const std::vector<NodeMetrics>& nodeMetrics)
+{
+	using namespace web_graph;
+
+	GraphAnalysisResult result{};
+	result.linksIndex = CalcLinksIndex(view);
+
+	// Summed in the order of the nodes of the graph like the other metrics do, so the results are the same
+	size_t nodesWithOneOrMoreInOutLinksNum{ 0 };
+	size_t nodesWithTotalLinksNotLessThan2_Num{ 0 };
+	double linkIndexSum{ 0.0 };
+	for (const auto& node : GetNodes(view.GetGraph()))
+	{
+		if (!view.IsActive(*node.second))
+		{
+			continue;
+		}
+
+		const NodeMetrics& metrics = nodeMetrics[GetNodeId(*node.second)];
+		const size_t neighboursNum{ metrics.inboundNeighboursNum + metrics.outboundNeighboursNum };
+		nodesWithOneOrMoreInOutLinksNum += neighboursNum > 0;
+		if (neighboursNum >= 2)
+		{
+			++nodesWithTotalLinksNotLessThan2_Num;
+			linkIndexSum += metrics.localLinksIndex;
+		}
+
+		switch (metrics.type)
+		{
+		case NodeType::Inductor: ++result.inductorNum; break;
+		case NodeType::Collector: ++result.collectorsNum; break;
+		case NodeType::Mediator: ++result.mediatorsNum; break;
+		}
+	}
+
+	result.edgesIndex = view.GetNodesNum() ?
+		static_cast<double>(nodesWithOneOrMoreInOutLinksNum) / view.GetNodesNum() : 0.0;
+	result.clusteringCoeff = nodesWithTotalLinksNotLessThan2_Num ?
+		linkIndexSum / nodesWithTotalLinksNotLessThan2_Num : 0.0;
+
+	return result;
+}
+
 bool ShouldBeDeleted(double chance)
 {
 	if (chance == 1.0)
@@ -209,36 +696,32 @@ bool ShouldBeDeleted(double chance)
 	return value <= chance;
 }
 
-void SimulateNodesDeletion(const web_graph::WebGraph& graph, double chance)
+web_graph::GraphView SimulateNodesDeletion(const web_graph::WebGraph& graph, double chance)
 {
 	if (chance < 0.0 || chance > 1.0)
 	{
 		throw std::invalid_argument{ "Chance should be within [0, 1]" };
 	}
 
-	if (chance != 0.0)
+	using namespace web_graph;
+
+	// Nodes already marked as deleted stay deleted
+	GraphView view{ common::MakeActiveView(graph) };
+	if (chance == 0.0)
 	{
-		using namespace web_graph;
-		const Nodes& nodes = GetNodes(graph);
+		return view;
+	}
 
-		for (auto& nodeData : nodes)
+	NodeMask active{ GetNodeIdBound(graph) };
+	for (const auto& node : GetNodes(graph))
+	{
+		if (view.IsActive(*node.second) && !ShouldBeDeleted(chance))
 		{
-			WebPageNode& node = *nodeData.second;
-			bool alreadyMarkedAsDeleted{ common::NodeMarkedAsDeleted(node) };
-
-			if (ShouldBeDeleted(chance))
-			{
-				if (!alreadyMarkedAsDeleted)
-				{
-					common::MarkNodeAsDeleted(node);
-				}
-			}
-			else if(alreadyMarkedAsDeleted)
-			{
-				common::MarkNodeAsNotDeleted(node);
-			}
+			active.Set(GetNodeId(*node.second));
 		}
 	}
+
+	return { graph, std::move(active) };
 }
 
 }// analyze
\ No newline at end of file
@@ -1,44 +1,110 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include "WebGraph.h"
+#include "GraphView.h"
+#include "CompressedGraph.h"
 
 namespace analyze
 {
 
+// Every metric takes either a view or a graph. A graph is analyzed without the nodes marked as deleted,
+// links from or to inactive nodes are ignored. A compressed graph is analyzed as a whole
+
 // Num of nodes with at least 1 inbound and outbound link / total num of nodes
 // Number of nodes included into information interaction
+double CalcEdgesIndex(const web_graph::GraphView& view);
 double CalcEdgesIndex(const web_graph::WebGraph& graph);
+double CalcEdgesIndex(const web_graph::CompressedGraph& graph);
 
 // Net density :
 // num of edges / (node of nodes * (num of nodes - 1))) or 0 if nodes num <= 1
+double CalcLinksIndex(const web_graph::GraphView& view);
 double CalcLinksIndex(const web_graph::WebGraph& graph);
+double CalcLinksIndex(const web_graph::CompressedGraph& graph);
 
 // The degree of coherense of the graph
 // N = set of nodes with in + out links num >= 2
 // Proximity subgraph of node = subgraph made of the node and it's adjacent nodes
 // Sum = sum of local link indexes of N
 // Clustering coeff = Sum / sizeof(N)
+double CalcClusteringCoeff(const web_graph::GraphView& view);
 double CalcClusteringCoeff(const web_graph::WebGraph& graph);
+double CalcClusteringCoeff(const web_graph::CompressedGraph& graph);
 
+void GetNodesTypesNum(
+	const web_graph::GraphView& view,
+	size_t& inductorsNum,
+	size_t& collectorsNum,
+	size_t& mediatorsNum);
 void GetNodesTypesNum(
 	const web_graph::WebGraph& graph,
 	size_t& inductorsNum,
 	size_t& collectorsNum,
 	size_t& mediatorsNum);
+void GetNodesTypesNum(
+	const web_graph::CompressedGraph& graph,
+	size_t& inductorsNum,
+	size_t& collectorsNum,
+	size_t& mediatorsNum);
+
+// How the links are counted by Analyze, whether the inactive nodes are skipped is up to the view
+struct AnalysisOptions
+{
+	// Multiple links between two nodes count as many links, otherwise as one
+	bool weighted{ true };
+	// Links both ways between two nodes are two links, otherwise the graph is taken as undirected:
+	// the two nodes have one link, with the multiplicities of both ways if weighted, and the densities
+	// are taken against the num of node pairs
+	bool directed{ true };
+};
 
 struct GraphAnalysisResult
 {
 	double edgesIndex;
 	double linksIndex;
 	double clusteringCoeff;
+	// Zero if the options are undirected, the types of the nodes need the directions of their links
 	size_t inductorNum;
 	size_t collectorsNum;
 	size_t mediatorsNum;
+	// The result was computed with
+	AnalysisOptions options;
 };
 
+// Every metric in one pass, the combination of the options and of the view mask runs its own kernel
+GraphAnalysisResult Analyze(const web_graph::GraphView& view, const AnalysisOptions& options);
+GraphAnalysisResult Analyze(const web_graph::GraphView& view);
 GraphAnalysisResult Analyze(const web_graph::WebGraph& graph);
+GraphAnalysisResult Analyze(const web_graph::CompressedGraph& graph);
+
+enum class NodeType : uint8_t { Inductor, Collector, Mediator };
+
+// Metrics of a node the global ones are made of, links from or to inactive nodes are ignored
+struct NodeMetrics
+{
+	// Counting multiple links
+	size_t inboundLinksNum{ 0 };
+	size_t outboundLinksNum{ 0 };
+	// Distinct neighbours
+	size_t inboundNeighboursNum{ 0 };
+	size_t outboundNeighboursNum{ 0 };
+	NodeType type{ NodeType::Mediator };
+	// Links index of the subgraph of the node and its neighbours,
+	// the clustering coeff counts it for the nodes with 2 or more neighbours only
+	double localLinksIndex{ 0.0 };
+};
+
+// Metrics of the active nodes indexed by node id, computed on up to threadsNum threads.
+// The entries of the inactive nodes are zero
+std::vector<NodeMetrics> CalcNodeMetrics(const web_graph::GraphView& view, size_t threadsNum);
+// The same result as Analyze(view) with the default options made of the metrics of its nodes
+GraphAnalysisResult Analyze(const web_graph::GraphView& view, const std::vector<NodeMetrics>& nodeMetrics);
 
-// Mark nodes as deleted with the specified chance(should be within [0, 1])
-void SimulateNodesDeletion(const web_graph::WebGraph& graph, double chance);
+// View of the graph with nodes deleted with the specified chance(should be within [0, 1]).
+// The graph itself is not modified, so several scenarios can share it
+web_graph::GraphView SimulateNodesDeletion(const web_graph::WebGraph& graph, double chance);
 
 }// analyze
\ No newline at end of file
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+namespace common
+{
+
+struct QueueLevel
+{
+	size_t items{ 0 };
+	size_t bytes{ 0 };
+};
+
+// FIFO queue bounded both by the number of items and by their total size in bytes.
+// Producers block while the queue is full, consumers block while it is empty.
+// An item bigger than the byte capacity is still accepted by an empty queue
+template<typename T>
+class BoundedQueue
+{
+public:
+	BoundedQueue(size_t maxItems, size_t maxBytes) noexcept
+		: m_maxItems(maxItems), m_maxBytes(maxBytes) {}
+
+	void SetCapacity(size_t maxItems, size_t maxBytes) noexcept
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		m_maxItems = maxItems;
+		m_maxBytes = maxBytes;
+		m_notFull.notify_all();
+	}
+
+	// Blocks while the queue is full, returns false if the queue has been closed.
+	// The time spent blocked is added to blockedTime, level receives the fill level after the push
+	bool Push(T&& item, size_t bytes, QueueLevel& level, std::chrono::steady_clock::duration& blockedTime)
+	{
+		std::unique_lock<std::mutex> l{ m_mutex };
+		if (!HasRoom(bytes) && !m_closed)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			m_notFull.wait(l, [&] { return HasRoom(bytes) || m_closed; });
+			blockedTime += std::chrono::steady_clock::now() - start;
+		}
+
+		if (m_closed)
+		{
+			return false;
+		}
+
+		m_items.emplace_back(std::move(item), bytes);
+		m_bytes += bytes;
+		level = { m_items.size(), m_bytes };
+
+		m_notEmpty.notify_one();
+		return true;
+	}
+
+	// Blocks while the queue is empty, returns false if the queue is closed and empty
+	bool Pop(T& item, QueueLevel& level)
+	{
+		std::unique_lock<std::mutex> l{ m_mutex };
+		m_notEmpty.wait(l, [&] { return !m_items.empty() || m_closed; });
+		if (m_items.empty())
+		{
+			return false;
+		}
+
+		item = std::move(m_items.front().first);
+		m_bytes -= m_items.front().second;
+		m_items.pop_front();
+		level = { m_items.size(), m_bytes };
+
+		m_notFull.notify_one();
+		return true;
+	}
+
+	// Wakes up all waiting threads, pushes fail from now on, pops drain the rest
+	void Close()
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		m_closed = true;
+		m_notFull.notify_all();
+		m_notEmpty.notify_all();
+	}
+
+	void Reset()
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		m_items.clear();
+		m_bytes = 0;
+		m_closed = false;
+	}
+
+	QueueLevel GetLevel() const
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		return { m_items.size(), m_bytes };
+	}
+
+private:
+	bool HasRoom(size_t bytes) const noexcept
+	{
+		return m_items.empty() ||
+			(m_items.size() < m_maxItems && m_bytes + bytes <= m_maxBytes);
+	}
+
+private:
+	mutable std::mutex m_mutex;
+	std::condition_variable m_notFull;
+	std::condition_variable m_notEmpty;
+
+	std::deque<std::pair<T, size_t>> m_items;
+	size_t m_bytes{ 0 };
+	size_t m_maxItems;
+	size_t m_maxBytes;
+	bool m_closed{ false };
+};
+
+}// namespace common
@@ -1,25 +1,50 @@
 #pragma once
 
 #include "WebGraph.h"
+#include "GraphView.h"
 
 namespace common
 {
 
 enum class Tag : web_graph::TagId { MarkedAsDeleted };
 
-inline bool NodeMarkedAsDeleted(const web_graph::WebPageNode& node)
+inline bool NodeMarkedAsDeleted(const web_graph::WebGraph& graph, const web_graph::WebPageNode& node) noexcept
 {
-	return web_graph::HasTag(node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
+	return web_graph::HasTag(graph, node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
 }
 
-inline void MarkNodeAsDeleted(web_graph::WebPageNode& node)
+inline void MarkNodeAsDeleted(web_graph::WebGraph& graph, const web_graph::WebPageNode& node)
 {
-	web_graph::AddTag(node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
+	web_graph::AddTag(graph, node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
 }
 
-inline void MarkNodeAsNotDeleted(web_graph::WebPageNode& node)
+inline void MarkNodeAsNotDeleted(web_graph::WebGraph& graph, const web_graph::WebPageNode& node)
 {
-	web_graph::DeleteTag(node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
+	web_graph::DeleteTag(graph, node, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
+}
+
+inline const web_graph::NodeMask& GetDeletedNodesMask(const web_graph::WebGraph& graph) noexcept
+{
+	return web_graph::GetTagMask(graph, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted));
+}
+
+inline void SetDeletedNodesMask(web_graph::WebGraph& graph, web_graph::NodeMask mask)
+{
+	web_graph::SetTagMask(graph, static_cast<web_graph::TagId>(Tag::MarkedAsDeleted), std::move(mask));
+}
+
+// View of the nodes not marked as deleted, unmasked if there are none
+inline web_graph::GraphView MakeActiveView(const web_graph::WebGraph& graph)
+{
+	const web_graph::NodeMask& deleted = GetDeletedNodesMask(graph);
+	if (!deleted.Any())
+	{
+		return web_graph::GraphView{ graph };
+	}
+
+	web_graph::NodeMask active{ web_graph::GetNodeIdBound(graph), true };
+	active.AndNot(deleted);
+	return { graph, std::move(active) };
 }
 
 }
@@ -0,0 +1,328 @@
+#include "CompressedGraph.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace web_graph
+{
+
+static constexpr NodeId InvalidNode{ UINT32_MAX };
+
+static void PutVarint(uint8_t*& out, uint64_t value) noexcept
+{
+	while (value >= 0x80)
+	{
+		*out++ = static_cast<uint8_t>(value | 0x80);
+		value >>= 7;
+	}
+
+	*out++ = static_cast<uint8_t>(value);
+}
+
+static size_t GetVarintSize(uint64_t value) noexcept
+{
+	size_t size{ 1 };
+	while (value >= 0x80)
+	{
+		value >>= 7;
+		++size;
+	}
+
+	return size;
+}
+
+// The first neighbour is relative to the node the list belongs to, the next ones to the previous neighbour
+static uint64_t EncodeDelta(NodeId neighbour, NodeId previous, bool first) noexcept
+{
+	if (first)
+	{
+		const int64_t delta{ static_cast<int64_t>(neighbour) - static_cast<int64_t>(previous) };
+		return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+	}
+
+	return neighbour - previous - 1;
+}
+
+static size_t GetLinkSize(uint64_t delta, NodeLinkNum count) noexcept
+{
+	return GetVarintSize((delta << 1) | (count > 1)) + (count > 1 ? GetVarintSize(count - 2) : 0);
+}
+
+static void PutLink(uint8_t*& out, uint64_t delta, NodeLinkNum count) noexcept
+{
+	PutVarint(out, (delta << 1) | (count > 1));
+	if (count > 1)
+	{
+		PutVarint(out, count - 2);
+	}
+}
+
+CompressedGraph::Builder::Builder(size_t nodesNum)
+	: m_nodesNum(nodesNum)
+{
+	if (nodesNum >= InvalidNode)
+	{
+		throw std::invalid_argument{ "Too many nodes" };
+	}
+
+	m_graph.m_outbound.offsets.reserve(nodesNum + 1);
+}
+
+void CompressedGraph::Builder::AddNode(std::vector<Link>& links)
+{
+	std::vector<uint64_t>& offsets = m_graph.m_outbound.offsets;
+	if (offsets.size() > m_nodesNum)
+	{
+		throw std::logic_error{ "All the nodes are already added" };
+	}
+
+	std::sort(links.begin(), links.end(), [](const Link& left, const Link& right) { return left.node < right.node; });
+
+	// Repeated targets are merged into the first of them
+	auto last = links.begin();
+	for (auto it = links.begin(); it != links.end(); ++it)
+	{
+		if (it->node >= m_nodesNum)
+		{
+			throw std::invalid_argument{ "Link target is out of range" };
+		}
+
+		if (it != last && it->node == last->node)
+		{
+			last->count += it->count;
+		}
+		else if (it != links.begin())
+		{
+			*++last = *it;
+		}
+	}
+
+	links.erase(links.empty() ? links.end() : last + 1, links.end());
+
+	const NodeId node{ static_cast<NodeId>(offsets.size() - 1) };
+	std::vector<uint8_t>& bytes = m_graph.m_outbound.bytes;
+
+	size_t size{ 0 };
+	NodeId previous{ node };
+	for (const Link& link : links)
+	{
+		size += GetLinkSize(EncodeDelta(link.node, previous, link.node == links.front().node), link.count);
+		previous = link.node;
+	}
+
+	const size_t begin{ bytes.size() };
+	bytes.resize(begin + size);
+
+	uint8_t* out{ bytes.data() + begin };
+	previous = node;
+	for (const Link& link : links)
+	{
+		PutLink(out, EncodeDelta(link.node, previous, link.node == links.front().node), link.count);
+		previous = link.node;
+		m_graph.m_linksNum += link.count;
+	}
+
+	offsets.push_back(bytes.size());
+}
+
+CompressedGraph CompressedGraph::Builder::Build()
+{
+	// Nodes not added have no outbound links
+	std::vector<uint64_t>& offsets = m_graph.m_outbound.offsets;
+	offsets.resize(m_nodesNum + 1, offsets.back());
+	m_graph.m_outbound.bytes.shrink_to_fit();
+
+	m_graph.BuildInbound();
+	return std::move(m_graph);
+}
+
+void CompressedGraph::BuildInbound()
+{
+	const size_t nodesNum{ GetNodesNum() };
+
+	// Sources come in ascending order, so the inbound lists are sorted as they are filled.
+	// The first pass sizes every list, the second one encodes the links in place
+	std::vector<uint64_t>& offsets = m_inbound.offsets;
+	offsets.assign(nodesNum + 1, 0);
+	std::vector<NodeId> previous(nodesNum, InvalidNode);
+
+	for (NodeId from{ 0 }; from < nodesNum; ++from)
+	{
+		for (const Link& link : GetOutboundLinks(from))
+		{
+			const bool first{ previous[link.node] == InvalidNode };
+			offsets[link.node + 1] += GetLinkSize(EncodeDelta(from, first ? link.node : previous[link.node], first), link.count);
+			previous[link.node] = from;
+		}
+	}
+
+	for (size_t i{ 0 }; i < nodesNum; ++i)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	m_inbound.bytes.resize(offsets.back());
+
+	std::vector<uint64_t> cursors{ offsets.begin(), offsets.end() - 1 };
+	std::fill(previous.begin(), previous.end(), InvalidNode);
+
+	for (NodeId from{ 0 }; from < nodesNum; ++from)
+	{
+		for (const Link& link : GetOutboundLinks(from))
+		{
+			const bool first{ previous[link.node] == InvalidNode };
+			uint8_t* out{ m_inbound.bytes.data() + cursors[link.node] };
+			PutLink(out, EncodeDelta(from, first ? link.node : previous[link.node], first), link.count);
+
+			cursors[link.node] = static_cast<uint64_t>(out - m_inbound.bytes.data());
+			previous[link.node] = from;
+		}
+	}
+}
+
+CompressedGraph::CompressedGraph(const GraphView& view)
+{
+	const WebGraph& graph = view.GetGraph();
+	const NodeId idBound{ GetNodeIdBound(graph) };
+
+	std::vector<const WebPageNode*> nodes(idBound, nullptr);
+	for (const auto& node : GetNodes(graph))
+	{
+		if (view.IsActive(*node.second))
+		{
+			nodes[GetNodeId(*node.second)] = node.second.get();
+		}
+	}
+
+	std::vector<NodeId> sourceIds;
+	sourceIds.reserve(view.GetNodesNum());
+	std::vector<NodeId> ids(idBound, InvalidNode);
+	for (NodeId id{ 0 }; id < idBound; ++id)
+	{
+		if (nodes[id])
+		{
+			ids[id] = static_cast<NodeId>(sourceIds.size());
+			sourceIds.push_back(id);
+		}
+	}
+
+	Builder builder{ sourceIds.size() };
+	std::vector<Link> links;
+	for (NodeId sourceId : sourceIds)
+	{
+		links.clear();
+		for (const auto& linkInfo : GetOutboundNodeLinks(*nodes[sourceId]))
+		{
+			const NodeId target{ ids[GetNodeId(*linkInfo.first)] };
+			if (target != InvalidNode)
+			{
+				links.push_back({ target, linkInfo.second });
+			}
+		}
+
+		builder.AddNode(links);
+	}
+
+	*this = builder.Build();
+	m_sourceIds = std::move(sourceIds);
+}
+
+CompressedGraph CompressedGraph::Relabel(const std::vector<NodeId>& order) const
+{
+	const size_t nodesNum{ GetNodesNum() };
+	if (order.size() != nodesNum)
+	{
+		throw std::invalid_argument{ "Order should have every node once" };
+	}
+
+	std::vector<NodeId> ids(nodesNum, InvalidNode);
+	for (NodeId id{ 0 }; id < nodesNum; ++id)
+	{
+		if (order[id] >= nodesNum || ids[order[id]] != InvalidNode)
+		{
+			throw std::invalid_argument{ "Order should have every node once" };
+		}
+
+		ids[order[id]] = id;
+	}
+
+	Builder builder{ nodesNum };
+	std::vector<Link> links;
+	for (NodeId node : order)
+	{
+		links.clear();
+		for (const Link& link : GetOutboundLinks(node))
+		{
+			links.push_back({ ids[link.node], link.count });
+		}
+
+		builder.AddNode(links);
+	}
+
+	CompressedGraph result{ builder.Build() };
+	result.m_sourceIds.resize(nodesNum);
+	for (NodeId id{ 0 }; id < nodesNum; ++id)
+	{
+		result.m_sourceIds[id] = GetSourceId(order[id]);
+	}
+
+	return result;
+}
+
+size_t CompressedGraph::GetNodesNum() const noexcept
+{
+	return m_outbound.offsets.size() - 1;
+}
+
+size_t CompressedGraph::GetLinksNum() const noexcept
+{
+	return m_linksNum;
+}
+
+CompressedGraph::Links CompressedGraph::GetOutboundLinks(NodeId node) const noexcept
+{
+	return m_outbound.GetLinks(node);
+}
+
+CompressedGraph::Links CompressedGraph::GetInboundLinks(NodeId node) const noexcept
+{
+	return m_inbound.GetLinks(node);
+}
+
+NodeId CompressedGraph::GetSourceId(NodeId node) const noexcept
+{
+	return m_sourceIds.empty() ? node : m_sourceIds[node];
+}
+
+size_t CompressedGraph::GetMemoryBytes() const noexcept
+{
+	return sizeof(*this) +
+		(m_outbound.offsets.capacity() + m_inbound.offsets.capacity()) * sizeof(uint64_t) +
+		m_outbound.bytes.capacity() + m_inbound.bytes.capacity() +
+		m_sourceIds.capacity() * sizeof(NodeId);
+}
+
+std::vector<std::string_view> GetNodeUrls(const CompressedGraph& compressed, const WebGraph& graph)
+{
+	std::vector<const WebPageNode*> nodes(GetNodeIdBound(graph), nullptr);
+	for (const auto& node : GetNodes(graph))
+	{
+		nodes[GetNodeId(*node.second)] = node.second.get();
+	}
+
+	std::vector<std::string_view> urls(compressed.GetNodesNum());
+	for (NodeId node{ 0 }; node < urls.size(); ++node)
+	{
+		const NodeId sourceId{ compressed.GetSourceId(node) };
+		if (sourceId >= nodes.size() || !nodes[sourceId])
+		{
+			throw std::invalid_argument{ "Compressed graph is not made of the graph" };
+		}
+
+		urls[node] = GetNodeUrl(*nodes[sourceId]);
+	}
+
+	return urls;
+}
+
+}// namespace web_graph
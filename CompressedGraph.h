@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include <string_view>
+
+#include "WebGraph.h"
+#include "GraphView.h"
+
+namespace web_graph
+{
+
+// Frozen graph with both adjacency directions stored as gap encoded varints, a few bytes per link
+// instead of the hash map entries of WebGraph. Nodes are numbered densely from 0.
+// Every list is sorted by neighbour id: the first neighbour is stored as a zigzag delta from the node itself,
+// the rest as gaps from the previous one. The lowest bit of a gap tells whether a link count follows,
+// so single links, the vast majority, cost no extra byte
+class CompressedGraph
+{
+public:
+	struct Link
+	{
+		NodeId node;
+		NodeLinkNum count;
+	};
+
+	// Decodes a list on the fly, only the current link is kept
+	class LinkIterator
+	{
+	public:
+		using iterator_category = std::input_iterator_tag;
+		using value_type = Link;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const Link*;
+		using reference = const Link&;
+
+		LinkIterator(const uint8_t* pos, const uint8_t* end, NodeId node) noexcept
+			: m_pos(pos), m_end(end), m_link{ node, 0 }, m_valid(pos != end)
+		{
+			// The first neighbour is a zigzag delta from the node
+			if (m_valid)
+			{
+				const uint64_t value{ ReadVarint(m_pos) };
+				const uint64_t delta{ value >> 1 };
+				m_link.node += static_cast<NodeId>((delta >> 1) ^ (0 - (delta & 1)));
+				ReadCount(value);
+			}
+		}
+
+		reference operator*() const noexcept { return m_link; }
+		pointer operator->() const noexcept { return &m_link; }
+
+		LinkIterator& operator++() noexcept
+		{
+			m_valid = m_pos != m_end;
+			if (m_valid)
+			{
+				const uint64_t value{ ReadVarint(m_pos) };
+				m_link.node += static_cast<NodeId>((value >> 1) + 1);
+				ReadCount(value);
+			}
+
+			return *this;
+		}
+
+		bool operator==(const LinkIterator& other) const noexcept
+		{
+			return m_pos == other.m_pos && m_valid == other.m_valid;
+		}
+
+		bool operator!=(const LinkIterator& other) const noexcept { return !(*this == other); }
+
+	private:
+		void ReadCount(uint64_t value) noexcept
+		{
+			m_link.count = (value & 1) ? static_cast<NodeLinkNum>(ReadVarint(m_pos)) + 2 : 1;
+		}
+
+	private:
+		const uint8_t* m_pos;
+		const uint8_t* m_end;
+		Link m_link;
+		bool m_valid;
+	};
+
+	class Links
+	{
+	public:
+		Links(const uint8_t* begin, const uint8_t* end, NodeId node) noexcept
+			: m_begin(begin), m_end(end), m_node(node) {}
+
+		LinkIterator begin() const noexcept { return { m_begin, m_end, m_node }; }
+		LinkIterator end() const noexcept { return { m_end, m_end, m_node }; }
+		bool empty() const noexcept { return m_begin == m_end; }
+
+	private:
+		const uint8_t* m_begin;
+		const uint8_t* m_end;
+		NodeId m_node;
+	};
+
+	class Builder;
+
+	// Frozen copy of the active part of the view, the nodes keep the order of their ids
+	explicit CompressedGraph(const GraphView& view);
+
+	size_t GetNodesNum() const noexcept;
+	size_t GetLinksNum() const noexcept;
+	Links GetOutboundLinks(NodeId node) const noexcept;
+	Links GetInboundLinks(NodeId node) const noexcept;
+	// Id of the node in the graph it was made of, the same id if it was built
+	NodeId GetSourceId(NodeId node) const noexcept;
+	size_t GetMemoryBytes() const noexcept;
+
+	// Copy with the nodes renumbered, node i of the copy is the node order[i]. The source ids follow the nodes
+	CompressedGraph Relabel(const std::vector<NodeId>& order) const;
+
+private:
+	struct Adjacency
+	{
+		// Lists of node i are within [offsets[i], offsets[i + 1])
+		std::vector<uint64_t> offsets{ 0 };
+		std::vector<uint8_t> bytes;
+
+		Links GetLinks(NodeId node) const noexcept
+		{
+			return { bytes.data() + offsets[node], bytes.data() + offsets[node + 1], node };
+		}
+	};
+
+	CompressedGraph() = default;
+	void BuildInbound();
+
+	static uint64_t ReadVarint(const uint8_t*& pos) noexcept
+	{
+		uint64_t value{ *pos++ };
+		if (value < 0x80)
+		{
+			return value;
+		}
+
+		value &= 0x7f;
+		for (unsigned shift{ 7 };; shift += 7)
+		{
+			const uint8_t byte{ *pos++ };
+			value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+			if (byte < 0x80)
+			{
+				return value;
+			}
+		}
+	}
+
+private:
+	Adjacency m_outbound;
+	Adjacency m_inbound;
+	std::vector<NodeId> m_sourceIds;
+	size_t m_linksNum{ 0 };
+};
+
+// Urls of the nodes by their id in the compressed graph made of the given one
+std::vector<std::string_view> GetNodeUrls(const CompressedGraph& compressed, const WebGraph& graph);
+
+// Takes the outbound links node by node, the inbound ones are derived from them on Build()
+// with memory proportional to the nodes only
+class CompressedGraph::Builder
+{
+public:
+	explicit Builder(size_t nodesNum);
+
+	// Outbound links of the next node in any order, the counts of repeated targets are summed.
+	// The links are sorted and merged in place
+	void AddNode(std::vector<Link>& links);
+	CompressedGraph Build();
+
+private:
+	CompressedGraph m_graph;
+	size_t m_nodesNum;
+};
+
+}// namespace web_graph
@@ -0,0 +1,296 @@
+#include "ContentHash.h"
+
+#include <bitset>
+#include <cstring>
+#include <algorithm>
+
+#include "StringUtils.h"
+
+namespace web_graph
+{
+
+static uint64_t Rotl(uint64_t value, int shift) noexcept
+{
+	return (value << shift) | (value >> (64 - shift));
+}
+
+static uint64_t Mix(uint64_t value) noexcept
+{
+	value ^= value >> 33;
+	value *= 0xff51afd7ed558ccdull;
+	value ^= value >> 33;
+	value *= 0xc4ceb9fe1a85ec53ull;
+	value ^= value >> 33;
+	return value;
+}
+
+static bool IsWordChar(char c) noexcept
+{
+	// Bytes of multibyte UTF-8 sequences are word chars too
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9') || static_cast<unsigned char>(c) >= 0x80;
+}
+
+// Value of the attribute within the tag, quoted or not
+static std::string_view GetAttribute(std::string_view tag, std::string_view lowerName) noexcept
+{
+	for (size_t pos{ common::FindIgnoreCase(tag, lowerName, 0) }; pos != std::string_view::npos; pos = common::FindIgnoreCase(tag, lowerName, pos + 1))
+	{
+		if (!pos || !common::IsSpace(tag[pos - 1]))
+		{
+			continue;
+		}
+
+		size_t valuePos{ pos + lowerName.size() };
+		while (valuePos < tag.size() && common::IsSpace(tag[valuePos]))
+		{
+			++valuePos;
+		}
+
+		if (valuePos == tag.size() || tag[valuePos] != '=')
+		{
+			continue;
+		}
+
+		valuePos = tag.find_first_not_of(" \t\r\n\f", valuePos + 1);
+		if (valuePos == std::string_view::npos)
+		{
+			return {};
+		}
+
+		if (tag[valuePos] == '"' || tag[valuePos] == '\'')
+		{
+			const size_t valueEnd{ tag.find(tag[valuePos], valuePos + 1) };
+			return valueEnd != std::string_view::npos ? tag.substr(valuePos + 1, valueEnd - valuePos - 1) : std::string_view{};
+		}
+
+		const size_t valueEnd{ std::min(tag.find_first_of(" \t\r\n\f/", valuePos), tag.size()) };
+		return tag.substr(valuePos, valueEnd - valuePos);
+	}
+
+	return {};
+}
+
+ContentHash HashContent(std::string_view data) noexcept
+{
+	static constexpr uint64_t c1{ 0x87c37b91114253d5ull };
+	static constexpr uint64_t c2{ 0x4cf5ad432745937full };
+
+	uint64_t h1{ 0 };
+	uint64_t h2{ 0 };
+
+	const size_t blocksNum{ data.size() / 16 };
+	for (size_t i{ 0 }; i < blocksNum; ++i)
+	{
+		uint64_t k1{ 0 }, k2{ 0 };
+		std::memcpy(&k1, data.data() + i * 16, sizeof(k1));
+		std::memcpy(&k2, data.data() + i * 16 + 8, sizeof(k2));
+
+		h1 ^= Rotl(k1 * c1, 31) * c2;
+		h1 = (Rotl(h1, 27) + h2) * 5 + 0x52dce729;
+
+		h2 ^= Rotl(k2 * c2, 33) * c1;
+		h2 = (Rotl(h2, 31) + h1) * 5 + 0x38495ab5;
+	}
+
+	const unsigned char* tail{ reinterpret_cast<const unsigned char*>(data.data()) + blocksNum * 16 };
+	const size_t tailSize{ data.size() % 16 };
+
+	uint64_t k1{ 0 }, k2{ 0 };
+	for (size_t i{ tailSize }; i > 8; --i)
+	{
+		k2 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 9) * 8);
+	}
+
+	for (size_t i{ std::min<size_t>(tailSize, 8) }; i > 0; --i)
+	{
+		k1 ^= static_cast<uint64_t>(tail[i - 1]) << ((i - 1) * 8);
+	}
+
+	if (tailSize > 8)
+	{
+		h2 ^= Rotl(k2 * c2, 33) * c1;
+	}
+
+	if (tailSize)
+	{
+		h1 ^= Rotl(k1 * c1, 31) * c2;
+	}
+
+	h1 ^= data.size();
+	h2 ^= data.size();
+	h1 += h2;
+	h2 += h1;
+	h1 = Mix(h1);
+	h2 = Mix(h2);
+	h1 += h2;
+	h2 += h1;
+
+	return { h1, h2 };
+}
+
+uint64_t SimHash(std::string_view html) noexcept
+{
+	static constexpr size_t ShingleSize{ 3 };
+	// Short texts of different pages are too alike, e.g. a few words around the same menu
+	static constexpr size_t MinShingles{ 16 };
+
+	int32_t weights[64]{};
+	uint64_t window[ShingleSize]{};
+	size_t tokensNum{ 0 };
+
+	auto addToken = [&](uint64_t token)
+	{
+		window[tokensNum++ % ShingleSize] = token;
+		if (tokensNum < ShingleSize)
+		{
+			return;
+		}
+
+		uint64_t shingle{ 0 };
+		for (size_t i{ tokensNum - ShingleSize }; i < tokensNum; ++i)
+		{
+			shingle = Mix(Rotl(shingle, 21) ^ window[i % ShingleSize]);
+		}
+
+		for (size_t bit{ 0 }; bit < 64; ++bit)
+		{
+			weights[bit] += ((shingle >> bit) & 1) ? 1 : -1;
+		}
+	};
+
+	uint64_t token{ 14695981039346656037ull };
+	bool inToken{ false };
+
+	for (size_t i{ 0 }; i < html.size(); ++i)
+	{
+		const char c{ html[i] };
+		if (IsWordChar(c))
+		{
+			// FNV-1a of the lowercased word
+			token = (token ^ static_cast<unsigned char>(common::ToLowerAscii(c))) * 1099511628211ull;
+			inToken = true;
+			continue;
+		}
+
+		if (inToken)
+		{
+			addToken(token);
+			token = 14695981039346656037ull;
+			inToken = false;
+		}
+
+		if (c != '<')
+		{
+			continue;
+		}
+
+		// Markup and scripts are not the text
+		const std::string_view tag{ html.substr(i + 1) };
+		size_t end{ std::string_view::npos };
+		if (common::HasPrefixIgnoreCase(tag, "script"))
+		{
+			end = common::FindIgnoreCase(html, "</script", i + 1);
+		}
+		else if (common::HasPrefixIgnoreCase(tag, "style"))
+		{
+			end = common::FindIgnoreCase(html, "</style", i + 1);
+		}
+		else if (tag.compare(0, 3, "!--") == 0)
+		{
+			end = html.find("-->", i + 1);
+		}
+
+		end = html.find('>', end != std::string_view::npos ? end : i + 1);
+		if (end == std::string_view::npos)
+		{
+			break;
+		}
+
+		i = end;
+	}
+
+	if (inToken)
+	{
+		addToken(token);
+	}
+
+	if (tokensNum < MinShingles + ShingleSize - 1)
+	{
+		return 0;
+	}
+
+	uint64_t fingerprint{ 0 };
+	for (size_t bit{ 0 }; bit < 64; ++bit)
+	{
+		fingerprint |= static_cast<uint64_t>(weights[bit] > 0) << bit;
+	}
+
+	return fingerprint;
+}
+
+std::string_view FindCanonicalLink(std::string_view html) noexcept
+{
+	html = html.substr(0, common::FindIgnoreCase(html, "</head", 0));
+
+	for (size_t pos{ common::FindIgnoreCase(html, "<link", 0) }; pos != std::string_view::npos; pos = common::FindIgnoreCase(html, "<link", pos + 1))
+	{
+		const size_t end{ html.find('>', pos) };
+		if (end == std::string_view::npos)
+		{
+			break;
+		}
+
+		const std::string_view tag{ html.substr(pos, end - pos) };
+
+		// rel is a space separated list of link types
+		const std::string_view rel{ GetAttribute(tag, "rel") };
+		for (size_t typePos{ common::FindIgnoreCase(rel, "canonical", 0) }; typePos != std::string_view::npos;
+			typePos = common::FindIgnoreCase(rel, "canonical", typePos + 1))
+		{
+			const size_t typeEnd{ typePos + 9 };
+			if ((!typePos || common::IsSpace(rel[typePos - 1])) && (typeEnd == rel.size() || common::IsSpace(rel[typeEnd])))
+			{
+				return GetAttribute(tag, "href");
+			}
+		}
+	}
+
+	return {};
+}
+
+void SimHashIndex::Add(uint64_t fingerprint, WebPageNode* page)
+{
+	for (size_t block{ 0 }; block < BlocksNum; ++block)
+	{
+		m_blocks[block][static_cast<uint16_t>(fingerprint >> (block * 16))].emplace_back(fingerprint, page);
+	}
+}
+
+WebPageNode* SimHashIndex::Find(uint64_t fingerprint, uint32_t maxDistance) const noexcept
+{
+	WebPageNode* closest{ nullptr };
+	size_t closestDistance{ std::min(maxDistance, MaxDistance) + size_t{ 1 } };
+
+	for (size_t block{ 0 }; block < BlocksNum; ++block)
+	{
+		const auto it = m_blocks[block].find(static_cast<uint16_t>(fingerprint >> (block * 16)));
+		if (it == m_blocks[block].end())
+		{
+			continue;
+		}
+
+		for (const Entry& entry : it->second)
+		{
+			const size_t distance{ std::bitset<64>{ entry.first ^ fingerprint }.count() };
+			if (distance < closestDistance)
+			{
+				closest = entry.second;
+				closestDistance = distance;
+			}
+		}
+	}
+
+	return closest;
+}
+
+}// namespace web_graph
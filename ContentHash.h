@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace web_graph
+{
+
+struct WebPageNode;
+
+// 128-bit MurmurHash3 of a page body, collisions are practically impossible within a crawl
+struct ContentHash
+{
+	uint64_t low{ 0 };
+	uint64_t high{ 0 };
+
+	bool operator==(const ContentHash& other) const noexcept { return low == other.low && high == other.high; }
+};
+
+struct ContentHashHasher
+{
+	size_t operator()(const ContentHash& hash) const noexcept { return static_cast<size_t>(hash.low); }
+};
+
+ContentHash HashContent(std::string_view data) noexcept;
+
+// SimHash of the shingles of the visible text, pages with mostly the same text differ in a few bits.
+// Zero if the page has too little text to tell it from others
+uint64_t SimHash(std::string_view html) noexcept;
+
+// href of the <link rel="canonical"> in the head, empty if there is none
+std::string_view FindCanonicalLink(std::string_view html) noexcept;
+
+// Pages by SimHash. Fingerprints within the distance of 3 bits have at least one of
+// the four 16-bit blocks equal, so only the pages sharing a block are compared
+class SimHashIndex
+{
+public:
+	static constexpr uint32_t MaxDistance{ 3 };
+
+	void Add(uint64_t fingerprint, WebPageNode* page);
+	// The closest page within the distance, null if there is none
+	WebPageNode* Find(uint64_t fingerprint, uint32_t maxDistance) const noexcept;
+
+private:
+	static constexpr size_t BlocksNum{ MaxDistance + 1 };
+
+	using Entry = std::pair<uint64_t, WebPageNode*>;
+
+	std::array<std::unordered_map<uint16_t, std::vector<Entry>>, BlocksNum> m_blocks;
+};
+
+}// namespace web_graph
@@ -0,0 +1,272 @@
+#include "CrawlMetrics.h"
+
+#include <cstdio>
+#include <algorithm>
+#include <sstream>
+
+namespace metrics
+{
+
+void UpdateMax(std::atomic<uint64_t>& max, uint64_t value) noexcept
+{
+	uint64_t current{ max.load(std::memory_order_relaxed) };
+	while (current < value &&
+		!max.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+size_t GetBucket(uint64_t ns) noexcept
+{
+	const size_t bucket{ static_cast<size_t>(64 - __builtin_clzll(ns | 1)) };
+	return std::min(bucket, HistogramSnapshot::BucketsNum - 1);
+}
+
+const char* ToString(Stage stage) noexcept
+{
+	switch (stage)
+	{
+	case Stage::Dns: return "dns";
+	case Stage::Connect: return "connect";
+	case Stage::Ttfb: return "ttfb";
+	case Stage::Transfer: return "transfer";
+	case Stage::Fingerprint: return "fingerprint";
+	case Stage::Parse: return "parse";
+	case Stage::Insert: return "insert";
+	case Stage::LockWait: return "lock_wait";
+	default: return "unknown";
+	}
+}
+
+const char* ToString(ErrorCategory category) noexcept
+{
+	switch (category)
+	{
+	case ErrorCategory::Resolve: return "resolve";
+	case ErrorCategory::Connect: return "connect";
+	case ErrorCategory::Timeout: return "timeout";
+	case ErrorCategory::Ssl: return "ssl";
+	case ErrorCategory::Http: return "http";
+	case ErrorCategory::Parse: return "parse";
+	default: return "other";
+	}
+}
+
+void Gauge::Set(uint64_t value) noexcept
+{
+	m_value.store(value, std::memory_order_relaxed);
+	UpdateMax(m_max, value);
+}
+
+double HistogramSnapshot::MeanNs() const noexcept
+{
+	return count ? static_cast<double>(sumNs) / count : 0.0;
+}
+
+uint64_t HistogramSnapshot::PercentileNs(double percentile) const noexcept
+{
+	if (!count)
+	{
+		return 0;
+	}
+
+	const uint64_t rank{ static_cast<uint64_t>(percentile * (count - 1)) + 1 };
+	uint64_t accumulated{ 0 };
+	for (size_t i{ 0 }; i < BucketsNum; ++i)
+	{
+		accumulated += buckets[i];
+		if (accumulated >= rank)
+		{
+			return std::min(uint64_t{ 1 } << i, maxNs);
+		}
+	}
+
+	return maxNs;
+}
+
+void LatencyHistogram::Record(Clock::duration duration) noexcept
+{
+	const uint64_t ns{ static_cast<uint64_t>(
+		std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), 0)) };
+
+	m_buckets[GetBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+	m_count.fetch_add(1, std::memory_order_relaxed);
+	m_sumNs.fetch_add(ns, std::memory_order_relaxed);
+	UpdateMax(m_maxNs, ns);
+}
+
+HistogramSnapshot LatencyHistogram::Snapshot() const noexcept
+{
+	HistogramSnapshot snapshot;
+	for (size_t i{ 0 }; i < HistogramSnapshot::BucketsNum; ++i)
+	{
+		snapshot.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+	}
+
+	snapshot.count = m_count.load(std::memory_order_relaxed);
+	snapshot.sumNs = m_sumNs.load(std::memory_order_relaxed);
+	snapshot.maxNs = m_maxNs.load(std::memory_order_relaxed);
+	return snapshot;
+}
+
+uint64_t MetricsSnapshot::ErrorsNum() const noexcept
+{
+	uint64_t result{ 0 };
+	for (uint64_t errorsNum : errors)
+	{
+		result += errorsNum;
+	}
+
+	return result;
+}
+
+void CrawlMetrics::RecordStage(Stage stage, Clock::duration duration) noexcept
+{
+	stages[static_cast<size_t>(stage)].Record(duration);
+}
+
+void CrawlMetrics::RecordError(ErrorCategory category) noexcept
+{
+	errors[static_cast<size_t>(category)].Add();
+}
+
+MetricsSnapshot CrawlMetrics::Snapshot() const noexcept
+{
+	MetricsSnapshot snapshot;
+	snapshot.elapsedSec = std::chrono::duration<double>(Clock::now() - startTime).count();
+	snapshot.pagesDownloaded = pagesDownloaded.Get();
+	snapshot.pagesParsed = pagesParsed.Get();
+	snapshot.bytesDownloaded = bytesDownloaded.Get();
+	snapshot.linksFound = linksFound.Get();
+	snapshot.nodesAdded = nodesAdded.Get();
+	snapshot.pagesDisallowed = pagesDisallowed.Get();
+	snapshot.sitemapUrls = sitemapUrls.Get();
+	snapshot.pagesDeduplicated = pagesDeduplicated.Get();
+	snapshot.pagesSpilled = pagesSpilled.Get();
+	snapshot.bytesSpilled = bytesSpilled.Get();
+	snapshot.frontierDepth = frontierDepth.Get();
+	snapshot.frontierDepthMax = frontierDepth.GetMax();
+	snapshot.parseQueueDepth = parseQueueDepth.Get();
+	snapshot.parseQueueDepthMax = parseQueueDepth.GetMax();
+	snapshot.parseQueueBytes = parseQueueBytes.Get();
+	snapshot.parseQueueBytesMax = parseQueueBytes.GetMax();
+	snapshot.parseQueueBlockedNs = parseQueueBlockedNs.Get();
+	snapshot.downloaderIdleNs = downloaderIdleNs.Get();
+	snapshot.downloadersNum = downloadersNum.load(std::memory_order_relaxed);
+
+	for (size_t i{ 0 }; i < errors.size(); ++i)
+	{
+		snapshot.errors[i] = errors[i].Get();
+	}
+
+	for (size_t i{ 0 }; i < stages.size(); ++i)
+	{
+		snapshot.stages[i] = stages[i].Snapshot();
+	}
+
+	return snapshot;
+}
+
+std::string FormatBytes(double bytes)
+{
+	static const char* units[]{ "B", "KB", "MB", "GB", "TB" };
+	size_t unit{ 0 };
+	while (bytes >= 1024.0 && unit + 1 < sizeof(units) / sizeof(*units))
+	{
+		bytes /= 1024.0;
+		++unit;
+	}
+
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%.1f%s", bytes, units[unit]);
+	return buffer;
+}
+
+std::string FormatStatsLine(const MetricsSnapshot& current, const MetricsSnapshot& previous)
+{
+	const double interval{ std::max(current.elapsedSec - previous.elapsedSec, 1e-9) };
+	const double idleShare{ current.downloadersNum ?
+		(current.downloaderIdleNs - previous.downloaderIdleNs) / (interval * 1e9 * current.downloadersNum) :
+		0.0 };
+
+	const HistogramSnapshot& lockWait = current.stages[static_cast<size_t>(Stage::LockWait)];
+
+	char buffer[512];
+	snprintf(buffer, sizeof(buffer),
+		"[%.1fs] pages %llu (%.1f/s) parsed %llu bytes %s (%s/s) frontier %llu "
+		"parse_queue %llu/%s (max %llu/%s) errors %llu idle %.0f%% lock_wait p50 %lluns p99 %lluns",
+		current.elapsedSec,
+		static_cast<unsigned long long>(current.pagesDownloaded),
+		(current.pagesDownloaded - previous.pagesDownloaded) / interval,
+		static_cast<unsigned long long>(current.pagesParsed),
+		FormatBytes(static_cast<double>(current.bytesDownloaded)).c_str(),
+		FormatBytes((current.bytesDownloaded - previous.bytesDownloaded) / interval).c_str(),
+		static_cast<unsigned long long>(current.frontierDepth),
+		static_cast<unsigned long long>(current.parseQueueDepth),
+		FormatBytes(static_cast<double>(current.parseQueueBytes)).c_str(),
+		static_cast<unsigned long long>(current.parseQueueDepthMax),
+		FormatBytes(static_cast<double>(current.parseQueueBytesMax)).c_str(),
+		static_cast<unsigned long long>(current.ErrorsNum()),
+		std::min(idleShare, 1.0) * 100,
+		static_cast<unsigned long long>(lockWait.PercentileNs(0.5)),
+		static_cast<unsigned long long>(lockWait.PercentileNs(0.99)));
+
+	return buffer;
+}
+
+std::string ToJson(const MetricsSnapshot& snapshot)
+{
+	std::ostringstream out;
+	const double elapsed{ std::max(snapshot.elapsedSec, 1e-9) };
+
+	out << "{\n"
+		<< "    \"elapsed_sec\": " << snapshot.elapsedSec << ",\n"
+		<< "    \"pages_downloaded\": " << snapshot.pagesDownloaded << ",\n"
+		<< "    \"pages_parsed\": " << snapshot.pagesParsed << ",\n"
+		<< "    \"pages_per_sec\": " << snapshot.pagesDownloaded / elapsed << ",\n"
+		<< "    \"bytes_downloaded\": " << snapshot.bytesDownloaded << ",\n"
+		<< "    \"bytes_per_sec\": " << snapshot.bytesDownloaded / elapsed << ",\n"
+		<< "    \"links_found\": " << snapshot.linksFound << ",\n"
+		<< "    \"nodes_added\": " << snapshot.nodesAdded << ",\n"
+		<< "    \"pages_disallowed\": " << snapshot.pagesDisallowed << ",\n"
+		<< "    \"sitemap_urls\": " << snapshot.sitemapUrls << ",\n"
+		<< "    \"pages_deduplicated\": " << snapshot.pagesDeduplicated << ",\n"
+		<< "    \"pages_spilled\": " << snapshot.pagesSpilled << ",\n"
+		<< "    \"bytes_spilled\": " << snapshot.bytesSpilled << ",\n"
+		<< "    \"frontier_depth\": " << snapshot.frontierDepth << ",\n"
+		<< "    \"frontier_depth_max\": " << snapshot.frontierDepthMax << ",\n"
+		<< "    \"parse_queue_depth\": " << snapshot.parseQueueDepth << ",\n"
+		<< "    \"parse_queue_depth_max\": " << snapshot.parseQueueDepthMax << ",\n"
+		<< "    \"parse_queue_bytes\": " << snapshot.parseQueueBytes << ",\n"
+		<< "    \"parse_queue_bytes_max\": " << snapshot.parseQueueBytesMax << ",\n"
+		<< "    \"parse_queue_blocked_ns\": " << snapshot.parseQueueBlockedNs << ",\n"
+		<< "    \"downloaders\": " << snapshot.downloadersNum << ",\n"
+		<< "    \"downloader_idle_ns\": " << snapshot.downloaderIdleNs << ",\n"
+		<< "    \"errors\": {";
+
+	for (size_t i{ 0 }; i < snapshot.errors.size(); ++i)
+	{
+		out << (i ? ", " : " ") << '"' << ToString(static_cast<ErrorCategory>(i)) << "\": " << snapshot.errors[i];
+	}
+
+	out << " },\n"
+		<< "    \"stages\": {\n";
+
+	for (size_t i{ 0 }; i < snapshot.stages.size(); ++i)
+	{
+		const HistogramSnapshot& stage = snapshot.stages[i];
+		out << "        \"" << ToString(static_cast<Stage>(i)) << "\": { "
+			<< "\"count\": " << stage.count << ", "
+			<< "\"mean_ns\": " << stage.MeanNs() << ", "
+			<< "\"p50_ns\": " << stage.PercentileNs(0.5) << ", "
+			<< "\"p90_ns\": " << stage.PercentileNs(0.9) << ", "
+			<< "\"p99_ns\": " << stage.PercentileNs(0.99) << ", "
+			<< "\"max_ns\": " << stage.maxNs << " }"
+			<< (i + 1 < snapshot.stages.size() ? ",\n" : "\n");
+	}
+
+	out << "    }\n"
+		<< "}\n";
+
+	return out.str();
+}
+
+}// namespace metrics
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace metrics
+{
+
+using Clock = std::chrono::steady_clock;
+
+enum class Stage : size_t { Dns, Connect, Ttfb, Transfer, Fingerprint, Parse, Insert, LockWait, Count };
+enum class ErrorCategory : size_t { Resolve, Connect, Timeout, Ssl, Http, Parse, Other, Count };
+
+const char* ToString(Stage stage) noexcept;
+const char* ToString(ErrorCategory category) noexcept;
+
+// Monotonic counter, safe to update from any thread
+class Counter
+{
+public:
+	void Add(uint64_t value = 1) noexcept { m_value.fetch_add(value, std::memory_order_relaxed); }
+	uint64_t Get() const noexcept { return m_value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> m_value{ 0 };
+};
+
+// Current value plus the highest value seen
+class Gauge
+{
+public:
+	void Set(uint64_t value) noexcept;
+	uint64_t Get() const noexcept { return m_value.load(std::memory_order_relaxed); }
+	uint64_t GetMax() const noexcept { return m_max.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> m_value{ 0 };
+	std::atomic<uint64_t> m_max{ 0 };
+};
+
+struct HistogramSnapshot
+{
+	// Bucket i holds durations within [2^(i-1), 2^i) ns
+	static constexpr size_t BucketsNum{ 48 };
+
+	std::array<uint64_t, BucketsNum> buckets{};
+	uint64_t count{ 0 };
+	uint64_t sumNs{ 0 };
+	uint64_t maxNs{ 0 };
+
+	double MeanNs() const noexcept;
+	// Upper bound estimate of the percentile within [0, 1]
+	uint64_t PercentileNs(double percentile) const noexcept;
+};
+
+// Log2 bucketed latency histogram with lock free recording
+class LatencyHistogram
+{
+public:
+	void Record(Clock::duration duration) noexcept;
+	HistogramSnapshot Snapshot() const noexcept;
+
+private:
+	std::array<std::atomic<uint64_t>, HistogramSnapshot::BucketsNum> m_buckets{};
+	std::atomic<uint64_t> m_count{ 0 };
+	std::atomic<uint64_t> m_sumNs{ 0 };
+	std::atomic<uint64_t> m_maxNs{ 0 };
+};
+
+struct MetricsSnapshot
+{
+	double elapsedSec{ 0.0 };
+	uint64_t pagesDownloaded{ 0 };
+	uint64_t pagesParsed{ 0 };
+	uint64_t bytesDownloaded{ 0 };
+	uint64_t linksFound{ 0 };
+	uint64_t nodesAdded{ 0 };
+	uint64_t pagesDisallowed{ 0 };
+	uint64_t sitemapUrls{ 0 };
+	uint64_t pagesDeduplicated{ 0 };
+	uint64_t pagesSpilled{ 0 };
+	uint64_t bytesSpilled{ 0 };
+	uint64_t frontierDepth{ 0 };
+	uint64_t frontierDepthMax{ 0 };
+	uint64_t parseQueueDepth{ 0 };
+	uint64_t parseQueueDepthMax{ 0 };
+	uint64_t parseQueueBytes{ 0 };
+	uint64_t parseQueueBytesMax{ 0 };
+	uint64_t parseQueueBlockedNs{ 0 };
+	uint64_t downloaderIdleNs{ 0 };
+	uint64_t downloadersNum{ 0 };
+	std::array<uint64_t, static_cast<size_t>(ErrorCategory::Count)> errors{};
+	std::array<HistogramSnapshot, static_cast<size_t>(Stage::Count)> stages{};
+
+	uint64_t ErrorsNum() const noexcept;
+};
+
+// Metrics of a single crawl, a new instance is used for every crawl
+struct CrawlMetrics
+{
+	void RecordStage(Stage stage, Clock::duration duration) noexcept;
+	void RecordError(ErrorCategory category) noexcept;
+	MetricsSnapshot Snapshot() const noexcept;
+
+	Clock::time_point startTime{ Clock::now() };
+	std::atomic<uint64_t> downloadersNum{ 0 };
+
+	Counter pagesDownloaded;
+	Counter pagesParsed;
+	Counter bytesDownloaded;
+	Counter linksFound;
+	Counter nodesAdded;
+	// Links not followed because robots.txt disallows them
+	Counter pagesDisallowed;
+	// Pages seeded from sitemaps
+	Counter sitemapUrls;
+	// Pages merged into a page with the same content or into their canonical url
+	Counter pagesDeduplicated;
+	// Downloaded pages and their bytes written to disk in the memory budget mode
+	Counter pagesSpilled;
+	Counter bytesSpilled;
+	Counter downloaderIdleNs;
+	// Time downloaders spent blocked on the full parse queue
+	Counter parseQueueBlockedNs;
+	Gauge frontierDepth;
+	Gauge parseQueueDepth;
+	Gauge parseQueueBytes;
+
+	std::array<Counter, static_cast<size_t>(ErrorCategory::Count)> errors;
+	std::array<LatencyHistogram, static_cast<size_t>(Stage::Count)> stages;
+};
+
+// One line summary, rates are computed against the previous snapshot
+std::string FormatStatsLine(const MetricsSnapshot& current, const MetricsSnapshot& previous);
+std::string ToJson(const MetricsSnapshot& snapshot);
+
+// Records the lifetime of the scope as a stage duration
+class ScopedStageTimer
+{
+public:
+	ScopedStageTimer(CrawlMetrics& metrics, Stage stage) noexcept
+		: m_metrics(metrics), m_stage(stage) {}
+	~ScopedStageTimer() { m_metrics.RecordStage(m_stage, Clock::now() - m_start); }
+
+	ScopedStageTimer(const ScopedStageTimer&) = delete;
+	ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+	Clock::time_point GetStart() const noexcept { return m_start; }
+
+private:
+	CrawlMetrics& m_metrics;
+	Stage m_stage;
+	Clock::time_point m_start{ Clock::now() };
+};
+
+}// namespace metrics
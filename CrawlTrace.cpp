@@ -0,0 +1,74 @@
+#include "CrawlTrace.h"
+
+#include <fstream>
+#include <stdexcept>
+
+namespace metrics
+{
+
+void WriteJsonString(std::ostream& out, const std::string& str)
+{
+	out << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if (static_cast<unsigned char>(c) >= 0x20)
+		{
+			out << c;
+		}
+	}
+
+	out << '"';
+}
+
+TraceRecorder::TraceRecorder(size_t threadsNum)
+	: m_threadEvents(threadsNum)
+{
+}
+
+void TraceRecorder::Record(size_t thread, const char* name, Clock::time_point start, std::string detail)
+{
+	m_threadEvents.at(thread).push_back({ name, start, Clock::now() - start, std::move(detail) });
+}
+
+void TraceRecorder::Write(const std::string& filePath) const
+{
+	std::ofstream outFile{ filePath };
+	if (!outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	using Microseconds = std::chrono::duration<double, std::micro>;
+
+	outFile << "{\"traceEvents\":[\n";
+
+	bool first{ true };
+	for (size_t thread{ 0 }; thread < m_threadEvents.size(); ++thread)
+	{
+		for (const TraceEvent& event : m_threadEvents[thread])
+		{
+			outFile << (first ? "" : ",\n")
+				<< "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+				<< ",\"ts\":" << Microseconds{ event.start - m_startTime }.count()
+				<< ",\"dur\":" << Microseconds{ event.duration }.count();
+
+			if (!event.detail.empty())
+			{
+				outFile << ",\"args\":{\"url\":";
+				WriteJsonString(outFile, event.detail);
+				outFile << '}';
+			}
+
+			outFile << '}';
+			first = false;
+		}
+	}
+
+	outFile << "\n]}\n";
+}
+
+}// namespace metrics
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "CrawlMetrics.h"
+
+namespace metrics
+{
+
+struct TraceEvent
+{
+	const char* name;
+	Clock::time_point start;
+	Clock::duration duration;
+	std::string detail;
+};
+
+// Collects complete ("X") events in the Chrome trace event format.
+// Every thread owns a slot it writes to without locking, so the events
+// should only be read after the threads have been joined
+class TraceRecorder
+{
+public:
+	explicit TraceRecorder(size_t threadsNum);
+
+	void Record(size_t thread, const char* name, Clock::time_point start, std::string detail = {});
+	void Write(const std::string& filePath) const;
+
+private:
+	Clock::time_point m_startTime{ Clock::now() };
+	std::vector<std::vector<TraceEvent>> m_threadEvents;
+};
+
+}// namespace metrics
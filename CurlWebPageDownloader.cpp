@@ -1,6 +1,7 @@
 #include "CurlWebPageDownloader.h"
 
 #include <regex>
+#include <algorithm>
 #include <stdexcept>
 
 namespace network
@@ -14,6 +15,51 @@ static size_t WriteCallback(void* contents, size_t size, size_t count, void* use
 	return len;
 }
 
+DownloadErrorType GetErrorType(CURLcode code) noexcept
+{
+	switch (code)
+	{
+	case CURLE_OK:
+		return DownloadErrorType::None;
+	case CURLE_COULDNT_RESOLVE_HOST:
+	case CURLE_COULDNT_RESOLVE_PROXY:
+		return DownloadErrorType::Resolve;
+	case CURLE_COULDNT_CONNECT:
+		return DownloadErrorType::Connect;
+	case CURLE_OPERATION_TIMEDOUT:
+		return DownloadErrorType::Timeout;
+	case CURLE_SSL_CONNECT_ERROR:
+	case CURLE_PEER_FAILED_VERIFICATION:
+	case CURLE_SSL_CERTPROBLEM:
+	case CURLE_SSL_CIPHER:
+	case CURLE_SSL_CACERT_BADFILE:
+		return DownloadErrorType::Ssl;
+	case CURLE_HTTP_RETURNED_ERROR:
+		return DownloadErrorType::Http;
+	default:
+		return DownloadErrorType::Other;
+	}
+}
+
+void FillTimings(CURL* curl, DownloadTimings& timings) noexcept
+{
+	curl_off_t nameLookup{ 0 };
+	curl_off_t connect{ 0 };
+	curl_off_t startTransfer{ 0 };
+	curl_off_t total{ 0 };
+
+	curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T, &nameLookup);
+	curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &startTransfer);
+	curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T, &total);
+
+	// Curl reports times elapsed since the start of the transfer, convert them to stage durations
+	timings.dns = std::chrono::microseconds{ nameLookup };
+	timings.connect = std::chrono::microseconds{ std::max<curl_off_t>(connect - nameLookup, 0) };
+	timings.ttfb = std::chrono::microseconds{ std::max<curl_off_t>(startTransfer - connect, 0) };
+	timings.transfer = std::chrono::microseconds{ std::max<curl_off_t>(total - startTransfer, 0) };
+}
+
 //
 
 template<typename T>
@@ -26,6 +72,23 @@ void SetOptionOrThrow(CURL* curl, CURLoption option, T&& value )
 	}
 }
 
+void SetDefaultOptions(CURL* curl)
+{
+	SetOptionOrThrow(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
+	SetOptionOrThrow(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+	SetOptionOrThrow(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+	SetOptionOrThrow(curl, CURLOPT_USERAGENT, "libcurl-agent/1.0");
+}
+
+void FillContentType(CURL* curl, std::string& contentType)
+{
+	char* value{ nullptr };
+	if (curl_easy_getinfo(curl, CURLINFO_CONTENT_TYPE, &value) == CURLE_OK && value)
+	{
+		contentType = value;
+	}
+}
+
 CurlWebPageDownloader::CurlWebPageDownloader()
 {
 	m_curl.reset(curl_easy_init());
@@ -34,10 +97,7 @@ CurlWebPageDownloader::CurlWebPageDownloader()
 		throw std::logic_error{ "Failed to init curl" };
 	}
 
-	SetOptionOrThrow(m_curl.get(), CURLOPT_WRITEFUNCTION, WriteCallback);
-	SetOptionOrThrow(m_curl.get(), CURLOPT_SSL_VERIFYPEER, 0L);
-	SetOptionOrThrow(m_curl.get(), CURLOPT_SSL_VERIFYHOST, 0L);
-	SetOptionOrThrow(m_curl.get(), CURLOPT_USERAGENT, "libcurl-agent/1.0");
+	SetDefaultOptions(m_curl.get());
 }
 
 void CurlWebPageDownloader::SetProxy(const ProxySettings& proxySettings)
@@ -70,6 +130,7 @@ WebPageDownloadResult CurlWebPageDownloader::DownloadPage(const std::string& url
 	if (res != CURLE_OK)
 	{
 		result.error = curl_easy_strerror(res);
+		result.errorType = DownloadErrorType::Other;
 		return result;
 	}
 
@@ -77,22 +138,203 @@ WebPageDownloadResult CurlWebPageDownloader::DownloadPage(const std::string& url
 	if (res != CURLE_OK)
 	{
 		result.error = curl_easy_strerror(res);
+		result.errorType = DownloadErrorType::Other;
 		return result;
 	}
 
 	res = curl_easy_perform(m_curl.get());
+	FillTimings(m_curl.get(), result.timings);
 	if (res != CURLE_OK)
 	{
 		result.error = curl_easy_strerror(res);
+		result.errorType = GetErrorType(res);
 		return result;
 	}
 
+	FillContentType(m_curl.get(), result.contentType);
 	return result;
 }
 
+//
+
+struct CurlMultiWebPageDownloader::Transfer
+{
+	std::unique_ptr<CURL, void(*)(CURL*)> curl{
+		nullptr,
+		[](CURL* c) {curl_easy_cleanup(c); } };
+	WebPageDownloadResult result;
+	CompletionHandler onCompleted;
+};
+
+CurlMultiWebPageDownloader::CurlMultiWebPageDownloader()
+{
+	m_multi.reset(curl_multi_init());
+	if (!m_multi)
+	{
+		throw std::logic_error{ "Failed to init curl multi" };
+	}
+}
+
+CurlMultiWebPageDownloader::~CurlMultiWebPageDownloader()
+{
+	CancelAll();
+}
+
+void CurlMultiWebPageDownloader::SetProxy(const ProxySettings& proxySettings)
+{
+	if (proxySettings.proxyUrl.empty())
+	{
+		throw std::invalid_argument{ "Invalid proxy address" };
+	}
+
+	// Applied to every transfer as it starts
+	m_proxy = proxySettings.proxyUrl + ":" + std::to_string(proxySettings.proxyPort);
+	m_proxyCredentials.clear();
+	if (!proxySettings.user.empty() && !proxySettings.password.empty())
+	{
+		m_proxyCredentials = proxySettings.user + ":" + proxySettings.password;
+	}
+}
+
+void CurlMultiWebPageDownloader::StartDownload(const std::string& url, CompletionHandler onCompleted)
+{
+	if (url.empty())
+	{
+		throw std::invalid_argument{ "Invalid url" };
+	}
+
+	std::unique_ptr<Transfer> transfer;
+	if (!m_freeTransfers.empty())
+	{
+		transfer = std::move(m_freeTransfers.back());
+		m_freeTransfers.pop_back();
+	}
+	else
+	{
+		transfer = std::make_unique<Transfer>();
+		transfer->curl.reset(curl_easy_init());
+		if (!transfer->curl)
+		{
+			throw std::logic_error{ "Failed to init curl" };
+		}
+
+		SetDefaultOptions(transfer->curl.get());
+	}
+
+	CURL* curl{ transfer->curl.get() };
+	SetOptionOrThrow(curl, CURLOPT_URL, url.c_str());
+	SetOptionOrThrow(curl, CURLOPT_WRITEDATA, &transfer->result.data);
+	if (!m_proxy.empty())
+	{
+		SetOptionOrThrow(curl, CURLOPT_PROXY, m_proxy.c_str());
+		if (!m_proxyCredentials.empty())
+		{
+			SetOptionOrThrow(curl, CURLOPT_PROXYUSERPWD, m_proxyCredentials.c_str());
+		}
+	}
+
+	const CURLMcode res{ curl_multi_add_handle(m_multi.get(), curl) };
+	if (res != CURLM_OK)
+	{
+		throw std::logic_error{ curl_multi_strerror(res) };
+	}
+
+	transfer->onCompleted = std::move(onCompleted);
+	m_transfers.emplace(curl, std::move(transfer));
+}
+
+size_t CurlMultiWebPageDownloader::Poll(std::chrono::milliseconds timeout)
+{
+	Perform();
+	if (!m_transfers.empty())
+	{
+		// Sleeps on the sockets of all the transfers at once
+		const CURLMcode res{ curl_multi_poll(m_multi.get(), nullptr, 0, static_cast<int>(timeout.count()), nullptr) };
+		if (res != CURLM_OK)
+		{
+			throw std::logic_error{ curl_multi_strerror(res) };
+		}
+
+		Perform();
+	}
+
+	return m_transfers.size();
+}
+
+void CurlMultiWebPageDownloader::CancelAll()
+{
+	for (auto& transfer : m_transfers)
+	{
+		curl_multi_remove_handle(m_multi.get(), transfer.first);
+	}
+
+	m_transfers.clear();
+}
+
+void CurlMultiWebPageDownloader::Perform()
+{
+	int running{ 0 };
+	const CURLMcode res{ curl_multi_perform(m_multi.get(), &running) };
+	if (res != CURLM_OK)
+	{
+		throw std::logic_error{ curl_multi_strerror(res) };
+	}
+
+	CompleteTransfers();
+}
+
+void CurlMultiWebPageDownloader::CompleteTransfers()
+{
+	int messagesLeft{ 0 };
+	while (CURLMsg* message = curl_multi_info_read(m_multi.get(), &messagesLeft))
+	{
+		if (message->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+
+		CURL* curl{ message->easy_handle };
+		const CURLcode code{ message->data.result };
+		auto it = m_transfers.find(curl);
+		if (it == m_transfers.end())
+		{
+			continue;
+		}
+
+		std::unique_ptr<Transfer> transfer{ std::move(it->second) };
+		m_transfers.erase(it);
+		curl_multi_remove_handle(m_multi.get(), curl);
+
+		WebPageDownloadResult result{ std::move(transfer->result) };
+		CompletionHandler onCompleted{ std::move(transfer->onCompleted) };
+		transfer->result = WebPageDownloadResult{};
+		m_freeTransfers.push_back(std::move(transfer));
+
+		FillTimings(curl, result.timings);
+		if (code != CURLE_OK)
+		{
+			result.data.clear();
+			result.error = curl_easy_strerror(code);
+			result.errorType = GetErrorType(code);
+		}
+		else
+		{
+			FillContentType(curl, result.contentType);
+		}
+
+		// The handler may start new downloads
+		onCompleted(std::move(result));
+	}
+}
+
 std::unique_ptr<IWebPageDownloader> CurlWebDownloaderFactory::Create() const
 {
 	return std::make_unique<CurlWebPageDownloader>();
 }
 
+std::unique_ptr<IAsyncWebPageDownloader> CurlWebDownloaderFactory::CreateAsync() const
+{
+	return std::make_unique<CurlMultiWebPageDownloader>();
+}
+
 }//namespace network
\ No newline at end of file
@@ -3,6 +3,8 @@
 #include "IWebPageDownloader.h"
 
 #include <memory>
+#include <vector>
+#include <unordered_map>
 #include <curl/curl.h>
 
 namespace network
@@ -24,9 +26,42 @@ private:
 		[](CURL* c) {curl_easy_cleanup(c); } };
 };
 
+// Downloads over a curl multi handle, the transfers share its connection and DNS caches.
+// Easy handles of the finished transfers are reused
+class CurlMultiWebPageDownloader : public IAsyncWebPageDownloader
+{
+public:
+	CurlMultiWebPageDownloader();
+	~CurlMultiWebPageDownloader() override;
+
+	CurlMultiWebPageDownloader(const CurlMultiWebPageDownloader&) = delete;
+	CurlMultiWebPageDownloader& operator=(const CurlMultiWebPageDownloader&) = delete;
+
+	void SetProxy(const ProxySettings& proxySettings) override;
+	void StartDownload(const std::string& url, CompletionHandler onCompleted) override;
+	size_t Poll(std::chrono::milliseconds timeout) override;
+	void CancelAll() override;
+
+private:
+	struct Transfer;
+
+	void Perform();
+	void CompleteTransfers();
+
+private:
+	std::unique_ptr<CURLM, void(*)(CURLM*)> m_multi{
+		nullptr,
+		[](CURLM* m) {curl_multi_cleanup(m); } };
+	std::unordered_map<CURL*, std::unique_ptr<Transfer>> m_transfers;
+	std::vector<std::unique_ptr<Transfer>> m_freeTransfers;
+	std::string m_proxy;
+	std::string m_proxyCredentials;
+};
+
 struct CurlWebDownloaderFactory : public IWebPageDownloaderFactory
 {
 	std::unique_ptr<IWebPageDownloader> Create() const override;
+	std::unique_ptr<IAsyncWebPageDownloader> CreateAsync() const override;
 };
 
 }// namespace network
\ No newline at end of file
@@ -0,0 +1,192 @@
+#include "DegreeDistribution.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include "Parallel.h"
+
+namespace analyze
+{
+
+// Fewer tail nodes give too rough an exponent to tell anything about the site
+static constexpr size_t MinTailNodesNum{ 10 };
+
+const char* ToString(DegreeKind kind) noexcept
+{
+	switch (kind)
+	{
+	case DegreeKind::InboundLinks: return "inbound_links";
+	case DegreeKind::OutboundLinks: return "outbound_links";
+	case DegreeKind::TotalLinks: return "total_links";
+	case DegreeKind::InboundNeighbours: return "inbound_neighbours";
+	case DegreeKind::OutboundNeighbours: return "outbound_neighbours";
+	case DegreeKind::TotalNeighbours: return "total_neighbours";
+	default: return "unknown";
+	}
+}
+
+using DegreeHistograms = std::array<std::vector<size_t>, static_cast<size_t>(DegreeKind::Count)>;
+
+static void AddDegree(DegreeHistograms& histograms, DegreeKind kind, size_t degree)
+{
+	std::vector<size_t>& nodesNum = histograms[static_cast<size_t>(kind)];
+	if (degree >= nodesNum.size())
+	{
+		nodesNum.resize(degree + 1);
+	}
+
+	++nodesNum[degree];
+}
+
+// Totals are the sums of the inbound and outbound degrees, as the other metrics take them
+static void AddDegrees(DegreeHistograms& histograms, const NodeMetrics& metrics)
+{
+	AddDegree(histograms, DegreeKind::InboundLinks, metrics.inboundLinksNum);
+	AddDegree(histograms, DegreeKind::OutboundLinks, metrics.outboundLinksNum);
+	AddDegree(histograms, DegreeKind::TotalLinks, metrics.inboundLinksNum + metrics.outboundLinksNum);
+	AddDegree(histograms, DegreeKind::InboundNeighbours, metrics.inboundNeighboursNum);
+	AddDegree(histograms, DegreeKind::OutboundNeighbours, metrics.outboundNeighboursNum);
+	AddDegree(histograms, DegreeKind::TotalNeighbours, metrics.inboundNeighboursNum + metrics.outboundNeighboursNum);
+}
+
+static std::vector<size_t> MakeLogBins(const std::vector<size_t>& nodesNumByDegree)
+{
+	std::vector<size_t> result;
+	for (size_t degree{ 1 }; degree < nodesNumByDegree.size(); ++degree)
+	{
+		size_t bin{ 0 };
+		while ((degree >> bin) > 1)
+		{
+			++bin;
+		}
+
+		if (bin >= result.size())
+		{
+			result.resize(bin + 1);
+		}
+
+		result[bin] += nodesNumByDegree[degree];
+	}
+
+	return result;
+}
+
+DegreeDistributions CalcDegreeDistributions(
+	const web_graph::GraphView& view,
+	const std::vector<NodeMetrics>& nodeMetrics,
+	size_t threadsNum)
+{
+	using namespace web_graph;
+
+	std::vector<NodeId> nodes;
+	nodes.reserve(view.GetNodesNum());
+	for (const auto& node : GetNodes(view.GetGraph()))
+	{
+		if (view.IsActive(*node.second))
+		{
+			nodes.push_back(GetNodeId(*node.second));
+		}
+	}
+
+	std::vector<DegreeHistograms> partHistograms(std::max<size_t>(threadsNum, 1));
+	common::ParallelFor(partHistograms.size(), nodes.size(), [&](size_t begin, size_t end, size_t part)
+	{
+		for (size_t i{ begin }; i < end; ++i)
+		{
+			AddDegrees(partHistograms[part], nodeMetrics[nodes[i]]);
+		}
+	});
+
+	DegreeDistributions result;
+	for (size_t kind{ 0 }; kind < result.size(); ++kind)
+	{
+		std::vector<size_t>& nodesNum = result[kind].nodesNum;
+		for (const DegreeHistograms& histograms : partHistograms)
+		{
+			const std::vector<size_t>& partNodesNum = histograms[kind];
+			if (partNodesNum.size() > nodesNum.size())
+			{
+				nodesNum.resize(partNodesNum.size());
+			}
+
+			for (size_t degree{ 0 }; degree < partNodesNum.size(); ++degree)
+			{
+				nodesNum[degree] += partNodesNum[degree];
+			}
+		}
+
+		result[kind].logBinNodesNum = MakeLogBins(nodesNum);
+		result[kind].fit = FitPowerLaw(nodesNum);
+	}
+
+	return result;
+}
+
+// Clauset, Shalizi, Newman "Power-law distributions in empirical data": the discrete MLE
+// alpha = 1 + n / sum(ln(degree / (minDegree - 0.5))) and the tail P(X >= x) = ((x - 0.5) / (minDegree - 0.5))^(1 - alpha)
+// are taken in their continuous approximation, every degree seen is tried as minDegree
+PowerLawFit FitPowerLaw(const std::vector<size_t>& nodesNumByDegree)
+{
+	std::vector<size_t> degrees;
+	for (size_t degree{ 1 }; degree < nodesNumByDegree.size(); ++degree)
+	{
+		if (nodesNumByDegree[degree])
+		{
+			degrees.push_back(degree);
+		}
+	}
+
+	// Num of nodes and the sum of ln(degree) over the degrees from degrees[i] up
+	std::vector<size_t> tailNodesNum(degrees.size() + 1);
+	std::vector<double> tailLogSum(degrees.size() + 1);
+	for (size_t i{ degrees.size() }; i-- > 0; )
+	{
+		const size_t nodesNum{ nodesNumByDegree[degrees[i]] };
+		tailNodesNum[i] = tailNodesNum[i + 1] + nodesNum;
+		tailLogSum[i] = tailLogSum[i + 1] + nodesNum * std::log(static_cast<double>(degrees[i]));
+	}
+
+	PowerLawFit result;
+	result.ksDistance = std::numeric_limits<double>::infinity();
+	for (size_t min{ 0 }; min < degrees.size() && tailNodesNum[min] >= MinTailNodesNum; ++min)
+	{
+		const double n{ static_cast<double>(tailNodesNum[min]) };
+		const double minShifted{ degrees[min] - 0.5 };
+		const double logSum{ tailLogSum[min] - n * std::log(minShifted) };
+		if (logSum <= 0.0)
+		{
+			continue;
+		}
+
+		const double alpha{ 1.0 + n / logSum };
+		auto getTail = [alpha, minShifted](double degree) { return std::pow((degree - 0.5) / minShifted, 1.0 - alpha); };
+
+		// The empirical tail steps at every degree seen, so it is compared at both sides of the steps
+		double ksDistance{ 0.0 };
+		for (size_t i{ min }; i < degrees.size(); ++i)
+		{
+			ksDistance = std::max({ ksDistance,
+				std::abs(tailNodesNum[i] / n - getTail(static_cast<double>(degrees[i]))),
+				std::abs(tailNodesNum[i + 1] / n - getTail(static_cast<double>(degrees[i] + 1))) });
+		}
+
+		if (ksDistance < result.ksDistance)
+		{
+			result.alpha = alpha;
+			result.alphaError = (alpha - 1.0) / std::sqrt(n);
+			result.minDegree = degrees[min];
+			result.tailNodesNum = tailNodesNum[min];
+			result.ksDistance = ksDistance;
+		}
+	}
+
+	if (!result.tailNodesNum)
+	{
+		result.ksDistance = 0.0;
+	}
+
+	return result;
+}
+
+}// namespace analyze
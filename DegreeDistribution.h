@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <vector>
+
+#include "Analyze.h"
+
+namespace analyze
+{
+
+// Links count multiple links between two nodes, neighbours count them once
+enum class DegreeKind : size_t
+{
+	InboundLinks,
+	OutboundLinks,
+	TotalLinks,
+	InboundNeighbours,
+	OutboundNeighbours,
+	TotalNeighbours,
+	Count
+};
+
+const char* ToString(DegreeKind kind) noexcept;
+
+// Discrete power law P(degree) ~ degree^-alpha fitted by maximum likelihood to the degrees >= minDegree.
+// minDegree is the one whose fit is the closest to the data by the Kolmogorov-Smirnov distance.
+// The fit is empty if the nodes of nonzero degree are too few
+struct PowerLawFit
+{
+	double alpha{ 0.0 };
+	// Standard error of alpha
+	double alphaError{ 0.0 };
+	size_t minDegree{ 0 };
+	size_t tailNodesNum{ 0 };
+	double ksDistance{ 0.0 };
+};
+
+struct DegreeDistribution
+{
+	// Num of nodes by degree, the last one is the max degree
+	std::vector<size_t> nodesNum;
+	// Bin k has the nodes of degree in [2^k, 2^(k+1)), so the nodes of degree 0 are in nodesNum only
+	std::vector<size_t> logBinNodesNum;
+	PowerLawFit fit;
+};
+
+using DegreeDistributions = std::array<DegreeDistribution, static_cast<size_t>(DegreeKind::Count)>;
+
+// Distributions of the degrees of the active nodes. The degrees are taken from the metrics of the nodes
+// in one pass on up to threadsNum threads, every thread counts into its own histograms which are summed after
+DegreeDistributions CalcDegreeDistributions(
+	const web_graph::GraphView& view,
+	const std::vector<NodeMetrics>& nodeMetrics,
+	size_t threadsNum);
+
+PowerLawFit FitPowerLaw(const std::vector<size_t>& nodesNumByDegree);
+
+}// namespace analyze
@@ -0,0 +1,719 @@
+#include "DistributedCrawl.h"
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <list>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <condition_variable>
+
+namespace distributed
+{
+
+using web_graph::Url;
+using web_graph::WebGraph;
+using web_graph::WebPageNode;
+
+enum class MessageType : uint8_t
+{
+	// Partition of the sender, the first message of a connection
+	Hello,
+	// Urls separated by '\n'
+	Urls,
+	// Wave number, the receiver replies with its Status
+	StatusRequest,
+	Status,
+	Done
+};
+
+static constexpr size_t HeaderSize{ sizeof(uint8_t) + sizeof(uint32_t) };
+
+// Counters of the termination detection, urls are counted
+struct PartitionStatus
+{
+	uint64_t partition{ 0 };
+	uint64_t wave{ 0 };
+	uint64_t sent{ 0 };
+	uint64_t received{ 0 };
+	uint64_t idle{ 0 };
+};
+
+static void AppendUint64(std::string& buffer, uint64_t value)
+{
+	buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static uint64_t ReadUint64(std::string_view& buffer)
+{
+	if (buffer.size() < sizeof(uint64_t))
+	{
+		throw std::runtime_error{ "Truncated partition message" };
+	}
+
+	uint64_t value{ 0 };
+	std::memcpy(&value, buffer.data(), sizeof(value));
+	buffer.remove_prefix(sizeof(value));
+	return value;
+}
+
+static std::string ToPayload(const PartitionStatus& status)
+{
+	std::string payload;
+	for (uint64_t value : { status.partition, status.wave, status.sent, status.received, status.idle })
+	{
+		AppendUint64(payload, value);
+	}
+
+	return payload;
+}
+
+static PartitionStatus ToStatus(std::string_view payload)
+{
+	PartitionStatus status;
+	for (uint64_t* value : { &status.partition, &status.wave, &status.sent, &status.received, &status.idle })
+	{
+		*value = ReadUint64(payload);
+	}
+
+	return status;
+}
+
+static bool SendAll(int socket, const char* data, size_t size)
+{
+	while (size)
+	{
+		const ssize_t sent{ send(socket, data, size, MSG_NOSIGNAL) };
+		if (sent < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+
+	return true;
+}
+
+// False on the end of the stream
+static bool ReceiveAll(int socket, char* data, size_t size)
+{
+	while (size)
+	{
+		const ssize_t received{ recv(socket, data, size, 0) };
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		if (received <= 0)
+		{
+			return false;
+		}
+
+		data += received;
+		size -= static_cast<size_t>(received);
+	}
+
+	return true;
+}
+
+static sockaddr_un MakeSocketAddress(const std::string& socketDir, size_t partition)
+{
+	std::string path{ socketDir };
+	if (!path.empty() && path.back() != '/')
+	{
+		path += '/';
+	}
+
+	path += "partition-" + std::to_string(partition) + ".sock";
+
+	sockaddr_un address{};
+	if (path.size() >= sizeof(address.sun_path))
+	{
+		throw std::invalid_argument{ "Socket path is too long: " + path };
+	}
+
+	address.sun_family = AF_UNIX;
+	std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+	return address;
+}
+
+static int CreateSocket()
+{
+	const int fd{ socket(AF_UNIX, SOCK_STREAM, 0) };
+	if (fd < 0)
+	{
+		throw std::runtime_error{ std::string{ "Failed to create socket: " } + std::strerror(errno) };
+	}
+
+	return fd;
+}
+
+size_t GetUrlPartition(std::string_view url, size_t partitionsNum) noexcept
+{
+	// The trailing '/' is ignored the same way the graph does it for the node keys
+	if (!url.empty() && url.back() == '/')
+	{
+		url.remove_suffix(1);
+	}
+
+	// FNV-1a, std::hash is not guaranteed to be the same in different builds
+	uint64_t hash{ 14695981039346656037ull };
+	for (char c : url)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+
+	return partitionsNum ? static_cast<size_t>(hash % partitionsNum) : 0;
+}
+
+// Connections to the other partitions and the threads serving them. Every process has an outgoing
+// connection to each peer and receives over the connections the peers opened
+class PartitionNetwork
+{
+public:
+	PartitionNetwork(web_graph::AsyncWebGraphBuilder& builder, const PartitionSettings& settings);
+	~PartitionNetwork();
+
+	// Blocks until all the peers are connected
+	void Connect();
+	void Run();
+	// Waits for the threads, the crawl should be completed
+	void Shutdown();
+
+	// Called from the parse thread
+	void OnForeignUrl(const Url& url);
+
+private:
+	void ReceiveCycle(int socket);
+	void FlushCycle();
+	void DetectTermination();
+	void Flush();
+	PartitionStatus MakeStatus(uint64_t wave);
+	void Send(size_t partition, MessageType type, std::string_view payload);
+	void Complete(bool broadcast);
+	bool WaitFor(std::chrono::milliseconds timeout);
+
+private:
+	web_graph::AsyncWebGraphBuilder& m_builder;
+	PartitionSettings m_settings;
+	sockaddr_un m_address{};
+
+	int m_listenSocket{ -1 };
+	// Indexed by partition, own one is unused
+	std::vector<int> m_outSockets;
+	std::unique_ptr<std::mutex[]> m_outMutexes;
+	std::vector<int> m_inSockets;
+	std::list<std::thread> m_threads;
+
+	// Urls waiting to be sent, indexed by partition
+	std::mutex m_bufferMutex;
+	std::vector<std::vector<Url>> m_buffers;
+	size_t m_bufferedUrls{ 0 };
+	std::atomic<uint64_t> m_sent{ 0 };
+	std::atomic<uint64_t> m_received{ 0 };
+	std::mutex m_flushMutex;
+
+	std::mutex m_stateMutex;
+	std::condition_variable m_stateCv;
+	bool m_done{ false };
+	bool m_flushRequested{ false };
+	// Status request of the coordinator waiting for the reply
+	uint64_t m_requestedWave{ 0 };
+	// Replies collected by the coordinator for the current wave
+	uint64_t m_wave{ 0 };
+	std::vector<PartitionStatus> m_statuses;
+};
+
+PartitionNetwork::PartitionNetwork(web_graph::AsyncWebGraphBuilder& builder, const PartitionSettings& settings)
+	: m_builder(builder)
+	, m_settings(settings)
+	, m_address(MakeSocketAddress(settings.socketDir, settings.partition))
+	, m_outSockets(settings.partitionsNum, -1)
+	, m_outMutexes(std::make_unique<std::mutex[]>(settings.partitionsNum))
+	, m_buffers(settings.partitionsNum)
+{
+}
+
+PartitionNetwork::~PartitionNetwork()
+{
+	Complete(false);
+	Shutdown();
+}
+
+void PartitionNetwork::Connect()
+{
+	m_listenSocket = CreateSocket();
+
+	unlink(m_address.sun_path);
+	if (bind(m_listenSocket, reinterpret_cast<const sockaddr*>(&m_address), sizeof(m_address)) != 0 ||
+		listen(m_listenSocket, static_cast<int>(m_settings.partitionsNum)) != 0)
+	{
+		throw std::runtime_error{ std::string{ "Failed to listen on " } + m_address.sun_path + ": " + std::strerror(errno) };
+	}
+
+	// A connection is established by the listen backlog, so all the peers can connect before anyone accepts
+	const auto deadline = std::chrono::steady_clock::now() + m_settings.connectTimeout;
+	for (size_t partition{ 0 }; partition < m_settings.partitionsNum; ++partition)
+	{
+		if (partition == m_settings.partition)
+		{
+			continue;
+		}
+
+		const sockaddr_un address{ MakeSocketAddress(m_settings.socketDir, partition) };
+		while (true)
+		{
+			const int fd{ CreateSocket() };
+			if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+			{
+				m_outSockets[partition] = fd;
+				break;
+			}
+
+			close(fd);
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				throw std::runtime_error{ std::string{ "Failed to connect to " } + address.sun_path };
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds{ 100 });
+		}
+
+		std::string hello;
+		AppendUint64(hello, m_settings.partition);
+		Send(partition, MessageType::Hello, hello);
+	}
+
+	while (m_inSockets.size() + 1 < m_settings.partitionsNum)
+	{
+		const int fd{ accept(m_listenSocket, nullptr, nullptr) };
+		if (fd < 0 && errno != EINTR)
+		{
+			throw std::runtime_error{ std::string{ "Failed to accept peer: " } + std::strerror(errno) };
+		}
+
+		if (fd >= 0)
+		{
+			m_inSockets.push_back(fd);
+		}
+	}
+
+	close(m_listenSocket);
+	m_listenSocket = -1;
+	unlink(m_address.sun_path);
+}
+
+void PartitionNetwork::Run()
+{
+	for (int fd : m_inSockets)
+	{
+		m_threads.emplace_back(std::thread{ &PartitionNetwork::ReceiveCycle, this, fd });
+	}
+
+	m_threads.emplace_back(std::thread{ &PartitionNetwork::FlushCycle, this });
+	if (m_settings.partition == 0)
+	{
+		m_threads.emplace_back(std::thread{ &PartitionNetwork::DetectTermination, this });
+	}
+}
+
+void PartitionNetwork::Shutdown()
+{
+	// Wakes up the receivers, the messages of the peers are not needed anymore
+	for (int fd : m_inSockets)
+	{
+		shutdown(fd, SHUT_RD);
+	}
+
+	for (std::thread& t : m_threads)
+	{
+		if (t.joinable())
+		{
+			t.join();
+		}
+	}
+
+	m_threads.clear();
+
+	for (int& fd : m_outSockets)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+			fd = -1;
+		}
+	}
+
+	for (int fd : m_inSockets)
+	{
+		close(fd);
+	}
+
+	m_inSockets.clear();
+
+	if (m_listenSocket >= 0)
+	{
+		close(m_listenSocket);
+		m_listenSocket = -1;
+		unlink(m_address.sun_path);
+	}
+}
+
+void PartitionNetwork::OnForeignUrl(const Url& url)
+{
+	bool batchFull{ false };
+	{
+		std::lock_guard<std::mutex> l{ m_bufferMutex };
+		std::vector<Url>& buffer = m_buffers[GetUrlPartition(url, m_settings.partitionsNum)];
+		buffer.push_back(url);
+		++m_bufferedUrls;
+		batchFull = buffer.size() >= m_settings.batchSize;
+	}
+
+	// Sent by the flush thread, so the parse thread never blocks on a peer
+	if (batchFull)
+	{
+		std::lock_guard<std::mutex> l{ m_stateMutex };
+		m_flushRequested = true;
+		m_stateCv.notify_all();
+	}
+}
+
+void PartitionNetwork::Send(size_t partition, MessageType type, std::string_view payload)
+{
+	char header[HeaderSize];
+	const uint32_t size{ static_cast<uint32_t>(payload.size()) };
+	header[0] = static_cast<char>(type);
+	std::memcpy(header + 1, &size, sizeof(size));
+
+	std::lock_guard<std::mutex> l{ m_outMutexes[partition] };
+	const int fd{ m_outSockets[partition] };
+	if (fd < 0 || !SendAll(fd, header, sizeof(header)) || !SendAll(fd, payload.data(), payload.size()))
+	{
+		throw std::runtime_error{ "Failed to send to partition " + std::to_string(partition) };
+	}
+}
+
+void PartitionNetwork::Flush()
+{
+	std::lock_guard<std::mutex> flushLock{ m_flushMutex };
+
+	std::vector<std::vector<Url>> buffers(m_settings.partitionsNum);
+	{
+		std::lock_guard<std::mutex> l{ m_bufferMutex };
+		buffers.swap(m_buffers);
+		m_buffers.resize(m_settings.partitionsNum);
+		m_bufferedUrls = 0;
+	}
+
+	for (size_t partition{ 0 }; partition < buffers.size(); ++partition)
+	{
+		const std::vector<Url>& urls = buffers[partition];
+		for (size_t begin{ 0 }; begin < urls.size(); begin += m_settings.batchSize)
+		{
+			const size_t end{ std::min(urls.size(), begin + m_settings.batchSize) };
+
+			std::string payload;
+			for (size_t i{ begin }; i < end; ++i)
+			{
+				payload += urls[i];
+				payload += '\n';
+			}
+
+			// Counted before the peer can receive them, so the sums never show the batch as delivered too early
+			m_sent += end - begin;
+			Send(partition, MessageType::Urls, payload);
+		}
+	}
+}
+
+PartitionStatus PartitionNetwork::MakeStatus(uint64_t wave)
+{
+	Flush();
+
+	PartitionStatus status;
+	status.partition = m_settings.partition;
+	status.wave = wave;
+	status.received = m_received;
+	status.sent = m_sent;
+
+	// Urls buffered after the flush belong to a page being processed, so the builder is not idle anyway
+	std::lock_guard<std::mutex> l{ m_bufferMutex };
+	status.idle = m_builder.IsIdle() && !m_bufferedUrls;
+	return status;
+}
+
+void PartitionNetwork::ReceiveCycle(int socket)
+{
+	uint64_t peer{ m_settings.partitionsNum };
+
+	try
+	{
+		char header[HeaderSize];
+		std::string payload;
+		while (ReceiveAll(socket, header, sizeof(header)))
+		{
+			uint32_t size{ 0 };
+			std::memcpy(&size, header + 1, sizeof(size));
+			payload.resize(size);
+			if (!ReceiveAll(socket, payload.data(), size))
+			{
+				break;
+			}
+
+			std::string_view data{ payload };
+			switch (static_cast<MessageType>(header[0]))
+			{
+			case MessageType::Hello:
+				peer = ReadUint64(data);
+				break;
+
+			case MessageType::Urls:
+			{
+				std::vector<Url> urls;
+				while (!data.empty())
+				{
+					const size_t end{ std::min(data.find('\n'), data.size()) };
+					urls.emplace_back(data.substr(0, end));
+					data.remove_prefix(std::min(end + 1, data.size()));
+				}
+
+				// Queued before counted, so a status never shows the urls received but the builder idle
+				const size_t urlsNum{ urls.size() };
+				m_builder.AddPages(std::move(urls));
+				m_received += urlsNum;
+				break;
+			}
+
+			case MessageType::StatusRequest:
+			{
+				std::lock_guard<std::mutex> l{ m_stateMutex };
+				m_requestedWave = ReadUint64(data);
+				m_stateCv.notify_all();
+				break;
+			}
+
+			case MessageType::Status:
+			{
+				const PartitionStatus status{ ToStatus(data) };
+
+				std::lock_guard<std::mutex> l{ m_stateMutex };
+				if (status.wave == m_wave)
+				{
+					m_statuses.push_back(status);
+					m_stateCv.notify_all();
+				}
+				break;
+			}
+
+			case MessageType::Done:
+				Complete(false);
+				return;
+
+			default:
+				throw std::runtime_error{ "Unknown partition message" };
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Partition connection failed: " << e.what() << '\n';
+	}
+
+	// Losing the coordinator or, for the coordinator, any peer means the crawl can't be completed properly
+	std::lock_guard<std::mutex> l{ m_stateMutex };
+	if (!m_done && (m_settings.partition == 0 || peer == 0))
+	{
+		std::cerr << "Partition " << peer << " disconnected, the graph may be incomplete\n";
+		m_done = true;
+		m_stateCv.notify_all();
+		m_builder.Finish();
+	}
+}
+
+bool PartitionNetwork::WaitFor(std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> l{ m_stateMutex };
+	m_stateCv.wait_for(l, timeout, [this] { return m_done || m_flushRequested || m_requestedWave; });
+	m_flushRequested = false;
+	return !m_done;
+}
+
+void PartitionNetwork::FlushCycle()
+{
+	try
+	{
+		while (WaitFor(m_settings.flushInterval))
+		{
+			uint64_t wave{ 0 };
+			{
+				std::lock_guard<std::mutex> l{ m_stateMutex };
+				std::swap(wave, m_requestedWave);
+			}
+
+			if (wave)
+			{
+				Send(0, MessageType::Status, ToPayload(MakeStatus(wave)));
+			}
+			else
+			{
+				Flush();
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to send urls: " << e.what() << '\n';
+	}
+}
+
+void PartitionNetwork::DetectTermination()
+{
+	// Four-counter method: the crawl is over when two consecutive waves find every partition idle
+	// and the same numbers of urls sent and received, so nothing was in flight between the waves
+	PartitionStatus previous;
+	bool previousIdle{ false };
+
+	try
+	{
+		for (uint64_t wave{ 1 }; ; ++wave)
+		{
+			{
+				std::unique_lock<std::mutex> l{ m_stateMutex };
+				if (m_stateCv.wait_for(l, m_settings.flushInterval, [this] { return m_done; }))
+				{
+					return;
+				}
+
+				m_wave = wave;
+				m_statuses.clear();
+			}
+
+			std::string request;
+			AppendUint64(request, wave);
+			for (size_t partition{ 1 }; partition < m_settings.partitionsNum; ++partition)
+			{
+				Send(partition, MessageType::StatusRequest, request);
+			}
+
+			PartitionStatus total{ MakeStatus(wave) };
+			bool idle{ total.idle != 0 };
+			{
+				std::unique_lock<std::mutex> l{ m_stateMutex };
+				m_stateCv.wait(l, [this] { return m_done || m_statuses.size() + 1 >= m_settings.partitionsNum; });
+				if (m_done)
+				{
+					return;
+				}
+
+				for (const PartitionStatus& status : m_statuses)
+				{
+					total.sent += status.sent;
+					total.received += status.received;
+					idle = idle && status.idle;
+				}
+			}
+
+			const bool balanced{ total.sent == total.received };
+			if (idle && balanced && previousIdle && previous.sent == total.sent && previous.received == total.received)
+			{
+				break;
+			}
+
+			previous = total;
+			previousIdle = idle && balanced;
+		}
+
+		Complete(true);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to detect crawl completion: " << e.what() << '\n';
+		Complete(false);
+	}
+}
+
+void PartitionNetwork::Complete(bool broadcast)
+{
+	{
+		std::lock_guard<std::mutex> l{ m_stateMutex };
+		if (m_done && !broadcast)
+		{
+			return;
+		}
+
+		m_done = true;
+		m_stateCv.notify_all();
+	}
+
+	if (broadcast)
+	{
+		for (size_t partition{ 1 }; partition < m_settings.partitionsNum; ++partition)
+		{
+			Send(partition, MessageType::Done, {});
+		}
+	}
+
+	m_builder.Finish();
+}
+
+std::unique_ptr<WebGraph> CrawlPartition(
+	web_graph::AsyncWebGraphBuilder& builder,
+	const Url& rootUrl,
+	const PartitionSettings& settings)
+{
+	if (!settings.partitionsNum || settings.partition >= settings.partitionsNum)
+	{
+		throw std::invalid_argument{ "Invalid partition" };
+	}
+
+	if (!settings.batchSize)
+	{
+		throw std::invalid_argument{ "Batch size should be positive" };
+	}
+
+	PartitionNetwork network{ builder, settings };
+	network.Connect();
+
+	builder.SetPartition({
+		[&settings](const Url& url) { return GetUrlPartition(url, settings.partitionsNum) == settings.partition; },
+		[&network](const Url& url) { network.OnForeignUrl(url); } });
+
+	std::unique_ptr<WebGraph> graph;
+	try
+	{
+		auto future = builder.Start(rootUrl);
+		network.Run();
+		graph = future.get();
+	}
+	catch (...)
+	{
+		builder.Stop();
+		builder.SetPartition({});
+		throw;
+	}
+
+	network.Shutdown();
+	builder.Stop();
+	builder.SetPartition({});
+
+	return graph;
+}
+
+}// namespace distributed
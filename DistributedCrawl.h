@@ -0,0 +1,43 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <string_view>
+
+#include "WebGraph.h"
+#include "WebGraphBuilder.h"
+
+namespace distributed
+{
+
+// A site is split between several crawler processes by the hash of the page urls. Every process
+// downloads its own pages only and passes the urls of others to their owners in batches over unix
+// sockets. The partition 0 detects that all the processes are idle with no urls in flight and
+// completes the crawl. Every process gets a partial graph: its pages with their outbound links
+// and the link targets owned by others, the partial graphs written as graphml are combined by
+// graph_diff::MergeGraphs()
+struct PartitionSettings
+{
+	size_t partition{ 0 };
+	size_t partitionsNum{ 1 };
+	// Shared by all the processes, the sockets are named after the partitions
+	std::string socketDir;
+	// Urls sent to a peer at once, smaller batches are sent every flush interval
+	size_t batchSize{ 256 };
+	std::chrono::milliseconds flushInterval{ 50 };
+	// How long the peers are waited for to start
+	std::chrono::seconds connectTimeout{ 30 };
+};
+
+// Stable across processes, equivalent urls of a node get the same partition
+size_t GetUrlPartition(std::string_view url, size_t partitionsNum) noexcept;
+
+// Blocks until all the partitions are crawled, the builder is stopped afterwards
+std::unique_ptr<web_graph::WebGraph> CrawlPartition(
+	web_graph::AsyncWebGraphBuilder& builder,
+	const web_graph::Url& rootUrl,
+	const PartitionSettings& settings);
+
+}// namespace distributed
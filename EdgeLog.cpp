@@ -0,0 +1,576 @@
+#include "EdgeLog.h"
+
+#include <zlib.h>
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace edge_log
+{
+
+static constexpr char Magic[8]{ 'W', 'G', 'E', 'D', 'G', 'E', 'S', '1' };
+// Raw size, compressed size and crc32 of the raw data
+static constexpr size_t BlockHeaderSize{ 12 };
+static constexpr size_t MaxVarintSize{ 5 };
+
+enum class RecordType : uint8_t { SiteStarted = 1, NodeAdded, LinkAdded, NodeMerged, SiteCompleted, End };
+
+static size_t PutVarint(char* out, uint32_t value) noexcept
+{
+	size_t size{ 0 };
+	while (value >= 0x80)
+	{
+		out[size++] = static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+
+	out[size++] = static_cast<char>(value);
+	return size;
+}
+
+static void PutUint32(char* out, uint32_t value) noexcept
+{
+	for (size_t i{ 0 }; i < 4; ++i)
+	{
+		out[i] = static_cast<char>(value >> (i * 8));
+	}
+}
+
+static uint32_t GetUint32(const char* data) noexcept
+{
+	uint32_t value{ 0 };
+	for (size_t i{ 0 }; i < 4; ++i)
+	{
+		value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (i * 8);
+	}
+
+	return value;
+}
+
+namespace
+{
+
+// Reads the records of a block, throws if a record is cut
+class RecordReader
+{
+public:
+	explicit RecordReader(std::string_view data) noexcept : m_data(data) {}
+
+	bool AtEnd() const noexcept { return m_pos == m_data.size(); }
+
+	RecordType ReadType()
+	{
+		Check(1);
+		return static_cast<RecordType>(m_data[m_pos++]);
+	}
+
+	uint32_t ReadVarint()
+	{
+		uint32_t value{ 0 };
+		for (size_t shift{ 0 }; shift < MaxVarintSize * 7; shift += 7)
+		{
+			Check(1);
+			const auto byte = static_cast<unsigned char>(m_data[m_pos++]);
+			value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+
+		throw std::runtime_error{ "Corrupted edge log: invalid varint" };
+	}
+
+	std::string_view ReadString()
+	{
+		const size_t size{ ReadVarint() };
+		Check(size);
+		const std::string_view result{ m_data.substr(m_pos, size) };
+		m_pos += size;
+		return result;
+	}
+
+private:
+	void Check(size_t size) const
+	{
+		if (m_data.size() - m_pos < size)
+		{
+			throw std::runtime_error{ "Corrupted edge log: record is cut" };
+		}
+	}
+
+private:
+	std::string_view m_data;
+	size_t m_pos{ 0 };
+};
+
+}// namespace
+
+EdgeLogWriter::EdgeLogWriter(const std::string& filePath, size_t blockBytes, std::chrono::milliseconds flushInterval)
+	: m_outFile(filePath, std::ios::binary | std::ios::trunc)
+	, m_filePath(filePath)
+	, m_blockBytes(blockBytes)
+	, m_flushInterval(flushInterval)
+{
+	if (!m_blockBytes || m_blockBytes > UINT32_MAX / 2)
+	{
+		throw std::invalid_argument{ "Invalid edge log block size" };
+	}
+
+	if (!m_outFile.is_open() || !m_outFile.write(Magic, sizeof(Magic)).flush())
+	{
+		throw std::runtime_error{ "Failed to open file " + filePath };
+	}
+
+	m_bytesWritten = sizeof(Magic);
+	m_buffer.reserve(m_blockBytes);
+	m_thread = std::thread{ &EdgeLogWriter::FlushCycle, this };
+}
+
+EdgeLogWriter::~EdgeLogWriter()
+{
+	try
+	{
+		Close();
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to close edge log: " << e.what() << '\n';
+	}
+}
+
+void EdgeLogWriter::Close()
+{
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		if (m_closed)
+		{
+			return;
+		}
+	}
+
+	const char record{ static_cast<char>(RecordType::End) };
+	Append(&record, 1);
+
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		m_closed = true;
+		m_flushCv.notify_one();
+	}
+
+	m_thread.join();
+	m_outFile.close();
+
+	if (!m_error.empty())
+	{
+		throw std::runtime_error{ m_error };
+	}
+}
+
+uint64_t EdgeLogWriter::GetBytesWritten() const noexcept
+{
+	return m_bytesWritten;
+}
+
+void EdgeLogWriter::OnSiteStarted(uint32_t siteId, const web_graph::Url& rootUrl)
+{
+	char record[1 + 2 * MaxVarintSize];
+	record[0] = static_cast<char>(RecordType::SiteStarted);
+	size_t size{ 1 };
+	size += PutVarint(record + size, siteId);
+	size += PutVarint(record + size, static_cast<uint32_t>(rootUrl.size()));
+	Append(record, size, rootUrl);
+}
+
+void EdgeLogWriter::OnNodeAdded(uint32_t siteId, web_graph::NodeId node, const web_graph::Url& url)
+{
+	char record[1 + 3 * MaxVarintSize];
+	record[0] = static_cast<char>(RecordType::NodeAdded);
+	size_t size{ 1 };
+	size += PutVarint(record + size, siteId);
+	size += PutVarint(record + size, node);
+	size += PutVarint(record + size, static_cast<uint32_t>(url.size()));
+	Append(record, size, url);
+}
+
+void EdgeLogWriter::OnLinkAdded(uint32_t siteId, web_graph::NodeId from, web_graph::NodeId to)
+{
+	char record[1 + 3 * MaxVarintSize];
+	record[0] = static_cast<char>(RecordType::LinkAdded);
+	size_t size{ 1 };
+	size += PutVarint(record + size, siteId);
+	size += PutVarint(record + size, from);
+	size += PutVarint(record + size, to);
+	Append(record, size);
+}
+
+void EdgeLogWriter::OnNodeMerged(uint32_t siteId, web_graph::NodeId node, web_graph::NodeId into)
+{
+	char record[1 + 3 * MaxVarintSize];
+	record[0] = static_cast<char>(RecordType::NodeMerged);
+	size_t size{ 1 };
+	size += PutVarint(record + size, siteId);
+	size += PutVarint(record + size, node);
+	size += PutVarint(record + size, into);
+	Append(record, size);
+}
+
+void EdgeLogWriter::OnSiteCompleted(uint32_t siteId)
+{
+	char record[1 + MaxVarintSize];
+	record[0] = static_cast<char>(RecordType::SiteCompleted);
+	const size_t size{ 1 + PutVarint(record + 1, siteId) };
+	Append(record, size);
+}
+
+void EdgeLogWriter::Append(const char* record, size_t size, std::string_view url)
+{
+	std::unique_lock<std::mutex> l{ m_mutex };
+	if (m_closed || !m_error.empty())
+	{
+		return;
+	}
+
+	// Records are never split between blocks, so every complete block is readable on its own
+	if (!m_buffer.empty() && m_buffer.size() + size + url.size() > m_blockBytes)
+	{
+		m_roomCv.wait(l, [this] { return m_blocks.size() < MaxPendingBlocks || !m_error.empty(); });
+
+		m_blocks.push_back(std::move(m_buffer));
+		m_buffer = std::string{};
+		m_buffer.reserve(m_blockBytes);
+		m_flushCv.notify_one();
+	}
+
+	m_buffer.append(record, size);
+	m_buffer.append(url);
+}
+
+void EdgeLogWriter::FlushCycle()
+{
+	std::unique_lock<std::mutex> l{ m_mutex };
+	while (true)
+	{
+		m_flushCv.wait_for(l, m_flushInterval, [this] { return !m_blocks.empty() || m_closed; });
+
+		// Partial block on the timeout or once closed
+		if (m_blocks.empty() && !m_buffer.empty())
+		{
+			m_blocks.push_back(std::move(m_buffer));
+			m_buffer = std::string{};
+		}
+
+		if (m_blocks.empty())
+		{
+			if (m_closed)
+			{
+				return;
+			}
+
+			continue;
+		}
+
+		const std::string block{ std::move(m_blocks.front()) };
+		m_blocks.pop_front();
+		m_roomCv.notify_all();
+
+		if (!m_error.empty())
+		{
+			continue;
+		}
+
+		l.unlock();
+		std::string error;
+		try
+		{
+			WriteBlock(block);
+		}
+		catch (const std::exception& e)
+		{
+			error = e.what();
+			std::cerr << "Failed to write edge log: " << error << '\n';
+		}
+
+		l.lock();
+		if (!error.empty())
+		{
+			m_error = error;
+			m_roomCv.notify_all();
+		}
+	}
+}
+
+void EdgeLogWriter::WriteBlock(const std::string& data)
+{
+	std::string block(BlockHeaderSize + compressBound(static_cast<uLong>(data.size())), '\0');
+
+	uLongf compressedSize{ static_cast<uLongf>(block.size() - BlockHeaderSize) };
+	if (compress2(reinterpret_cast<Bytef*>(&block[BlockHeaderSize]), &compressedSize,
+		reinterpret_cast<const Bytef*>(data.data()), static_cast<uLong>(data.size()), Z_BEST_SPEED) != Z_OK)
+	{
+		throw std::runtime_error{ "Failed to compress block" };
+	}
+
+	const uLong crc{ crc32(0, reinterpret_cast<const Bytef*>(data.data()), static_cast<uInt>(data.size())) };
+	PutUint32(&block[0], static_cast<uint32_t>(data.size()));
+	PutUint32(&block[4], static_cast<uint32_t>(compressedSize));
+	PutUint32(&block[8], static_cast<uint32_t>(crc));
+	block.resize(BlockHeaderSize + compressedSize);
+
+	// Flushed at once, so the block survives a crash of the process
+	if (!m_outFile.write(block.data(), static_cast<std::streamsize>(block.size())).flush())
+	{
+		throw std::runtime_error{ "Failed to write file " + m_filePath };
+	}
+
+	m_bytesWritten += block.size();
+}
+
+// Replays the records of a block, true at the end mark
+static bool ReplayBlock(std::string_view data, web_graph::IGraphSink& sink)
+{
+	RecordReader reader{ data };
+	while (!reader.AtEnd())
+	{
+		switch (reader.ReadType())
+		{
+		case RecordType::SiteStarted:
+		{
+			const uint32_t siteId{ reader.ReadVarint() };
+			sink.OnSiteStarted(siteId, web_graph::Url{ reader.ReadString() });
+			break;
+		}
+		case RecordType::NodeAdded:
+		{
+			const uint32_t siteId{ reader.ReadVarint() };
+			const web_graph::NodeId node{ reader.ReadVarint() };
+			sink.OnNodeAdded(siteId, node, web_graph::Url{ reader.ReadString() });
+			break;
+		}
+		case RecordType::LinkAdded:
+		{
+			const uint32_t siteId{ reader.ReadVarint() };
+			const web_graph::NodeId from{ reader.ReadVarint() };
+			sink.OnLinkAdded(siteId, from, reader.ReadVarint());
+			break;
+		}
+		case RecordType::NodeMerged:
+		{
+			const uint32_t siteId{ reader.ReadVarint() };
+			const web_graph::NodeId node{ reader.ReadVarint() };
+			sink.OnNodeMerged(siteId, node, reader.ReadVarint());
+			break;
+		}
+		case RecordType::SiteCompleted:
+			sink.OnSiteCompleted(reader.ReadVarint());
+			break;
+		case RecordType::End:
+			return true;
+		default:
+			throw std::runtime_error{ "Corrupted edge log: unknown record" };
+		}
+	}
+
+	return false;
+}
+
+bool ReadEdgeLog(const std::string& filePath, web_graph::IGraphSink& sink)
+{
+	std::ifstream inFile{ filePath, std::ios::binary };
+	if (!inFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file " + filePath };
+	}
+
+	char magic[sizeof(Magic)];
+	if (!inFile.read(magic, sizeof(magic)) || std::memcmp(magic, Magic, sizeof(Magic)) != 0)
+	{
+		throw std::runtime_error{ "Not an edge log: " + filePath };
+	}
+
+	std::string compressed;
+	std::string data;
+	char header[BlockHeaderSize];
+	while (inFile.read(header, sizeof(header)))
+	{
+		const uint32_t rawSize{ GetUint32(header) };
+		const uint32_t compressedSize{ GetUint32(header + 4) };
+
+		compressed.resize(compressedSize);
+		if (!inFile.read(compressed.data(), compressedSize))
+		{
+			return false;
+		}
+
+		// A block torn by a crash ends the log
+		data.resize(rawSize);
+		uLongf size{ rawSize };
+		if (uncompress(reinterpret_cast<Bytef*>(data.data()), &size,
+			reinterpret_cast<const Bytef*>(compressed.data()), compressedSize) != Z_OK || size != rawSize ||
+			crc32(0, reinterpret_cast<const Bytef*>(data.data()), static_cast<uInt>(size)) != GetUint32(header + 8))
+		{
+			return false;
+		}
+
+		if (ReplayBlock(data, sink))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+namespace
+{
+
+// Node urls of a single site and the nodes merged into others
+class NodeTable : public web_graph::IGraphSink
+{
+public:
+	static constexpr web_graph::NodeId NotMerged{ UINT32_MAX };
+
+	void OnSiteStarted(uint32_t siteId, const web_graph::Url&) override
+	{
+		if (m_hasSite && siteId != m_siteId)
+		{
+			throw std::runtime_error{ "Edge log has several sites" };
+		}
+
+		m_hasSite = true;
+		m_siteId = siteId;
+	}
+
+	void OnNodeAdded(uint32_t, web_graph::NodeId node, const web_graph::Url& url) override
+	{
+		if (node >= m_urls.size())
+		{
+			m_urls.resize(node + size_t{ 1 });
+			m_mergedInto.resize(node + size_t{ 1 }, NotMerged);
+		}
+
+		if (!m_hasRoot)
+		{
+			m_root = node;
+			m_hasRoot = true;
+		}
+
+		m_urls[node] = url;
+	}
+
+	void OnLinkAdded(uint32_t, web_graph::NodeId, web_graph::NodeId) override {}
+
+	void OnNodeMerged(uint32_t, web_graph::NodeId node, web_graph::NodeId into) override
+	{
+		m_mergedInto.at(node) = into;
+	}
+
+	void OnSiteCompleted(uint32_t) override {}
+
+	bool IsMerged(web_graph::NodeId node) const
+	{
+		return m_mergedInto.at(node) != NotMerged;
+	}
+
+	// The node the links to the given one point to
+	web_graph::NodeId Resolve(web_graph::NodeId node) const
+	{
+		while (IsMerged(node))
+		{
+			node = m_mergedInto[node];
+		}
+
+		return node;
+	}
+
+	const web_graph::Url& GetUrl(web_graph::NodeId node) const
+	{
+		return m_urls.at(node);
+	}
+
+	void ReadNodes(const graphml::NodeCallback& onNode) const
+	{
+		if (!m_hasRoot)
+		{
+			return;
+		}
+
+		onNode(m_urls[m_root]);
+		for (web_graph::NodeId node{ 0 }; node < m_urls.size(); ++node)
+		{
+			if (node != m_root && !m_urls[node].empty() && !IsMerged(node))
+			{
+				onNode(m_urls[node]);
+			}
+		}
+	}
+
+private:
+	bool m_hasSite{ false };
+	uint32_t m_siteId{ 0 };
+	bool m_hasRoot{ false };
+	web_graph::NodeId m_root{ 0 };
+	std::vector<web_graph::Url> m_urls;
+	std::vector<web_graph::NodeId> m_mergedInto;
+};
+
+// Passes the links on, those to the merged nodes are moved the way the builder moves them
+class EdgeReader : public web_graph::IGraphSink
+{
+public:
+	EdgeReader(const NodeTable& nodes, const graphml::EdgeCallback& onEdge) noexcept
+		: m_nodes(nodes), m_onEdge(onEdge) {}
+
+	void OnSiteStarted(uint32_t, const web_graph::Url&) override {}
+	void OnNodeAdded(uint32_t, web_graph::NodeId, const web_graph::Url&) override {}
+
+	void OnLinkAdded(uint32_t, web_graph::NodeId from, web_graph::NodeId to) override
+	{
+		// Merged pages are never parsed, their links would be dropped with them anyway
+		if (!m_nodes.IsMerged(from))
+		{
+			m_onEdge(m_nodes.GetUrl(from), m_nodes.GetUrl(m_nodes.Resolve(to)));
+		}
+	}
+
+	void OnNodeMerged(uint32_t, web_graph::NodeId, web_graph::NodeId) override {}
+	void OnSiteCompleted(uint32_t) override {}
+
+private:
+	const NodeTable& m_nodes;
+	const graphml::EdgeCallback& m_onEdge;
+};
+
+}// namespace
+
+bool IsEdgeLog(const std::string& filePath)
+{
+	std::ifstream inFile{ filePath, std::ios::binary };
+	char magic[sizeof(Magic)];
+	return inFile.read(magic, sizeof(magic)) && std::memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+bool ReadGraph(const std::string& logPath, const graphml::NodeCallback& onNode, const graphml::EdgeCallback& onEdge)
+{
+	NodeTable nodes;
+	const bool complete{ ReadEdgeLog(logPath, nodes) };
+	nodes.ReadNodes(onNode);
+
+	EdgeReader edges{ nodes, onEdge };
+	ReadEdgeLog(logPath, edges);
+	return complete;
+}
+
+bool ConvertToGraphml(const std::string& logPath, const std::string& outFilePath)
+{
+	graphml::Writer writer{ outFilePath };
+	const bool complete{ ReadGraph(logPath,
+		[&writer](std::string_view url) { writer.WriteNode(url); },
+		[&writer](std::string_view sourceUrl, std::string_view targetUrl) { writer.WriteEdge(sourceUrl, targetUrl); }) };
+
+	writer.Close();
+	return complete;
+}
+
+}// namespace edge_log
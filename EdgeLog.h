@@ -0,0 +1,93 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <functional>
+#include <condition_variable>
+
+#include "GraphSink.h"
+#include "GraphmlSerialization.h"
+
+namespace edge_log
+{
+
+// Binary log of the graph events of a crawl. Records are varint encoded and grouped into zlib compressed
+// blocks with a checksum, written by a background thread. A log cut short by a crash is readable up to its last
+// complete block
+class EdgeLogWriter : public web_graph::IGraphSink
+{
+public:
+	static constexpr size_t DefaultBlockBytes{ 1024 * 1024 };
+	// Max time an event waits in memory, the loss on a crash
+	static constexpr std::chrono::milliseconds DefaultFlushInterval{ 1000 };
+	// Full blocks waiting for the write, the crawl blocks beyond that
+	static constexpr size_t MaxPendingBlocks{ 4 };
+
+	explicit EdgeLogWriter(
+		const std::string& filePath,
+		size_t blockBytes = DefaultBlockBytes,
+		std::chrono::milliseconds flushInterval = DefaultFlushInterval);
+	~EdgeLogWriter() override;
+
+	EdgeLogWriter(const EdgeLogWriter&) = delete;
+	EdgeLogWriter& operator=(const EdgeLogWriter&) = delete;
+
+	// Writes the rest of the events and the end mark, throws if anything failed to be written.
+	// Events after that are dropped
+	void Close();
+	// Compressed bytes written so far
+	uint64_t GetBytesWritten() const noexcept;
+
+	void OnSiteStarted(uint32_t siteId, const web_graph::Url& rootUrl) override;
+	void OnNodeAdded(uint32_t siteId, web_graph::NodeId node, const web_graph::Url& url) override;
+	void OnLinkAdded(uint32_t siteId, web_graph::NodeId from, web_graph::NodeId to) override;
+	void OnNodeMerged(uint32_t siteId, web_graph::NodeId node, web_graph::NodeId into) override;
+	void OnSiteCompleted(uint32_t siteId) override;
+
+private:
+	void Append(const char* record, size_t size, std::string_view url = {});
+	void FlushCycle();
+	void WriteBlock(const std::string& data);
+
+private:
+	std::ofstream m_outFile;
+	std::string m_filePath;
+	const size_t m_blockBytes;
+	const std::chrono::milliseconds m_flushInterval;
+
+	std::mutex m_mutex;
+	std::condition_variable m_flushCv;
+	std::condition_variable m_roomCv;
+	std::string m_buffer;
+	std::deque<std::string> m_blocks;
+	bool m_closed{ false };
+	// First write error, the events are dropped after it
+	std::string m_error;
+
+	std::atomic<uint64_t> m_bytesWritten{ 0 };
+	std::thread m_thread;
+};
+
+// Replays the events of the log to the sink in the order they were written.
+// Returns false if the log is cut short, the events of its complete blocks are replayed then
+bool ReadEdgeLog(const std::string& filePath, web_graph::IGraphSink& sink);
+
+// Whether the file starts like an edge log
+bool IsEdgeLog(const std::string& filePath);
+
+// Streams the graph of a single site log: the root first, then the rest of the nodes, then the links with
+// the merged nodes resolved. The node urls are kept in memory, the links are read from the log.
+// Returns false if the log is cut short, the graph then has the pages found before
+bool ReadGraph(const std::string& logPath, const graphml::NodeCallback& onNode, const graphml::EdgeCallback& onEdge);
+
+// Writes the graph of a single site log as graphml, the root first like graphml::Serialize.
+// The node urls are kept in memory, the links are streamed from the log.
+// Returns false if the log is cut short, the graph then has the pages found before
+bool ConvertToGraphml(const std::string& logPath, const std::string& outFilePath);
+
+}// namespace edge_log
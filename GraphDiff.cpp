@@ -0,0 +1,554 @@
+#include "GraphDiff.h"
+
+#include <queue>
+#include <memory>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <filesystem>
+
+#include "EdgeLog.h"
+#include "SpillStore.h"
+#include "GraphmlSerialization.h"
+
+namespace graph_diff
+{
+
+using web_graph::NodeLinkNum;
+
+// Sorted runs are spilled in chunks of about this size
+static constexpr size_t ChunkBytes{ 1024 * 1024 };
+
+namespace
+{
+
+// Link of a sorted stream or a node, which has no target
+struct Entry
+{
+	std::string_view source;
+	std::string_view target;
+	NodeLinkNum count{ 0 };
+};
+
+int Compare(const Entry& left, const Entry& right) noexcept
+{
+	const int result{ web_graph::MakeKey(left.source).compare(web_graph::MakeKey(right.source)) };
+	return result ? result : web_graph::MakeKey(left.target).compare(web_graph::MakeKey(right.target));
+}
+
+void PutVarint(std::string& out, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		out += static_cast<char>(value | 0x80);
+		value >>= 7;
+	}
+
+	out += static_cast<char>(value);
+}
+
+uint32_t ReadVarint(std::string_view data, size_t& pos)
+{
+	uint32_t value{ 0 };
+	for (uint32_t shift{ 0 }; shift < 35 && pos < data.size(); shift += 7)
+	{
+		const auto byte = static_cast<unsigned char>(data[pos++]);
+		value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			return value;
+		}
+	}
+
+	throw std::runtime_error{ "Corrupted diff spill: invalid varint" };
+}
+
+std::string_view ReadString(std::string_view data, size_t& pos)
+{
+	const size_t size{ ReadVarint(data, pos) };
+	if (data.size() - pos < size)
+	{
+		throw std::runtime_error{ "Corrupted diff spill: record is cut" };
+	}
+
+	const std::string_view result{ data.substr(pos, size) };
+	pos += size;
+	return result;
+}
+
+// Sorts the entries summing the counts of the same keys. Runs over the memory budget are spilled sorted
+// and merged back as they are read
+class EntrySorter
+{
+public:
+	EntrySorter(common::SpillStore& spill, size_t memoryBytes) noexcept
+		: m_spill(spill), m_memoryBytes(memoryBytes) {}
+
+	void Add(std::string_view source, std::string_view target, NodeLinkNum count)
+	{
+		m_items.push_back({ m_arena.size(), static_cast<uint32_t>(source.size()), static_cast<uint32_t>(target.size()), count });
+		m_arena.append(source);
+		m_arena.append(target);
+
+		if (m_arena.size() + m_items.size() * sizeof(Item) >= m_memoryBytes)
+		{
+			SpillBuffer();
+		}
+	}
+
+	// Called once after all the entries are added
+	void Finish()
+	{
+		if (m_runs.empty())
+		{
+			SortBuffer();
+			return;
+		}
+
+		if (!m_items.empty())
+		{
+			SpillBuffer();
+		}
+
+		for (size_t i{ 0 }; i < m_runs.size(); ++i)
+		{
+			if (m_runs[i].Advance(m_spill))
+			{
+				m_heap.push(&m_runs[i]);
+			}
+		}
+	}
+
+	// Next entry in the key order, the views are valid till the next call
+	bool Next(Entry& entry)
+	{
+		if (m_runs.empty())
+		{
+			if (m_nextItem == m_items.size())
+			{
+				return false;
+			}
+
+			entry = GetEntry(m_items[m_nextItem++]);
+			return true;
+		}
+
+		if (m_heap.empty())
+		{
+			return false;
+		}
+
+		// The head is copied as the run may load its next chunk over it
+		Run* run{ m_heap.top() };
+		m_heap.pop();
+		m_source = run->head.source;
+		m_target = run->head.target;
+		entry = { m_source, m_target, run->head.count };
+		if (run->Advance(m_spill))
+		{
+			m_heap.push(run);
+		}
+
+		while (!m_heap.empty() && Compare(m_heap.top()->head, entry) == 0)
+		{
+			run = m_heap.top();
+			m_heap.pop();
+			entry.count += run->head.count;
+			if (run->Advance(m_spill))
+			{
+				m_heap.push(run);
+			}
+		}
+
+		return true;
+	}
+
+private:
+	struct Item
+	{
+		size_t offset;
+		uint32_t sourceSize;
+		uint32_t targetSize;
+		NodeLinkNum count;
+	};
+
+	// Sorted run read back chunk by chunk, every chunk is read once and freed in the spill
+	struct Run
+	{
+		std::vector<common::SpillStore::Location> chunks;
+		size_t nextChunk{ 0 };
+		std::string data;
+		size_t pos{ 0 };
+		Entry head;
+
+		bool Advance(common::SpillStore& spill)
+		{
+			if (pos == data.size())
+			{
+				if (nextChunk == chunks.size())
+				{
+					return false;
+				}
+
+				spill.Read(chunks[nextChunk++], data);
+				pos = 0;
+			}
+
+			head.source = ReadString(data, pos);
+			head.target = ReadString(data, pos);
+			head.count = ReadVarint(data, pos);
+			return true;
+		}
+	};
+
+	struct RunGreater
+	{
+		bool operator()(const Run* left, const Run* right) const noexcept
+		{
+			return Compare(left->head, right->head) > 0;
+		}
+	};
+
+	Entry GetEntry(const Item& item) const noexcept
+	{
+		const std::string_view arena{ m_arena };
+		return { arena.substr(item.offset, item.sourceSize), arena.substr(item.offset + item.sourceSize, item.targetSize), item.count };
+	}
+
+	void SortBuffer()
+	{
+		std::sort(m_items.begin(), m_items.end(), [this](const Item& left, const Item& right)
+		{
+			return Compare(GetEntry(left), GetEntry(right)) < 0;
+		});
+
+		// Sums the repeated keys
+		size_t last{ 0 };
+		for (size_t i{ 1 }; i < m_items.size(); ++i)
+		{
+			if (Compare(GetEntry(m_items[last]), GetEntry(m_items[i])) == 0)
+			{
+				m_items[last].count += m_items[i].count;
+			}
+			else
+			{
+				m_items[++last] = m_items[i];
+			}
+		}
+
+		m_items.resize(std::min(m_items.size(), last + 1));
+	}
+
+	void SpillBuffer()
+	{
+		SortBuffer();
+
+		Run run;
+		std::string chunk;
+		chunk.reserve(ChunkBytes + 64);
+		for (const Item& item : m_items)
+		{
+			const Entry entry{ GetEntry(item) };
+			PutVarint(chunk, static_cast<uint32_t>(entry.source.size()));
+			chunk.append(entry.source);
+			PutVarint(chunk, static_cast<uint32_t>(entry.target.size()));
+			chunk.append(entry.target);
+			PutVarint(chunk, entry.count);
+
+			if (chunk.size() >= ChunkBytes)
+			{
+				run.chunks.push_back(m_spill.Write(chunk));
+				chunk.clear();
+			}
+		}
+
+		if (!chunk.empty())
+		{
+			run.chunks.push_back(m_spill.Write(chunk));
+		}
+
+		m_runs.push_back(std::move(run));
+		m_items = std::vector<Item>{};
+		m_arena = std::string{};
+	}
+
+private:
+	common::SpillStore& m_spill;
+	const size_t m_memoryBytes;
+
+	// Entries added since the last spill, the urls are in the arena
+	std::string m_arena;
+	std::vector<Item> m_items;
+	size_t m_nextItem{ 0 };
+
+	// Never resized once the merge starts, the heap points into it
+	std::vector<Run> m_runs;
+	std::priority_queue<Run*, std::vector<Run*>, RunGreater> m_heap;
+	std::string m_source;
+	std::string m_target;
+};
+
+// Walks over the union of the keys of the sorted streams, the count of a key is zero in the streams without it
+class Join
+{
+public:
+	explicit Join(std::vector<EntrySorter*> streams)
+		: m_streams(std::move(streams))
+		, m_heads(m_streams.size())
+		, m_hasHead(m_streams.size())
+	{
+		for (size_t i{ 0 }; i < m_streams.size(); ++i)
+		{
+			m_hasHead[i] = m_streams[i]->Next(m_heads[i]);
+		}
+	}
+
+	// The urls of the entry are those of the first stream having the key
+	bool Next(Entry& entry, std::vector<NodeLinkNum>& counts)
+	{
+		const Entry* min{ nullptr };
+		for (size_t i{ 0 }; i < m_streams.size(); ++i)
+		{
+			if (m_hasHead[i] && (!min || Compare(m_heads[i], *min) < 0))
+			{
+				min = &m_heads[i];
+			}
+		}
+
+		if (!min)
+		{
+			return false;
+		}
+
+		m_source = min->source;
+		m_target = min->target;
+		entry = { m_source, m_target, 0 };
+
+		counts.assign(m_streams.size(), 0);
+		for (size_t i{ 0 }; i < m_streams.size(); ++i)
+		{
+			if (m_hasHead[i] && Compare(m_heads[i], entry) == 0)
+			{
+				counts[i] = m_heads[i].count;
+				m_hasHead[i] = m_streams[i]->Next(m_heads[i]);
+			}
+		}
+
+		return true;
+	}
+
+private:
+	std::vector<EntrySorter*> m_streams;
+	std::vector<Entry> m_heads;
+	std::vector<bool> m_hasHead;
+	std::string m_source;
+	std::string m_target;
+};
+
+}// namespace
+
+static std::string GetSpillDir(const DiffSettings& settings)
+{
+	return settings.spillDir.empty() ? std::filesystem::temp_directory_path().string() : settings.spillDir;
+}
+
+// Sorts the nodes and the links of a graph file, the root receives the first node if it is empty
+static void SortGraph(const std::string& filePath, EntrySorter& nodes, EntrySorter& links, std::string& root)
+{
+	const graphml::NodeCallback onNode{ [&nodes, &root](std::string_view url)
+	{
+		if (root.empty())
+		{
+			root = url;
+		}
+
+		nodes.Add(url, {}, 1);
+	} };
+
+	const graphml::EdgeCallback onEdge{ [&links](std::string_view sourceUrl, std::string_view targetUrl)
+	{
+		links.Add(sourceUrl, targetUrl, 1);
+	} };
+
+	if (!edge_log::IsEdgeLog(filePath))
+	{
+		graphml::Read(filePath, onNode, onEdge);
+	}
+	else if (!edge_log::ReadGraph(filePath, onNode, onEdge))
+	{
+		std::cerr << "Edge log " << filePath << " is cut short, the graph has the pages found before" << std::endl;
+	}
+
+	nodes.Finish();
+	links.Finish();
+}
+
+DiffStats DiffGraphs(
+	const std::string& oldGraphPath,
+	const std::string& newGraphPath,
+	IDiffSink& sink,
+	const DiffSettings& settings)
+{
+	common::SpillStore spill{ GetSpillDir(settings), "graph-diff" };
+
+	// The buffers of the old graph are kept while the new one is sorted
+	const size_t sorterBytes{ settings.memoryBytes / 4 };
+	EntrySorter oldNodes{ spill, sorterBytes };
+	EntrySorter oldLinks{ spill, sorterBytes };
+	EntrySorter newNodes{ spill, sorterBytes };
+	EntrySorter newLinks{ spill, sorterBytes };
+
+	std::string oldRoot;
+	std::string newRoot;
+	SortGraph(oldGraphPath, oldNodes, oldLinks, oldRoot);
+	SortGraph(newGraphPath, newNodes, newLinks, newRoot);
+
+	DiffStats stats;
+	Entry entry;
+	std::vector<NodeLinkNum> counts;
+
+	Join nodes{ { &oldNodes, &newNodes } };
+	while (nodes.Next(entry, counts))
+	{
+		if (!counts[0])
+		{
+			++stats.nodesAdded;
+			sink.OnNodeAdded(entry.source);
+		}
+		else if (!counts[1])
+		{
+			++stats.nodesRemoved;
+			sink.OnNodeRemoved(entry.source);
+		}
+	}
+
+	Join links{ { &oldLinks, &newLinks } };
+	while (links.Next(entry, counts))
+	{
+		if (counts[0] != counts[1])
+		{
+			++(!counts[0] ? stats.linksAdded : !counts[1] ? stats.linksRemoved : stats.linksChanged);
+			sink.OnLinkChanged(entry.source, entry.target, counts[0], counts[1]);
+		}
+	}
+
+	return stats;
+}
+
+MergeStats MergeGraphs(
+	const std::vector<std::string>& graphPaths,
+	const std::string& outFilePath,
+	const DiffSettings& settings)
+{
+	if (graphPaths.empty())
+	{
+		throw std::invalid_argument{ "No graphs to merge" };
+	}
+
+	common::SpillStore spill{ GetSpillDir(settings), "graph-merge" };
+
+	const size_t sorterBytes{ settings.memoryBytes / (2 * graphPaths.size()) };
+	std::vector<std::unique_ptr<EntrySorter>> nodeSorters;
+	std::vector<std::unique_ptr<EntrySorter>> linkSorters;
+	std::vector<EntrySorter*> nodeStreams;
+	std::vector<EntrySorter*> linkStreams;
+
+	std::string root;
+	for (const std::string& graphPath : graphPaths)
+	{
+		nodeSorters.push_back(std::make_unique<EntrySorter>(spill, sorterBytes));
+		linkSorters.push_back(std::make_unique<EntrySorter>(spill, sorterBytes));
+		nodeStreams.push_back(nodeSorters.back().get());
+		linkStreams.push_back(linkSorters.back().get());
+		SortGraph(graphPath, *nodeSorters.back(), *linkSorters.back(), root);
+	}
+
+	MergeStats stats;
+	Entry entry;
+	std::vector<NodeLinkNum> counts;
+	graphml::Writer writer{ outFilePath };
+
+	// Deserialize takes the first node as the root
+	if (!root.empty())
+	{
+		writer.WriteNode(root);
+		++stats.nodesNum;
+	}
+
+	Join nodes{ nodeStreams };
+	while (nodes.Next(entry, counts))
+	{
+		if (web_graph::MakeKey(entry.source) != web_graph::MakeKey(root))
+		{
+			writer.WriteNode(entry.source);
+			++stats.nodesNum;
+		}
+	}
+
+	Join links{ linkStreams };
+	while (links.Next(entry, counts))
+	{
+		const NodeLinkNum count{ *std::max_element(counts.begin(), counts.end()) };
+		for (NodeLinkNum i{ 0 }; i < count; ++i)
+		{
+			writer.WriteEdge(entry.source, entry.target);
+		}
+
+		stats.linksNum += count;
+	}
+
+	writer.Close();
+	return stats;
+}
+
+//
+
+TextDiffWriter::TextDiffWriter(const std::string& outFilePath)
+	: m_outFile(outFilePath)
+{
+	if (!m_outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file " + outFilePath };
+	}
+}
+
+void TextDiffWriter::OnNodeAdded(std::string_view url)
+{
+	m_outFile << "node+ " << url << '\n';
+}
+
+void TextDiffWriter::OnNodeRemoved(std::string_view url)
+{
+	m_outFile << "node- " << url << '\n';
+}
+
+void TextDiffWriter::OnLinkChanged(
+	std::string_view sourceUrl,
+	std::string_view targetUrl,
+	NodeLinkNum oldCount,
+	NodeLinkNum newCount)
+{
+	if (!oldCount)
+	{
+		m_outFile << "link+ " << sourceUrl << ' ' << targetUrl << ' ' << newCount << '\n';
+	}
+	else if (!newCount)
+	{
+		m_outFile << "link- " << sourceUrl << ' ' << targetUrl << ' ' << oldCount << '\n';
+	}
+	else
+	{
+		m_outFile << "link~ " << sourceUrl << ' ' << targetUrl << ' ' << oldCount << ' ' << newCount << '\n';
+	}
+}
+
+void TextDiffWriter::Close()
+{
+	m_outFile.close();
+	if (m_outFile.fail())
+	{
+		throw std::runtime_error{ "Failed to write file" };
+	}
+}
+
+}// namespace graph_diff
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <string_view>
+
+#include "WebGraph.h"
+
+namespace graph_diff
+{
+
+// Graph files are graphml files or edge logs of a single site, both are streamed.
+// Nodes of the graphs are aligned by web_graph::MakeKey with an external sort-merge join,
+// so only the sort buffers and the node urls of an edge log are kept in memory
+
+// Changes between two graphs in the key order, the urls are valid during the call only
+class IDiffSink
+{
+public:
+	virtual ~IDiffSink() = default;
+	virtual void OnNodeAdded(std::string_view url) = 0;
+	virtual void OnNodeRemoved(std::string_view url) = 0;
+	// Number of the links from the page to the page in the old and the new graph, zero if there are none
+	virtual void OnLinkChanged(
+		std::string_view sourceUrl,
+		std::string_view targetUrl,
+		web_graph::NodeLinkNum oldCount,
+		web_graph::NodeLinkNum newCount) = 0;
+};
+
+struct DiffSettings
+{
+	static constexpr size_t DefaultMemoryBytes{ 256 * 1024 * 1024 };
+
+	// Memory of the sort buffers, the sorted runs over it are spilled to the directory
+	size_t memoryBytes{ DefaultMemoryBytes };
+	// The temp directory if empty
+	std::string spillDir;
+};
+
+struct DiffStats
+{
+	size_t nodesAdded{ 0 };
+	size_t nodesRemoved{ 0 };
+	size_t linksAdded{ 0 };
+	size_t linksRemoved{ 0 };
+	// Links of both graphs repeated a different number of times
+	size_t linksChanged{ 0 };
+};
+
+struct MergeStats
+{
+	size_t nodesNum{ 0 };
+	size_t linksNum{ 0 };
+};
+
+DiffStats DiffGraphs(
+	const std::string& oldGraphPath,
+	const std::string& newGraphPath,
+	IDiffSink& sink,
+	const DiffSettings& settings = {});
+
+// Union of the graphs of partial or repeated crawls written as graphml, the first node of the first graph is the root.
+// A link is repeated as many times as in the graph it is repeated the most in, so the pages parsed
+// by several crawls don't get their links doubled
+MergeStats MergeGraphs(
+	const std::vector<std::string>& graphPaths,
+	const std::string& outFilePath,
+	const DiffSettings& settings = {});
+
+// Writes the changes one per line: "node+ url", "node- url", "link+ source target count",
+// "link- source target count" and "link~ source target old_count new_count"
+class TextDiffWriter : public IDiffSink
+{
+public:
+	explicit TextDiffWriter(const std::string& outFilePath);
+
+	void OnNodeAdded(std::string_view url) override;
+	void OnNodeRemoved(std::string_view url) override;
+	void OnLinkChanged(
+		std::string_view sourceUrl,
+		std::string_view targetUrl,
+		web_graph::NodeLinkNum oldCount,
+		web_graph::NodeLinkNum newCount) override;
+
+	// Throws if anything failed to be written
+	void Close();
+
+private:
+	std::ofstream m_outFile;
+};
+
+}// namespace graph_diff
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "WebGraph.h"
+
+namespace web_graph
+{
+
+// Receives the changes of the graphs built by AsyncWebGraphBuilder as they are made.
+// Events of a site come in order from one thread at a time, events of different sites may interleave.
+// Called from the crawl threads, so the sink should not block for long and should not throw
+class IGraphSink
+{
+public:
+	virtual ~IGraphSink() = default;
+
+	// Comes before the other events of the site, the first node added is the root
+	virtual void OnSiteStarted(uint32_t siteId, const Url& rootUrl) = 0;
+	virtual void OnNodeAdded(uint32_t siteId, NodeId node, const Url& url) = 0;
+	virtual void OnLinkAdded(uint32_t siteId, NodeId from, NodeId to) = 0;
+	// The node is deleted, its inbound links point to the other node from now on
+	virtual void OnNodeMerged(uint32_t siteId, NodeId node, NodeId into) = 0;
+	virtual void OnSiteCompleted(uint32_t siteId) = 0;
+};
+
+}// namespace web_graph
@@ -0,0 +1,65 @@
+#include "GraphView.h"
+
+namespace web_graph
+{
+
+GraphView::GraphView(const WebGraph& graph) noexcept
+	: m_graph(&graph)
+	, m_nodesNum(web_graph::GetNodesNum(graph))
+	, m_linksNum(web_graph::GetLinksNum(graph))
+{
+}
+
+GraphView::GraphView(const WebGraph& graph, NodeMask activeNodes)
+	: m_graph(&graph)
+	, m_active(std::move(activeNodes))
+	, m_masked(true)
+{
+	// Count once here, the mask may have bits of nodes missing in the graph
+	for (const auto& node : web_graph::GetNodes(graph))
+	{
+		if (IsActive(*node.second))
+		{
+			++m_nodesNum;
+			for (const auto& outNodeLinksInfo : GetOutboundNodeLinks(*node.second))
+			{
+				if (IsActive(*outNodeLinksInfo.first))
+				{
+					m_linksNum += outNodeLinksInfo.second;
+				}
+			}
+		}
+	}
+}
+
+const WebGraph& GraphView::GetGraph() const noexcept
+{
+	return *m_graph;
+}
+
+bool GraphView::IsMasked() const noexcept
+{
+	return m_masked;
+}
+
+const NodeMask& GraphView::GetMask() const noexcept
+{
+	return m_active;
+}
+
+bool GraphView::IsActive(const WebPageNode& node) const noexcept
+{
+	return !m_masked || m_active.Test(GetNodeId(node));
+}
+
+size_t GraphView::GetNodesNum() const noexcept
+{
+	return m_nodesNum;
+}
+
+size_t GraphView::GetLinksNum() const noexcept
+{
+	return m_linksNum;
+}
+
+}// namespace web_graph
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "WebGraph.h"
+
+namespace web_graph
+{
+
+// Read-only view of a graph restricted to the nodes set in the active mask.
+// Links are visible only if both of their ends are active.
+// A view without a mask shows the whole graph, algorithms take a fast path for it
+class GraphView
+{
+public:
+	explicit GraphView(const WebGraph& graph) noexcept;
+	GraphView(const WebGraph& graph, NodeMask activeNodes);
+
+	const WebGraph& GetGraph() const noexcept;
+	bool IsMasked() const noexcept;
+	// Valid only for a masked view
+	const NodeMask& GetMask() const noexcept;
+
+	bool IsActive(const WebPageNode& node) const noexcept;
+	size_t GetNodesNum() const noexcept;
+	size_t GetLinksNum() const noexcept;
+
+private:
+	const WebGraph* m_graph;
+	NodeMask m_active;
+	bool m_masked{ false };
+	size_t m_nodesNum{ 0 };
+	size_t m_linksNum{ 0 };
+};
+
+}// namespace web_graph
@@ -1,148 +1,504 @@
 #include "GraphmlSerialization.h"
 
-#include <regex>
-#include <fstream>
+#include <future>
+#include <vector>
+#include <limits>
+#include <algorithm>
 
 #include "Common.h"
+#include "Parallel.h"
 
 namespace graphml
 {
 
-void Serialize(const web_graph::WebGraph& graph, const std::string& outFilePath)
+Writer::Writer(const std::string& outFilePath)
+	: m_outFile(outFilePath)
 {
-	using namespace common;
-	using namespace web_graph;
-
-	std::ofstream outFile{ outFilePath };
-	if (!outFile.is_open())
+	if (!m_outFile.is_open())
 	{
 		throw std::runtime_error{ "Failed to open file" };
 	}
 
-	outFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+	m_outFile << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
 		<< "<graphml xmlns=\"http://graphml.graphdrawing.org/xmlns\">\n"
 		<< "    <graph id=\"WebSiteGraph\" edgedefault=\"directed\">\n";
+}
+
+void Writer::WriteNode(std::string_view url)
+{
+	m_outFile << "        <node id=\"" << url << "\"/>\n";
+}
+
+void Writer::WriteEdge(std::string_view sourceUrl, std::string_view targetUrl)
+{
+	m_outFile << "        <edge source=\"" << sourceUrl << "\"" << " target=\"" << targetUrl << "\"/>\n";
+}
+
+void Writer::Close()
+{
+	m_outFile << "    </graph>\n" << "</graphml>";
+	m_outFile.close();
+	if (m_outFile.fail())
+	{
+		throw std::runtime_error{ "Failed to write file" };
+	}
+}
+
+void Serialize(const web_graph::WebGraph& graph, const std::string& outFilePath)
+{
+	using namespace common;
+	using namespace web_graph;
+
+	Writer writer{ outFilePath };
+
+	// Deserialize takes the first node as the root
+	const WebPageNode* root{ GetRoot(graph) };
+	if (root && !NodeMarkedAsDeleted(graph, *root))
+	{
+		writer.WriteNode(GetNodeUrl(*root));
+	}
 
 	const Nodes& nodes = GetNodes(graph);
 	for (const auto& node : nodes)
 	{
 		const WebPageNode* currNode{ node.second.get() };
-		if (!NodeMarkedAsDeleted(*currNode))
+		if (currNode != root && !NodeMarkedAsDeleted(graph, *currNode))
 		{
-			outFile << "        <node id=\"" << GetNodeUrl(*node.second) << "\"/>\n";
+			writer.WriteNode(GetNodeUrl(*node.second));
 		}
 	}
 
 	for (const auto& node : nodes)
 	{
 		const WebPageNode& currNode = *node.second.get();
-		if (!NodeMarkedAsDeleted(currNode))
+		if (!NodeMarkedAsDeleted(graph, currNode))
 		{
 			auto outLinkNodes = GetOutboundNodeLinks(*node.second);
 			for (auto outNodeLinksInfo : outLinkNodes)
 			{
-				if (!NodeMarkedAsDeleted(*outNodeLinksInfo.first))
+				if (!NodeMarkedAsDeleted(graph, *outNodeLinksInfo.first))
 				{
 					for (size_t i{ 0 }; i < outNodeLinksInfo.second; ++i)
 					{
-						outFile << "        <edge source=\"" << GetNodeUrl(*node.second) << "\""
-							<< " target=\"" << GetNodeUrl(*outNodeLinksInfo.first) << "\"/>\n";
+						writer.WriteEdge(GetNodeUrl(*node.second), GetNodeUrl(*outNodeLinksInfo.first));
 					}
 				}
 			}
 		}
 	}
 
-	outFile << "    </graph>\n" << "</graphml>";
+	writer.Close();
 }
 
-void AddNode(std::unique_ptr<web_graph::WebGraph>& graph, const std::smatch& match)
+// Value of the attribute in the line, false if there is no such attribute
+bool FindAttribute(std::string_view line, std::string_view prefix, size_t& pos, std::string_view& value) noexcept
 {
-	using namespace web_graph;
+	const size_t start{ line.find(prefix, pos) };
+	if (start == std::string_view::npos)
+	{
+		return false;
+	}
 
-	if (match.size() != 2)
+	const size_t valueStart{ start + prefix.size() };
+	const size_t end{ line.find('"', valueStart) };
+	if (end == std::string_view::npos || end == valueStart)
 	{
-		throw std::invalid_argument{ "Corrupted graphml: invalid node match" };
+		return false;
 	}
 
-	std::string nodeUrl{ match[1] };
-	if (graph)
+	value = line.substr(valueStart, end - valueStart);
+	pos = end + 1;
+	return true;
+}
+
+void Read(const std::string& filePath, const NodeCallback& onNode, const EdgeCallback& onEdge)
+{
+	std::ifstream inFile{ filePath };
+	if (!inFile.is_open())
 	{
-		AddNode(*graph, nodeUrl);
+		throw std::runtime_error{ "Failed to open file" };
 	}
-	else
+
+	std::string line;
+	bool edgesStarted{ false };
+	std::string_view source;
+	std::string_view target;
+
+	while (std::getline(inFile, line))
 	{
-		graph = std::make_unique<WebGraph>(CreateWebGraph(nodeUrl));
+		size_t pos{ 0 };
+		if (!edgesStarted && FindAttribute(line, "<node id=\"", pos, source))
+		{
+			onNode(source);
+		}
+		else if (FindAttribute(line, "<edge source=\"", pos, source) && FindAttribute(line, " target=\"", pos, target))
+		{
+			edgesStarted = true;
+			onEdge(source, target);
+		}
 	}
 }
 
-void AddLink(web_graph::WebGraph& graph, const std::smatch& match)
+namespace
 {
-	using namespace web_graph;
 
-	if (match.size() != 3)
+// Bytes of the file parsed at once
+constexpr size_t BlockBytes{ 32 * 1024 * 1024 };
+
+// Lines of a block parsed by one thread
+struct BlockPart
+{
+	// Nodes before the first edge of the part
+	std::vector<std::string_view> nodes;
+	std::vector<std::pair<std::string_view, std::string_view>> edges;
+	std::vector<web_graph::IndexedLink> links;
+};
+
+// Open addressing index of the url keys, which are copied one after another, so a lookup
+// mostly touches a slot and a key only
+class KeyIndex
+{
+public:
+	// The index doesn't grow, so the number of the keys is known in advance
+	void Reserve(size_t keysNum)
+	{
+		m_shift = 4;
+		while ((size_t{ 1 } << m_shift) < keysNum * 2)
+		{
+			++m_shift;
+		}
+
+		m_slots.assign(size_t{ 1 } << m_shift, Slot{});
+		m_keys.clear();
+	}
+
+	// False if there is such a key already
+	bool Insert(std::string_view key, uint64_t hash, web_graph::NodeId id)
 	{
-		throw std::invalid_argument{ "Corrupted graphml: invalid link match" };
+		if (key.size() > MaxKeySize)
+		{
+			throw std::runtime_error{ "Corrupted graphml: too long url" };
+		}
+
+		Slot& slot = m_slots[FindSlot(key, hash)];
+		if (slot.id != NoId)
+		{
+			return false;
+		}
+
+		slot = { static_cast<uint32_t>(hash), id, m_keys.size() << KeySizeBits | key.size() };
+		m_keys.append(key);
+		return true;
 	}
 
-	std::string fromUrl{ match[1] };
-	WebPageNode* fromNode{ GetNode(graph, fromUrl) };
-	if (!fromNode)
+	const web_graph::NodeId* Find(std::string_view key, uint64_t hash) const noexcept
 	{
-		throw std::runtime_error{ "Corrupted graphml: source node not found" };
+		const Slot& slot = m_slots[FindSlot(key, hash)];
+		return slot.id != NoId ? &slot.id : nullptr;
 	}
 
-	std::string toUrl{ match[2] };
-	WebPageNode* toNode{ GetNode(graph, toUrl) };
-	if (!toNode)
+	void Remap(const std::vector<web_graph::NodeId>& ids) noexcept
 	{
-		throw std::runtime_error{ "Corrupted graphml: dest node not found" };
+		for (Slot& slot : m_slots)
+		{
+			if (slot.id != NoId)
+			{
+				slot.id = ids[slot.id];
+			}
+		}
 	}
 
-	AddLink(graph, *toNode, *fromNode);
-}
+private:
+	static constexpr web_graph::NodeId NoId{ std::numeric_limits<web_graph::NodeId>::max() };
+	static constexpr size_t KeySizeBits{ 24 };
+	static constexpr size_t MaxKeySize{ (size_t{ 1 } << KeySizeBits) - 1 };
 
-std::unique_ptr<web_graph::WebGraph> Deserialize(const std::string & filePath)
+	struct Slot
+	{
+		// Low bits of the hash, most of the other keys on the probe path differ in them
+		uint32_t tag{ 0 };
+		web_graph::NodeId id{ NoId };
+		// Offset of the key in the keys << KeySizeBits | size of the key
+		uint64_t key{ 0 };
+	};
+
+	// Slot of the key or the free one it would take, the table is at most half full
+	size_t FindSlot(std::string_view key, uint64_t hash) const noexcept
+	{
+		const size_t mask{ m_slots.size() - 1 };
+		for (size_t i{ static_cast<size_t>(hash >> (64 - m_shift)) }; ; i = (i + 1) & mask)
+		{
+			const Slot& slot = m_slots[i];
+			if (slot.id == NoId || (slot.tag == static_cast<uint32_t>(hash) &&
+				std::string_view{ m_keys }.substr(slot.key >> KeySizeBits, slot.key & MaxKeySize) == key))
+			{
+				return i;
+			}
+		}
+	}
+
+private:
+	std::vector<Slot> m_slots;
+	size_t m_shift{ 0 };
+	std::string m_keys;
+};
+
+// Collects the urls of the nodes and resolves the urls of the edges to their indices on several threads.
+// The urls are indexed by key once the edges start, in shards built in parallel
+class GraphLoader
 {
-	using namespace web_graph;
+public:
+	explicit GraphLoader(size_t threadsNum)
+		: m_threadsNum(std::max<size_t>(threadsNum, 1))
+		, m_parts(m_threadsNum) {}
 
-	std::ifstream inFile{ filePath };
-	if (!inFile.is_open())
+	void AddLines(std::string_view lines)
 	{
-		return false;
+		common::ParallelFor(m_threadsNum, m_threadsNum, [this, lines](size_t part, size_t, size_t)
+		{
+			ParseLines(lines.substr(0, GetPartBegin(lines, part + 1)).substr(GetPartBegin(lines, part)), m_parts[part]);
+		});
+
+		for (BlockPart& part : m_parts)
+		{
+			if (!m_edgesStarted)
+			{
+				m_urls.insert(m_urls.end(), part.nodes.begin(), part.nodes.end());
+			}
+
+			m_edgesStarted = m_edgesStarted || !part.edges.empty();
+		}
+
+		if (!m_edgesStarted)
+		{
+			return;
+		}
+
+		if (m_urls.empty())
+		{
+			throw std::runtime_error{ "Corrupted graphml : no nodes added but egges found" };
+		}
+
+		if (m_shards.empty())
+		{
+			BuildIndex();
+		}
+
+		common::ParallelFor(m_threadsNum, m_threadsNum, [this](size_t part, size_t, size_t)
+		{
+			ResolveEdges(m_parts[part]);
+		});
+
+		for (BlockPart& part : m_parts)
+		{
+			m_links.insert(m_links.end(), part.links.begin(), part.links.end());
+		}
 	}
 
-	static const std::regex nodeRegex{ "<node id=\"(\\S+)\"/>" };
-	static const std::regex edgeRegex{ "<edge source=\"(\\S+)\" target=\"(\\S+)\"/>" };
-	std::smatch match;
+	std::unique_ptr<web_graph::WebGraph> Finish()
+	{
+		if (m_urls.empty())
+		{
+			return nullptr;
+		}
 
-	std::string line;
-	bool edgesStarted{ false };
+		if (m_shards.empty())
+		{
+			BuildIndex();
+		}
 
-	std::unique_ptr<web_graph::WebGraph> graph;
-	while (std::getline(inFile, line))
+		m_shards.clear();
+		size_t nodesNum{ 0 };
+		for (size_t i{ 0 }; i < m_urls.size(); ++i)
+		{
+			if (!m_repeated[i] && nodesNum++ != i)
+			{
+				m_urls[nodesNum - 1] = std::move(m_urls[i]);
+			}
+		}
+
+		m_urls.resize(nodesNum);
+		return std::make_unique<web_graph::WebGraph>(
+			web_graph::BuildWebGraph(std::move(m_urls), std::move(m_links), m_threadsNum));
+	}
+
+private:
+	// Part boundaries are moved to the line starts
+	size_t GetPartBegin(std::string_view lines, size_t part) const noexcept
 	{
-		if (!edgesStarted && std::regex_search(line, match, nodeRegex))
+		if (part == 0 || part == m_threadsNum)
 		{
-			AddNode(graph, match);
+			return part ? lines.size() : 0;
 		}
-		else if (std::regex_search(line, match, edgeRegex))
+
+		const size_t lineEnd{ lines.find('\n', lines.size() / m_threadsNum * part) };
+		return lineEnd != std::string_view::npos ? lineEnd + 1 : lines.size();
+	}
+
+	static void ParseLines(std::string_view lines, BlockPart& part)
+	{
+		part.nodes.clear();
+		part.edges.clear();
+
+		std::string_view source;
+		std::string_view target;
+		while (!lines.empty())
 		{
-			if (!graph)
+			const size_t lineEnd{ std::min(lines.find('\n'), lines.size()) };
+			const std::string_view line{ lines.substr(0, lineEnd) };
+			lines.remove_prefix(std::min(lineEnd + 1, lines.size()));
+
+			size_t pos{ 0 };
+			if (part.edges.empty() && FindAttribute(line, "<node id=\"", pos, source))
 			{
-				throw std::runtime_error{ "Corrupted graphml : no nodes added but egges found" };
+				part.nodes.push_back(source);
 			}
+			else if (FindAttribute(line, "<edge source=\"", pos, source) && FindAttribute(line, " target=\"", pos, target))
+			{
+				part.edges.emplace_back(source, target);
+			}
+		}
+	}
 
-			if (!edgesStarted)
+	static uint64_t GetHash(std::string_view key) noexcept
+	{
+		return std::hash<std::string_view>{}(key);
+	}
+
+	// Urls repeating a key are the node of the first one, the nodes get ids without them
+	void BuildIndex()
+	{
+		std::vector<uint64_t> hashes(m_urls.size());
+		common::ParallelFor(m_threadsNum, m_urls.size(), [this, &hashes](size_t begin, size_t end, size_t)
+		{
+			for (size_t i{ begin }; i < end; ++i)
 			{
-				edgesStarted = true;
+				hashes[i] = GetHash(web_graph::MakeKey(m_urls[i]));
 			}
+		});
+
+		m_shards.resize(m_threadsNum);
+		m_repeated.assign(m_urls.size(), 0);
+		common::ParallelFor(m_threadsNum, m_threadsNum, [this, &hashes](size_t shard, size_t, size_t)
+		{
+			KeyIndex& index = m_shards[shard];
+			index.Reserve(static_cast<size_t>(std::count_if(hashes.begin(), hashes.end(),
+				[this, shard](uint64_t hash) { return hash % m_threadsNum == shard; })));
 
-			AddLink(*graph, match);
+			for (size_t i{ 0 }; i < m_urls.size(); ++i)
+			{
+				if (hashes[i] % m_threadsNum == shard)
+				{
+					m_repeated[i] = !index.Insert(web_graph::MakeKey(m_urls[i]), hashes[i], static_cast<web_graph::NodeId>(i));
+				}
+			}
+		});
+
+		if (std::find(m_repeated.begin(), m_repeated.end(), 1) == m_repeated.end())
+		{
+			return;
+		}
+
+		std::vector<web_graph::NodeId> ids(m_urls.size());
+		web_graph::NodeId nextId{ 0 };
+		for (size_t i{ 0 }; i < m_urls.size(); ++i)
+		{
+			ids[i] = nextId;
+			nextId += !m_repeated[i];
+		}
+
+		common::ParallelFor(m_threadsNum, m_threadsNum, [this, &ids](size_t shard, size_t, size_t)
+		{
+			m_shards[shard].Remap(ids);
+		});
+	}
+
+	const web_graph::NodeId* FindNode(std::string_view url) const noexcept
+	{
+		const std::string_view key{ web_graph::MakeKey(url) };
+		const uint64_t hash{ GetHash(key) };
+		return m_shards[hash % m_threadsNum].Find(key, hash);
+	}
+
+	void ResolveEdges(BlockPart& part) const
+	{
+		part.links.clear();
+		part.links.reserve(part.edges.size());
+
+		// Edges of a page go one after another
+		std::string_view lastSourceUrl;
+		const web_graph::NodeId* source{ nullptr };
+		for (const auto& edge : part.edges)
+		{
+			if (edge.first != lastSourceUrl)
+			{
+				lastSourceUrl = edge.first;
+				source = FindNode(edge.first);
+			}
+
+			if (!source)
+			{
+				throw std::runtime_error{ "Corrupted graphml: source node not found" };
+			}
+
+			const web_graph::NodeId* target{ FindNode(edge.second) };
+			if (!target)
+			{
+				throw std::runtime_error{ "Corrupted graphml: dest node not found" };
+			}
+
+			part.links.push_back({ *source, *target });
 		}
 	}
 
-	return graph;
+private:
+	const size_t m_threadsNum;
+	std::vector<BlockPart> m_parts;
+	bool m_edgesStarted{ false };
+
+	std::vector<web_graph::Url> m_urls;
+	// Bytes, as the shards set them in parallel
+	std::vector<char> m_repeated;
+	std::vector<KeyIndex> m_shards;
+	std::vector<web_graph::IndexedLink> m_links;
+};
+
+}// namespace
+
+std::unique_ptr<web_graph::WebGraph> Deserialize(const std::string& filePath, size_t threadsNum)
+{
+	std::ifstream inFile{ filePath, std::ios::binary };
+	if (!inFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	// Appends the next block after the cut line of the previous one
+	auto readBlock = [&inFile](std::string& block)
+	{
+		const size_t tailSize{ block.size() };
+		block.resize(tailSize + BlockBytes);
+		inFile.read(block.data() + tailSize, BlockBytes);
+		block.resize(tailSize + static_cast<size_t>(inFile.gcount()));
+	};
+
+	GraphLoader loader{ threadsNum };
+	std::string block;
+	std::string nextBlock;
+	readBlock(block);
+
+	// The next block is read while the lines of the current one are parsed
+	while (!block.empty())
+	{
+		const size_t linesEnd{ inFile ? block.rfind('\n') + 1 : block.size() };
+		nextBlock.assign(block, linesEnd, std::string::npos);
+		auto reading = std::async(std::launch::async, readBlock, std::ref(nextBlock));
+		loader.AddLines(std::string_view{ block }.substr(0, linesEnd));
+		reading.get();
+		block.swap(nextBlock);
+	}
+
+	return loader.Finish();
 }
 
 }// graphml
\ No newline at end of file
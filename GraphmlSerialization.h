@@ -1,11 +1,39 @@
 #pragma once
 
+#include <fstream>
+#include <functional>
+#include <string_view>
+
 #include "WebGraph.h"
 
 namespace graphml
 {
 
+// Writes a graph element by element without having it in memory.
+// All the nodes go before the edges, Deserialize takes the first node as the root
+class Writer
+{
+public:
+	explicit Writer(const std::string& outFilePath);
+
+	void WriteNode(std::string_view url);
+	void WriteEdge(std::string_view sourceUrl, std::string_view targetUrl);
+	// Completes the document, throws if anything failed to be written
+	void Close();
+
+private:
+	std::ofstream m_outFile;
+};
+
+using NodeCallback = std::function<void(std::string_view url)>;
+using EdgeCallback = std::function<void(std::string_view sourceUrl, std::string_view targetUrl)>;
+
+// Streams the nodes and the edges of a file without having the graph in memory,
+// the urls are valid during the call only. Nodes after the first edge are skipped
+void Read(const std::string& filePath, const NodeCallback& onNode, const EdgeCallback& onEdge);
+
 void Serialize(const web_graph::WebGraph& graph, const std::string& outFilePath);
-std::unique_ptr<web_graph::WebGraph> Deserialize(const std::string& filePath);
+// Parses the blocks of the file and builds the graph on up to threadsNum threads
+std::unique_ptr<web_graph::WebGraph> Deserialize(const std::string& filePath, size_t threadsNum = 1);
 
 }// graphml
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #include <string>
 #include <memory>
+#include <chrono>
+#include <functional>
 
 namespace network
 {
@@ -14,10 +16,25 @@ struct ProxySettings
 	std::string password;
 };
 
+enum class DownloadErrorType { None, Resolve, Connect, Timeout, Ssl, Http, Other };
+
+// Left zero by downloaders which do not measure them
+struct DownloadTimings
+{
+	std::chrono::microseconds dns{ 0 };
+	std::chrono::microseconds connect{ 0 };
+	std::chrono::microseconds ttfb{ 0 };
+	std::chrono::microseconds transfer{ 0 };
+};
+
 struct WebPageDownloadResult
 {
 	std::string data;
+	// Content-Type header, empty if the server sent none
+	std::string contentType;
 	std::string error;
+	DownloadErrorType errorType{ DownloadErrorType::None };
+	DownloadTimings timings;
 };
 
 class IWebPageDownloader
@@ -27,9 +44,32 @@ public:
 	virtual WebPageDownloadResult DownloadPage(const std::string& url) = 0;
 };
 
+// Keeps many downloads in flight on the thread which polls it, the downloads progress only inside Poll()
+class IAsyncWebPageDownloader
+{
+public:
+	using CompletionHandler = std::function<void(WebPageDownloadResult&& result)>;
+
+	virtual ~IAsyncWebPageDownloader() = default;
+
+	virtual void SetProxy(const ProxySettings& proxySettings) = 0;
+	// The handler is called from Poll() once the download is finished or failed
+	virtual void StartDownload(const std::string& url, CompletionHandler onCompleted) = 0;
+	// Waits up to the timeout for the downloads to progress and calls the handlers of the finished ones,
+	// returns at once if there is nothing in flight. Returns the number of downloads still in flight
+	virtual size_t Poll(std::chrono::milliseconds timeout) = 0;
+	// Drops the downloads in flight without calling their handlers
+	virtual void CancelAll() = 0;
+};
+
 struct IWebPageDownloaderFactory
 {
 	virtual std::unique_ptr<IWebPageDownloader> Create() const = 0;
+	// Null if the downloaders have no async counterpart
+	virtual std::unique_ptr<IAsyncWebPageDownloader> CreateAsync() const
+	{
+		return nullptr;
+	}
 };
 
 }// namespace network
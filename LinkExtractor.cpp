@@ -0,0 +1,460 @@
+#include "LinkExtractor.h"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define WEB_GRAPH_X86_SIMD
+#endif
+
+#include "StringUtils.h"
+
+namespace web_graph
+{
+
+namespace
+{
+
+// Bytes searched for at once, up to 16. The vector is padded with the first of them
+struct ByteSet
+{
+	explicit ByteSet(std::string_view chars) noexcept
+		: size(static_cast<int>(chars.size()))
+	{
+		for (size_t i{ 0 }; i < sizeof(bytes); ++i)
+		{
+			bytes[i] = chars[i < chars.size() ? i : 0];
+		}
+
+		for (char c : chars)
+		{
+			table[static_cast<unsigned char>(c)] = true;
+		}
+	}
+
+	alignas(16) char bytes[16];
+	int size;
+	std::array<bool, 256> table{};
+};
+
+enum class Tag
+{
+	Other,
+	Anchor,
+	Area,
+	Link,
+	Frame,
+	Meta,
+	Base
+};
+
+// The first of the repeated attributes wins, like in browsers
+struct Attributes
+{
+	std::string_view href;
+	std::string_view src;
+	std::string_view rel;
+	std::string_view httpEquiv;
+	std::string_view content;
+};
+
+using FindFunction = const char* (*)(const char* pos, const char* end, const ByteSet& set) noexcept;
+
+}// namespace
+
+static const ByteSet TagStart{ "<" };
+static const ByteSet DoubleQuote{ "\"" };
+static const ByteSet SingleQuote{ "'" };
+static const ByteSet UnquotedValueEnd{ " \t\r\n\f>" };
+
+static const char* FindScalar(const char* pos, const char* end, const ByteSet& set) noexcept
+{
+	while (pos != end && !set.table[static_cast<unsigned char>(*pos)])
+	{
+		++pos;
+	}
+
+	return pos;
+}
+
+#ifdef WEB_GRAPH_X86_SIMD
+
+__attribute__((target("sse4.2")))
+static const char* FindSse42(const char* pos, const char* end, const ByteSet& set) noexcept
+{
+	const __m128i bytes{ _mm_load_si128(reinterpret_cast<const __m128i*>(set.bytes)) };
+
+	if (set.size == 1)
+	{
+		// A plain compare finds a single byte faster than the string instructions
+		for (; end - pos >= 16; pos += 16)
+		{
+			const __m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)) };
+			const int mask{ _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, bytes)) };
+			if (mask)
+			{
+				return pos + __builtin_ctz(mask);
+			}
+		}
+	}
+	else
+	{
+		for (; end - pos >= 16; pos += 16)
+		{
+			const __m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos)) };
+			const int index{ _mm_cmpestri(bytes, set.size, chunk, 16,
+				_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT) };
+			if (index < 16)
+			{
+				return pos + index;
+			}
+		}
+	}
+
+	return FindScalar(pos, end, set);
+}
+
+__attribute__((target("avx2")))
+static const char* FindAvx2(const char* pos, const char* end, const ByteSet& set) noexcept
+{
+	__m256i bytes[16];
+	for (int i{ 0 }; i < set.size; ++i)
+	{
+		bytes[i] = _mm256_set1_epi8(set.bytes[i]);
+	}
+
+	for (; end - pos >= 32; pos += 32)
+	{
+		const __m256i chunk{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pos)) };
+		__m256i matches{ _mm256_cmpeq_epi8(chunk, bytes[0]) };
+		for (int i{ 1 }; i < set.size; ++i)
+		{
+			matches = _mm256_or_si256(matches, _mm256_cmpeq_epi8(chunk, bytes[i]));
+		}
+
+		const uint32_t mask{ static_cast<uint32_t>(_mm256_movemask_epi8(matches)) };
+		if (mask)
+		{
+			return pos + __builtin_ctz(mask);
+		}
+	}
+
+	return FindScalar(pos, end, set);
+}
+
+#endif
+
+static FindFunction GetFindFunction(ScanLevel level) noexcept
+{
+#ifdef WEB_GRAPH_X86_SIMD
+	switch (level)
+	{
+	case ScanLevel::Avx2: return FindAvx2;
+	case ScanLevel::Sse42: return FindSse42;
+	default: break;
+	}
+#endif
+
+	return FindScalar;
+}
+
+static bool IsAlNum(char c) noexcept
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || ('0' <= c && c <= '9');
+}
+
+static std::string_view Trim(std::string_view str) noexcept
+{
+	while (!str.empty() && common::IsSpace(str.front()))
+	{
+		str.remove_prefix(1);
+	}
+
+	while (!str.empty() && common::IsSpace(str.back()))
+	{
+		str.remove_suffix(1);
+	}
+
+	return str;
+}
+
+static Tag GetTag(std::string_view name, const LinkExtractionSettings& settings) noexcept
+{
+	if (settings.anchors && common::EqualsIgnoreCase(name, "a")) return Tag::Anchor;
+	if (settings.areas && common::EqualsIgnoreCase(name, "area")) return Tag::Area;
+	if (settings.pagination && common::EqualsIgnoreCase(name, "link")) return Tag::Link;
+	if (settings.frames && (common::EqualsIgnoreCase(name, "frame") || common::EqualsIgnoreCase(name, "iframe"))) return Tag::Frame;
+	if (settings.metaRefresh && common::EqualsIgnoreCase(name, "meta")) return Tag::Meta;
+	if (settings.baseHref && common::EqualsIgnoreCase(name, "base")) return Tag::Base;
+	return Tag::Other;
+}
+
+static void SetAttribute(Attributes& attributes, std::string_view name, std::string_view value) noexcept
+{
+	std::string_view* attribute{ nullptr };
+	if (common::EqualsIgnoreCase(name, "href")) attribute = &attributes.href;
+	else if (common::EqualsIgnoreCase(name, "src")) attribute = &attributes.src;
+	else if (common::EqualsIgnoreCase(name, "rel")) attribute = &attributes.rel;
+	else if (common::EqualsIgnoreCase(name, "http-equiv")) attribute = &attributes.httpEquiv;
+	else if (common::EqualsIgnoreCase(name, "content")) attribute = &attributes.content;
+
+	if (attribute && !attribute->data())
+	{
+		*attribute = value;
+	}
+}
+
+// Reads the attributes up to the end of the tag, returns the position after it
+static const char* ReadAttributes(const char* pos, const char* end, FindFunction find, Attributes& attributes) noexcept
+{
+	for (;;)
+	{
+		while (pos != end && (common::IsSpace(*pos) || *pos == '/'))
+		{
+			++pos;
+		}
+
+		if (pos == end || *pos == '>')
+		{
+			return pos == end ? end : pos + 1;
+		}
+
+		const char* nameBegin{ pos };
+		while (pos != end && !common::IsSpace(*pos) && *pos != '=' && *pos != '>' && *pos != '/')
+		{
+			++pos;
+		}
+
+		// A stray '=' is taken as a name
+		if (pos == nameBegin)
+		{
+			++pos;
+		}
+
+		const std::string_view name{ nameBegin, static_cast<size_t>(pos - nameBegin) };
+
+		while (pos != end && common::IsSpace(*pos))
+		{
+			++pos;
+		}
+
+		if (pos == end || *pos != '=')
+		{
+			continue;
+		}
+
+		++pos;
+		while (pos != end && common::IsSpace(*pos))
+		{
+			++pos;
+		}
+
+		if (pos == end)
+		{
+			return end;
+		}
+
+		const char* valueBegin{ pos };
+		const char* valueEnd{ nullptr };
+		if (*pos == '"' || *pos == '\'')
+		{
+			++valueBegin;
+			valueEnd = find(valueBegin, end, *pos == '"' ? DoubleQuote : SingleQuote);
+			pos = valueEnd == end ? end : valueEnd + 1;
+		}
+		else
+		{
+			valueEnd = find(valueBegin, end, UnquotedValueEnd);
+			pos = valueEnd;
+		}
+
+		SetAttribute(attributes, name, { valueBegin, static_cast<size_t>(valueEnd - valueBegin) });
+	}
+}
+
+// rel is a space separated list of link types
+static bool HasLinkType(std::string_view rel, std::string_view lowerType) noexcept
+{
+	for (size_t pos{ 0 }; pos < rel.size();)
+	{
+		const size_t typeEnd{ std::min(rel.find_first_of(" \t\r\n\f", pos), rel.size()) };
+		if (common::EqualsIgnoreCase(rel.substr(pos, typeEnd - pos), lowerType))
+		{
+			return true;
+		}
+
+		pos = typeEnd + 1;
+	}
+
+	return false;
+}
+
+// Url of "5; url=/next", the "url=" part and the quotes are optional
+static std::string_view GetRefreshUrl(std::string_view content) noexcept
+{
+	const size_t separator{ content.find_first_of(";,") };
+	if (separator == std::string_view::npos)
+	{
+		return {};
+	}
+
+	std::string_view url{ Trim(content.substr(separator + 1)) };
+	if (url.size() > 3 && common::EqualsIgnoreCase(url.substr(0, 3), "url"))
+	{
+		const std::string_view value{ Trim(url.substr(3)) };
+		if (!value.empty() && value.front() == '=')
+		{
+			url = Trim(value.substr(1));
+		}
+	}
+
+	if (!url.empty() && (url.front() == '"' || url.front() == '\''))
+	{
+		url = url.substr(1, url.find(url.front(), 1) - 1);
+	}
+
+	return Trim(url);
+}
+
+static void AddLinks(Tag tag, const Attributes& attributes, PageLinks& result)
+{
+	std::string_view link;
+	switch (tag)
+	{
+	case Tag::Anchor:
+	case Tag::Area:
+		link = attributes.href;
+		break;
+	case Tag::Link:
+		if (HasLinkType(attributes.rel, "next") || HasLinkType(attributes.rel, "prev"))
+		{
+			link = attributes.href;
+		}
+		break;
+	case Tag::Frame:
+		link = attributes.src;
+		break;
+	case Tag::Meta:
+		if (common::EqualsIgnoreCase(Trim(attributes.httpEquiv), "refresh"))
+		{
+			link = GetRefreshUrl(attributes.content);
+		}
+		break;
+	case Tag::Base:
+		if (result.baseHref.empty())
+		{
+			result.baseHref = Trim(attributes.href);
+		}
+		return;
+	default:
+		return;
+	}
+
+	if (!link.empty())
+	{
+		result.links.push_back(link);
+	}
+}
+
+LinkExtractionSettings ParseLinkTags(std::string_view list)
+{
+	LinkExtractionSettings settings{ false, false, false, false, false, false };
+	for (size_t pos{ 0 }; pos < list.size();)
+	{
+		const size_t nameEnd{ std::min(list.find(',', pos), list.size()) };
+		const std::string_view name{ Trim(list.substr(pos, nameEnd - pos)) };
+
+		if (name == "a") settings.anchors = true;
+		else if (name == "area") settings.areas = true;
+		else if (name == "link") settings.pagination = true;
+		else if (name == "frame" || name == "iframe") settings.frames = true;
+		else if (name == "meta") settings.metaRefresh = true;
+		else if (name == "base") settings.baseHref = true;
+		else throw std::invalid_argument{ "Unknown link tag: " + std::string{ name } };
+
+		pos = nameEnd + 1;
+	}
+
+	return settings;
+}
+
+ScanLevel GetSupportedScanLevel() noexcept
+{
+#ifdef WEB_GRAPH_X86_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2"))
+	{
+		return ScanLevel::Avx2;
+	}
+
+	if (__builtin_cpu_supports("sse4.2"))
+	{
+		return ScanLevel::Sse42;
+	}
+#endif
+
+	return ScanLevel::Scalar;
+}
+
+const char* ToString(ScanLevel level) noexcept
+{
+	switch (level)
+	{
+	case ScanLevel::Scalar: return "scalar";
+	case ScanLevel::Sse42: return "sse4.2";
+	case ScanLevel::Avx2: return "avx2";
+	default: return "unknown";
+	}
+}
+
+HtmlLinkExtractor::HtmlLinkExtractor(const LinkExtractionSettings& settings, ScanLevel level)
+	: m_settings(settings)
+	, m_level(level)
+{
+	if (level > GetSupportedScanLevel())
+	{
+		throw std::invalid_argument{ std::string{ "Scan level is not supported by the cpu: " } + ToString(level) };
+	}
+}
+
+void HtmlLinkExtractor::Extract(std::string_view html, PageLinks& result) const
+{
+	const FindFunction find{ GetFindFunction(m_level) };
+	result.baseHref = {};
+	result.links.clear();
+
+	const char* const end{ html.data() + html.size() };
+	for (const char* pos{ find(html.data(), end, TagStart) }; pos != end; pos = find(pos, end, TagStart))
+	{
+		++pos;
+		if (end - pos >= 3 && std::memcmp(pos, "!--", 3) == 0)
+		{
+			const size_t commentEnd{ html.find("-->", static_cast<size_t>(pos - html.data()) + 3) };
+			pos = commentEnd == std::string_view::npos ? end : html.data() + commentEnd + 3;
+			continue;
+		}
+
+		// Closing tags and the rest of the markup have no name here
+		const char* nameEnd{ pos };
+		while (nameEnd != end && IsAlNum(*nameEnd))
+		{
+			++nameEnd;
+		}
+
+		const Tag tag{ GetTag({ pos, static_cast<size_t>(nameEnd - pos) }, m_settings) };
+		pos = nameEnd;
+		if (tag == Tag::Other || (pos != end && !common::IsSpace(*pos) && *pos != '>' && *pos != '/'))
+		{
+			continue;
+		}
+
+		Attributes attributes;
+		pos = ReadAttributes(pos, end, find, attributes);
+		AddLinks(tag, attributes, result);
+	}
+}
+
+}// namespace web_graph
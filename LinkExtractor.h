@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <string_view>
+
+namespace web_graph
+{
+
+// Links of a page as they are written in it, the views point into the html
+struct PageLinks
+{
+	// href of the first <base>, the links are relative to it instead of the page url. Empty if there is none
+	std::string_view baseHref;
+	std::vector<std::string_view> links;
+};
+
+// Finds the links of a page, called from the parse thread only
+class ILinkExtractor
+{
+public:
+	virtual ~ILinkExtractor() = default;
+	virtual void Extract(std::string_view html, PageLinks& result) const = 0;
+};
+
+// Tags the links are taken from
+struct LinkExtractionSettings
+{
+	// <a href>
+	bool anchors{ true };
+	// <area href> of image maps
+	bool areas{ true };
+	// <link rel="next"> and rel="prev" of paginated pages
+	bool pagination{ true };
+	// <frame src> and <iframe src>
+	bool frames{ true };
+	// <meta http-equiv="refresh" content="0; url=...">
+	bool metaRefresh{ true };
+	// Resolve the links against <base href>
+	bool baseHref{ true };
+};
+
+// Comma separated tag list like "a,area,link,frame,meta,base", throws on unknown names
+LinkExtractionSettings ParseLinkTags(std::string_view list);
+
+// Instruction set the scanner searches the html with
+enum class ScanLevel
+{
+	Scalar,
+	Sse42,
+	Avx2
+};
+
+// Best level the cpu supports
+ScanLevel GetSupportedScanLevel() noexcept;
+const char* ToString(ScanLevel level) noexcept;
+
+// Single pass scanner which jumps from '<' to '<' and over the attribute values 16 or 32 bytes at a time,
+// only the tags with links are tokenized. Comments are skipped, the rest of the markup is taken as is
+class HtmlLinkExtractor : public ILinkExtractor
+{
+public:
+	// Throws if the cpu does not support the level
+	explicit HtmlLinkExtractor(
+		const LinkExtractionSettings& settings = {},
+		ScanLevel level = GetSupportedScanLevel());
+
+	void Extract(std::string_view html, PageLinks& result) const override;
+
+private:
+	LinkExtractionSettings m_settings;
+	ScanLevel m_level;
+};
+
+}// namespace web_graph
@@ -0,0 +1,171 @@
+#include "NodeMask.h"
+
+#include <algorithm>
+
+namespace web_graph
+{
+
+size_t WordsFor(size_t bitsNum) noexcept
+{
+	return (bitsNum + NodeMask::WordBits - 1) / NodeMask::WordBits;
+}
+
+NodeMask::NodeMask(size_t bitsNum, bool value)
+	: m_words(std::make_shared<std::vector<Word>>(WordsFor(bitsNum), value ? ~Word{ 0 } : Word{ 0 }))
+	, m_size(bitsNum)
+{
+	ClearTail();
+}
+
+size_t NodeMask::GetSize() const noexcept
+{
+	return m_size;
+}
+
+void NodeMask::Resize(size_t bitsNum)
+{
+	if (bitsNum != m_size)
+	{
+		Mutable().resize(WordsFor(bitsNum), 0);
+		m_size = bitsNum;
+		ClearTail();
+	}
+}
+
+bool NodeMask::Test(NodeId id) const noexcept
+{
+	return id < m_size && ((*m_words)[id / WordBits] >> (id % WordBits)) & 1;
+}
+
+void NodeMask::Set(NodeId id)
+{
+	if (id >= m_size)
+	{
+		// Grow geometrically, ids are assigned sequentially
+		Resize(std::max<size_t>(id + 1, m_size * 2));
+	}
+
+	Mutable()[id / WordBits] |= Word{ 1 } << (id % WordBits);
+}
+
+void NodeMask::Reset(NodeId id)
+{
+	if (Test(id))
+	{
+		Mutable()[id / WordBits] &= ~(Word{ 1 } << (id % WordBits));
+	}
+}
+
+void NodeMask::Clear()
+{
+	if (Any())
+	{
+		std::vector<Word>& words = Mutable();
+		std::fill(words.begin(), words.end(), 0);
+	}
+}
+
+size_t NodeMask::Count() const noexcept
+{
+	size_t result{ 0 };
+	const Word* words{ GetWords() };
+	for (size_t i{ 0 }; i < GetWordsNum(); ++i)
+	{
+		result += static_cast<size_t>(__builtin_popcountll(words[i]));
+	}
+
+	return result;
+}
+
+bool NodeMask::Any() const noexcept
+{
+	const Word* words{ GetWords() };
+	return std::any_of(words, words + GetWordsNum(), [](Word word) { return word != 0; });
+}
+
+NodeMask& NodeMask::operator&=(const NodeMask& other)
+{
+	std::vector<Word>& words = Mutable();
+	const Word* otherWords{ other.GetWords() };
+	for (size_t i{ 0 }; i < words.size(); ++i)
+	{
+		words[i] &= i < other.GetWordsNum() ? otherWords[i] : 0;
+	}
+
+	return *this;
+}
+
+NodeMask& NodeMask::operator|=(const NodeMask& other)
+{
+	if (other.m_size > m_size)
+	{
+		Resize(other.m_size);
+	}
+
+	std::vector<Word>& words = Mutable();
+	const Word* otherWords{ other.GetWords() };
+	for (size_t i{ 0 }; i < other.GetWordsNum(); ++i)
+	{
+		words[i] |= otherWords[i];
+	}
+
+	return *this;
+}
+
+NodeMask& NodeMask::AndNot(const NodeMask& other)
+{
+	std::vector<Word>& words = Mutable();
+	const Word* otherWords{ other.GetWords() };
+	for (size_t i{ 0 }; i < std::min(words.size(), other.GetWordsNum()); ++i)
+	{
+		words[i] &= ~otherWords[i];
+	}
+
+	return *this;
+}
+
+NodeMask& NodeMask::Invert()
+{
+	for (Word& word : Mutable())
+	{
+		word = ~word;
+	}
+
+	ClearTail();
+	return *this;
+}
+
+const NodeMask::Word* NodeMask::GetWords() const noexcept
+{
+	return m_words ? m_words->data() : nullptr;
+}
+
+size_t NodeMask::GetWordsNum() const noexcept
+{
+	return m_words ? m_words->size() : 0;
+}
+
+std::vector<NodeMask::Word>& NodeMask::Mutable()
+{
+	if (!m_words)
+	{
+		m_words = std::make_shared<std::vector<Word>>();
+	}
+	else if (m_words.use_count() > 1)
+	{
+		// Copy on write
+		m_words = std::make_shared<std::vector<Word>>(*m_words);
+	}
+
+	return *m_words;
+}
+
+void NodeMask::ClearTail() noexcept
+{
+	if (m_size % WordBits && m_words && !m_words->empty())
+	{
+		m_words->back() &= (Word{ 1 } << (m_size % WordBits)) - 1;
+	}
+}
+
+}// namespace web_graph
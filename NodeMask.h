@@ -0,0 +1,70 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+namespace web_graph
+{
+
+using NodeId = uint32_t;
+
+// Dense bitset indexed by node id. Copies share the bits until one of them is modified,
+// so taking a mask snapshot is O(1)
+class NodeMask
+{
+public:
+	using Word = uint64_t;
+	static constexpr size_t WordBits{ 64 };
+
+	NodeMask() = default;
+	explicit NodeMask(size_t bitsNum, bool value = false);
+
+	size_t GetSize() const noexcept;
+	void Resize(size_t bitsNum);
+
+	bool Test(NodeId id) const noexcept;
+	void Set(NodeId id);
+	void Reset(NodeId id);
+	void Clear();
+
+	// Number of set bits
+	size_t Count() const noexcept;
+	bool Any() const noexcept;
+
+	NodeMask& operator&=(const NodeMask& other);
+	NodeMask& operator|=(const NodeMask& other);
+	// Clears the bits set in other
+	NodeMask& AndNot(const NodeMask& other);
+	NodeMask& Invert();
+
+	const Word* GetWords() const noexcept;
+	size_t GetWordsNum() const noexcept;
+
+	// Calls func(NodeId) for every set bit in ascending order, skipping zero words at once
+	template<typename Func>
+	void ForEachSet(Func&& func) const
+	{
+		const Word* words{ GetWords() };
+		const size_t wordsNum{ GetWordsNum() };
+		for (size_t i{ 0 }; i < wordsNum; ++i)
+		{
+			Word word{ words[i] };
+			while (word)
+			{
+				func(static_cast<NodeId>(i * WordBits + __builtin_ctzll(word)));
+				word &= word - 1;
+			}
+		}
+	}
+
+private:
+	std::vector<Word>& Mutable();
+	void ClearTail() noexcept;
+
+private:
+	std::shared_ptr<std::vector<Word>> m_words;
+	size_t m_size{ 0 };
+};
+
+}// namespace web_graph
@@ -0,0 +1,142 @@
+#include "NodeOrder.h"
+
+#include <numeric>
+#include <algorithm>
+#include <stdexcept>
+
+namespace web_graph
+{
+
+// Neighbours of both directions, a node linked both ways is counted twice
+static std::vector<uint32_t> GetDegrees(const CompressedGraph& graph)
+{
+	std::vector<uint32_t> degrees(graph.GetNodesNum(), 0);
+	for (NodeId node{ 0 }; node < degrees.size(); ++node)
+	{
+		for (const auto& link : graph.GetOutboundLinks(node))
+		{
+			++degrees[node];
+			++degrees[link.node];
+		}
+	}
+
+	return degrees;
+}
+
+// Appends the nodes reached from the start to the order, which also serves as the queue.
+// The neighbours of a node are taken by id or, if the degrees are given, by degree
+static void AppendBfsOrder(const CompressedGraph& graph, NodeId start, const std::vector<uint32_t>* degrees,
+	std::vector<bool>& visited, std::vector<NodeId>& order)
+{
+	std::vector<NodeId> neighbours;
+	visited[start] = true;
+	order.push_back(start);
+
+	for (size_t next{ order.size() - 1 }; next < order.size(); ++next)
+	{
+		const NodeId node{ order[next] };
+		neighbours.clear();
+
+		for (const auto& links : { graph.GetOutboundLinks(node), graph.GetInboundLinks(node) })
+		{
+			for (const auto& link : links)
+			{
+				if (!visited[link.node])
+				{
+					visited[link.node] = true;
+					neighbours.push_back(link.node);
+				}
+			}
+		}
+
+		if (degrees)
+		{
+			std::stable_sort(neighbours.begin(), neighbours.end(),
+				[degrees](NodeId left, NodeId right) { return (*degrees)[left] < (*degrees)[right]; });
+		}
+
+		order.insert(order.end(), neighbours.begin(), neighbours.end());
+	}
+}
+
+static std::vector<NodeId> MakeBfsOrder(const CompressedGraph& graph, NodeId start)
+{
+	const size_t nodesNum{ graph.GetNodesNum() };
+	std::vector<bool> visited(nodesNum, false);
+	std::vector<NodeId> order;
+	order.reserve(nodesNum);
+
+	if (nodesNum > 0)
+	{
+		AppendBfsOrder(graph, start, nullptr, visited, order);
+	}
+
+	for (NodeId node{ 0 }; node < nodesNum; ++node)
+	{
+		if (!visited[node])
+		{
+			AppendBfsOrder(graph, node, nullptr, visited, order);
+		}
+	}
+
+	return order;
+}
+
+static std::vector<NodeId> MakeDegreeOrder(const CompressedGraph& graph)
+{
+	const std::vector<uint32_t> degrees{ GetDegrees(graph) };
+	std::vector<NodeId> order(graph.GetNodesNum());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(),
+		[&degrees](NodeId left, NodeId right) { return degrees[left] > degrees[right]; });
+
+	return order;
+}
+
+static std::vector<NodeId> MakeReverseCuthillMcKeeOrder(const CompressedGraph& graph)
+{
+	const size_t nodesNum{ graph.GetNodesNum() };
+	const std::vector<uint32_t> degrees{ GetDegrees(graph) };
+
+	// Every component starts from its least linked node
+	std::vector<NodeId> starts(nodesNum);
+	std::iota(starts.begin(), starts.end(), 0);
+	std::stable_sort(starts.begin(), starts.end(),
+		[&degrees](NodeId left, NodeId right) { return degrees[left] < degrees[right]; });
+
+	std::vector<bool> visited(nodesNum, false);
+	std::vector<NodeId> order;
+	order.reserve(nodesNum);
+	for (NodeId start : starts)
+	{
+		if (!visited[start])
+		{
+			AppendBfsOrder(graph, start, &degrees, visited, order);
+		}
+	}
+
+	std::reverse(order.begin(), order.end());
+	return order;
+}
+
+std::vector<NodeId> MakeNodeOrder(const CompressedGraph& graph, NodeOrder order, NodeId start)
+{
+	if (start >= graph.GetNodesNum() && graph.GetNodesNum() > 0)
+	{
+		throw std::invalid_argument{ "Start node is out of range" };
+	}
+
+	switch (order)
+	{
+	case NodeOrder::Bfs:
+		return MakeBfsOrder(graph, start);
+	case NodeOrder::Degree:
+		return MakeDegreeOrder(graph);
+	case NodeOrder::ReverseCuthillMcKee:
+		return MakeReverseCuthillMcKeeOrder(graph);
+	}
+
+	throw std::invalid_argument{ "Unknown node order" };
+}
+
+}// namespace web_graph
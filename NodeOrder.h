@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "CompressedGraph.h"
+
+namespace web_graph
+{
+
+enum class NodeOrder
+{
+	// Breadth-first from the start node, neighbours of both directions
+	Bfs,
+	// Most linked nodes first, the hubs share the cache lines
+	Degree,
+	// Breadth-first from the least linked nodes with the neighbours by degree, reversed.
+	// Keeps the neighbours of a node close to it and to each other
+	ReverseCuthillMcKee
+};
+
+// Node order for CompressedGraph::Relabel. Nodes not reached from the start are ordered after them.
+// The start of a graph made of a WebGraph in id order is its root, node 0
+std::vector<NodeId> MakeNodeOrder(const CompressedGraph& graph, NodeOrder order, NodeId start = 0);
+
+}// namespace web_graph
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+namespace common
+{
+
+// Calls func(begin, end, part) for every part of [0, itemsNum) split into up to partsNum contiguous ranges,
+// each on its own thread. Rethrows the first exception thrown by the parts after all of them are done
+template<typename Func>
+void ParallelFor(size_t partsNum, size_t itemsNum, Func&& func)
+{
+	partsNum = std::max<size_t>(std::min(partsNum, itemsNum), 1);
+	auto getBegin = [partsNum, itemsNum](size_t part) { return itemsNum / partsNum * part + std::min(part, itemsNum % partsNum); };
+
+	if (partsNum == 1)
+	{
+		func(size_t{ 0 }, itemsNum, size_t{ 0 });
+		return;
+	}
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+	auto runPart = [&](size_t part)
+	{
+		try
+		{
+			func(getBegin(part), getBegin(part + 1), part);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock{ errorMutex };
+			if (!error)
+			{
+				error = std::current_exception();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(partsNum - 1);
+	for (size_t part{ 1 }; part < partsNum; ++part)
+	{
+		threads.emplace_back(runPart, part);
+	}
+
+	runPart(0);
+	for (std::thread& t : threads)
+	{
+		t.join();
+	}
+
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+}
+
+}// namespace common
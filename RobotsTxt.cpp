@@ -0,0 +1,329 @@
+#include "RobotsTxt.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+#include "StringUtils.h"
+#include "UrlNormalizer.h"
+
+namespace web_graph
+{
+
+static int HexValue(char c) noexcept
+{
+	if ('0' <= c && c <= '9') return c - '0';
+	if ('a' <= c && c <= 'f') return c - 'a' + 10;
+	if ('A' <= c && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+static std::string_view TrimSpaces(std::string_view str) noexcept
+{
+	while (!str.empty() && (str.front() == ' ' || str.front() == '\t'))
+	{
+		str.remove_prefix(1);
+	}
+
+	while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r'))
+	{
+		str.remove_suffix(1);
+	}
+
+	return str;
+}
+
+// Same form the crawled urls have after NormalizeUrl
+static std::string NormalizePattern(std::string_view pattern)
+{
+	std::string result;
+	result.reserve(pattern.size());
+
+	for (size_t i{ 0 }; i < pattern.size(); ++i)
+	{
+		int high{ 0 }, low{ 0 };
+		if (pattern[i] == '%' && i + 2 < pattern.size() &&
+			(high = HexValue(pattern[i + 1])) >= 0 && (low = HexValue(pattern[i + 2])) >= 0)
+		{
+			const char decoded{ static_cast<char>(high * 16 + low) };
+			if (IsDecodedEscape(decoded))
+			{
+				result += common::ToLowerAscii(decoded);
+			}
+			else
+			{
+				result += '%';
+				result += common::ToLowerAscii(pattern[i + 1]);
+				result += common::ToLowerAscii(pattern[i + 2]);
+			}
+
+			i += 2;
+		}
+		else
+		{
+			result += common::ToLowerAscii(pattern[i]);
+		}
+	}
+
+	return result;
+}
+
+// '*' matches any sequence, the pattern matches a prefix of the path unless it is exact
+static bool MatchWildcard(std::string_view pattern, std::string_view path, bool exact) noexcept
+{
+	size_t p{ 0 }, s{ 0 };
+	size_t starP{ std::string_view::npos }, starS{ 0 };
+
+	while (true)
+	{
+		if (p == pattern.size() && (!exact || s == path.size()))
+		{
+			return true;
+		}
+
+		if (p < pattern.size() && pattern[p] == '*')
+		{
+			starP = p++;
+			starS = s;
+		}
+		else if (p < pattern.size() && s < path.size() && pattern[p] == path[s])
+		{
+			++p;
+			++s;
+		}
+		else if (starP != std::string_view::npos && starS < path.size())
+		{
+			p = starP + 1;
+			s = ++starS;
+		}
+		else
+		{
+			return false;
+		}
+	}
+}
+
+RobotsRules::RobotsRules()
+	: m_trie(1)
+{
+}
+
+RobotsRules RobotsRules::Parse(std::string_view content, std::string_view userAgent)
+{
+	// Only the product token is matched, "name/1.0" -> "name", case is ignored
+	std::string lowerUserAgent{ userAgent.substr(0, userAgent.find('/')) };
+	std::transform(lowerUserAgent.begin(), lowerUserAgent.end(), lowerUserAgent.begin(), common::ToLowerAscii);
+
+	RobotsRules specificRules;
+	RobotsRules anyRules;
+	bool specificGroupFound{ false };
+	std::vector<std::string> sitemaps;
+
+	// Consecutive User-agent lines start a group, the following rules belong to all its agents
+	bool readingAgents{ false };
+	bool groupIsSpecific{ false };
+	bool groupIsAny{ false };
+
+	while (!content.empty())
+	{
+		const size_t lineEnd{ std::min(content.find('\n'), content.size()) };
+		std::string_view line{ content.substr(0, lineEnd) };
+		content.remove_prefix(std::min(lineEnd + 1, content.size()));
+
+		line = line.substr(0, line.find('#'));
+		const size_t separator{ line.find(':') };
+		if (separator == std::string_view::npos)
+		{
+			continue;
+		}
+
+		const std::string_view key{ TrimSpaces(line.substr(0, separator)) };
+		const std::string_view value{ TrimSpaces(line.substr(separator + 1)) };
+
+		if (common::EqualsIgnoreCase(key, "user-agent"))
+		{
+			if (!readingAgents)
+			{
+				readingAgents = true;
+				groupIsSpecific = false;
+				groupIsAny = false;
+			}
+
+			if (value == "*")
+			{
+				groupIsAny = true;
+			}
+			else if (common::EqualsIgnoreCase(value.substr(0, value.find('/')), lowerUserAgent))
+			{
+				groupIsSpecific = true;
+				specificGroupFound = true;
+			}
+		}
+		else if (common::EqualsIgnoreCase(key, "allow") || common::EqualsIgnoreCase(key, "disallow"))
+		{
+			readingAgents = false;
+
+			// An empty Disallow allows everything, which is the default anyway
+			if (!value.empty())
+			{
+				const bool allow{ common::EqualsIgnoreCase(key, "allow") };
+				if (groupIsSpecific)
+				{
+					specificRules.AddRule(value, allow);
+				}
+
+				if (groupIsAny)
+				{
+					anyRules.AddRule(value, allow);
+				}
+			}
+		}
+		else if (common::EqualsIgnoreCase(key, "crawl-delay"))
+		{
+			readingAgents = false;
+
+			const std::string delayStr{ value };
+			char* end{ nullptr };
+			const double seconds{ std::strtod(delayStr.c_str(), &end) };
+			if (end != delayStr.c_str() && std::isfinite(seconds) && seconds > 0.0)
+			{
+				// Clamped before the conversion, which would overflow for huge values
+				const double maxSeconds{ std::chrono::duration<double>(MaxCrawlDelay).count() };
+				const std::chrono::milliseconds delay{ static_cast<int64_t>(std::min(seconds, maxSeconds) * 1000) };
+				if (groupIsSpecific)
+				{
+					specificRules.m_crawlDelay = delay;
+				}
+
+				if (groupIsAny)
+				{
+					anyRules.m_crawlDelay = delay;
+				}
+			}
+		}
+		else if (common::EqualsIgnoreCase(key, "sitemap"))
+		{
+			if (!value.empty())
+			{
+				sitemaps.emplace_back(value);
+			}
+		}
+	}
+
+	RobotsRules result{ specificGroupFound ? std::move(specificRules) : std::move(anyRules) };
+	result.m_sitemaps = std::move(sitemaps);
+	return result;
+}
+
+void RobotsRules::AddRule(std::string_view pattern, bool allow)
+{
+	std::string normalized{ NormalizePattern(pattern) };
+
+	const bool exact{ !normalized.empty() && normalized.back() == '$' };
+	if (exact)
+	{
+		normalized.pop_back();
+	}
+
+	const Rule rule{ allow ? Rule::Allow : Rule::Disallow };
+
+	if (normalized.find('*') != std::string::npos)
+	{
+		m_wildcardRules.push_back({ std::move(normalized), exact, allow });
+		return;
+	}
+
+	uint32_t node{ 0 };
+	for (char symbol : normalized)
+	{
+		uint32_t child{ GetChild(node, symbol) };
+		node = child ? child : AddChild(node, symbol);
+	}
+
+	// Allow wins if the same path is both allowed and disallowed
+	Rule& nodeRule = exact ? m_trie[node].exactRule : m_trie[node].rule;
+	if (nodeRule != Rule::Allow)
+	{
+		nodeRule = rule;
+	}
+}
+
+bool RobotsRules::IsAllowed(std::string_view path) const noexcept
+{
+	Rule bestRule{ Rule::None };
+	size_t bestLength{ 0 };
+
+	auto consider = [&](Rule rule, size_t length)
+	{
+		if (rule != Rule::None &&
+			(bestRule == Rule::None || length > bestLength || (length == bestLength && rule == Rule::Allow)))
+		{
+			bestRule = rule;
+			bestLength = length;
+		}
+	};
+
+	uint32_t node{ 0 };
+	for (size_t i{ 0 }; i < path.size(); ++i)
+	{
+		node = GetChild(node, path[i]);
+		if (!node)
+		{
+			break;
+		}
+
+		consider(m_trie[node].rule, i + 1);
+		if (i + 1 == path.size())
+		{
+			consider(m_trie[node].exactRule, i + 1);
+		}
+	}
+
+	for (const WildcardRule& rule : m_wildcardRules)
+	{
+		if (MatchWildcard(rule.pattern, path, rule.exact))
+		{
+			consider(rule.allow ? Rule::Allow : Rule::Disallow, rule.pattern.size());
+		}
+	}
+
+	return bestRule != Rule::Disallow;
+}
+
+std::chrono::milliseconds RobotsRules::GetCrawlDelay() const noexcept
+{
+	return m_crawlDelay;
+}
+
+const std::vector<std::string>& RobotsRules::GetSitemaps() const noexcept
+{
+	return m_sitemaps;
+}
+
+uint32_t RobotsRules::GetChild(uint32_t node, char symbol) const noexcept
+{
+	for (uint32_t child{ m_trie[node].firstChild }; child; child = m_trie[child].nextSibling)
+	{
+		if (m_trie[child].symbol == symbol)
+		{
+			return child;
+		}
+	}
+
+	return 0;
+}
+
+uint32_t RobotsRules::AddChild(uint32_t node, char symbol)
+{
+	const uint32_t child{ static_cast<uint32_t>(m_trie.size()) };
+
+	TrieNode childNode;
+	childNode.symbol = symbol;
+	childNode.nextSibling = m_trie[node].firstChild;
+	m_trie.push_back(childNode);
+	m_trie[node].firstChild = child;
+
+	return child;
+}
+
+}// namespace web_graph
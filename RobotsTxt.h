@@ -0,0 +1,67 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <string_view>
+
+namespace web_graph
+{
+
+// Allow/Disallow rules of robots.txt (RFC 9309) for a single user agent.
+// Plain rules are kept in a prefix trie, so a check is one walk down the path,
+// rules with '*' wildcards are matched separately. The longest matching rule wins,
+// Allow wins a tie. Patterns are lowercased and %XX decoded the same way NormalizeUrl does
+class RobotsRules
+{
+public:
+	// Longer Crawl-delay values are clamped, a site asking for hours between pages would never be crawled
+	static constexpr std::chrono::milliseconds MaxCrawlDelay{ std::chrono::seconds{ 60 } };
+
+	// Rules of the groups naming the user agent or, if there are none, of the "*" groups
+	static RobotsRules Parse(std::string_view content, std::string_view userAgent);
+
+	// Allows everything
+	RobotsRules();
+
+	void AddRule(std::string_view pattern, bool allow);
+	// Path of the url including the query
+	bool IsAllowed(std::string_view path) const noexcept;
+
+	std::chrono::milliseconds GetCrawlDelay() const noexcept;
+	// Urls of the Sitemap lines, these do not belong to any group
+	const std::vector<std::string>& GetSitemaps() const noexcept;
+
+private:
+	enum class Rule : uint8_t { None, Allow, Disallow };
+
+	struct TrieNode
+	{
+		uint32_t firstChild{ 0 };
+		uint32_t nextSibling{ 0 };
+		char symbol{ 0 };
+		// Rule ending at the node and the one anchored with '$'
+		Rule rule{ Rule::None };
+		Rule exactRule{ Rule::None };
+	};
+
+	struct WildcardRule
+	{
+		std::string pattern;
+		bool exact;
+		bool allow;
+	};
+
+	uint32_t GetChild(uint32_t node, char symbol) const noexcept;
+	uint32_t AddChild(uint32_t node, char symbol);
+
+private:
+	// The root is the node 0, so 0 also means "no node" for the links
+	std::vector<TrieNode> m_trie;
+	std::vector<WildcardRule> m_wildcardRules;
+	std::chrono::milliseconds m_crawlDelay{ 0 };
+	std::vector<std::string> m_sitemaps;
+};
+
+}// namespace web_graph
@@ -0,0 +1,301 @@
+#include "Sitemap.h"
+
+#include <zlib.h>
+
+#include <cstdlib>
+#include <algorithm>
+#include <stdexcept>
+
+namespace web_graph
+{
+
+static constexpr size_t ChunkBytes{ 64 * 1024 };
+
+static bool HasPrefix(std::string_view str, std::string_view prefix) noexcept
+{
+	return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+static bool IsGzip(std::string_view data) noexcept
+{
+	return data.size() >= 2 &&
+		static_cast<unsigned char>(data[0]) == 0x1f && static_cast<unsigned char>(data[1]) == 0x8b;
+}
+
+static std::string_view TrimXmlSpaces(std::string_view str) noexcept
+{
+	const size_t begin{ str.find_first_not_of(" \t\r\n") };
+	if (begin == std::string_view::npos)
+	{
+		return {};
+	}
+
+	return str.substr(begin, str.find_last_not_of(" \t\r\n") - begin + 1);
+}
+
+// Predefined and numeric ASCII entities, the rest is kept as is
+static std::string DecodeXmlEntities(std::string_view text)
+{
+	static constexpr std::pair<std::string_view, char> entities[]{
+		{ "amp;", '&' }, { "lt;", '<' }, { "gt;", '>' }, { "quot;", '"' }, { "apos;", '\'' } };
+
+	std::string result;
+	result.reserve(text.size());
+
+	for (size_t i{ 0 }; i < text.size(); ++i)
+	{
+		if (text[i] != '&')
+		{
+			result += text[i];
+			continue;
+		}
+
+		const std::string_view rest{ text.substr(i + 1) };
+		bool decoded{ false };
+
+		for (const auto& entity : entities)
+		{
+			if (HasPrefix(rest, entity.first))
+			{
+				result += entity.second;
+				i += entity.first.size();
+				decoded = true;
+				break;
+			}
+		}
+
+		const size_t end{ rest.find(';') };
+		if (!decoded && HasPrefix(rest, "#") && end != std::string_view::npos && end < 10)
+		{
+			const std::string number{ rest.substr(1, end - 1) };
+			const bool hex{ !number.empty() && (number[0] == 'x' || number[0] == 'X') };
+
+			char* numberEnd{ nullptr };
+			const long code{ std::strtol(number.c_str() + hex, &numberEnd, hex ? 16 : 10) };
+			if (*numberEnd == '\0' && code > 0 && code < 128)
+			{
+				result += static_cast<char>(code);
+				i += end + 1;
+				decoded = true;
+			}
+		}
+
+		if (!decoded)
+		{
+			result += '&';
+		}
+	}
+
+	return result;
+}
+
+struct SitemapParser::Inflater
+{
+	Inflater()
+	{
+		// 16 selects the gzip wrapper
+		if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK)
+		{
+			throw std::runtime_error{ "Failed to init zlib" };
+		}
+	}
+
+	~Inflater()
+	{
+		inflateEnd(&stream);
+	}
+
+	z_stream stream{};
+};
+
+SitemapParser::SitemapParser(Callback onPage, Callback onSitemap)
+	: m_onPage(std::move(onPage))
+	, m_onSitemap(std::move(onSitemap))
+{
+}
+
+SitemapParser::~SitemapParser() = default;
+
+void SitemapParser::Feed(std::string_view data)
+{
+	if (!m_started && !data.empty())
+	{
+		m_started = true;
+		if (IsGzip(data))
+		{
+			m_inflater = std::make_unique<Inflater>();
+		}
+	}
+
+	if (!m_inflater)
+	{
+		FeedXml(data);
+		return;
+	}
+
+	z_stream& stream = m_inflater->stream;
+	stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+	stream.avail_in = static_cast<uInt>(data.size());
+
+	char out[ChunkBytes];
+	do
+	{
+		stream.next_out = reinterpret_cast<Bytef*>(out);
+		stream.avail_out = sizeof(out);
+
+		const int res{ inflate(&stream, Z_NO_FLUSH) };
+		if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+		{
+			throw std::runtime_error{ "Corrupted gzip sitemap" };
+		}
+
+		FeedXml({ out, sizeof(out) - stream.avail_out });
+
+		if (res == Z_STREAM_END)
+		{
+			// Concatenated gzip members continue the document, anything else is trailing garbage
+			const std::string_view rest{ reinterpret_cast<const char*>(stream.next_in), stream.avail_in };
+			if (!IsGzip(rest))
+			{
+				stream.avail_in = 0;
+				break;
+			}
+
+			inflateReset(&stream);
+		}
+		else if (res == Z_BUF_ERROR)
+		{
+			break;
+		}
+	}
+	while (stream.avail_in || !stream.avail_out);
+}
+
+void SitemapParser::FeedXml(std::string_view data)
+{
+	m_documentBytes += data.size();
+	if (m_documentBytes > MaxDocumentBytes)
+	{
+		throw std::runtime_error{ "Sitemap is too big" };
+	}
+
+	m_buffer.append(data);
+	ParseXml();
+}
+
+void SitemapParser::ParseXml()
+{
+	size_t pos{ 0 };
+	while (pos < m_buffer.size())
+	{
+		const size_t tagBegin{ m_buffer.find('<', pos) };
+		const size_t textEnd{ tagBegin != std::string::npos ? tagBegin : m_buffer.size() };
+		if (m_inLoc)
+		{
+			m_loc.append(m_buffer, pos, textEnd - pos);
+		}
+
+		pos = textEnd;
+		if (tagBegin == std::string::npos)
+		{
+			break;
+		}
+
+		const std::string_view rest{ std::string_view{ m_buffer }.substr(tagBegin) };
+		if (HasPrefix(rest, "<!"))
+		{
+			static constexpr std::string_view cdataBegin{ "<![CDATA[" };
+			static constexpr std::string_view commentBegin{ "<!--" };
+
+			if (rest.size() < cdataBegin.size())
+			{
+				// Wait for the rest of the markup
+				break;
+			}
+
+			const bool cdata{ HasPrefix(rest, cdataBegin) };
+			const bool comment{ HasPrefix(rest, commentBegin) };
+			if (cdata || comment)
+			{
+				const size_t bodyBegin{ tagBegin + (cdata ? cdataBegin.size() : commentBegin.size()) };
+				const size_t bodyEnd{ m_buffer.find(cdata ? "]]>" : "-->", bodyBegin) };
+				if (bodyEnd == std::string::npos)
+				{
+					break;
+				}
+
+				if (cdata && m_inLoc)
+				{
+					m_loc.append(m_buffer, bodyBegin, bodyEnd - bodyBegin);
+				}
+
+				pos = bodyEnd + 3;
+				continue;
+			}
+		}
+
+		const size_t tagEnd{ m_buffer.find('>', tagBegin) };
+		if (tagEnd == std::string::npos)
+		{
+			break;
+		}
+
+		OnTag(std::string_view{ m_buffer }.substr(tagBegin + 1, tagEnd - tagBegin - 1));
+		pos = tagEnd + 1;
+	}
+
+	m_buffer.erase(0, pos);
+}
+
+void SitemapParser::OnTag(std::string_view tag)
+{
+	const bool closing{ HasPrefix(tag, "/") };
+	if (closing)
+	{
+		tag.remove_prefix(1);
+	}
+
+	std::string_view name{ tag.substr(0, tag.find_first_of(" \t\r\n/")) };
+	// Drop the namespace prefix
+	name.remove_prefix(name.find(':') + 1);
+
+	if (name == "sitemap")
+	{
+		m_inSitemap = !closing;
+	}
+	else if (name == "url")
+	{
+		m_inSitemap = false;
+	}
+	else if (name == "loc")
+	{
+		if (!closing)
+		{
+			m_inLoc = true;
+			m_loc.clear();
+		}
+		else if (m_inLoc)
+		{
+			m_inLoc = false;
+
+			const std::string url{ DecodeXmlEntities(TrimXmlSpaces(m_loc)) };
+			if (!url.empty())
+			{
+				(m_inSitemap ? m_onSitemap : m_onPage)(url);
+			}
+		}
+	}
+}
+
+void ParseSitemap(std::string_view document, SitemapParser::Callback onPage, SitemapParser::Callback onSitemap)
+{
+	SitemapParser parser{ std::move(onPage), std::move(onSitemap) };
+	while (!document.empty())
+	{
+		const size_t chunkSize{ std::min(document.size(), ChunkBytes) };
+		parser.Feed(document.substr(0, chunkSize));
+		document.remove_prefix(chunkSize);
+	}
+}
+
+}// namespace web_graph
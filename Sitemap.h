@@ -0,0 +1,52 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <functional>
+#include <string_view>
+
+namespace web_graph
+{
+
+// Incremental parser of sitemaps and sitemap indexes (sitemaps.org), plain or gzip compressed.
+// The document is fed in parts of any size and never kept whole, only an unfinished tag is buffered
+class SitemapParser
+{
+public:
+	using Callback = std::function<void(std::string_view)>;
+
+	// Decompressed documents bigger than this are rejected, the protocol allows 50MB
+	static constexpr size_t MaxDocumentBytes{ 64 * 1024 * 1024 };
+
+	// onPage receives every <url><loc>, onSitemap every <sitemap><loc> of an index
+	SitemapParser(Callback onPage, Callback onSitemap);
+	~SitemapParser();
+
+	// Throws std::runtime_error on a corrupted gzip stream or an oversized document
+	void Feed(std::string_view data);
+
+private:
+	struct Inflater;
+
+	void FeedXml(std::string_view data);
+	void ParseXml();
+	void OnTag(std::string_view tag);
+
+private:
+	Callback m_onPage;
+	Callback m_onSitemap;
+
+	std::unique_ptr<Inflater> m_inflater;
+	bool m_started{ false };
+	size_t m_documentBytes{ 0 };
+
+	std::string m_buffer;
+	bool m_inLoc{ false };
+	bool m_inSitemap{ false };
+	std::string m_loc;
+};
+
+// Parses a downloaded sitemap in chunks
+void ParseSitemap(std::string_view document, SitemapParser::Callback onPage, SitemapParser::Callback onSitemap);
+
+}// namespace web_graph
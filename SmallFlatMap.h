@@ -0,0 +1,335 @@
+#pragma once
+
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+#include <type_traits>
+
+namespace common
+{
+
+// Map from pointers to small counters without a heap allocation for the first InlineSize entries.
+// Bigger maps move to an open addressing table with linear probing, null keys mark its free slots.
+// Iteration order is unspecified, any insertion or erase invalidates the iterators
+template<typename Key, typename Value, size_t InlineSize>
+class SmallFlatMap
+{
+	static_assert(std::is_pointer_v<Key>, "Null key marks the free slots");
+	static_assert(InlineSize > 0, "Inline storage should not be empty");
+
+public:
+	using key_type = Key;
+	using mapped_type = Value;
+	using value_type = std::pair<Key, Value>;
+	using size_type = size_t;
+
+	// Walks over the used slots
+	class const_iterator
+	{
+	public:
+		using iterator_category = std::forward_iterator_tag;
+		using value_type = SmallFlatMap::value_type;
+		using difference_type = std::ptrdiff_t;
+		using pointer = const value_type*;
+		using reference = const value_type&;
+
+		const_iterator() = default;
+
+		reference operator*() const noexcept
+		{
+			return *m_pos;
+		}
+
+		pointer operator->() const noexcept
+		{
+			return m_pos;
+		}
+
+		const_iterator& operator++() noexcept
+		{
+			++m_pos;
+			SkipFree();
+			return *this;
+		}
+
+		const_iterator operator++(int) noexcept
+		{
+			const_iterator result{ *this };
+			++*this;
+			return result;
+		}
+
+		bool operator==(const const_iterator& other) const noexcept
+		{
+			return m_pos == other.m_pos;
+		}
+
+		bool operator!=(const const_iterator& other) const noexcept
+		{
+			return m_pos != other.m_pos;
+		}
+
+	private:
+		friend class SmallFlatMap;
+
+		const_iterator(const value_type* pos, const value_type* end) noexcept
+			: m_pos(pos), m_end(end)
+		{
+			SkipFree();
+		}
+
+		void SkipFree() noexcept
+		{
+			while (m_pos != m_end && !m_pos->first)
+			{
+				++m_pos;
+			}
+		}
+
+	private:
+		const value_type* m_pos{ nullptr };
+		const value_type* m_end{ nullptr };
+	};
+
+	using iterator = const_iterator;
+
+	SmallFlatMap() = default;
+
+	SmallFlatMap(const SmallFlatMap& other)
+	{
+		*this = other;
+	}
+
+	SmallFlatMap(SmallFlatMap&& other) noexcept
+	{
+		*this = std::move(other);
+	}
+
+	SmallFlatMap& operator=(const SmallFlatMap& other)
+	{
+		if (this != &other)
+		{
+			std::copy(std::begin(other.m_inline), std::end(other.m_inline), std::begin(m_inline));
+			m_table.reset();
+			if (other.m_table)
+			{
+				m_table = std::make_unique<value_type[]>(other.GetCapacity());
+				std::copy(other.m_table.get(), other.m_table.get() + other.GetCapacity(), m_table.get());
+			}
+
+			m_size = other.m_size;
+			m_shift = other.m_shift;
+		}
+
+		return *this;
+	}
+
+	SmallFlatMap& operator=(SmallFlatMap&& other) noexcept
+	{
+		if (this != &other)
+		{
+			std::copy(std::begin(other.m_inline), std::end(other.m_inline), std::begin(m_inline));
+			m_table = std::move(other.m_table);
+			m_size = other.m_size;
+			m_shift = other.m_shift;
+			other.m_size = 0;
+			other.m_shift = 0;
+		}
+
+		return *this;
+	}
+
+	size_t size() const noexcept
+	{
+		return m_size;
+	}
+
+	bool empty() const noexcept
+	{
+		return !m_size;
+	}
+
+	const_iterator begin() const noexcept
+	{
+		return { GetSlots(), GetSlots() + GetSlotsNum() };
+	}
+
+	const_iterator end() const noexcept
+	{
+		return { GetSlots() + GetSlotsNum(), GetSlots() + GetSlotsNum() };
+	}
+
+	const_iterator find(Key key) const noexcept
+	{
+		const value_type* slot{ FindSlot(key) };
+		return slot && slot->first == key ? const_iterator{ slot, GetSlots() + GetSlotsNum() } : end();
+	}
+
+	size_t count(Key key) const noexcept
+	{
+		return find(key) != end();
+	}
+
+	// Value of the key, a zero one is inserted if there is none
+	Value& operator[](Key key)
+	{
+		value_type* slot{ const_cast<value_type*>(FindSlot(key)) };
+		if (slot && slot->first == key)
+		{
+			return slot->second;
+		}
+
+		if (!m_table && m_size < InlineSize)
+		{
+			m_inline[m_size] = { key, Value{} };
+			return m_inline[m_size++].second;
+		}
+
+		// Keeps the table at most 3/4 full, so the probes stay short and always end at a free slot
+		if ((m_size + 1) * 4 > GetCapacity() * 3)
+		{
+			Rehash(std::max<size_t>(GetCapacity() * 2, InlineSize * 4));
+			slot = const_cast<value_type*>(FindSlot(key));
+		}
+
+		*slot = { key, Value{} };
+		++m_size;
+		return slot->second;
+	}
+
+	// Returns the number of erased entries
+	size_t erase(Key key) noexcept
+	{
+		value_type* slot{ const_cast<value_type*>(FindSlot(key)) };
+		if (!slot || slot->first != key)
+		{
+			return 0;
+		}
+
+		--m_size;
+		if (!m_table)
+		{
+			*slot = m_inline[m_size];
+			m_inline[m_size] = {};
+			return 1;
+		}
+
+		// Backward shift deletion: moves up the entries of the probe run which may no longer be found
+		const size_t mask{ GetCapacity() - 1 };
+		size_t hole{ static_cast<size_t>(slot - m_table.get()) };
+		for (size_t i{ (hole + 1) & mask }; m_table[i].first; i = (i + 1) & mask)
+		{
+			const size_t home{ GetHome(m_table[i].first) };
+			if (((i - home) & mask) >= ((i - hole) & mask))
+			{
+				m_table[hole] = m_table[i];
+				hole = i;
+			}
+		}
+
+		m_table[hole] = {};
+		return 1;
+	}
+
+	// Makes room for the number of entries, so inserting them doesn't rehash
+	void reserve(size_t size)
+	{
+		if (size > InlineSize && size * 4 > GetCapacity() * 3)
+		{
+			Rehash(std::max<size_t>((size * 4 + 2) / 3, InlineSize * 4));
+		}
+	}
+
+	void clear() noexcept
+	{
+		std::fill(std::begin(m_inline), std::end(m_inline), value_type{});
+		m_table.reset();
+		m_size = 0;
+		m_shift = 0;
+	}
+
+private:
+	const value_type* GetSlots() const noexcept
+	{
+		return m_table ? m_table.get() : m_inline;
+	}
+
+	size_t GetSlotsNum() const noexcept
+	{
+		return m_table ? GetCapacity() : m_size;
+	}
+
+	size_t GetCapacity() const noexcept
+	{
+		return m_table ? size_t{ 1 } << m_shift : 0;
+	}
+
+	size_t GetHome(Key key) const noexcept
+	{
+		// Fibonacci hashing, the high bits of the product are the best mixed
+		const uint64_t hash{ static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key)) * 0x9e3779b97f4a7c15ull };
+		return static_cast<size_t>(hash >> (64 - m_shift));
+	}
+
+	// Slot of the key, or the free slot it would take in the table. Null if the inline storage has no such key
+	const value_type* FindSlot(Key key) const noexcept
+	{
+		if (!m_table)
+		{
+			const value_type* const end{ m_inline + m_size };
+			const value_type* slot{ std::find_if(m_inline, end, [key](const value_type& v) { return v.first == key; }) };
+			return slot != end ? slot : nullptr;
+		}
+
+		const size_t mask{ GetCapacity() - 1 };
+		for (size_t i{ GetHome(key) }; ; i = (i + 1) & mask)
+		{
+			if (m_table[i].first == key || !m_table[i].first)
+			{
+				return &m_table[i];
+			}
+		}
+	}
+
+	void Rehash(size_t minCapacity)
+	{
+		const size_t oldSlotsNum{ GetSlotsNum() };
+		std::unique_ptr<value_type[]> oldTable{ std::move(m_table) };
+		const value_type* const oldSlots{ oldTable ? oldTable.get() : m_inline };
+
+		m_shift = 0;
+		while ((size_t{ 1 } << m_shift) < minCapacity)
+		{
+			++m_shift;
+		}
+
+		m_table = std::make_unique<value_type[]>(size_t{ 1 } << m_shift);
+		const size_t mask{ GetCapacity() - 1 };
+		for (const value_type* slot{ oldSlots }; slot != oldSlots + oldSlotsNum; ++slot)
+		{
+			if (slot->first)
+			{
+				size_t i{ GetHome(slot->first) };
+				while (m_table[i].first)
+				{
+					i = (i + 1) & mask;
+				}
+
+				m_table[i] = *slot;
+			}
+		}
+
+		std::fill(std::begin(m_inline), std::end(m_inline), value_type{});
+	}
+
+private:
+	value_type m_inline[InlineSize]{};
+	// 2^m_shift slots, null while the entries fit inline
+	std::unique_ptr<value_type[]> m_table;
+	uint32_t m_size{ 0 };
+	uint32_t m_shift{ 0 };
+};
+
+}// namespace common
@@ -0,0 +1,189 @@
+#include "SpillStore.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <filesystem>
+
+namespace common
+{
+
+static std::runtime_error MakeIoError(const std::string& what, const std::string& path)
+{
+	return std::runtime_error{ what + " " + path + ": " + std::strerror(errno) };
+}
+
+SpillStore::SpillStore(std::string dir, std::string name, uint64_t segmentBytes)
+	: m_dir(std::move(dir))
+	, m_name(std::move(name))
+	, m_segmentBytes(segmentBytes)
+{
+	if (!m_segmentBytes)
+	{
+		throw std::invalid_argument{ "Spill segment size should be positive" };
+	}
+
+	std::filesystem::create_directories(m_dir);
+
+	std::lock_guard<std::mutex> l{ m_mutex };
+	OpenSegment();
+}
+
+SpillStore::~SpillStore()
+{
+	std::lock_guard<std::mutex> l{ m_mutex };
+	while (!m_segments.empty())
+	{
+		CloseSegment(m_segments.begin()->first);
+	}
+}
+
+SpillStore::Segment& SpillStore::OpenSegment()
+{
+	const uint32_t id{ m_nextSegment++ };
+
+	Segment segment;
+	segment.path = (std::filesystem::path{ m_dir } / (m_name + "-" + std::to_string(id) + ".spill")).string();
+	segment.fd = open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if (segment.fd < 0)
+	{
+		throw MakeIoError("Failed to create spill file", segment.path);
+	}
+
+	m_writeSegment = id;
+	return m_segments[id] = std::move(segment);
+}
+
+void SpillStore::CloseSegment(uint32_t id)
+{
+	auto it = m_segments.find(id);
+	close(it->second.fd);
+	unlink(it->second.path.c_str());
+
+	m_diskBytes -= it->second.size;
+	m_segments.erase(it);
+}
+
+SpillStore::Location SpillStore::Write(std::string_view data)
+{
+	if (data.size() > UINT32_MAX)
+	{
+		throw std::invalid_argument{ "Spilled record is too big" };
+	}
+
+	Location location;
+	int fd{ -1 };
+	std::string path;
+	{
+		// Space is reserved under the lock, so the writers don't wait for each other's io
+		std::lock_guard<std::mutex> l{ m_mutex };
+		Segment* segment{ &m_segments[m_writeSegment] };
+		if (segment->size && segment->size + data.size() > m_segmentBytes)
+		{
+			const uint32_t fullSegment{ m_writeSegment };
+			segment = &OpenSegment();
+			if (!m_segments[fullSegment].liveRecords)
+			{
+				CloseSegment(fullSegment);
+			}
+		}
+
+		location.segment = m_writeSegment;
+		location.size = static_cast<uint32_t>(data.size());
+		location.offset = segment->size;
+
+		segment->size += data.size();
+		++segment->liveRecords;
+		m_diskBytes += data.size();
+
+		fd = segment->fd;
+		path = segment->path;
+	}
+
+	for (size_t written{ 0 }; written < data.size();)
+	{
+		const ssize_t res{ pwrite(fd, data.data() + written, data.size() - written,
+			static_cast<off_t>(location.offset + written)) };
+		if (res < 0 && errno != EINTR)
+		{
+			const std::runtime_error error{ MakeIoError("Failed to write spill file", path) };
+			CancelWrite(location);
+			throw error;
+		}
+
+		written += res > 0 ? static_cast<size_t>(res) : 0;
+	}
+
+	return location;
+}
+
+// Takes back the reservation of a record which failed to be written, so the segment is still deleted once
+// its other records are read. Its bytes are given back if no record was reserved after it
+void SpillStore::CancelWrite(const Location& location)
+{
+	std::lock_guard<std::mutex> l{ m_mutex };
+	Segment& segment = m_segments[location.segment];
+	if (segment.size == location.offset + location.size)
+	{
+		segment.size = location.offset;
+		m_diskBytes -= location.size;
+	}
+
+	ReleaseRecord(location.segment);
+}
+
+// The segment being written stays until it is full
+void SpillStore::ReleaseRecord(uint32_t segment)
+{
+	if (!--m_segments[segment].liveRecords && segment != m_writeSegment)
+	{
+		CloseSegment(segment);
+	}
+}
+
+void SpillStore::Read(const Location& location, std::string& data)
+{
+	int fd{ -1 };
+	std::string path;
+	{
+		std::lock_guard<std::mutex> l{ m_mutex };
+		const auto it = m_segments.find(location.segment);
+		if (it == m_segments.end())
+		{
+			throw std::logic_error{ "Spilled record is already read" };
+		}
+
+		fd = it->second.fd;
+		path = it->second.path;
+	}
+
+	data.resize(location.size);
+	for (size_t read{ 0 }; read < data.size();)
+	{
+		const ssize_t res{ pread(fd, data.data() + read, data.size() - read, static_cast<off_t>(location.offset + read)) };
+		if (res == 0 || (res < 0 && errno != EINTR))
+		{
+			// The record is lost anyway, so it does not keep the segment on disk
+			const std::runtime_error error{ MakeIoError("Failed to read spill file", path) };
+			std::lock_guard<std::mutex> l{ m_mutex };
+			ReleaseRecord(location.segment);
+			throw error;
+		}
+
+		read += res > 0 ? static_cast<size_t>(res) : 0;
+	}
+
+	std::lock_guard<std::mutex> l{ m_mutex };
+	ReleaseRecord(location.segment);
+}
+
+uint64_t SpillStore::GetDiskBytes() const
+{
+	std::lock_guard<std::mutex> l{ m_mutex };
+	return m_diskBytes;
+}
+
+}// namespace common
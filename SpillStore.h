@@ -0,0 +1,69 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+
+namespace common
+{
+
+// Records which don't fit the memory budget, appended to sequential segment files in a directory.
+// Every record is read back once, a segment file is deleted as soon as all its records are read.
+// Thread-safe, the file io is done outside the lock
+class SpillStore
+{
+public:
+	static constexpr uint64_t DefaultSegmentBytes{ 64 * 1024 * 1024 };
+
+	struct Location
+	{
+		uint32_t segment{ 0 };
+		uint32_t size{ 0 };
+		uint64_t offset{ 0 };
+	};
+
+	// Files are named %name-%segment.spill, the directory is created if needed
+	SpillStore(std::string dir, std::string name, uint64_t segmentBytes = DefaultSegmentBytes);
+	~SpillStore();
+
+	SpillStore(const SpillStore&) = delete;
+	SpillStore& operator=(const SpillStore&) = delete;
+
+	// Throws std::runtime_error on io errors, a record which fails to be read is given up
+	Location Write(std::string_view data);
+	void Read(const Location& location, std::string& data);
+
+	// Size of the segment files not deleted yet
+	uint64_t GetDiskBytes() const;
+
+private:
+	struct Segment
+	{
+		int fd{ -1 };
+		uint64_t size{ 0 };
+		// Written or being written and not read yet
+		size_t liveRecords{ 0 };
+		std::string path;
+	};
+
+	Segment& OpenSegment();
+	void CloseSegment(uint32_t id);
+	void CancelWrite(const Location& location);
+	// Called under the lock
+	void ReleaseRecord(uint32_t segment);
+
+private:
+	std::string m_dir;
+	std::string m_name;
+	uint64_t m_segmentBytes;
+
+	mutable std::mutex m_mutex;
+	std::unordered_map<uint32_t, Segment> m_segments;
+	uint32_t m_writeSegment{ 0 };
+	uint32_t m_nextSegment{ 0 };
+	uint64_t m_diskBytes{ 0 };
+};
+
+}// namespace common
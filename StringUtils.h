@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <string_view>
+
+namespace common
+{
+
+// ASCII only helpers of the html, robots.txt and charset parsers. Patterns named lower* should be in lower case
+
+inline char ToLowerAscii(char c) noexcept
+{
+	return ('A' <= c && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+inline char ToUpperAscii(char c) noexcept
+{
+	return ('a' <= c && c <= 'z') ? static_cast<char>(c - 'a' + 'A') : c;
+}
+
+// Whitespace as html defines it
+inline bool IsSpace(char c) noexcept
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f';
+}
+
+inline bool HasPrefixIgnoreCase(std::string_view str, std::string_view lowerPrefix) noexcept
+{
+	if (str.size() < lowerPrefix.size())
+	{
+		return false;
+	}
+
+	for (size_t i{ 0 }; i < lowerPrefix.size(); ++i)
+	{
+		if (ToLowerAscii(str[i]) != lowerPrefix[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+inline bool EqualsIgnoreCase(std::string_view str, std::string_view lower) noexcept
+{
+	return str.size() == lower.size() && HasPrefixIgnoreCase(str, lower);
+}
+
+// Candidates are found by the first char of the pattern in both cases, so most of the text is skipped by find
+inline size_t FindIgnoreCase(std::string_view str, std::string_view lowerPattern, size_t pos) noexcept
+{
+	if (lowerPattern.empty())
+	{
+		return pos <= str.size() ? pos : std::string_view::npos;
+	}
+
+	for (; pos < str.size(); ++pos)
+	{
+		pos = std::min(str.find(lowerPattern[0], pos), str.find(ToUpperAscii(lowerPattern[0]), pos));
+		if (pos == std::string_view::npos || HasPrefixIgnoreCase(str.substr(pos), lowerPattern))
+		{
+			return pos;
+		}
+	}
+
+	return std::string_view::npos;
+}
+
+}// namespace common
@@ -0,0 +1,319 @@
+#include "TextDecoding.h"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "StringUtils.h"
+
+namespace web_graph
+{
+
+// Code points of the bytes 0x80-0x9f, the rest of windows-1252 is the same as in Unicode
+static constexpr uint16_t Windows1252Controls[32]
+{
+	0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+	0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178
+};
+
+static constexpr std::string_view Utf8Labels[]{ "utf-8", "utf8", "unicode-1-1-utf-8" };
+static constexpr std::string_view Windows1252Labels[]
+{
+	"windows-1252", "iso-8859-1", "iso8859-1", "iso_8859-1", "latin1", "l1", "cp1252", "x-cp1252",
+	"cp819", "ibm819", "us-ascii", "ascii", "ansi_x3.4-1968"
+};
+
+// Skips the ASCII prefix of the range 16 or 8 bytes at a time
+static const uint8_t* SkipAscii(const uint8_t* pos, const uint8_t* end) noexcept
+{
+#ifdef __SSE2__
+	for (; end - pos >= 16; pos += 16)
+	{
+		const int mask{ _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(pos))) };
+		if (mask)
+		{
+			return pos + __builtin_ctz(mask);
+		}
+	}
+#endif
+
+	for (; end - pos >= 8; pos += 8)
+	{
+		uint64_t word;
+		std::memcpy(&word, pos, sizeof(word));
+		if (word & 0x8080808080808080ull)
+		{
+			break;
+		}
+	}
+
+	while (pos != end && *pos < 0x80)
+	{
+		++pos;
+	}
+
+	return pos;
+}
+
+// Charset of the label which follows "charset" in the text, false if there is none
+static bool ParseCharsetLabel(std::string_view text, size_t pos, Charset& charset) noexcept
+{
+	pos += 7;
+	while (pos < text.size() && common::IsSpace(text[pos]))
+	{
+		++pos;
+	}
+
+	if (pos == text.size() || text[pos] != '=')
+	{
+		return false;
+	}
+
+	pos = text.find_first_not_of(" \t\r\n\f\"'", pos + 1);
+	if (pos == std::string_view::npos)
+	{
+		return false;
+	}
+
+	const size_t end{ std::min(text.find_first_of(" \t\r\n\f\"';>/", pos), text.size()) };
+	const std::string_view label{ text.substr(pos, end - pos) };
+	if (label.empty())
+	{
+		return false;
+	}
+
+	charset = Charset::Other;
+	for (std::string_view utf8Label : Utf8Labels)
+	{
+		if (common::EqualsIgnoreCase(label, utf8Label))
+		{
+			charset = Charset::Utf8;
+		}
+	}
+
+	for (std::string_view windowsLabel : Windows1252Labels)
+	{
+		if (common::EqualsIgnoreCase(label, windowsLabel))
+		{
+			charset = Charset::Windows1252;
+		}
+	}
+
+	return true;
+}
+
+// <meta charset="..."> or <meta http-equiv="Content-Type" content="text/html; charset=...">
+static bool FindMetaCharset(std::string_view head, Charset& charset) noexcept
+{
+	for (size_t pos{ common::FindIgnoreCase(head, "<meta", 0) }; pos != std::string_view::npos; pos = common::FindIgnoreCase(head, "<meta", pos + 1))
+	{
+		const std::string_view tag{ head.substr(pos, head.find('>', pos) - pos) };
+		for (size_t charsetPos{ common::FindIgnoreCase(tag, "charset", 0) }; charsetPos != std::string_view::npos;
+			charsetPos = common::FindIgnoreCase(tag, "charset", charsetPos + 1))
+		{
+			if (ParseCharsetLabel(tag, charsetPos, charset))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static void AppendUtf8(std::string& out, uint32_t codePoint)
+{
+	if (codePoint < 0x80)
+	{
+		out += static_cast<char>(codePoint);
+	}
+	else if (codePoint < 0x800)
+	{
+		out += static_cast<char>(0xc0 | (codePoint >> 6));
+		out += static_cast<char>(0x80 | (codePoint & 0x3f));
+	}
+	else if (codePoint < 0x10000)
+	{
+		out += static_cast<char>(0xe0 | (codePoint >> 12));
+		out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+		out += static_cast<char>(0x80 | (codePoint & 0x3f));
+	}
+	else
+	{
+		out += static_cast<char>(0xf0 | (codePoint >> 18));
+		out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3f));
+		out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3f));
+		out += static_cast<char>(0x80 | (codePoint & 0x3f));
+	}
+}
+
+// Decodes the reference at the '&', returns its length or 0 if it is not a known one
+static size_t DecodeReference(std::string_view text, uint32_t& codePoint) noexcept
+{
+	const size_t end{ text.find(';', 1) };
+	if (end == std::string_view::npos || end > 10)
+	{
+		return 0;
+	}
+
+	const std::string_view name{ text.substr(1, end - 1) };
+	if (name.size() > 1 && name[0] == '#')
+	{
+		const bool hex{ name[1] == 'x' || name[1] == 'X' };
+		const std::string_view digits{ name.substr(hex ? 2 : 1) };
+		if (digits.empty())
+		{
+			return 0;
+		}
+
+		codePoint = 0;
+		for (char c : digits)
+		{
+			const char lower{ common::ToLowerAscii(c) };
+			uint32_t digit;
+			if ('0' <= c && c <= '9') digit = static_cast<uint32_t>(c - '0');
+			else if (hex && 'a' <= lower && lower <= 'f') digit = static_cast<uint32_t>(lower - 'a' + 10);
+			else return 0;
+
+			codePoint = std::min<uint32_t>(codePoint * (hex ? 16 : 10) + digit, 0x110000);
+		}
+
+		// Like browsers do: the C1 controls are read as windows-1252, invalid code points are replaced
+		if (0x80 <= codePoint && codePoint < 0xa0)
+		{
+			codePoint = Windows1252Controls[codePoint - 0x80];
+		}
+		else if (!codePoint || codePoint >= 0x110000 || (0xd800 <= codePoint && codePoint < 0xe000))
+		{
+			codePoint = 0xfffd;
+		}
+
+		return end + 1;
+	}
+
+	static constexpr std::pair<std::string_view, uint32_t> NamedReferences[]
+	{
+		{ "amp", '&' }, { "lt", '<' }, { "gt", '>' }, { "quot", '"' }, { "apos", '\'' }, { "nbsp", 0xa0 }
+	};
+
+	for (const auto& reference : NamedReferences)
+	{
+		if (name == reference.first)
+		{
+			codePoint = reference.second;
+			return end + 1;
+		}
+	}
+
+	return 0;
+}
+
+Charset DetectCharset(std::string_view contentType, std::string_view html) noexcept
+{
+	if (html.compare(0, 3, "\xef\xbb\xbf") == 0)
+	{
+		return Charset::Utf8;
+	}
+
+	if (html.compare(0, 2, "\xfe\xff") == 0 || html.compare(0, 2, "\xff\xfe") == 0)
+	{
+		return Charset::Other;
+	}
+
+	Charset charset;
+	const size_t charsetPos{ common::FindIgnoreCase(contentType, "charset", 0) };
+	if (charsetPos != std::string_view::npos && ParseCharsetLabel(contentType, charsetPos, charset))
+	{
+		return charset;
+	}
+
+	if (FindMetaCharset(html.substr(0, 1024), charset))
+	{
+		return charset;
+	}
+
+	return IsValidUtf8(html) ? Charset::Utf8 : Charset::Windows1252;
+}
+
+bool IsValidUtf8(std::string_view text) noexcept
+{
+	const uint8_t* pos{ reinterpret_cast<const uint8_t*>(text.data()) };
+	const uint8_t* const end{ pos + text.size() };
+
+	while ((pos = SkipAscii(pos, end)) != end)
+	{
+		// Shortest forms only, no surrogates and nothing above U+10FFFF
+		const uint8_t lead{ *pos };
+		size_t length;
+		uint8_t secondMin{ 0x80 };
+		uint8_t secondMax{ 0xbf };
+
+		if (0xc2 <= lead && lead <= 0xdf) length = 2;
+		else if (lead == 0xe0) { length = 3; secondMin = 0xa0; }
+		else if (0xe1 <= lead && lead <= 0xef) { length = 3; secondMax = lead == 0xed ? 0x9f : 0xbf; }
+		else if (lead == 0xf0) { length = 4; secondMin = 0x90; }
+		else if (0xf1 <= lead && lead <= 0xf4) { length = 4; secondMax = lead == 0xf4 ? 0x8f : 0xbf; }
+		else return false;
+
+		if (static_cast<size_t>(end - pos) < length || pos[1] < secondMin || pos[1] > secondMax)
+		{
+			return false;
+		}
+
+		for (size_t i{ 2 }; i < length; ++i)
+		{
+			if ((pos[i] & 0xc0) != 0x80)
+			{
+				return false;
+			}
+		}
+
+		pos += length;
+	}
+
+	return true;
+}
+
+std::string_view DecodeAttributeValue(std::string_view value, Charset charset, std::string& buffer)
+{
+	const bool transcode{ charset == Charset::Windows1252 };
+	const uint8_t* const begin{ reinterpret_cast<const uint8_t*>(value.data()) };
+	const uint8_t* const end{ begin + value.size() };
+
+	if (value.find('&') == std::string_view::npos && (!transcode || SkipAscii(begin, end) == end))
+	{
+		return value;
+	}
+
+	buffer.clear();
+	buffer.reserve(value.size() + 8);
+	for (size_t i{ 0 }; i < value.size(); ++i)
+	{
+		const uint8_t c{ begin[i] };
+		uint32_t codePoint;
+		size_t length;
+
+		if (c == '&' && (length = DecodeReference(value.substr(i), codePoint)) != 0)
+		{
+			AppendUtf8(buffer, codePoint);
+			i += length - 1;
+		}
+		else if (transcode && c >= 0x80)
+		{
+			AppendUtf8(buffer, c < 0xa0 ? Windows1252Controls[c - 0x80] : c);
+		}
+		else
+		{
+			buffer += static_cast<char>(c);
+		}
+	}
+
+	return buffer;
+}
+
+}// namespace web_graph
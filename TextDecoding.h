@@ -0,0 +1,28 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace web_graph
+{
+
+// Charsets the links are converted from, the rest are taken as is
+enum class Charset
+{
+	Utf8,
+	// Also iso-8859-1 and us-ascii, which browsers treat as windows-1252
+	Windows1252,
+	Other
+};
+
+// Charset of the page by the byte order mark, the Content-Type header and <meta> in the first 1024 bytes.
+// Undeclared pages are UTF-8 if they are valid UTF-8 and windows-1252 otherwise
+Charset DetectCharset(std::string_view contentType, std::string_view html) noexcept;
+
+bool IsValidUtf8(std::string_view text) noexcept;
+
+// Attribute value of a page as UTF-8 with the character references like &amp; and &#47; decoded,
+// unknown references are kept. Returns the value itself if there is nothing to decode, the buffer otherwise
+std::string_view DecodeAttributeValue(std::string_view value, Charset charset, std::string& buffer);
+
+}// namespace web_graph
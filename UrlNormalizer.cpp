@@ -0,0 +1,488 @@
+#include "UrlNormalizer.h"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace web_graph
+{
+
+static constexpr std::string_view SchemeSeparator{ "://" };
+static constexpr std::string_view WebPrefix{ "www." };
+
+constexpr char ToLower(const char c) noexcept
+{
+	return ('A' <= c && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+constexpr bool IsAlpha(const char c) noexcept
+{
+	return ('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z');
+}
+
+constexpr bool IsAlNum(const char c) noexcept
+{
+	return IsAlpha(c) || ('0' <= c && c <= '9');
+}
+
+constexpr bool IsSpace(const char c) noexcept
+{
+	return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+constexpr std::array<int8_t, 256> MakeHexTable() noexcept
+{
+	std::array<int8_t, 256> table{};
+	for (auto& value : table)
+	{
+		value = -1;
+	}
+
+	for (int c{ '0' }; c <= '9'; ++c)
+	{
+		table[c] = static_cast<int8_t>(c - '0');
+	}
+
+	for (int c{ 'a' }; c <= 'f'; ++c)
+	{
+		table[c] = static_cast<int8_t>(c - 'a' + 10);
+		table[c - 'a' + 'A'] = static_cast<int8_t>(c - 'a' + 10);
+	}
+
+	return table;
+}
+
+static constexpr std::array<int8_t, 256> HexTable{ MakeHexTable() };
+
+bool StartsWith(std::string_view str, std::string_view prefix) noexcept
+{
+	return str.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool EqualsNoCase(std::string_view str, std::string_view lowercase) noexcept
+{
+	if (str.size() != lowercase.size())
+	{
+		return false;
+	}
+
+	for (size_t i{ 0 }; i < str.size(); ++i)
+	{
+		if (ToLower(str[i]) != lowercase[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string_view Trim(std::string_view str) noexcept
+{
+	while (!str.empty() && IsSpace(str.front()))
+	{
+		str.remove_prefix(1);
+	}
+
+	while (!str.empty() && IsSpace(str.back()))
+	{
+		str.remove_suffix(1);
+	}
+
+	return str;
+}
+
+// Length of the "scheme:" part without ':' or 0 if the link has no scheme
+size_t GetSchemeLength(std::string_view link) noexcept
+{
+	if (link.empty() || !IsAlpha(link.front()))
+	{
+		return 0;
+	}
+
+	for (size_t i{ 1 }; i < link.size(); ++i)
+	{
+		const char c{ link[i] };
+		if (c == ':')
+		{
+			return i;
+		}
+
+		if (!IsAlNum(c) && c != '+' && c != '-' && c != '.')
+		{
+			return 0;
+		}
+	}
+
+	return 0;
+}
+
+// Packs an extension of up to 8 symbols into an integer so it can be compared at once
+constexpr uint64_t PackExtension(std::string_view extension) noexcept
+{
+	uint64_t packed{ 0 };
+	for (char c : extension)
+	{
+		packed = (packed << 8) | static_cast<uint8_t>(c);
+	}
+
+	return packed;
+}
+
+template<size_t N>
+constexpr std::array<uint64_t, N> MakeSortedExtensions(const std::string_view (&extensions)[N]) noexcept
+{
+	std::array<uint64_t, N> packed{};
+	for (size_t i{ 0 }; i < N; ++i)
+	{
+		packed[i] = PackExtension(extensions[i]);
+		for (size_t j{ i }; j > 0 && packed[j - 1] > packed[j]; --j)
+		{
+			const uint64_t tmp{ packed[j - 1] };
+			packed[j - 1] = packed[j];
+			packed[j] = tmp;
+		}
+	}
+
+	return packed;
+}
+
+static constexpr std::string_view FileExtensions[]
+{
+	".jpg", ".jpeg", ".js", ".ico", ".css", ".png", ".pdf", ".rar", ".zip", ".doc",
+	".docx", ".xls", ".xlsx", ".mp3", ".djvu", ".rtf", ".ppt", ".txt", ".pptx", ".gz",
+	".gif", ".xml", ".tif", ".tiff", ".flv", ".avi", ".mkv", ".flac", ".ogg", ".mp4",
+	".exe", ".msi", ".deb", ".001", ".002", ".svg", ".odt", ".7z", ".ppsx"
+};
+
+static constexpr auto PackedFileExtensions = MakeSortedExtensions(FileExtensions);
+
+bool IsFileExtension(std::string_view extension) noexcept
+{
+	return extension.size() <= sizeof(uint64_t) &&
+		std::binary_search(
+			PackedFileExtensions.begin(),
+			PackedFileExtensions.end(),
+			PackExtension(extension));
+}
+
+// Whether the last segment of the path [pathBegin, pathEnd) has a file extension
+bool IsFile(std::string_view url, size_t pathBegin, size_t pathEnd)
+{
+	std::string_view path{ url.substr(pathBegin, pathEnd - pathBegin) };
+	std::string_view segment{ path.substr(path.rfind('/') + 1) };
+
+	auto dotPos = segment.rfind('.');
+	return dotPos != std::string_view::npos && IsFileExtension(segment.substr(dotPos));
+}
+
+enum CharClass : uint8_t
+{
+	Plain = 0,
+	Stop,		// cuts the rest of the url
+	Skip,		// dropped from the url
+	Escape		// %XX
+};
+
+constexpr std::array<uint8_t, 256> MakeCharClassTable() noexcept
+{
+	std::array<uint8_t, 256> table{};
+	table['#'] = table[';'] = table['&'] = Stop;
+	table['"'] = table['\''] = table['\t'] = table['\n'] = table['\r'] = Skip;
+	table['%'] = Escape;
+	return table;
+}
+
+constexpr std::array<char, 256> MakeLowerTable() noexcept
+{
+	std::array<char, 256> table{};
+	for (int c{ 0 }; c < 256; ++c)
+	{
+		table[c] = ToLower(static_cast<char>(c));
+	}
+
+	return table;
+}
+
+static constexpr std::array<uint8_t, 256> CharClasses{ MakeCharClassTable() };
+static constexpr std::array<char, 256> LowerTable{ MakeLowerTable() };
+
+#ifdef __SSE2__
+// Lowercases the plain characters 16 at a time up to the first one of another class.
+// The whole block is stored, the bytes after the plain ones are overwritten later
+void AppendPlainRun(const uint8_t*& src, const uint8_t* end, char*& dst) noexcept
+{
+	for (; end - src >= 16; src += 16, dst += 16)
+	{
+		const __m128i chunk{ _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)) };
+		__m128i special{ _mm_cmpeq_epi8(chunk, _mm_set1_epi8('%')) };
+		for (char c : { '#', ';', '&', '"', '\'', '\t', '\n', '\r' })
+		{
+			special = _mm_or_si128(special, _mm_cmpeq_epi8(chunk, _mm_set1_epi8(c)));
+		}
+
+		const __m128i upper{ _mm_and_si128(
+			_mm_cmpgt_epi8(chunk, _mm_set1_epi8('A' - 1)),
+			_mm_cmplt_epi8(chunk, _mm_set1_epi8('Z' + 1))) };
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_add_epi8(chunk, _mm_and_si128(upper, _mm_set1_epi8(0x20))));
+
+		const int mask{ _mm_movemask_epi8(special) };
+		if (mask)
+		{
+			const int plainNum{ __builtin_ctz(mask) };
+			src += plainNum;
+			dst += plainNum;
+			return;
+		}
+	}
+}
+#endif
+
+// Appends the link to out lowercasing it, skipping quotes and decoding the %XX escapes IsDecodedEscape allows,
+// the others are kept with lowercase hex digits. Stops at the first '#', ';' or '&'
+void AppendNormalized(std::string_view link, std::string& out)
+{
+	const size_t oldSize{ out.size() };
+	out.resize(oldSize + link.size());
+
+	char* dst{ &out[oldSize] };
+	const uint8_t* src{ reinterpret_cast<const uint8_t*>(link.data()) };
+	const uint8_t* end{ src + link.size() };
+
+	while (src != end)
+	{
+#ifdef __SSE2__
+		// The output never gets ahead of the input, so the block stores stay within the buffer
+		AppendPlainRun(src, end, dst);
+		if (src == end)
+		{
+			break;
+		}
+#endif
+
+		const uint8_t c{ *src++ };
+		const uint8_t charClass{ CharClasses[c] };
+
+		if (charClass == Plain)
+		{
+			*dst++ = LowerTable[c];
+		}
+		else if (charClass == Stop)
+		{
+			break;
+		}
+		else if (charClass == Escape)
+		{
+			const int8_t high{ end - src >= 2 ? HexTable[src[0]] : int8_t{ -1 } };
+			const int8_t low{ end - src >= 2 ? HexTable[src[1]] : int8_t{ -1 } };
+			if (high >= 0 && low >= 0)
+			{
+				const uint8_t decoded{ static_cast<uint8_t>((high << 4) | low) };
+				if (IsDecodedEscape(static_cast<char>(decoded)))
+				{
+					*dst++ = LowerTable[decoded];
+				}
+				else
+				{
+					*dst++ = '%';
+					*dst++ = LowerTable[src[0]];
+					*dst++ = LowerTable[src[1]];
+				}
+
+				src += 2;
+			}
+			else
+			{
+				*dst++ = '%';
+			}
+		}
+	}
+
+	out.resize(static_cast<size_t>(dst - out.data()));
+}
+
+// In place removal of "." and ".." segments from the path [pathBegin, pathEnd) (RFC 3986, section 5.2.4).
+// Returns the new end of the path
+size_t RemoveDotSegments(std::string& url, size_t pathBegin, size_t pathEnd) noexcept
+{
+	char* data{ &url[0] };
+	size_t read{ pathBegin };
+	size_t write{ pathBegin };
+
+	while (read < pathEnd)
+	{
+		// Every segment starts with '/' here
+		const char* segmentEnd{ static_cast<const char*>(
+			std::memchr(data + read + 1, '/', pathEnd - read - 1)) };
+		const size_t next{ segmentEnd ? static_cast<size_t>(segmentEnd - data) : pathEnd };
+		const std::string_view segment{ data + read + 1, next - read - 1 };
+
+		if (segment == "." || segment == "..")
+		{
+			if (segment.size() == 2)
+			{
+				while (write > pathBegin && data[--write] != '/') {}
+			}
+
+			if (next == pathEnd)
+			{
+				data[write++] = '/';
+			}
+		}
+		else
+		{
+			std::memmove(data + write, data + read, next - read);
+			write += next - read;
+		}
+
+		read = next;
+	}
+
+	if (write == pathBegin)
+	{
+		data[write++] = '/';
+	}
+
+	if (write != pathEnd)
+	{
+		url.erase(write, pathEnd - write);
+	}
+
+	return write;
+}
+
+// Interface
+
+bool IsDecodedEscape(char c) noexcept
+{
+	return IsAlNum(c) || c == '-' || c == '_' || c == '~' || static_cast<uint8_t>(c) >= 0x80;
+}
+
+bool ParseBaseUrl(std::string_view url, BaseUrl& base) noexcept
+{
+	auto schemeEnd = url.find(SchemeSeparator);
+	if (schemeEnd == std::string_view::npos || !schemeEnd)
+	{
+		return false;
+	}
+
+	base.scheme = url.substr(0, schemeEnd);
+
+	const size_t hostBegin{ schemeEnd + SchemeSeparator.size() };
+	const size_t hostEnd{ std::min(url.find_first_of("/?", hostBegin), url.size()) };
+	base.host = url.substr(hostBegin, hostEnd - hostBegin);
+
+	const size_t pathEnd{ std::min(url.find('?', hostEnd), url.size()) };
+	std::string_view path{ url.substr(hostEnd, pathEnd - hostEnd) };
+	if (path.empty())
+	{
+		path = "/";
+	}
+
+	base.document = path;
+	base.directory = path.substr(0, path.rfind('/') + 1);
+
+	return !base.host.empty();
+}
+
+std::string_view GetUrlHost(std::string_view url) noexcept
+{
+	auto schemeEnd = url.find(SchemeSeparator);
+	if (schemeEnd == std::string_view::npos)
+	{
+		return {};
+	}
+
+	url.remove_prefix(schemeEnd + SchemeSeparator.size());
+	return url.substr(0, url.find_first_of("/?"));
+}
+
+std::string_view GetUrlPath(std::string_view url) noexcept
+{
+	auto schemeEnd = url.find(SchemeSeparator);
+	if (schemeEnd != std::string_view::npos)
+	{
+		url.remove_prefix(schemeEnd + SchemeSeparator.size());
+		url.remove_prefix(std::min(url.find_first_of("/?"), url.size()));
+	}
+
+	return !url.empty() && url.front() == '/' ? url : std::string_view{ "/" };
+}
+
+bool InDomain(std::string_view url, std::string_view rootHost) noexcept
+{
+	std::string_view host{ GetUrlHost(url) };
+	if (StartsWith(host, WebPrefix))
+	{
+		host.remove_prefix(WebPrefix.size());
+	}
+
+	return host.size() >= rootHost.size() &&
+		host.compare(host.size() - rootHost.size(), rootHost.size(), rootHost) == 0 &&
+		(host.size() == rootHost.size() || host[host.size() - rootHost.size() - 1] == '.');
+}
+
+bool NormalizeUrl(std::string_view link, const BaseUrl& base, std::string& out)
+{
+	out.clear();
+
+	link = Trim(link);
+	if (link.empty() ||
+		link == "/" ||
+		(!IsAlNum(link.front()) && link.front() != '/' && link.front() != '.' && link.front() != '?'))
+	{
+		return false;
+	}
+
+	const size_t schemeLength{ GetSchemeLength(link) };
+	if (schemeLength)
+	{
+		std::string_view scheme{ link.substr(0, schemeLength) };
+		if ((!EqualsNoCase(scheme, "http") && !EqualsNoCase(scheme, "https")) ||
+			link.compare(schemeLength, SchemeSeparator.size(), SchemeSeparator) != 0)
+		{
+			return false;
+		}
+	}
+	else if (StartsWith(link, "//"))
+	{
+		// Scheme-relative
+		out.append(base.scheme).append(":");
+	}
+	else
+	{
+		out.append(base.scheme).append(SchemeSeparator).append(base.host);
+		if (link.front() == '?')
+		{
+			out.append(base.document);
+		}
+		else if (link.front() != '/')
+		{
+			out.append(base.directory);
+		}
+	}
+
+	out.reserve(out.size() + link.size());
+	AppendNormalized(link, out);
+
+	const size_t hostBegin{ out.find(SchemeSeparator) + SchemeSeparator.size() };
+	const size_t hostEnd{ std::min(out.find_first_of("/?", hostBegin), out.size()) };
+	if (hostEnd == hostBegin)
+	{
+		return false;
+	}
+
+	size_t pathEnd{ std::min(out.find('?', hostEnd), out.size()) };
+	if (pathEnd != hostEnd)
+	{
+		pathEnd = RemoveDotSegments(out, hostEnd, pathEnd);
+	}
+
+	return !IsFile(out, hostEnd, pathEnd);
+}
+
+}// namespace web_graph
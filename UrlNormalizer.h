@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+namespace web_graph
+{
+
+// Components of a normalized page url the links found on it are resolved against
+struct BaseUrl
+{
+	std::string_view scheme;	// "http" or "https"
+	std::string_view host;		// host[:port]
+	std::string_view document;	// path without query, "/" if empty
+	std::string_view directory;	// path up to and including the last '/'
+};
+
+// Splits a normalized absolute http(s) url into components, false if the url is not absolute
+bool ParseBaseUrl(std::string_view url, BaseUrl& base) noexcept;
+
+// Host[:port] part of an absolute url, empty if the url has no authority
+std::string_view GetUrlHost(std::string_view url) noexcept;
+
+// Path of an absolute url including the query, "/" if empty
+std::string_view GetUrlPath(std::string_view url) noexcept;
+
+// Whether the host of the url is the root host or its subdomain, "www." is ignored
+bool InDomain(std::string_view url, std::string_view rootHost) noexcept;
+
+// Whether NormalizeUrl decodes the %XX escape of the char: the unreserved chars of RFC 3986, section 2.3,
+// but '.', which would make dot segments, and the bytes of non-ASCII chars. Reserved chars, '%' and the
+// rest stay escaped, as they mean other urls
+bool IsDecodedEscape(char c) noexcept;
+
+// Single pass link normalization:
+// - resolves absolute, scheme-relative ("//host"), absolute-path and relative links against
+//   the base url and removes "." and ".." segments (RFC 3986, section 5.2)
+// - lowercases the url, drops quotes and cuts it at the first '#', ';' or '&'
+// - decodes the %XX escapes IsDecodedEscape allows before the path is split from the query
+//   and its dot segments are removed, so the escapes of the delimiters never change the structure
+// The result is written to out, whose capacity is reused between calls.
+// Returns false if the link should be skipped (non-http schemes, links to files etc.)
+bool NormalizeUrl(std::string_view link, const BaseUrl& base, std::string& out);
+
+}// namespace web_graph
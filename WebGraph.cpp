@@ -1,21 +1,105 @@
 #include "WebGraph.h"
 
+#include <atomic>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "Parallel.h"
+
 namespace web_graph
 {
 
 struct WebPageNode
 {
-	WebPageNode(const Url& url) : url(url){}
+	WebPageNode(Url url, NodeId id) : url(std::move(url)), id(id){}
 
 	Url url;
+	NodeId id;
 	NodeLinks inbound_links;
 	NodeLinks outbound_links;
-	std::unordered_set<TagId> tags;
 };
 
-WebPageNodePtr CreateNode(const Url& url)
+WebPageNodePtr CreateNode(Url url, NodeId id)
 {
-	return { new WebPageNode{ url }, [](WebPageNode* node) { delete node; } };
+	return { new WebPageNode{ std::move(url), id }, [](WebPageNode* node) { delete node; } };
+}
+
+// Other ends of the links grouped by the first end like in CSR: the links of the node are
+// ends[offsets[node]]..ends[offsets[node + 1]]. The links are scattered in parallel over atomic positions
+std::vector<NodeId> GroupLinks(const std::vector<IndexedLink>& links, size_t nodesNum, size_t threadsNum,
+	bool bySource, std::vector<size_t>& offsets)
+{
+	auto getFirst = [bySource](const IndexedLink& link) noexcept { return bySource ? link.source : link.target; };
+	auto getSecond = [bySource](const IndexedLink& link) noexcept { return bySource ? link.target : link.source; };
+
+	// Degrees of the nodes, then the positions the next links of the nodes go to
+	std::unique_ptr<std::atomic<size_t>[]> positions{ new std::atomic<size_t>[nodesNum]() };
+	common::ParallelFor(threadsNum, links.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i{ begin }; i < end; ++i)
+		{
+			if (links[i].source >= nodesNum || links[i].target >= nodesNum)
+			{
+				throw std::invalid_argument{ "Link refers to no node" };
+			}
+
+			positions[getFirst(links[i])].fetch_add(1, std::memory_order_relaxed);
+		}
+	});
+
+	offsets.resize(nodesNum + 1);
+	offsets[0] = 0;
+	for (size_t node{ 0 }; node < nodesNum; ++node)
+	{
+		offsets[node + 1] = offsets[node] + positions[node].load(std::memory_order_relaxed);
+		positions[node].store(offsets[node], std::memory_order_relaxed);
+	}
+
+	std::vector<NodeId> ends(links.size());
+	common::ParallelFor(threadsNum, links.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i{ begin }; i < end; ++i)
+		{
+			ends[positions[getFirst(links[i])].fetch_add(1, std::memory_order_relaxed)] = getSecond(links[i]);
+		}
+	});
+
+	return ends;
+}
+
+// Repeated ends are counted as the multiplicity of the link
+void FillLinks(std::vector<NodeId>& ends, const std::vector<size_t>& offsets,
+	const std::vector<WebPageNode*>& nodes, bool outbound, size_t threadsNum)
+{
+	common::ParallelFor(threadsNum, nodes.size(), [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t node{ begin }; node < end; ++node)
+		{
+			const auto nodeEnds = ends.begin() + offsets[node];
+			const auto nodeEndsEnd = ends.begin() + offsets[node + 1];
+			if (nodeEnds == nodeEndsEnd)
+			{
+				continue;
+			}
+
+			std::sort(nodeEnds, nodeEndsEnd);
+			size_t distinctNum{ 1 };
+			for (auto it = nodeEnds + 1; it != nodeEndsEnd; ++it)
+			{
+				distinctNum += *it != *(it - 1);
+			}
+
+			NodeLinks& links = outbound ? nodes[node]->outbound_links : nodes[node]->inbound_links;
+			links.reserve(distinctNum);
+			for (auto it = nodeEnds; it != nodeEndsEnd;)
+			{
+				const auto linkEnd = std::upper_bound(it, nodeEndsEnd, *it);
+				links[nodes[*it]] = static_cast<NodeLinkNum>(linkEnd - it);
+				it = linkEnd;
+			}
+		}
+	});
 }
 
 WebGraph::WebGraph(const Url& rootUrl)
@@ -35,26 +119,76 @@ WebGraph CreateWebGraph(const Url& rootUrl)
 	return WebGraph{ rootUrl };
 }
 
-Url MakeKey(const Url& url)
+std::string_view MakeKey(std::string_view url) noexcept
+{
+	static constexpr std::string_view webPrefix{ "www." };
+	if (url.compare(0, webPrefix.length(), webPrefix) == 0)
+	{
+		url.remove_prefix(webPrefix.length());
+	}
+
+	if (!url.empty() && url.back() == '/')
+	{
+		url.remove_suffix(1);
+	}
+
+	return url;
+}
+
+WebGraph BuildWebGraph(std::vector<Url> urls, std::vector<IndexedLink> links, size_t threadsNum)
 {
-	Url key{ url };
-	static const std::string webPrefix{ "www." };
-	if (key.find(webPrefix) == 0)
+	const size_t nodesNum{ urls.size() };
+	if (nodesNum >= std::numeric_limits<NodeId>::max())
 	{
-		key.erase(0, webPrefix.length());
+		throw std::length_error{ "Too many nodes" };
 	}
 
-	if (key.back() == '/')
+	threadsNum = std::max<size_t>(threadsNum, 1);
+
+	std::vector<WebPageNodePtr> newNodes;
+	newNodes.reserve(nodesNum);
+	for (size_t i{ 0 }; i < nodesNum; ++i)
 	{
-		key.pop_back();
+		newNodes.emplace_back(nullptr, nullptr);
 	}
 
-	return key;
+	common::ParallelFor(threadsNum, nodesNum, [&](size_t begin, size_t end, size_t)
+	{
+		for (size_t i{ begin }; i < end; ++i)
+		{
+			newNodes[i] = CreateNode(std::move(urls[i]), static_cast<NodeId>(i));
+		}
+	});
+
+	WebGraph graph;
+	graph.m_nodes.reserve(nodesNum);
+	std::vector<WebPageNode*> nodes(nodesNum);
+	for (size_t i{ 0 }; i < nodesNum; ++i)
+	{
+		nodes[i] = newNodes[i].get();
+		if (!graph.m_nodes.try_emplace(MakeKey(nodes[i]->url), std::move(newNodes[i])).second)
+		{
+			throw std::invalid_argument{ "Urls with the same key: " + nodes[i]->url };
+		}
+	}
+
+	graph.m_root = nodesNum ? nodes[0] : nullptr;
+	graph.m_nextNodeId = static_cast<NodeId>(nodesNum);
+	graph.m_linksNum = links.size();
+
+	std::vector<size_t> offsets;
+	std::vector<NodeId> ends{ GroupLinks(links, nodesNum, threadsNum, true, offsets) };
+	FillLinks(ends, offsets, nodes, true, threadsNum);
+	ends = GroupLinks(links, nodesNum, threadsNum, false, offsets);
+	links = {};
+	FillLinks(ends, offsets, nodes, false, threadsNum);
+
+	return graph;
 }
 
 WebPageNode& AddNode(WebGraph& graph, const Url& url) noexcept
 {
-	auto newNode = CreateNode(url);
+	auto newNode = CreateNode(url, graph.m_nextNodeId++);
 	WebPageNode* node{ newNode.get() };
 
 	if (graph.m_nodes.empty())
@@ -62,7 +196,7 @@ WebPageNode& AddNode(WebGraph& graph, const Url& url) noexcept
 		graph.m_root = node;
 	}
 
-	graph.m_nodes.emplace(MakeKey(url), std::move(newNode));
+	graph.m_nodes.emplace(MakeKey(node->url), std::move(newNode));
 
 	return *node;
 }
@@ -82,7 +216,7 @@ size_t GetLinksNum(const WebGraph& graph) noexcept
 	return graph.m_linksNum;
 }
 
-WebPageNode* GetNode(const WebGraph& graph, const Url& url) noexcept
+WebPageNode* GetNode(const WebGraph& graph, std::string_view url) noexcept
 {
 	if (graph.m_root && graph.m_root->url == url)
 	{
@@ -124,19 +258,59 @@ void DeleteLink(WebPageNode& node, const WebPageNode& nodeToDelete)
 
 void DeleteNode(WebGraph& graph, const WebPageNode& nodeToDelete)
 {
-	for (auto& node : graph.m_nodes)
+	// A self link is both inbound and outbound, so it is counted once
+	auto selfLink = nodeToDelete.outbound_links.find(&nodeToDelete);
+	size_t linksNum{ 0 };
+	for (const NodeLinks* links : { &nodeToDelete.inbound_links, &nodeToDelete.outbound_links })
 	{
-		DeleteLink(*node.second, nodeToDelete);
+		for (const auto& linkInfo : *links)
+		{
+			linksNum += linkInfo.second;
+		}
 	}
 
+	linksNum -= selfLink != nodeToDelete.outbound_links.end() ? selfLink->second : 0;
+	if (linksNum > graph.m_linksNum)
+	{
+		throw std::logic_error{ "Node has more links than the graph" };
+	}
+
+	graph.m_linksNum -= linksNum;
+
+	// Only the neighbours refer to the node
+	for (const NodeLinks* links : { &nodeToDelete.inbound_links, &nodeToDelete.outbound_links })
+	{
+		for (const auto& linkInfo : *links)
+		{
+			DeleteLink(*const_cast<WebPageNode*>(linkInfo.first), nodeToDelete);
+		}
+	}
+
+	// The new root is any page the old one links to but itself
 	if (&nodeToDelete == graph.m_root)
 	{
-		const NodeLinks& outboundLinks = graph.m_root->outbound_links;
-		graph.m_root = !outboundLinks.empty() ?
-			const_cast<WebPageNode*>(outboundLinks.begin()->first) : nullptr;
+		graph.m_root = nullptr;
+		for (const auto& linkInfo : nodeToDelete.outbound_links)
+		{
+			if (linkInfo.first != &nodeToDelete)
+			{
+				graph.m_root = const_cast<WebPageNode*>(linkInfo.first);
+				break;
+			}
+		}
 	}
 
-	graph.m_nodes.erase(MakeKey(nodeToDelete.url));
+	for (NodeMask& mask : graph.m_tags)
+	{
+		mask.Reset(nodeToDelete.id);
+	}
+
+	// The key views the url of the node, so erase by iterator
+	auto it = graph.m_nodes.find(MakeKey(nodeToDelete.url));
+	if (it != graph.m_nodes.end())
+	{
+		graph.m_nodes.erase(it);
+	}
 }
 
 const Url& GetNodeUrl(const WebPageNode& node) noexcept
@@ -159,19 +333,59 @@ const Nodes& GetNodes(const WebGraph& graph) noexcept
 	return graph.m_nodes;
 }
 
-void AddTag(WebPageNode& node, TagId tag)
+NodeId GetNodeId(const WebPageNode& node) noexcept
 {
-	node.tags.emplace(tag);
+	return node.id;
 }
 
-void DeleteTag(WebPageNode& node, TagId tag)
+NodeId GetNodeIdBound(const WebGraph& graph) noexcept
 {
-	node.tags.erase(tag);
+	return graph.m_nextNodeId;
 }
 
-bool HasTag(const WebPageNode& node, TagId tag)
+void AddTag(WebGraph& graph, const WebPageNode& node, TagId tag)
 {
-	return !!node.tags.count(tag);
+	if (tag >= graph.m_tags.size())
+	{
+		graph.m_tags.resize(tag + 1);
+	}
+
+	NodeMask& mask = graph.m_tags[tag];
+	if (mask.GetSize() < graph.m_nextNodeId)
+	{
+		mask.Resize(graph.m_nextNodeId);
+	}
+
+	mask.Set(node.id);
+}
+
+void DeleteTag(WebGraph& graph, const WebPageNode& node, TagId tag)
+{
+	if (tag < graph.m_tags.size())
+	{
+		graph.m_tags[tag].Reset(node.id);
+	}
+}
+
+bool HasTag(const WebGraph& graph, const WebPageNode& node, TagId tag) noexcept
+{
+	return tag < graph.m_tags.size() && graph.m_tags[tag].Test(node.id);
+}
+
+const NodeMask& GetTagMask(const WebGraph& graph, TagId tag) noexcept
+{
+	static const NodeMask emptyMask;
+	return tag < graph.m_tags.size() ? graph.m_tags[tag] : emptyMask;
+}
+
+void SetTagMask(WebGraph& graph, TagId tag, NodeMask mask)
+{
+	if (tag >= graph.m_tags.size())
+	{
+		graph.m_tags.resize(tag + 1);
+	}
+
+	graph.m_tags[tag] = std::move(mask);
 }
 
 }// namespace web_graph
\ No newline at end of file
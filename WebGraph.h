@@ -1,10 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <memory>
-#include <unordered_set>
+#include <vector>
+#include <cstdint>
 #include <unordered_map>
 
+#include "NodeMask.h"
+#include "SmallFlatMap.h"
+
 namespace web_graph
 {
 
@@ -12,24 +17,40 @@ struct WebPageNode;
 
 using Url = std::string;
 using WebPageNodePtr = std::unique_ptr<WebPageNode, void(*)(WebPageNode*)>;
-using NodeLinkNum = size_t;
-using NodeLinks = std::unordered_map<const WebPageNode*, NodeLinkNum>;
-using Nodes = std::unordered_map<Url, WebPageNodePtr>;
+using NodeLinkNum = uint32_t;
+// Most pages link to a few distinct pages and are linked from fewer, those links are kept inline in the node
+using NodeLinks = common::SmallFlatMap<const WebPageNode*, NodeLinkNum, 4>;
+// Keys are views into the urls owned by the nodes
+using Nodes = std::unordered_map<std::string_view, WebPageNodePtr>;
 using TagId = uint32_t;
 
+// Link of a graph built at once, the ends are indices of its urls
+struct IndexedLink
+{
+	NodeId source;
+	NodeId target;
+};
+
 struct WebGraph
 {
 	friend WebGraph CreateWebGraph() noexcept;
 	friend WebGraph CreateWebGraph(const Url&);
+	friend WebGraph BuildWebGraph(std::vector<Url>, std::vector<IndexedLink>, size_t);
 	friend WebPageNode& AddNode(WebGraph&, const Url&) noexcept;
 	friend WebPageNode* GetRoot(const WebGraph&) noexcept;
-	friend WebPageNode* GetNode(const WebGraph&, const Url&) noexcept;
+	friend WebPageNode* GetNode(const WebGraph&, std::string_view) noexcept;
 	friend size_t GetNodesNum(const WebGraph&) noexcept;
 	friend size_t GetLinksNum(const WebGraph&) noexcept;
 	friend WebPageNode& AddLink(WebGraph&, const Url&, WebPageNode&);
 	friend WebPageNode& AddLink(WebGraph&, WebPageNode& to, WebPageNode& from);
 	friend const Nodes& GetNodes(const WebGraph&) noexcept;
 	friend void DeleteNode(WebGraph&, const WebPageNode&);
+	friend NodeId GetNodeIdBound(const WebGraph&) noexcept;
+	friend void AddTag(WebGraph&, const WebPageNode&, TagId);
+	friend void DeleteTag(WebGraph&, const WebPageNode&, TagId);
+	friend bool HasTag(const WebGraph&, const WebPageNode&, TagId) noexcept;
+	friend const NodeMask& GetTagMask(const WebGraph&, TagId) noexcept;
+	friend void SetTagMask(WebGraph&, TagId, NodeMask);
 
 public:
 	WebGraph(WebGraph&&) = default;
@@ -43,24 +64,41 @@ private:
 	WebPageNode* m_root{ nullptr };
 	Nodes m_nodes;
 	size_t m_linksNum{ 0 };
+	NodeId m_nextNodeId{ 0 };
+	// One bitmap per tag indexed by node id
+	std::vector<NodeMask> m_tags;
 };
 
 WebGraph CreateWebGraph() noexcept;
 WebGraph CreateWebGraph(const Url& rootUrl);
+// Builds the graph of all the urls and the links between them at once on up to threadsNum threads,
+// which is much faster than adding them one by one. The first url is the root, the node ids are the url indices.
+// Throws if two urls have the same key or a link refers to no url
+WebGraph BuildWebGraph(std::vector<Url> urls, std::vector<IndexedLink> links, size_t threadsNum);
 WebPageNode& AddNode(WebGraph&, const Url&) noexcept;
 WebPageNode* GetRoot(const WebGraph&) noexcept;
 size_t GetNodesNum(const WebGraph&) noexcept;
 size_t GetLinksNum(const WebGraph&) noexcept;
-WebPageNode* GetNode(const WebGraph&, const Url&) noexcept;
+WebPageNode* GetNode(const WebGraph&, std::string_view) noexcept;
 WebPageNode& AddLink(WebGraph&, const Url&, WebPageNode& from);
 WebPageNode& AddLink(WebGraph&, WebPageNode& to, WebPageNode& from);
 const Url& GetNodeUrl(const WebPageNode&) noexcept;
+// Urls with the same key are the same node, the key is a view into the url
+std::string_view MakeKey(std::string_view url) noexcept;
+// Dense id of the node, ids of deleted nodes are not reused
+NodeId GetNodeId(const WebPageNode&) noexcept;
+// All node ids are less than the bound
+NodeId GetNodeIdBound(const WebGraph&) noexcept;
 const NodeLinks& GetInboundNodeLinks(const WebPageNode&) noexcept;
 const NodeLinks& GetOutboundNodeLinks(const WebPageNode&) noexcept;
 const Nodes& GetNodes(const WebGraph&) noexcept;
 void DeleteNode(WebGraph&, const WebPageNode&);
-void AddTag(WebPageNode& node, TagId);
-void DeleteTag(WebPageNode&, TagId);
-bool HasTag(const WebPageNode&, TagId);
+void AddTag(WebGraph&, const WebPageNode&, TagId);
+void DeleteTag(WebGraph&, const WebPageNode&, TagId);
+bool HasTag(const WebGraph&, const WebPageNode&, TagId) noexcept;
+// Nodes having the tag. Masks are copy-on-write, so a copy is a cheap snapshot which
+// can later be restored with SetTagMask, e.g. to share one graph between several scenarios
+const NodeMask& GetTagMask(const WebGraph&, TagId) noexcept;
+void SetTagMask(WebGraph&, TagId, NodeMask);
 
 }//namepsace web_graph
\ No newline at end of file
@@ -1,265 +1,336 @@
 #include "WebGraphBuilder.h"
 
-#include <cctype>
-#include <regex>
+#include <algorithm>
 #include <iostream>
 #include <unordered_set>
 
+#include "Sitemap.h"
+
 namespace web_graph
 {
 
-bool GetExtension(const Url& url, std::string& extension)
+std::vector<Url> GetValidHyperLinks(
+	const ILinkExtractor& extractor,
+	const std::string& html,
+	Charset charset,
+	const BaseUrl& pageBase,
+	std::string_view rootHost)
 {
-	auto it = url.rfind('.');
-	if (it != std::string::npos)
+	PageLinks pageLinks;
+	extractor.Extract(html, pageLinks);
+
+	std::string decoded;
+
+	// Links are relative to the <base href> if the page has a valid one
+	BaseUrl base{ pageBase };
+	Url baseUrl;
+	BaseUrl hrefBase;
+	if (!pageLinks.baseHref.empty() &&
+		NormalizeUrl(DecodeAttributeValue(pageLinks.baseHref, charset, decoded), pageBase, baseUrl) &&
+		ParseBaseUrl(baseUrl, hrefBase))
 	{
-		extension = url.substr(it);
-		return true;
+		base = hrefBase;
 	}
 
-	return false;
-}
+	std::vector<Url> urls;
+	Url url;
 
-bool IsFile(const std::string& url)
-{
-	static const std::unordered_set<std::string> extentions
+	for (std::string_view link : pageLinks.links)
 	{
-		".jpg",
-		".jpeg",
-		".js",
-		".ico",
-		".js",
-		".css",
-		".png",
-		".pdf",
-		".rar",
-		".zip",
-		".doc",
-		".docx",
-		".xls",
-		".xlsx",
-		".pdf",
-		".mp3",
-		".djvu",
-		".rtf",
-		".ppt",
-		".txt",
-		".pptx",
-		".gz",
-		".gif",
-		".xml",
-		".tif",
-		".tiff",
-		".flv",
-		".avi",
-		".mp3",
-		".mkv",
-		".flac",
-		".ogg",
-		".mp4",
-		".exe",
-		".msi",
-		".deb",
-		".zip.001",
-		".zip.002",
-		".svg",
-		".odt",
-		".7z",
-		".ppsx"
-	};
+		if (NormalizeUrl(DecodeAttributeValue(link, charset, decoded), base, url) && InDomain(url, rootHost))
+		{
+			urls.push_back(url);
+		}
+	}
 
-	std::string extension;
-	return GetExtension(url, extension) ?
-		!!extentions.count(extension) :
-		false;
+	return urls;
 }
 
-constexpr bool IsAlNum(const char c) noexcept
+metrics::ErrorCategory ToErrorCategory(network::DownloadErrorType type) noexcept
 {
-	return ('a' <= c && c <= 'z') || ('0' <= c && c <= '9');
+	using network::DownloadErrorType;
+	switch (type)
+	{
+	case DownloadErrorType::Resolve: return metrics::ErrorCategory::Resolve;
+	case DownloadErrorType::Connect: return metrics::ErrorCategory::Connect;
+	case DownloadErrorType::Timeout: return metrics::ErrorCategory::Timeout;
+	case DownloadErrorType::Ssl: return metrics::ErrorCategory::Ssl;
+	case DownloadErrorType::Http: return metrics::ErrorCategory::Http;
+	default: return metrics::ErrorCategory::Other;
+	}
 }
 
-bool IsRootOrInvalid(const Url& url)
+// Absolute root url without the trailing '/', "http://" is added if there is no scheme
+bool MakeRootUrl(const Url& rootUrl, Url& result)
 {
-	static const std::string mailPrefix{ "mailto:" };
+	static constexpr std::string_view defaultScheme{ "http://" };
+	Url absoluteRootUrl{ rootUrl.find("://") == Url::npos ? Url{ defaultScheme } + rootUrl : rootUrl };
+
+	BaseUrl rootBase;
+	if (rootUrl.empty() || !ParseBaseUrl(absoluteRootUrl, rootBase) || !NormalizeUrl(absoluteRootUrl, rootBase, result))
+	{
+		return false;
+	}
+
+	if (result.back() == '/')
+	{
+		result.pop_back();
+	}
 
-	return
-	(
-		url.empty() ||
-		url == "/" ||
-		(url.front() != '/' && !IsAlNum(url.front())) ||
-		url.compare(0, mailPrefix.size(), mailPrefix) == 0
-	);
+	return true;
 }
 
-void ToAbsoluteLink(Url& url, const Url& rootUrl)
+//
+
+struct AsyncWebGraphBuilder::Site
+{
+	// As passed to StartBatch
+	Url inputUrl;
+	Url rootUrl;
+	// Identifies the site to the graph sink
+	uint32_t id{ 0 };
+	std::string rootHost;
+	std::unique_ptr<WebGraph> graph;
+
+	// Set by the pre-crawl task before any page of the site is queued
+	RobotsRules robots;
+	std::chrono::milliseconds crawlDelay{ 0 };
+	// Earliest time of the next download, Clock ticks
+	std::atomic<metrics::Clock::rep> nextDownloadTime{ 0 };
+	// Pages taken before their download slot in the order they were taken, guarded by m_delayMutex
+	std::deque<WebPageNode*> delayedPages;
+
+	// Pages queued, being downloaded or waiting to be parsed including the pre-crawl task,
+	// the site is completed at zero
+	std::atomic<size_t> pagesInFlight{ 0 };
+
+	// Pages of other crawlers wait for the robots rules, parse thread only
+	bool preCrawlApplied{ false };
+	std::vector<std::string> earlyPages;
+
+	// Fingerprints of the parsed pages and the urls of the pages merged into others, parse thread only
+	std::unordered_map<ContentHash, WebPageNode*, ContentHashHasher> contentHashes;
+	SimHashIndex simHashes;
+	std::unordered_map<Url, Url> aliases;
+};
+
+// Aliases are matched the way the graph matches the urls of its nodes
+static std::string_view MakeAliasKey(std::string_view url) noexcept
 {
-	if (url.front() == '/')
+	if (!url.empty() && url.back() == '/')
 	{
-		// Relative link, concat with root
-		url = rootUrl + url;
+		url.remove_suffix(1);
 	}
+
+	return url;
 }
 
-bool IsHttpUrl(const Url& url)
+AsyncWebGraphBuilder::AsyncWebGraphBuilder(const network::IWebPageDownloaderFactory& factory, size_t maxThreads)
 {
-	static const std::string httpPrefix{ "http:/" };
-	static const std::string httpsPrefix{ "https:/" };
-	return (url.compare(0, httpPrefix.size(), httpPrefix) == 0 ||
-			url.compare(0, httpsPrefix.size(), httpsPrefix) == 0);
+	if (!maxThreads)
+	{
+		throw std::invalid_argument{ "Number of threads should be positive" };
+	}
+
+	for (size_t i{ 0 }; i < maxThreads; ++i)
+	{
+		m_workers.emplace_back(std::make_unique<Worker>());
+		m_workers.back()->downloader = factory.Create();
+		m_workers.back()->asyncDownloader = factory.CreateAsync();
+	}
 }
 
-void StripUrlAdditions(Url& url)
+AsyncWebGraphBuilder::~AsyncWebGraphBuilder()
 {
-	static const std::list<char> delimeters{ '#', ';', '&' };
-	for (char c : delimeters)
+	try
 	{
-		auto it = url.find(c);
-		if (it != std::string::npos)
-		{
-			url.erase(it, url.length() - it);
-		}
+		Stop();
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "Failed to stop web graph build: " << e.what() << "\n";
 	}
 }
 
-void StripWebPrefixes(Url& url)
+bool AsyncWebGraphBuilder::SetProxy(const network::ProxySettings& proxySettings)
 {
-	static const std::list<std::string> prefixes{ "http://", "https://", "www." };
-	for (const std::string& prefix : prefixes)
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		if (url.find(prefix) == 0)
+		for (auto& worker : m_workers)
 		{
-			url.erase(0, prefix.length());
+			worker->downloader->SetProxy(proxySettings);
+			if (worker->asyncDownloader)
+			{
+				worker->asyncDownloader->SetProxy(proxySettings);
+			}
 		}
+
+		return true;
 	}
+
+	return false;
 }
 
-Url TrimUrl(const Url& url)
+bool AsyncWebGraphBuilder::SetStatsOutput(std::ostream* out, std::chrono::seconds interval)
 {
-	std::string urlTrimmed{ url };
-	if (url.back() == '/')
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		urlTrimmed.pop_back();
+		m_statsOut = out;
+		m_statsInterval = interval;
+		return true;
 	}
 
-	return urlTrimmed;
+	return false;
 }
 
-bool InDomain(const Url& url, const Url& strippedRootUrl)
+bool AsyncWebGraphBuilder::SetTraceFile(const std::string& filePath)
 {
-	auto it = url.find(strippedRootUrl);
-	return (
-		it != std::string::npos &&
-		it > 0 &&
-		(url.at(it - 1) == '.' || url.at(it - 1) == '/'));
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
+	{
+		m_traceFile = filePath;
+		return true;
+	}
+
+	return false;
 }
 
-void DecodeUrl(web_graph::Url& url)
+bool AsyncWebGraphBuilder::SetParseQueueCapacity(size_t maxPages, size_t maxBytes)
 {
-	Url decodedUrl;
+	if (!maxPages || !maxBytes)
+	{
+		throw std::invalid_argument{ "Parse queue capacity should be positive" };
+	}
 
-	for (size_t i{ 0 }; i < url.length(); ++i)
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		if (url[i] == '%')
-		{
-			int charVal;
-			sscanf(url.substr(i + 1, 2).c_str(), "%x", &charVal);
-			decodedUrl += static_cast<char>(charVal);
-			i += 2;
-		}
-		else
-		{
-			decodedUrl += url[i];
-		}
+		m_pagesToParse.SetCapacity(maxPages, maxBytes);
+		return true;
 	}
 
-	url = decodedUrl;
+	return false;
 }
 
-void RemoveInvalidSymbols(std::string& url)
+bool AsyncWebGraphBuilder::SetPreCrawlSettings(const PreCrawlSettings& settings)
 {
-	url.erase(std::remove(url.begin(), url.end(), '"'), url.end());
-	url.erase(std::remove(url.begin(), url.end(), ''), url.end());
-	url.erase(std::remove(url.begin(), url.end(), '\''), url.end());
-	url.erase(std::remove(url.begin(), url.end(), '&'), url.end());
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
+	{
+		m_preCrawl = settings;
+		return true;
+	}
+
+	return false;
 }
 
-std::list<Url> GetValidHyperLinks(std::string&& html, const Url& rootUrl, const Url& strippedRootUrl)
+bool AsyncWebGraphBuilder::SetDedupSettings(const DedupSettings& settings)
 {
-	static const std::regex hl_regex{ "<a href=\"(.*?)\"", std::regex_constants::icase };
-	std::list<Url> urls{
-		std::sregex_token_iterator{ html.begin(), html.end(), hl_regex, 1 },
-		std::sregex_token_iterator{} };
+	if (settings.nearDuplicateDistance > SimHashIndex::MaxDistance)
+	{
+		throw std::invalid_argument{ "Near duplicate distance should be at most " + std::to_string(SimHashIndex::MaxDistance) };
+	}
 
-	auto it = urls.begin();
-	while (it != urls.end())
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		Url& url = *it;
-		std::transform(url.begin(), url.end(), url.begin(), ::tolower);
+		m_dedup = settings;
+		return true;
+	}
 
-		if (IsRootOrInvalid(url) || IsFile(url))
-		{
-			urls.erase(it++);
-		}
-		else
-		{
-			ToAbsoluteLink(url, rootUrl);
+	return false;
+}
 
-			if (!IsHttpUrl(url) || !InDomain(url, strippedRootUrl))
-			{
-				urls.erase(it++);
-				continue;
-			}
+bool AsyncWebGraphBuilder::SetMemoryBudget(size_t bytes, const std::string& spillDir)
+{
+	if (bytes && spillDir.empty())
+	{
+		throw std::invalid_argument{ "Spill directory should be set" };
+	}
+
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
+	{
+		m_memoryBudget = bytes;
+		m_spillDir = spillDir;
+		return true;
+	}
 
-			StripUrlAdditions(url);
-			RemoveInvalidSymbols(url);
-			DecodeUrl(url);
+	return false;
+}
 
-			++it;
-		}
+bool AsyncWebGraphBuilder::SetGraphSink(IGraphSink* sink)
+{
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
+	{
+		m_sink = sink;
+		return true;
 	}
 
-	return urls;
+	return false;
 }
 
-//
+bool AsyncWebGraphBuilder::SetLinkExtractor(std::unique_ptr<ILinkExtractor> extractor)
+{
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
+	{
+		m_linkExtractor = extractor ? std::move(extractor) : std::make_unique<HtmlLinkExtractor>();
+		return true;
+	}
 
-AsyncWebGraphBuilder::AsyncWebGraphBuilder(const network::IWebPageDownloaderFactory& factory, size_t maxThreads)
+	return false;
+}
+
+bool AsyncWebGraphBuilder::SetTransfersPerThread(size_t transfers)
 {
-	if (!maxThreads)
+	if (transfers && !m_workers.front()->asyncDownloader)
 	{
-		throw std::invalid_argument{ "Number of threads should be positive" };
+		throw std::invalid_argument{ "Downloader factory has no async downloaders" };
 	}
 
-	for (size_t i{ 0 }; i < maxThreads; ++i)
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		m_freeDownloaders.emplace_back(factory.Create());
+		m_transfersPerThread = transfers;
+		return true;
 	}
 
+	return false;
 }
 
-AsyncWebGraphBuilder::~AsyncWebGraphBuilder()
+bool AsyncWebGraphBuilder::SetMaxActiveSites(size_t maxSites)
 {
-	try
+	if (!maxSites)
 	{
-		Stop();
+		throw std::invalid_argument{ "Number of active sites should be positive" };
 	}
-	catch (const std::exception& e)
+
+	std::lock_guard<std::mutex> l{ m_urlMutex };
+	if (!m_running)
 	{
-		std::cout << "Failed to stop web graph build: " << e.what() << "\n";
+		m_maxActiveSites = maxSites;
+		return true;
 	}
+
+	return false;
 }
 
-bool AsyncWebGraphBuilder::SetProxy(const network::ProxySettings& proxySettings)
+bool AsyncWebGraphBuilder::SetPartition(CrawlPartition partition)
 {
+	// An empty partition turns partitioning off
+	if (static_cast<bool>(partition.isOwned) != static_cast<bool>(partition.onForeignUrl))
+	{
+		throw std::invalid_argument{ "Both partition callbacks should be set" };
+	}
+
 	std::lock_guard<std::mutex> l{ m_urlMutex };
 	if (!m_running)
 	{
-		for (auto& downloader : m_freeDownloaders)
-		{
-			downloader->SetProxy(proxySettings);
-		}
-
+		m_partition = std::move(partition);
 		return true;
 	}
 
@@ -273,6 +344,43 @@ std::future<std::unique_ptr<WebGraph>> AsyncWebGraphBuilder::Start(const Url& ro
 		throw std::invalid_argument{ "Url should not be empty" };
 	}
 
+	Url normalizedRootUrl;
+	if (!MakeRootUrl(rootUrl, normalizedRootUrl))
+	{
+		throw std::invalid_argument{ "Invalid root url" };
+	}
+
+	if (m_running)
+	{
+		throw std::logic_error{ "Already running" };
+	}
+
+	m_promise = std::promise<std::unique_ptr<WebGraph>>{};
+	StartSites({ rootUrl }, [this](const Url&, std::unique_ptr<WebGraph> graph)
+	{
+		m_promise.set_value(std::move(graph));
+	}, true);
+
+	return m_promise.get_future();
+}
+
+std::future<void> AsyncWebGraphBuilder::StartBatch(
+	const std::vector<Url>& rootUrls,
+	SiteCompletedCallback onSiteCompleted)
+{
+	return StartSites(rootUrls, std::move(onSiteCompleted), false);
+}
+
+std::future<void> AsyncWebGraphBuilder::StartSites(
+	const std::vector<Url>& rootUrls,
+	SiteCompletedCallback onSiteCompleted,
+	bool singleSite)
+{
+	if (!onSiteCompleted)
+	{
+		throw std::invalid_argument{ "Callback should be set" };
+	}
+
 	std::lock_guard<std::mutex> l{ m_urlMutex };
 
 	if (m_running)
@@ -280,34 +388,67 @@ std::future<std::unique_ptr<WebGraph>> AsyncWebGraphBuilder::Start(const Url& ro
 		throw std::logic_error{ "Already running" };
 	}
 
-	m_pagesToDownload = {};
-	m_pagesToParse = {};
+	if (m_partition.isOwned && rootUrls.size() != 1)
+	{
+		throw std::invalid_argument{ "Partitioned crawl takes a single site" };
+	}
+
+	m_pagesToParse.Reset();
 	m_graphCompleted = false;
+	m_needsToStop = false;
+	m_queuedPages = 0;
+	m_delayedSites.clear();
+	m_delayedPages = 0;
 
-	m_rootUrl = TrimUrl(rootUrl);
-	DecodeUrl(m_rootUrl);
-	RemoveInvalidSymbols(m_rootUrl);
+	m_pageSpill = m_memoryBudget ? std::make_unique<common::SpillStore>(m_spillDir, "pages") : nullptr;
 
-	m_graph = std::make_unique<WebGraph>(CreateWebGraph(m_rootUrl));
-	m_pagesToDownload.push(GetRoot(*m_graph));
+	for (auto& worker : m_workers)
+	{
+		worker->pages.clear();
+	}
 
-	StripWebPrefixes(m_rootUrl);
-	for (size_t i{ 0 }; i < m_freeDownloaders.size(); ++i)
 	{
-		m_threads.emplace_back(std::thread{ &AsyncWebGraphBuilder::DownloadCycle, this });
+		std::lock_guard<std::mutex> partitionLock{ m_partitionMutex };
+		m_partitionSite = nullptr;
+		m_partitionFinished = false;
 	}
 
-	m_threads.emplace_back(std::thread{ &AsyncWebGraphBuilder::ParseCycle, this });
+	m_activeSites.clear();
+	m_pendingSites.assign(rootUrls.begin(), rootUrls.end());
+	m_nextSiteId = 0;
+	m_onSiteCompleted = std::move(onSiteCompleted);
+	m_singleSite = singleSite;
+
+	const size_t downloadersNum{ m_workers.size() };
+
+	m_metrics = std::make_unique<metrics::CrawlMetrics>();
+	m_metrics->downloadersNum = downloadersNum;
+
+	m_trace = m_traceFile.empty() ? nullptr : std::make_unique<metrics::TraceRecorder>(downloadersNum + 1);
 
-	m_downloadCv.notify_one();
+	m_batchPromise = std::promise<void>{};
 	m_running = true;
 
-#ifdef DEBUG
-	m_outFile.open("web_graph_meta.txt");
-#endif
+	// Completes the crawl at once if there are no valid sites
+	for (size_t i{ 0 }; i < std::max<size_t>(m_maxActiveSites, 1); ++i)
+	{
+		ActivateNextSite();
+	}
 
-	m_promise = std::promise<std::unique_ptr<WebGraph>>{};
-	return m_promise.get_future();
+	for (size_t i{ 0 }; i < downloadersNum; ++i)
+	{
+		m_threads.emplace_back(std::thread{ m_transfersPerThread ?
+			&AsyncWebGraphBuilder::TransferCycle : &AsyncWebGraphBuilder::DownloadCycle, this, i });
+	}
+
+	m_threads.emplace_back(std::thread{ &AsyncWebGraphBuilder::ParseCycle, this, downloadersNum });
+
+	if (m_statsOut && m_statsInterval.count())
+	{
+		m_threads.emplace_back(std::thread{ &AsyncWebGraphBuilder::StatsCycle, this });
+	}
+
+	return m_batchPromise.get_future();
 }
 
 bool AsyncWebGraphBuilder::IsRunning() const noexcept
@@ -318,7 +459,8 @@ bool AsyncWebGraphBuilder::IsRunning() const noexcept
 void AsyncWebGraphBuilder::Stop()
 {
 	m_needsToStop = true;
-	m_downloadCv.notify_all();
+	m_pagesToParse.Close();
+	NotifyAll();
 
 	for (std::thread& t : m_threads)
 	{
@@ -329,153 +471,1221 @@ void AsyncWebGraphBuilder::Stop()
 	}
 
 	m_threads.clear();
-	if (m_running)
-	{
-		m_promise.set_exception(
-			std::make_exception_ptr(std::logic_error{ "Building aborted" }));
 
-		m_running = false;
-	}
-}
+	m_delayedSites.clear();
+	m_delayedPages = 0;
 
-void AsyncWebGraphBuilder::DownloadCycle()
-{
-	std::unique_ptr<network::IWebPageDownloader> downloader;
-	WebPageNode* currNode{ nullptr };
+	// Removes the spill files
+	m_pageSpill.reset();
 
-	while (!m_graphCompleted && !m_needsToStop)
 	{
-		try
-		{
-			{
-				std::unique_lock<std::mutex> l{ m_urlMutex };
-				m_downloadCv.wait(l, [&]
-				{
-					return CanDownloadNextPage() || m_graphCompleted || m_needsToStop;
-				});
-
-				if (m_needsToStop || m_graphCompleted)
-				{
-					return;
-				}
-
-				downloader = std::move(m_freeDownloaders.front());
-				m_freeDownloaders.pop_front();
-
-				currNode = m_pagesToDownload.front();
-				m_pagesToDownload.pop();
-			}
-
-			network::WebPageDownloadResult res = downloader->DownloadPage(GetNodeUrl(*currNode));
+		std::lock_guard<std::mutex> l{ m_partitionMutex };
+		m_partitionSite = nullptr;
+		m_partitionFinished = true;
+	}
 
-			std::lock_guard<std::mutex> l{ m_urlMutex };
-			if (res.error.empty())
+	if (m_running)
+	{
+		// Sites of a batch not completed yet get the pages found so far, a single site crawl fails
+		for (auto& site : m_activeSites)
+		{
+			if (m_singleSite)
 			{
-				m_pagesToParse.push({ currNode, std::move(res.data) });
-				m_parseCv.notify_one();
+				m_promise.set_exception(std::make_exception_ptr(std::logic_error{ "Building aborted" }));
 			}
 			else
 			{
-				std::cerr << "Failed to download page " << GetNodeUrl(*currNode) << ": " << res.error << '\n';
+				m_onSiteCompleted(site->inputUrl, std::move(site->graph));
 			}
+		}
 
-			m_freeDownloaders.push_back(std::move(downloader));
+		m_activeSites.clear();
+		m_pendingSites.clear();
+		m_batchPromise.set_value();
 
-			UpdateGraphCompleted();
-			if (m_graphCompleted)
-			{
-				m_downloadCv.notify_all();
-				m_parseCv.notify_one();
-			}
-		}
-		catch (const std::exception& e)
-		{
-			std::cerr << "Failed to download page " << GetNodeUrl(*currNode) << ": " << e.what() << '\n';
-		}
+		m_running = false;
 	}
-}
 
-void AsyncWebGraphBuilder::ParseCycle()
-{
-	while (!m_needsToStop)
+	if (m_trace)
 	{
-		WebPageNode* pageNode{ nullptr };
-		std::string pageData;
-
-		try
-		{
-			{
-				std::unique_lock<std::mutex> l{ m_urlMutex };
-				m_parseCv.wait(l, [&]
-				{
-					return (!m_pagesToParse.empty() || m_graphCompleted || m_needsToStop);
-				});
-
-				if (m_needsToStop || m_graphCompleted)
-				{
-					m_promise.set_value(std::move(m_graph));
-					m_running = false;
-					return;
-				}
+		m_trace->Write(m_traceFile);
+		m_trace.reset();
+	}
+}
 
-				pageNode = m_pagesToParse.front().first;
-				pageData = std::move(m_pagesToParse.front().second);
-			}
+metrics::MetricsSnapshot AsyncWebGraphBuilder::GetMetrics() const
+{
+	return m_metrics->Snapshot();
+}
 
-			std::list<Url> urls{
-				GetValidHyperLinks(std::move(pageData), GetNodeUrl(*GetRoot(*m_graph)), m_rootUrl) };
+void AsyncWebGraphBuilder::AddPages(std::vector<Url> urls)
+{
+	size_t bytes{ 0 };
+	for (const Url& url : urls)
+	{
+		bytes += url.size();
+	}
 
-			std::lock_guard<std::mutex> l{ m_urlMutex };
+	// The lock keeps the site alive, it is only completed after Finish()
+	std::lock_guard<std::mutex> l{ m_partitionMutex };
+	if (!m_partitionSite || m_partitionFinished || urls.empty())
+	{
+		return;
+	}
 
-			for (const Url& url : urls)
-			{
-				WebPageNode* node{ GetNode(*m_graph, url) };
-				if (node)
-				{
-					// Already downloaded, just update links
-					AddLink(*m_graph, *node, *pageNode);
-				}
-				else
-				{
-					WebPageNode& linkedNode = AddLink(*m_graph, url, *pageNode);
-					m_pagesToDownload.push(&linkedNode);
-					m_downloadCv.notify_one();
-#ifdef DEBUG
-					m_outFile
-						<< std::this_thread::get_id() << " "
-						<< m_freeDownloaders.size() << " "
-						<< m_pagesToDownload.size() << " "
-						<< GetNodeUrl(linkedNode) << << '\n';
-#endif
-				}
-			}
+	Site& site = *m_partitionSite;
+	++site.pagesInFlight;
 
-			m_pagesToParse.pop();
+	ParseTask parseTask;
+	parseTask.site = &site;
+	parseTask.seeds = std::move(urls);
+	parseTask.external = true;
 
-			UpdateGraphCompleted();
-			if (m_graphCompleted)
-			{
-				m_downloadCv.notify_all();
-			}
-		}
-		catch (const std::exception& e)
-		{
-			std::cerr << "Failed to parse page " << GetNodeUrl(*pageNode) << ": " << e.what() << '\n';
-		}
+	common::QueueLevel level;
+	metrics::Clock::duration blockedTime{ 0 };
+	if (!m_pagesToParse.Push(std::move(parseTask), bytes, level, blockedTime))
+	{
+		--site.pagesInFlight;
 	}
 }
 
-bool AsyncWebGraphBuilder::CanDownloadNextPage() noexcept
+bool AsyncWebGraphBuilder::IsIdle() const
 {
-	return (!m_pagesToDownload.empty() && !m_freeDownloaders.empty());
+	std::lock_guard<std::mutex> l{ m_partitionMutex };
+	return m_partitionSite && !m_partitionFinished && m_partitionSite->pagesInFlight == 1;
 }
 
-void AsyncWebGraphBuilder::UpdateGraphCompleted() noexcept
+void AsyncWebGraphBuilder::Finish()
 {
-	m_graphCompleted =
-		m_pagesToDownload.empty() && // no pages to download
-		m_pagesToParse.empty(); // no pages to parse
-		(m_freeDownloaders.size() == m_threads.size()); // all downloads finished
+	Site* site{ nullptr };
+	{
+		std::lock_guard<std::mutex> l{ m_partitionMutex };
+		if (m_partitionFinished)
+		{
+			return;
+		}
+
+		m_partitionFinished = true;
+		site = m_partitionSite;
+	}
+
+	if (site)
+	{
+		PageDone(*site);
+	}
+}
+
+std::unique_lock<std::mutex> AsyncWebGraphBuilder::LockPages(Worker& worker)
+{
+	const auto start = metrics::Clock::now();
+	std::unique_lock<std::mutex> l{ worker.pagesMutex };
+	m_metrics->RecordStage(metrics::Stage::LockWait, metrics::Clock::now() - start);
+
+	return l;
+}
+
+void AsyncWebGraphBuilder::RecordDownload(const network::WebPageDownloadResult& result) noexcept
+{
+	const network::DownloadTimings& timings = result.timings;
+	if ((timings.dns + timings.connect + timings.ttfb + timings.transfer).count())
+	{
+		m_metrics->RecordStage(metrics::Stage::Dns, timings.dns);
+		m_metrics->RecordStage(metrics::Stage::Connect, timings.connect);
+		m_metrics->RecordStage(metrics::Stage::Ttfb, timings.ttfb);
+		m_metrics->RecordStage(metrics::Stage::Transfer, timings.transfer);
+	}
+
+	if (result.error.empty())
+	{
+		m_metrics->pagesDownloaded.Add();
+		m_metrics->bytesDownloaded.Add(result.data.size());
+	}
+	else
+	{
+		m_metrics->RecordError(ToErrorCategory(result.errorType));
+	}
+}
+
+void AsyncWebGraphBuilder::PushPage(Site& site, WebPageNode* page)
+{
+	Worker& worker = *m_workers[m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+
+	++site.pagesInFlight;
+	{
+		std::unique_lock<std::mutex> l{ LockPages(worker) };
+		worker.pages.push_back({ &site, page });
+	}
+
+	m_metrics->frontierDepth.Set(++m_queuedPages);
+
+	if (m_idleWorkers)
+	{
+		std::lock_guard<std::mutex> l{ m_idleMutex };
+		m_workCv.notify_one();
+	}
+}
+
+bool AsyncWebGraphBuilder::PopPage(size_t workerIndex, PageTask& task)
+{
+	bool found{ false };
+
+	for (size_t i{ 0 }; i < m_workers.size() && !found; ++i)
+	{
+		Worker& worker = *m_workers[(workerIndex + i) % m_workers.size()];
+
+		std::unique_lock<std::mutex> l{ LockPages(worker) };
+		if (!worker.pages.empty())
+		{
+			if (!i)
+			{
+				task = worker.pages.front();
+				worker.pages.pop_front();
+			}
+			else
+			{
+				// Steal
+				task = worker.pages.back();
+				worker.pages.pop_back();
+			}
+
+			found = true;
+		}
+	}
+
+	if (found)
+	{
+		m_metrics->frontierDepth.Set(--m_queuedPages);
+	}
+
+	return found;
+}
+
+// Also returns at the time passed, when a delayed page gets its download slot
+void AsyncWebGraphBuilder::WaitForPages(metrics::Clock::time_point until)
+{
+	const auto idleStart = metrics::Clock::now();
+	auto hasWork = [this] { return m_queuedPages || m_graphCompleted || m_needsToStop; };
+
+	// The idle counter is raised before the queued pages are checked, so a concurrent
+	// PushPage either sees the idle worker and notifies it or the worker sees the page
+	std::unique_lock<std::mutex> l{ m_idleMutex };
+	++m_idleWorkers;
+	if (until == metrics::Clock::time_point::max())
+	{
+		m_workCv.wait(l, hasWork);
+	}
+	else
+	{
+		m_workCv.wait_until(l, until, hasWork);
+	}
+
+	--m_idleWorkers;
+
+	m_metrics->downloaderIdleNs.Add(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(metrics::Clock::now() - idleStart).count()));
+}
+
+void AsyncWebGraphBuilder::PageDone(Site& site)
+{
+	if (--site.pagesInFlight == 0)
+	{
+		CompleteSite(site);
+	}
+}
+
+void AsyncWebGraphBuilder::ActivateNextSite()
+{
+	while (true)
+	{
+		std::unique_ptr<Site> site{ std::make_unique<Site>() };
+		{
+			std::lock_guard<std::mutex> l{ m_sitesMutex };
+			if (m_pendingSites.empty())
+			{
+				if (m_activeSites.empty() && !m_graphCompleted.exchange(true))
+				{
+					m_pagesToParse.Close();
+					NotifyAll();
+				}
+
+				return;
+			}
+
+			site->inputUrl = std::move(m_pendingSites.front());
+			site->id = m_nextSiteId++;
+			m_pendingSites.pop_front();
+		}
+
+		if (!MakeRootUrl(site->inputUrl, site->rootUrl))
+		{
+			std::cerr << "Invalid root url " << site->inputUrl << '\n';
+			m_onSiteCompleted(site->inputUrl, nullptr);
+			continue;
+		}
+
+		site->graph = std::make_unique<WebGraph>(CreateWebGraph(site->rootUrl));
+		site->rootHost = GetUrlHost(site->rootUrl);
+		if (site->rootHost.compare(0, 4, "www.") == 0)
+		{
+			site->rootHost.erase(0, 4);
+		}
+
+		m_metrics->nodesAdded.Add();
+
+		if (m_sink)
+		{
+			const WebPageNode& root = *GetRoot(*site->graph);
+			m_sink->OnSiteStarted(site->id, site->rootUrl);
+			m_sink->OnNodeAdded(site->id, GetNodeId(root), GetNodeUrl(root));
+		}
+
+		Site& activeSite = *site;
+		{
+			std::lock_guard<std::mutex> l{ m_sitesMutex };
+			m_activeSites.push_back(std::move(site));
+		}
+
+		if (m_partition.isOwned)
+		{
+			++activeSite.pagesInFlight;
+
+			std::lock_guard<std::mutex> l{ m_partitionMutex };
+			m_partitionSite = &activeSite;
+		}
+
+		// The pre-crawl task queues the root page
+		PushPage(activeSite, nullptr);
+		return;
+	}
+}
+
+void AsyncWebGraphBuilder::CompleteSite(Site& site)
+{
+	// Pages given up on stop are done too, such a site is left to Stop()
+	if (m_needsToStop)
+	{
+		return;
+	}
+
+	// Nothing of the site is queued or processed anymore, so the graph can be handed over
+	if (m_sink)
+	{
+		m_sink->OnSiteCompleted(site.id);
+	}
+
+	try
+	{
+		m_onSiteCompleted(site.inputUrl, std::move(site.graph));
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Failed to complete site " << site.inputUrl << ": " << e.what() << '\n';
+	}
+
+	{
+		std::lock_guard<std::mutex> l{ m_partitionMutex };
+		if (m_partitionSite == &site)
+		{
+			m_partitionSite = nullptr;
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> l{ m_sitesMutex };
+		m_activeSites.remove_if([&site](const std::unique_ptr<Site>& activeSite) { return activeSite.get() == &site; });
+	}
+
+	ActivateNextSite();
+}
+
+void AsyncWebGraphBuilder::NotifyAll()
+{
+	{
+		std::lock_guard<std::mutex> l{ m_idleMutex };
+		m_workCv.notify_all();
+	}
+
+	{
+		std::lock_guard<std::mutex> l{ m_statsMutex };
+		m_statsCv.notify_all();
+	}
+}
+
+void AsyncWebGraphBuilder::DownloadCycle(size_t workerIndex)
+{
+	network::IWebPageDownloader& downloader = *m_workers[workerIndex]->downloader;
+
+	while (!m_graphCompleted && !m_needsToStop)
+	{
+		// A delayed page has its download slot taken already
+		PageTask task;
+		metrics::Clock::time_point nextSlotTime;
+		if (!PopDelayedPage(task, nextSlotTime))
+		{
+			if (!PopPage(workerIndex, task))
+			{
+				WaitForPages(nextSlotTime);
+				continue;
+			}
+
+			if (!task.page)
+			{
+				PreCrawl(*task.site, workerIndex);
+				continue;
+			}
+
+			if (!TakeDownloadSlot(task))
+			{
+				continue;
+			}
+		}
+
+		Site& site = *task.site;
+		WebPageNode* currNode{ task.page };
+
+		try
+		{
+			const auto downloadStart = metrics::Clock::now();
+			network::WebPageDownloadResult res = downloader.DownloadPage(GetNodeUrl(*currNode));
+
+			RecordDownload(res);
+			if (m_trace)
+			{
+				m_trace->Record(workerIndex, "download", downloadStart, GetNodeUrl(*currNode));
+			}
+
+			if (QueueParse(task, res))
+			{
+				continue;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			m_metrics->RecordError(metrics::ErrorCategory::Other);
+			std::cerr << "Failed to download page " << GetNodeUrl(*currNode) << ": " << e.what() << '\n';
+		}
+
+		PageDone(site);
+	}
+}
+
+// Keeps up to m_transfersPerThread pages of the worker in flight on its async downloader. Pages of the sites
+// with a crawl delay wait for their slot in the site like with the blocking downloaders, so only the
+// transfers count against the limit. The pre-crawl stage is still run with the blocking downloader
+void AsyncWebGraphBuilder::TransferCycle(size_t workerIndex)
+{
+	static constexpr std::chrono::milliseconds PollInterval{ 50 };
+
+	network::IAsyncWebPageDownloader& downloader = *m_workers[workerIndex]->asyncDownloader;
+	Transfers inFlight;
+	size_t transfers{ 0 };
+
+	// Sites are completed only once their pages are done, so nothing is in flight when the crawl is completed
+	while (!m_graphCompleted && !m_needsToStop)
+	{
+		PageTask task;
+		metrics::Clock::time_point nextSlotTime{ metrics::Clock::time_point::max() };
+		while (transfers < m_transfersPerThread)
+		{
+			// A delayed page has its download slot taken already
+			if (!PopDelayedPage(task, nextSlotTime))
+			{
+				if (!PopPage(workerIndex, task))
+				{
+					break;
+				}
+
+				if (!task.page)
+				{
+					PreCrawl(*task.site, workerIndex);
+					continue;
+				}
+
+				if (!TakeDownloadSlot(task))
+				{
+					continue;
+				}
+			}
+
+			StartTransfer(downloader, task, workerIndex, inFlight);
+			++transfers;
+		}
+
+		if (!transfers)
+		{
+			WaitForPages(nextSlotTime);
+			continue;
+		}
+
+		std::chrono::milliseconds timeout{ PollInterval };
+		if (nextSlotTime != metrics::Clock::time_point::max())
+		{
+			timeout = std::min(timeout, std::chrono::ceil<std::chrono::milliseconds>(
+				std::max(nextSlotTime - metrics::Clock::now(), metrics::Clock::duration{ 0 })));
+		}
+
+		try
+		{
+			transfers = downloader.Poll(timeout);
+		}
+		catch (const std::exception& e)
+		{
+			// The downloads in flight fail, the handlers are dropped first so none of them runs twice
+			m_metrics->RecordError(metrics::ErrorCategory::Other);
+			std::cerr << "Failed to poll downloads: " << e.what() << '\n';
+			downloader.CancelAll();
+
+			Transfers failed;
+			failed.swap(inFlight);
+			for (const Transfer& transfer : failed)
+			{
+				network::WebPageDownloadResult result;
+				result.error = e.what();
+				result.errorType = network::DownloadErrorType::Other;
+				CompleteTransfer(transfer, workerIndex, result);
+			}
+
+			transfers = 0;
+		}
+	}
+
+	// Handlers of the downloads still in flight on stop point to this crawl
+	downloader.CancelAll();
+}
+
+void AsyncWebGraphBuilder::StartTransfer(
+	network::IAsyncWebPageDownloader& downloader,
+	const PageTask& task,
+	size_t workerIndex,
+	Transfers& transfers)
+{
+	const Url& url = GetNodeUrl(*task.page);
+	const auto transfer = transfers.insert(transfers.end(), { task, metrics::Clock::now() });
+	try
+	{
+		downloader.StartDownload(url, [this, workerIndex, &transfers, transfer](network::WebPageDownloadResult&& res)
+		{
+			const Transfer completed{ *transfer };
+			transfers.erase(transfer);
+			CompleteTransfer(completed, workerIndex, res);
+		});
+	}
+	catch (const std::exception& e)
+	{
+		transfers.erase(transfer);
+		m_metrics->RecordError(metrics::ErrorCategory::Other);
+		std::cerr << "Failed to download page " << url << ": " << e.what() << '\n';
+		PageDone(*task.site);
+	}
+}
+
+void AsyncWebGraphBuilder::CompleteTransfer(
+	const Transfer& transfer,
+	size_t workerIndex,
+	network::WebPageDownloadResult& result)
+{
+	const PageTask& task = transfer.task;
+	try
+	{
+		RecordDownload(result);
+		if (m_trace)
+		{
+			m_trace->Record(workerIndex, "download", transfer.start, GetNodeUrl(*task.page));
+		}
+
+		if (QueueParse(task, result))
+		{
+			return;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		m_metrics->RecordError(metrics::ErrorCategory::Other);
+		std::cerr << "Failed to download page " << GetNodeUrl(*task.page) << ": " << e.what() << '\n';
+	}
+
+	PageDone(*task.site);
+}
+
+// Passes the downloaded page to the parse thread, false if the download failed or the crawl is stopped
+bool AsyncWebGraphBuilder::QueueParse(const PageTask& task, network::WebPageDownloadResult& result)
+{
+	if (!result.error.empty())
+	{
+		std::cerr << "Failed to download page " << GetNodeUrl(*task.page) << ": " << result.error << '\n';
+		return false;
+	}
+
+	const size_t pageBytes{ result.data.size() };
+	common::QueueLevel level;
+	metrics::Clock::duration blockedTime{ 0 };
+
+	size_t queuedBytes{ pageBytes };
+
+	ParseTask parseTask;
+	parseTask.site = task.site;
+	parseTask.page = task.page;
+	parseTask.data = std::move(result.data);
+	parseTask.charset = DetectCharset(result.contentType, parseTask.data);
+
+	// Hashed here to keep the work off the single parse thread
+	if (m_dedup.exactDuplicates || m_dedup.nearDuplicateDistance)
+	{
+		metrics::ScopedStageTimer timer{ *m_metrics, metrics::Stage::Fingerprint };
+		if (m_dedup.exactDuplicates)
+		{
+			parseTask.contentHash = HashContent(parseTask.data);
+		}
+
+		if (m_dedup.nearDuplicateDistance)
+		{
+			parseTask.simHash = SimHash(parseTask.data);
+		}
+	}
+
+	// Pages over the budget wait on disk instead of blocking the downloaders
+	if (m_pageSpill && m_pagesToParse.GetLevel().bytes + pageBytes > m_memoryBudget)
+	{
+		parseTask.spillLocation = m_pageSpill->Write(parseTask.data);
+		parseTask.spilled = true;
+		parseTask.data = std::string{};
+		queuedBytes = 0;
+		m_metrics->pagesSpilled.Add();
+		m_metrics->bytesSpilled.Add(pageBytes);
+	}
+
+	// Blocks while the parser is saturated
+	const bool pushed{ m_pagesToParse.Push(std::move(parseTask), queuedBytes, level, blockedTime) };
+
+	m_metrics->parseQueueBlockedNs.Add(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(blockedTime).count()));
+
+	if (pushed)
+	{
+		m_metrics->parseQueueDepth.Set(level.items);
+		m_metrics->parseQueueBytes.Set(level.bytes);
+	}
+
+	return pushed;
+}
+
+void AsyncWebGraphBuilder::ParseCycle(size_t threadIndex)
+{
+	ParseTask task;
+	common::QueueLevel level;
+
+	// The queue is closed once the crawl is completed or stopped
+	while (!m_needsToStop && m_pagesToParse.Pop(task, level))
+	{
+		m_metrics->parseQueueDepth.Set(level.items);
+		m_metrics->parseQueueBytes.Set(level.bytes);
+
+		Site& site = *task.site;
+		if (task.page)
+		{
+			ParsePage(task, threadIndex);
+		}
+		else if (task.external)
+		{
+			ApplyExternalPages(site, task.seeds);
+		}
+		else
+		{
+			ApplyPreCrawl(site, task.seeds);
+		}
+
+		task = ParseTask{};
+		PageDone(site);
+	}
+
+	level = m_pagesToParse.GetLevel();
+	m_metrics->parseQueueDepth.Set(level.items);
+	m_metrics->parseQueueBytes.Set(level.bytes);
+
+	// A stopped crawl is finished by Stop() once all the threads are joined
+	if (!m_needsToStop)
+	{
+		std::lock_guard<std::mutex> l{ m_urlMutex };
+		m_batchPromise.set_value();
+		m_running = false;
+	}
+
+	NotifyAll();
+}
+
+void AsyncWebGraphBuilder::ParsePage(ParseTask& task, size_t threadIndex)
+{
+	Site& site = *task.site;
+	WebPageNode* pageNode{ task.page };
+	WebGraph& graph = *site.graph;
+
+	try
+	{
+		if (task.spilled)
+		{
+			m_pageSpill->Read(task.spillLocation, task.data);
+		}
+
+		if (MergeDuplicate(task))
+		{
+			return;
+		}
+
+		std::vector<Url> urls;
+		{
+			metrics::ScopedStageTimer timer{ *m_metrics, metrics::Stage::Parse };
+
+			BaseUrl base;
+			if (ParseBaseUrl(GetNodeUrl(*pageNode), base))
+			{
+				urls = GetValidHyperLinks(*m_linkExtractor, task.data, task.charset, base, site.rootHost);
+			}
+
+			if (m_trace)
+			{
+				m_trace->Record(threadIndex, "parse", timer.GetStart(), GetNodeUrl(*pageNode));
+			}
+		}
+
+		// The graphs are only modified by this thread, so no locking is needed
+		metrics::ScopedStageTimer timer{ *m_metrics, metrics::Stage::Insert };
+
+		for (const Url& url : urls)
+		{
+			// Already known pages just get the link
+			WebPageNode* node{ FindPage(site, url) };
+			if (!node)
+			{
+				node = AddPage(site, url);
+			}
+
+			if (node)
+			{
+				AddLink(graph, *node, *pageNode);
+				if (m_sink)
+				{
+					m_sink->OnLinkAdded(site.id, GetNodeId(*pageNode), GetNodeId(*node));
+				}
+			}
+		}
+
+		m_metrics->pagesParsed.Add();
+		m_metrics->linksFound.Add(urls.size());
+
+		if (m_trace)
+		{
+			m_trace->Record(threadIndex, "insert", timer.GetStart());
+		}
+	}
+	catch (const std::exception& e)
+	{
+		m_metrics->RecordError(metrics::ErrorCategory::Parse);
+		std::cerr << "Failed to parse page " << GetNodeUrl(*pageNode) << ": " << e.what() << '\n';
+	}
+}
+
+bool AsyncWebGraphBuilder::MergeDuplicate(ParseTask& task)
+{
+	if (!m_dedup.exactDuplicates && !m_dedup.nearDuplicateDistance && !m_dedup.useCanonicalLinks)
+	{
+		return false;
+	}
+
+	Site& site = *task.site;
+	WebPageNode& page = *task.page;
+
+	WebPageNode* canonical{ nullptr };
+	if (m_dedup.useCanonicalLinks)
+	{
+		std::string decoded;
+		const std::string_view link{ DecodeAttributeValue(FindCanonicalLink(task.data), task.charset, decoded) };
+
+		BaseUrl base;
+		Url url;
+		if (!link.empty() && ParseBaseUrl(GetNodeUrl(page), base) && NormalizeUrl(link, base, url) &&
+			InDomain(url, site.rootHost))
+		{
+			canonical = FindPage(site, url);
+			if (!canonical)
+			{
+				canonical = AddPage(site, url);
+			}
+		}
+	}
+
+	if (!canonical && m_dedup.exactDuplicates)
+	{
+		const auto it = site.contentHashes.find(task.contentHash);
+		canonical = it != site.contentHashes.end() ? it->second : nullptr;
+	}
+
+	if (!canonical && m_dedup.nearDuplicateDistance && task.simHash)
+	{
+		canonical = site.simHashes.Find(task.simHash, m_dedup.nearDuplicateDistance);
+	}
+
+	// The root stays whatever it is a copy of
+	if (canonical && canonical != &page && &page != GetRoot(*site.graph))
+	{
+		MergePage(site, page, *canonical);
+		m_metrics->pagesDeduplicated.Add();
+		return true;
+	}
+
+	// Only the pages kept in the graph are fingerprinted, so the canonical pages are never merged later
+	if (m_dedup.exactDuplicates)
+	{
+		site.contentHashes.emplace(task.contentHash, &page);
+	}
+
+	if (m_dedup.nearDuplicateDistance && task.simHash)
+	{
+		site.simHashes.Add(task.simHash, &page);
+	}
+
+	return false;
+}
+
+void AsyncWebGraphBuilder::MergePage(Site& site, WebPageNode& page, WebPageNode& canonical)
+{
+	WebGraph& graph = *site.graph;
+
+	// The page is not parsed, so it has inbound links only
+	const std::vector<std::pair<const WebPageNode*, NodeLinkNum>> links{
+		GetInboundNodeLinks(page).begin(), GetInboundNodeLinks(page).end() };
+	const Url url{ GetNodeUrl(page) };
+
+	if (m_sink)
+	{
+		m_sink->OnNodeMerged(site.id, GetNodeId(page), GetNodeId(canonical));
+	}
+
+	DeleteNode(graph, page);
+
+	for (const auto& link : links)
+	{
+		WebPageNode& from = *GetNode(graph, GetNodeUrl(*link.first));
+		for (NodeLinkNum i{ 0 }; i < link.second; ++i)
+		{
+			AddLink(graph, canonical, from);
+		}
+	}
+
+	site.aliases.emplace(MakeAliasKey(url), GetNodeUrl(canonical));
+}
+
+WebPageNode* AsyncWebGraphBuilder::FindPage(const Site& site, const Url& url) const
+{
+	WebPageNode* node{ GetNode(*site.graph, url) };
+	if (node || site.aliases.empty())
+	{
+		return node;
+	}
+
+	// The page a url was merged into may have been merged later too
+	for (auto alias = site.aliases.find(Url{ MakeAliasKey(url) }); alias != site.aliases.end() && !node;
+		alias = site.aliases.find(Url{ MakeAliasKey(alias->second) }))
+	{
+		node = GetNode(*site.graph, alias->second);
+	}
+
+	return node;
+}
+
+// New page found by the parse thread, null if robots.txt disallows it
+WebPageNode* AsyncWebGraphBuilder::AddPage(Site& site, const Url& url)
+{
+	if (!IsAllowed(site, url))
+	{
+		m_metrics->pagesDisallowed.Add();
+		return nullptr;
+	}
+
+	WebPageNode& node = AddSiteNode(site, url);
+	if (IsOwned(url))
+	{
+		PushPage(site, &node);
+	}
+	else
+	{
+		// Kept as a link target, the owner downloads it
+		m_partition.onForeignUrl(url);
+	}
+
+	return &node;
+}
+
+WebPageNode& AsyncWebGraphBuilder::AddSiteNode(Site& site, const Url& url)
+{
+	WebPageNode& node = AddNode(*site.graph, url);
+	m_metrics->nodesAdded.Add();
+
+	if (m_sink)
+	{
+		m_sink->OnNodeAdded(site.id, GetNodeId(node), GetNodeUrl(node));
+	}
+
+	return node;
+}
+
+bool AsyncWebGraphBuilder::IsAllowed(const Site& site, const Url& url) const noexcept
+{
+	return !m_preCrawl.useRobotsTxt || site.robots.IsAllowed(GetUrlPath(url));
+}
+
+bool AsyncWebGraphBuilder::IsOwned(const Url& url) const
+{
+	return !m_partition.isOwned || m_partition.isOwned(url);
+}
+
+static metrics::Clock::rep GetCrawlDelayTicks(std::chrono::milliseconds crawlDelay) noexcept
+{
+	return std::chrono::duration_cast<metrics::Clock::duration>(std::min(crawlDelay, RobotsRules::MaxCrawlDelay)).count();
+}
+
+// Next free download slot of the site, slots are the crawl delay apart for all the downloaders
+metrics::Clock::time_point AsyncWebGraphBuilder::ReserveDownloadSlot(Site& site)
+{
+	const metrics::Clock::time_point now{ metrics::Clock::now() };
+	if (!site.crawlDelay.count())
+	{
+		return now;
+	}
+
+	const metrics::Clock::rep delay{ GetCrawlDelayTicks(site.crawlDelay) };
+	const metrics::Clock::rep nowTicks{ now.time_since_epoch().count() };
+
+	metrics::Clock::rep slot{ site.nextDownloadTime.load() };
+	while (!site.nextDownloadTime.compare_exchange_weak(slot, std::max(slot, nowTicks) + delay))
+	{
+	}
+
+	return metrics::Clock::time_point{ metrics::Clock::duration{ std::max(slot, nowTicks) } };
+}
+
+// Takes the download slot of the site only if it is free by now, otherwise returns the time it is free at
+bool AsyncWebGraphBuilder::TryReserveDownloadSlot(
+	Site& site,
+	metrics::Clock::time_point now,
+	metrics::Clock::time_point& nextSlotTime)
+{
+	const metrics::Clock::rep nowTicks{ now.time_since_epoch().count() };
+
+	metrics::Clock::rep slot{ site.nextDownloadTime.load() };
+	do
+	{
+		if (slot > nowTicks)
+		{
+			nextSlotTime = metrics::Clock::time_point{ metrics::Clock::duration{ slot } };
+			return false;
+		}
+	}
+	while (!site.nextDownloadTime.compare_exchange_weak(slot, nowTicks + GetCrawlDelayTicks(site.crawlDelay)));
+
+	return true;
+}
+
+// Takes the download slot of the site for the page or, if the slot is not free yet, leaves the page
+// to wait in the site behind its other delayed pages. False if the page was left
+bool AsyncWebGraphBuilder::TakeDownloadSlot(const PageTask& task)
+{
+	Site& site = *task.site;
+	if (!site.crawlDelay.count())
+	{
+		return true;
+	}
+
+	std::lock_guard<std::mutex> l{ m_delayMutex };
+	metrics::Clock::time_point nextSlotTime;
+	if (!site.delayedPages.empty())
+	{
+		site.delayedPages.push_back(task.page);
+	}
+	else if (TryReserveDownloadSlot(site, metrics::Clock::now(), nextSlotTime))
+	{
+		return true;
+	}
+	else
+	{
+		site.delayedPages.push_back(task.page);
+		m_delayedSites.emplace(nextSlotTime, &site);
+	}
+
+	++m_delayedPages;
+	return false;
+}
+
+// Delayed page of the site whose download slot is the first to come if the slot is free by now, the slot
+// is taken for it. Otherwise returns the time of that slot, the max time if no page is delayed
+bool AsyncWebGraphBuilder::PopDelayedPage(PageTask& task, metrics::Clock::time_point& nextSlotTime)
+{
+	nextSlotTime = metrics::Clock::time_point::max();
+	if (!m_delayedPages)
+	{
+		return false;
+	}
+
+	const metrics::Clock::time_point now{ metrics::Clock::now() };
+
+	std::lock_guard<std::mutex> l{ m_delayMutex };
+	while (!m_delayedSites.empty() && m_delayedSites.begin()->first <= now)
+	{
+		Site& site = *m_delayedSites.begin()->second;
+		m_delayedSites.erase(m_delayedSites.begin());
+
+		metrics::Clock::time_point siteSlotTime;
+		if (!TryReserveDownloadSlot(site, now, siteSlotTime))
+		{
+			m_delayedSites.emplace(siteSlotTime, &site);
+			continue;
+		}
+
+		task = { &site, site.delayedPages.front() };
+		site.delayedPages.pop_front();
+		--m_delayedPages;
+		if (!site.delayedPages.empty())
+		{
+			m_delayedSites.emplace(metrics::Clock::time_point{ metrics::Clock::duration{ site.nextDownloadTime.load() } },
+				&site);
+		}
+
+		return true;
+	}
+
+	if (!m_delayedSites.empty())
+	{
+		nextSlotTime = m_delayedSites.begin()->first;
+	}
+
+	return false;
+}
+
+bool AsyncWebGraphBuilder::WaitForCrawlDelay(Site& site)
+{
+	if (!site.crawlDelay.count())
+	{
+		return true;
+	}
+
+	const metrics::Clock::time_point slotTime{ ReserveDownloadSlot(site) };
+
+	std::unique_lock<std::mutex> l{ m_idleMutex };
+	return !m_workCv.wait_until(l, slotTime, [this] { return m_needsToStop.load(); });
+}
+
+bool AsyncWebGraphBuilder::DownloadPreCrawlFile(
+	network::IWebPageDownloader& downloader,
+	Site& site,
+	const Url& url,
+	size_t threadIndex,
+	std::string& data)
+{
+	if (!WaitForCrawlDelay(site))
+	{
+		return false;
+	}
+
+	const auto downloadStart = metrics::Clock::now();
+	try
+	{
+		network::WebPageDownloadResult res = downloader.DownloadPage(url);
+		if (m_trace)
+		{
+			m_trace->Record(threadIndex, "pre-crawl download", downloadStart, url);
+		}
+
+		if (res.error.empty())
+		{
+			m_metrics->bytesDownloaded.Add(res.data.size());
+			data = std::move(res.data);
+			return true;
+		}
+
+		m_metrics->RecordError(ToErrorCategory(res.errorType));
+		std::cerr << "Failed to download " << url << ": " << res.error << '\n';
+	}
+	catch (const std::exception& e)
+	{
+		m_metrics->RecordError(metrics::ErrorCategory::Other);
+		std::cerr << "Failed to download " << url << ": " << e.what() << '\n';
+	}
+
+	return false;
+}
+
+void AsyncWebGraphBuilder::PreCrawl(Site& site, size_t workerIndex)
+{
+	// Runs on a download thread while nothing else of the site is queued,
+	// so the rules and the delay are published to others by the queues
+	network::IWebPageDownloader& downloader = *m_workers[workerIndex]->downloader;
+
+	BaseUrl rootBase;
+	ParseBaseUrl(site.rootUrl, rootBase);
+	const Url siteUrl{ Url{ rootBase.scheme } + "://" + Url{ rootBase.host } };
+
+	ParseTask parseTask;
+	parseTask.site = &site;
+
+	std::vector<Url> sitemaps;
+
+	// Also fetched for the Sitemap lines only
+	std::string document;
+	if ((m_preCrawl.useRobotsTxt || m_preCrawl.useSitemaps) &&
+		DownloadPreCrawlFile(downloader, site, siteUrl + "/robots.txt", workerIndex, document))
+	{
+		RobotsRules robots{ RobotsRules::Parse(document, m_preCrawl.userAgent) };
+		sitemaps = robots.GetSitemaps();
+
+		if (m_preCrawl.useRobotsTxt)
+		{
+			site.robots = std::move(robots);
+			site.crawlDelay = site.robots.GetCrawlDelay();
+		}
+	}
+
+	if (m_preCrawl.useSitemaps && sitemaps.empty())
+	{
+		sitemaps.push_back(siteUrl + "/sitemap.xml");
+	}
+
+	std::unordered_set<Url> knownSitemaps{ sitemaps.begin(), sitemaps.end() };
+	size_t seedsBytes{ 0 };
+
+	// Indexes append their sitemaps to the list
+	for (size_t i{ 0 }; m_preCrawl.useSitemaps && i < sitemaps.size() && i < m_preCrawl.maxSitemaps && !m_needsToStop; ++i)
+	{
+		if (!DownloadPreCrawlFile(downloader, site, sitemaps[i], workerIndex, document))
+		{
+			continue;
+		}
+
+		const auto parseStart = metrics::Clock::now();
+		try
+		{
+			ParseSitemap(
+				document,
+				[&](std::string_view loc)
+				{
+					parseTask.seeds.emplace_back(loc);
+					seedsBytes += loc.size();
+				},
+				[&](std::string_view loc)
+				{
+					if (knownSitemaps.emplace(loc).second)
+					{
+						sitemaps.emplace_back(loc);
+					}
+				});
+		}
+		catch (const std::exception& e)
+		{
+			m_metrics->RecordError(metrics::ErrorCategory::Parse);
+			std::cerr << "Failed to parse sitemap " << sitemaps[i] << ": " << e.what() << '\n';
+		}
+
+		if (m_trace)
+		{
+			m_trace->Record(workerIndex, "sitemap", parseStart, sitemaps[i]);
+		}
+	}
+
+	// The parse thread queues the root and the seeds
+	common::QueueLevel level;
+	metrics::Clock::duration blockedTime{ 0 };
+	if (!m_pagesToParse.Push(std::move(parseTask), seedsBytes, level, blockedTime))
+	{
+		PageDone(site);
+	}
+}
+
+void AsyncWebGraphBuilder::ApplyPreCrawl(Site& site, const std::vector<std::string>& seeds)
+{
+	WebPageNode& root = *GetRoot(*site.graph);
+	if (!IsOwned(GetNodeUrl(root)))
+	{
+		// Another crawler downloads the root
+	}
+	else if (IsAllowed(site, GetNodeUrl(root)))
+	{
+		PushPage(site, &root);
+	}
+	else
+	{
+		m_metrics->pagesDisallowed.Add();
+	}
+
+	BaseUrl rootBase;
+	ParseBaseUrl(site.rootUrl, rootBase);
+
+	for (const std::string& seed : seeds)
+	{
+		SeedPage(site, seed, rootBase);
+	}
+
+	site.preCrawlApplied = true;
+	ApplyExternalPages(site, site.earlyPages);
+	site.earlyPages = {};
+}
+
+void AsyncWebGraphBuilder::ApplyExternalPages(Site& site, std::vector<std::string>& urls)
+{
+	if (!site.preCrawlApplied)
+	{
+		site.earlyPages.insert(site.earlyPages.end(),
+			std::make_move_iterator(urls.begin()), std::make_move_iterator(urls.end()));
+		return;
+	}
+
+	for (const std::string& url : urls)
+	{
+		if (FindPage(site, url))
+		{
+			continue;
+		}
+
+		if (!IsAllowed(site, url))
+		{
+			m_metrics->pagesDisallowed.Add();
+			continue;
+		}
+
+		PushPage(site, &AddSiteNode(site, url));
+	}
+}
+
+void AsyncWebGraphBuilder::SeedPage(Site& site, std::string_view link, const BaseUrl& rootBase)
+{
+	Url url;
+	// Seeds of other partitions are queued by their owners from the same sitemaps
+	if (!NormalizeUrl(link, rootBase, url) || !InDomain(url, site.rootHost) || FindPage(site, url) ||
+		!IsOwned(url))
+	{
+		return;
+	}
+
+	if (!IsAllowed(site, url))
+	{
+		m_metrics->pagesDisallowed.Add();
+		return;
+	}
+
+	m_metrics->sitemapUrls.Add();
+	PushPage(site, &AddSiteNode(site, url));
+}
+
+void AsyncWebGraphBuilder::StatsCycle()
+{
+	metrics::MetricsSnapshot previous{ m_metrics->Snapshot() };
+
+	std::unique_lock<std::mutex> l{ m_statsMutex };
+	while (!m_statsCv.wait_for(l, m_statsInterval, [this] { return !m_running || m_needsToStop; }))
+	{
+		metrics::MetricsSnapshot current{ m_metrics->Snapshot() };
+		*m_statsOut << metrics::FormatStatsLine(current, previous) << std::endl;
+		previous = current;
+	}
+
+	*m_statsOut << metrics::FormatStatsLine(m_metrics->Snapshot(), previous) << std::endl;
 }
 
 }
\ No newline at end of file
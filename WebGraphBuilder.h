@@ -1,61 +1,277 @@
 #pragma once
 
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
 #include <thread>
-#include <queue>
 #include <mutex>
 #include <atomic>
 #include <future>
+#include <functional>
+#include <chrono>
+#include <ostream>
 #include <condition_variable>
 
 #include "WebGraph.h"
+#include "GraphSink.h"
+#include "RobotsTxt.h"
+#include "ContentHash.h"
+#include "UrlNormalizer.h"
+#include "LinkExtractor.h"
+#include "TextDecoding.h"
+#include "BoundedQueue.h"
+#include "SpillStore.h"
+#include "CrawlMetrics.h"
+#include "CrawlTrace.h"
 #include "IWebPageDownloader.h"
 
-#ifdef DEBUG
-	#include <fstream>
-#endif // DEBUG
-
 namespace web_graph
 {
 
+// Stage run for every site before its crawl starts
+struct PreCrawlSettings
+{
+	// Fetch robots.txt, skip disallowed links before they enter the frontier and honour Crawl-delay
+	bool useRobotsTxt{ false };
+	// Seed the frontier with the pages of the sitemaps listed in robots.txt, /sitemap.xml if there are none
+	bool useSitemaps{ false };
+	// Product token the robots.txt groups are matched against
+	std::string userAgent{ "libcurl-agent" };
+	// Max sitemap files fetched, sitemap indexes included
+	size_t maxSitemaps{ 1000 };
+};
+
+// Pages with the same content are kept as a single node, links to the others point to it
+struct DedupSettings
+{
+	// Same body up to the last byte
+	bool exactDuplicates{ false };
+	// Max SimHash distance of the text, up to SimHashIndex::MaxDistance, 0 turns the check off
+	uint32_t nearDuplicateDistance{ 0 };
+	// Pages with <link rel="canonical"> to another url are merged into that url
+	bool useCanonicalLinks{ false };
+};
+
+// Share of a site crawled by this builder when the site is split between several crawlers
+struct CrawlPartition
+{
+	// Whether the page is downloaded by this crawler, the others only become link targets
+	std::function<bool(const Url& url)> isOwned;
+	// Called from the parse thread once for every new link target owned by another crawler
+	std::function<void(const Url& url)> onForeignUrl;
+};
+
+// Crawls one or many sites with a shared pool of downloaders and a single parse thread,
+// every site gets its own graph
 class AsyncWebGraphBuilder
 {
 public:
+	static constexpr size_t DefaultParseQueuePages{ 1024 };
+	static constexpr size_t DefaultParseQueueBytes{ 256 * 1024 * 1024 };
+	static constexpr size_t DefaultMaxActiveSites{ 64 };
+
+	// Called from a crawl thread as soon as the site is completed, the graph is null if the root url is invalid
+	using SiteCompletedCallback = std::function<void(const Url& rootUrl, std::unique_ptr<WebGraph> graph)>;
+
 	AsyncWebGraphBuilder(const network::IWebPageDownloaderFactory& factory, size_t maxThreads);
 	~AsyncWebGraphBuilder();
 
 	bool SetProxy(const network::ProxySettings& proxySettings);
 
+	// Periodic stats line printed while the crawl is running, zero interval disables it
+	bool SetStatsOutput(std::ostream* out, std::chrono::seconds interval);
+	// Chrome trace of the crawl written on Stop(), empty path disables it
+	bool SetTraceFile(const std::string& filePath);
+	// Capacity of the queue of downloaded pages waiting to be parsed,
+	// downloaders block while it is full
+	bool SetParseQueueCapacity(size_t maxPages, size_t maxBytes);
+	bool SetPreCrawlSettings(const PreCrawlSettings& settings);
+	bool SetDedupSettings(const DedupSettings& settings);
+	// Keeps the bodies of the downloaded pages waiting for parse within the budget, the rest waits in
+	// sequential files of the directory. The frontier and the graphs stay in memory. Zero budget turns it off
+	bool SetMemoryBudget(size_t bytes, const std::string& spillDir);
+	// Receives the changes of the graphs as they are made, e.g. to stream them to disk. Null turns it off
+	bool SetGraphSink(IGraphSink* sink);
+	// Finds the links of the downloaded pages, null restores HtmlLinkExtractor with the default settings
+	bool SetLinkExtractor(std::unique_ptr<ILinkExtractor> extractor);
+	// Downloads kept in flight by every download thread with the async downloaders of the factory,
+	// the thread polls them instead of blocking on one page. Zero downloads a page at a time.
+	// Throws if the factory has no async downloaders
+	bool SetTransfersPerThread(size_t transfers);
+	// Max sites crawled at the same time in a batch, the rest wait for their turn
+	bool SetMaxActiveSites(size_t maxSites);
+	// Crawls only a share of the site passed to Start(). Such a crawl never completes on its own,
+	// other crawlers may still pass pages with AddPages() until Finish() is called. An empty partition turns it off
+	bool SetPartition(CrawlPartition partition);
+
+	// The future fails with std::logic_error if Stop() is called before the site is completed
 	std::future<std::unique_ptr<WebGraph>> Start(const Url& rootUrl);
+	// The future is ready once every site is completed. Sites still crawled on Stop()
+	// are passed to the callback with the pages found so far
+	std::future<void> StartBatch(const std::vector<Url>& rootUrls, SiteCompletedCallback onSiteCompleted);
 	bool IsRunning() const noexcept;
 	void Stop();
 
+	// Queues pages of a partitioned crawl found by other crawlers, the urls are normalized.
+	// Safe to call from any thread, blocks while the parse queue is full
+	void AddPages(std::vector<Url> urls);
+	// Nothing of a partitioned crawl is queued or processed
+	bool IsIdle() const;
+	// Completes a partitioned crawl once everything queued is processed
+	void Finish();
+
+	metrics::MetricsSnapshot GetMetrics() const;
+
 private:
-	void DownloadCycle();
-	void ParseCycle();
-	bool CanDownloadNextPage() noexcept;
-	void UpdateGraphCompleted() noexcept;
+	struct Site;
+
+	// Page to download, a task without a page runs the pre-crawl stage of the site
+	struct PageTask
+	{
+		Site* site;
+		WebPageNode* page;
+	};
+
+	// Downloaded page or pre-crawl result waiting for the parse thread
+	struct ParseTask
+	{
+		Site* site{ nullptr };
+		WebPageNode* page{ nullptr };
+		std::string data;
+		// Raw <loc> values of the sitemaps of a pre-crawl result or urls passed by other crawlers
+		std::vector<std::string> seeds;
+		bool external{ false };
+		// Fingerprints of the page computed by the downloader when deduplication is on
+		ContentHash contentHash;
+		uint64_t simHash{ 0 };
+		// Detected by the downloader, the links are converted from it to UTF-8
+		Charset charset{ Charset::Utf8 };
+		// The page data is on disk
+		bool spilled{ false };
+		common::SpillStore::Location spillLocation;
+	};
+
+	// Download in flight on the async downloader of a worker. The worker keeps them,
+	// so their pages are still done if the downloader fails and drops them
+	struct Transfer
+	{
+		PageTask task;
+		metrics::Clock::time_point start;
+	};
+
+	using Transfers = std::list<Transfer>;
+
+	// Every download thread owns a downloader and a deque of pages to download.
+	// The owner takes pages from the front, idle workers steal from the back
+	struct Worker
+	{
+		std::unique_ptr<network::IWebPageDownloader> downloader;
+		// Null if the factory has no async downloaders
+		std::unique_ptr<network::IAsyncWebPageDownloader> asyncDownloader;
+		std::mutex pagesMutex;
+		std::deque<PageTask> pages;
+	};
+
+	std::future<void> StartSites(const std::vector<Url>& rootUrls, SiteCompletedCallback onSiteCompleted, bool singleSite);
+	void DownloadCycle(size_t workerIndex);
+	void TransferCycle(size_t workerIndex);
+	void StartTransfer(network::IAsyncWebPageDownloader& downloader, const PageTask& task, size_t workerIndex,
+		Transfers& transfers);
+	void CompleteTransfer(const Transfer& transfer, size_t workerIndex, network::WebPageDownloadResult& result);
+	bool QueueParse(const PageTask& task, network::WebPageDownloadResult& result);
+	void ParseCycle(size_t threadIndex);
+	void StatsCycle();
+	void ParsePage(ParseTask& task, size_t threadIndex);
+	bool MergeDuplicate(ParseTask& task);
+	void MergePage(Site& site, WebPageNode& page, WebPageNode& canonical);
+	WebPageNode* FindPage(const Site& site, const Url& url) const;
+	WebPageNode* AddPage(Site& site, const Url& url);
+	WebPageNode& AddSiteNode(Site& site, const Url& url);
+	void PushPage(Site& site, WebPageNode* page);
+	bool PopPage(size_t workerIndex, PageTask& task);
+	bool TakeDownloadSlot(const PageTask& task);
+	bool PopDelayedPage(PageTask& task, metrics::Clock::time_point& nextSlotTime);
+	void WaitForPages(metrics::Clock::time_point until = metrics::Clock::time_point::max());
+	void PageDone(Site& site);
+	void ActivateNextSite();
+	void CompleteSite(Site& site);
+	void NotifyAll();
+	std::unique_lock<std::mutex> LockPages(Worker& worker);
+	void RecordDownload(const network::WebPageDownloadResult& result) noexcept;
+	void PreCrawl(Site& site, size_t workerIndex);
+	void ApplyPreCrawl(Site& site, const std::vector<std::string>& seeds);
+	void SeedPage(Site& site, std::string_view link, const BaseUrl& rootBase);
+	void ApplyExternalPages(Site& site, std::vector<std::string>& urls);
+	bool DownloadPreCrawlFile(
+		network::IWebPageDownloader& downloader, Site& site, const Url& url, size_t threadIndex, std::string& data);
+	bool IsAllowed(const Site& site, const Url& url) const noexcept;
+	bool IsOwned(const Url& url) const;
+	metrics::Clock::time_point ReserveDownloadSlot(Site& site);
+	bool TryReserveDownloadSlot(Site& site, metrics::Clock::time_point now, metrics::Clock::time_point& nextSlotTime);
+	bool WaitForCrawlDelay(Site& site);
 
 private:
-	std::unique_ptr<WebGraph> m_graph;
-	std::queue<WebPageNode*> m_pagesToDownload;
-	std::queue<std::pair<WebPageNode*, std::string>> m_pagesToParse;
-	std::list<std::unique_ptr<network::IWebPageDownloader>> m_freeDownloaders;
+	common::BoundedQueue<ParseTask> m_pagesToParse{ DefaultParseQueuePages, DefaultParseQueueBytes };
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	// Zero if the workers run the blocking downloaders
+	size_t m_transfersPerThread{ 0 };
+	std::atomic<size_t> m_nextWorker{ 0 };
+	// Pages waiting in the worker deques
+	std::atomic<size_t> m_queuedPages{ 0 };
+	std::atomic<size_t> m_idleWorkers{ 0 };
+	std::mutex m_idleMutex;
+	std::condition_variable m_workCv;
 
 	std::list<std::thread> m_threads;
 	std::atomic_bool m_running{ false };
 	std::atomic_bool m_needsToStop{ false };
 	std::atomic_bool m_graphCompleted{ false };
 
-	std::string m_rootUrl;
+	// Sites being crawled and those waiting for their turn
+	std::mutex m_sitesMutex;
+	std::list<std::unique_ptr<Site>> m_activeSites;
+	std::deque<Url> m_pendingSites;
+	size_t m_maxActiveSites{ DefaultMaxActiveSites };
+	SiteCompletedCallback m_onSiteCompleted;
+	uint32_t m_nextSiteId{ 0 };
+	std::promise<void> m_batchPromise;
 	std::promise<std::unique_ptr<WebGraph>> m_promise;
+	// Started by Start(), so a site not completed on Stop() fails the promise instead of passing a partial graph
+	bool m_singleSite{ false };
 
 	mutable std::mutex m_urlMutex;
-	std::condition_variable m_downloadCv;
-	std::condition_variable m_parseCv;
 
-#ifdef DEBUG
-	std::ofstream m_outFile;
-#endif // DEBUG
+	PreCrawlSettings m_preCrawl;
+	DedupSettings m_dedup;
+	IGraphSink* m_sink{ nullptr };
+	std::unique_ptr<ILinkExtractor> m_linkExtractor{ std::make_unique<HtmlLinkExtractor>() };
+
+	// Sites with pages waiting for the crawl delay by the time of their next download slot. The pages wait
+	// in their site instead of in a download thread, so the threads go on with the pages of other sites
+	std::mutex m_delayMutex;
+	std::multimap<metrics::Clock::time_point, Site*> m_delayedSites;
+	std::atomic<size_t> m_delayedPages{ 0 };
+
+	// Memory budget mode, the downloaded pages over the budget wait for the parse thread on disk
+	size_t m_memoryBudget{ 0 };
+	std::string m_spillDir;
+	std::unique_ptr<common::SpillStore> m_pageSpill;
+
+	// The partitioned site holds an extra in-flight page until Finish()
+	CrawlPartition m_partition;
+	mutable std::mutex m_partitionMutex;
+	Site* m_partitionSite{ nullptr };
+	bool m_partitionFinished{ false };
+
+	std::unique_ptr<metrics::CrawlMetrics> m_metrics{ std::make_unique<metrics::CrawlMetrics>() };
+	std::unique_ptr<metrics::TraceRecorder> m_trace;
+	std::string m_traceFile;
+	std::ostream* m_statsOut{ nullptr };
+	std::chrono::seconds m_statsInterval{ 0 };
+	std::mutex m_statsMutex;
+	std::condition_variable m_statsCv;
 };
 
-}// web_graph
\ No newline at end of file
+}// web_graph
@@ -0,0 +1,374 @@
+// Compares the memory per link and the decode throughput of the adjacency layouts on a synthetic power-law web:
+// the hash maps of WebGraph, packed 32-bit ids with counts and the gap encoded varints of CompressedGraph.
+// The metrics of Analyze are computed on both graphs and should match.
+// Then the compressed graph is relabeled in every node order and timed on PageRank, BFS and Analyze,
+// a random order stands for the scattered ids of a hash map walk
+// Usage: ./AdjacencyBenchmark [--pages=N] [--seed=N] [--exponent=X] [--iterations=N]
+
+#include <chrono>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "MockWeb.h"
+#include "Analyze.h"
+#include "NodeOrder.h"
+#include "CompressedGraph.h"
+
+struct BenchmarkSettings
+{
+	mock_web::MockWebSettings web;
+	size_t iterations{ 5 };
+};
+
+// Links of the nodes as sorted 32-bit ids with counts, the layout a plain CSR graph would have
+struct PackedAdjacency
+{
+	std::vector<uint64_t> offsets{ 0 };
+	std::vector<uint32_t> nodes;
+	std::vector<uint32_t> counts;
+
+	size_t GetMemoryBytes() const noexcept
+	{
+		return offsets.capacity() * sizeof(uint64_t) + (nodes.capacity() + counts.capacity()) * sizeof(uint32_t);
+	}
+};
+
+BenchmarkSettings ParseArgs(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.web.pagesNum = 200000;
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(0, valuePos) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "--pages") settings.web.pagesNum = std::stoul(value);
+		else if (name == "--seed") settings.web.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (name == "--exponent") settings.web.powerLawExponent = std::stod(value);
+		else if (name == "--iterations") settings.iterations = std::stoul(value);
+		else throw std::invalid_argument{ "Unknown argument: " + arg };
+	}
+
+	return settings;
+}
+
+// Resident memory of the process, the only way to see what the hash maps take
+size_t GetResidentBytes()
+{
+	std::ifstream status{ "/proc/self/status" };
+	std::string line;
+	while (std::getline(status, line))
+	{
+		if (line.compare(0, 6, "VmRSS:") == 0)
+		{
+			return std::stoul(line.substr(6)) * 1024;
+		}
+	}
+
+	return 0;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+web_graph::WebGraph MakeGraph(const mock_web::MockWeb& web)
+{
+	using namespace web_graph;
+
+	const size_t pagesNum{ web.GetSettings().pagesNum };
+
+	WebGraph graph{ CreateWebGraph() };
+	std::vector<WebPageNode*> nodes(pagesNum);
+	for (size_t page{ 0 }; page < pagesNum; ++page)
+	{
+		nodes[page] = &AddNode(graph, "http://mock.web" + mock_web::MockWeb::MakePagePath(page));
+	}
+
+	for (size_t page{ 0 }; page < pagesNum; ++page)
+	{
+		for (uint32_t target : web.GetPageLinks(page))
+		{
+			AddLink(graph, *nodes[target], *nodes[page]);
+		}
+	}
+
+	return graph;
+}
+
+PackedAdjacency MakePackedAdjacency(const web_graph::CompressedGraph& graph)
+{
+	PackedAdjacency adjacency;
+	for (web_graph::NodeId node{ 0 }; node < graph.GetNodesNum(); ++node)
+	{
+		for (const auto& link : graph.GetOutboundLinks(node))
+		{
+			adjacency.nodes.push_back(link.node);
+			adjacency.counts.push_back(static_cast<uint32_t>(link.count));
+		}
+
+		adjacency.offsets.push_back(adjacency.nodes.size());
+	}
+
+	adjacency.nodes.shrink_to_fit();
+	adjacency.counts.shrink_to_fit();
+	return adjacency;
+}
+
+// Every pass visits all the outbound links, the checksum keeps the loops from being optimized out
+template<typename Pass>
+void ReportDecode(const char* name, size_t linksNum, size_t iterations, Pass&& pass)
+{
+	uint64_t checksum{ 0 };
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i{ 0 }; i < iterations; ++i)
+	{
+		checksum += pass();
+	}
+
+	const double seconds{ SecondsSince(start) };
+	std::printf("%-12s %12.1f %16llx\n", name, linksNum * iterations / seconds / 1e6,
+		static_cast<unsigned long long>(checksum));
+}
+
+// Pull iterations, every node reads the shares of its inbound neighbours. Returns the rank of the node 0
+double RunPageRank(const web_graph::CompressedGraph& graph, size_t iterations)
+{
+	using namespace web_graph;
+
+	constexpr double Damping{ 0.85 };
+	const size_t nodesNum{ graph.GetNodesNum() };
+
+	std::vector<double> outLinks(nodesNum, 0.0);
+	for (NodeId node{ 0 }; node < nodesNum; ++node)
+	{
+		for (const auto& link : graph.GetOutboundLinks(node))
+		{
+			outLinks[node] += link.count;
+		}
+	}
+
+	std::vector<double> ranks(nodesNum, 1.0 / nodesNum);
+	std::vector<double> shares(nodesNum);
+	for (size_t i{ 0 }; i < iterations; ++i)
+	{
+		for (NodeId node{ 0 }; node < nodesNum; ++node)
+		{
+			shares[node] = outLinks[node] > 0 ? ranks[node] / outLinks[node] : 0.0;
+		}
+
+		for (NodeId node{ 0 }; node < nodesNum; ++node)
+		{
+			double sum{ 0.0 };
+			for (const auto& link : graph.GetInboundLinks(node))
+			{
+				sum += shares[link.node] * link.count;
+			}
+
+			ranks[node] = (1.0 - Damping) / nodesNum + Damping * sum;
+		}
+	}
+
+	return nodesNum > 0 ? ranks[0] : 0.0;
+}
+
+// Outbound breadth-first walk, returns the sum of the distances
+uint64_t RunBfs(const web_graph::CompressedGraph& graph, web_graph::NodeId start)
+{
+	std::vector<uint32_t> distances(graph.GetNodesNum(), UINT32_MAX);
+	std::vector<web_graph::NodeId> queue{ start };
+	distances[start] = 0;
+
+	uint64_t sum{ 0 };
+	for (size_t next{ 0 }; next < queue.size(); ++next)
+	{
+		const web_graph::NodeId node{ queue[next] };
+		sum += distances[node];
+		for (const auto& link : graph.GetOutboundLinks(node))
+		{
+			if (distances[link.node] == UINT32_MAX)
+			{
+				distances[link.node] = distances[node] + 1;
+				queue.push_back(link.node);
+			}
+		}
+	}
+
+	return sum;
+}
+
+// Relabels the graph and times the kernels on it. The root is found by its source id,
+// the results should not depend on the order
+void ReportOrder(const char* name, const web_graph::CompressedGraph& graph, const std::vector<web_graph::NodeId>& order,
+	double orderSeconds, web_graph::NodeId rootSourceId, size_t iterations)
+{
+	using namespace web_graph;
+
+	auto start = std::chrono::steady_clock::now();
+	const CompressedGraph relabeled{ graph.Relabel(order) };
+	const double relabelSeconds{ orderSeconds + SecondsSince(start) };
+
+	NodeId root{ 0 };
+	while (relabeled.GetSourceId(root) != rootSourceId)
+	{
+		++root;
+	}
+
+	start = std::chrono::steady_clock::now();
+	RunPageRank(relabeled, iterations);
+	const double pageRankSeconds{ SecondsSince(start) };
+
+	start = std::chrono::steady_clock::now();
+	const uint64_t distances{ RunBfs(relabeled, root) };
+	const double bfsSeconds{ SecondsSince(start) };
+
+	start = std::chrono::steady_clock::now();
+	const analyze::GraphAnalysisResult result{ analyze::Analyze(relabeled) };
+	const double analyzeSeconds{ SecondsSince(start) };
+
+	std::printf("%-12s %10.2f %9.3fs %9.3fs %9.3fs %9.3fs %12llu %12.8f\n", name,
+		static_cast<double>(relabeled.GetMemoryBytes()) / relabeled.GetLinksNum(), relabelSeconds,
+		pageRankSeconds, bfsSeconds, analyzeSeconds, static_cast<unsigned long long>(distances),
+		result.clusteringCoeff);
+}
+
+void PrintAnalysis(const char* name, const analyze::GraphAnalysisResult& result, double seconds)
+{
+	std::printf("%-12s %10.3fs %12.8f %12.10f %12.8f %10zu %10zu %10zu\n", name, seconds,
+		result.edgesIndex, result.linksIndex, result.clusteringCoeff,
+		result.inductorNum, result.collectorsNum, result.mediatorsNum);
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		using namespace web_graph;
+
+		const BenchmarkSettings settings{ ParseArgs(argc, argv) };
+		const mock_web::MockWeb web{ settings.web };
+
+		const size_t residentBefore{ GetResidentBytes() };
+		auto start = std::chrono::steady_clock::now();
+		const WebGraph graph{ MakeGraph(web) };
+		const double graphSeconds{ SecondsSince(start) };
+		const size_t graphBytes{ GetResidentBytes() - residentBefore };
+
+		start = std::chrono::steady_clock::now();
+		const CompressedGraph compressed{ GraphView{ graph } };
+		const double compressSeconds{ SecondsSince(start) };
+
+		const PackedAdjacency packed{ MakePackedAdjacency(compressed) };
+		const size_t linksNum{ GetLinksNum(graph) };
+
+		std::cout << "mock web: " << settings.web.pagesNum << " pages, " << linksNum << " links, "
+			<< packed.nodes.size() << " distinct, seed " << settings.web.seed << "\n\n";
+
+		std::printf("%-12s %12s %14s %10s\n", "layout", "MB", "bytes/link", "build");
+		std::printf("%-12s %12.2f %14.2f %9.3fs   (resident, both directions)\n", "hash maps",
+			graphBytes / (1024.0 * 1024.0), static_cast<double>(graphBytes) / linksNum, graphSeconds);
+		std::printf("%-12s %12.2f %14.2f %10s   (outbound only)\n", "packed",
+			packed.GetMemoryBytes() / (1024.0 * 1024.0), static_cast<double>(packed.GetMemoryBytes()) / linksNum, "");
+		std::printf("%-12s %12.2f %14.2f %9.3fs   (both directions)\n", "compressed",
+			compressed.GetMemoryBytes() / (1024.0 * 1024.0), static_cast<double>(compressed.GetMemoryBytes()) / linksNum,
+			compressSeconds);
+
+		std::printf("\n%-12s %12s %16s\n", "decode", "Mlinks/s", "checksum");
+		ReportDecode("hash maps", linksNum, settings.iterations, [&]
+		{
+			uint64_t sum{ 0 };
+			for (const auto& node : GetNodes(graph))
+			{
+				for (const auto& linkInfo : GetOutboundNodeLinks(*node.second))
+				{
+					sum += GetNodeId(*linkInfo.first) * linkInfo.second;
+				}
+			}
+
+			return sum;
+		});
+
+		ReportDecode("packed", linksNum, settings.iterations, [&]
+		{
+			uint64_t sum{ 0 };
+			for (size_t node{ 0 }; node + 1 < packed.offsets.size(); ++node)
+			{
+				for (uint64_t i{ packed.offsets[node] }; i < packed.offsets[node + 1]; ++i)
+				{
+					sum += static_cast<uint64_t>(packed.nodes[i]) * packed.counts[i];
+				}
+			}
+
+			return sum;
+		});
+
+		ReportDecode("compressed", linksNum, settings.iterations, [&]
+		{
+			uint64_t sum{ 0 };
+			for (NodeId node{ 0 }; node < compressed.GetNodesNum(); ++node)
+			{
+				for (const auto& link : compressed.GetOutboundLinks(node))
+				{
+					sum += static_cast<uint64_t>(link.node) * link.count;
+				}
+			}
+
+			return sum;
+		});
+
+		std::printf("\n%-12s %11s %12s %12s %12s %10s %10s %10s\n",
+			"analyze", "seconds", "edges", "links", "clustering", "inductors", "collectors", "mediators");
+
+		start = std::chrono::steady_clock::now();
+		const analyze::GraphAnalysisResult graphResult{ analyze::Analyze(graph) };
+		PrintAnalysis("hash maps", graphResult, SecondsSince(start));
+
+		start = std::chrono::steady_clock::now();
+		const analyze::GraphAnalysisResult compressedResult{ analyze::Analyze(compressed) };
+		PrintAnalysis("compressed", compressedResult, SecondsSince(start));
+
+		std::printf("\n%-12s %10s %10s %10s %10s %10s %12s %12s\n", "node order", "bytes/link", "relabel",
+			"pagerank", "bfs", "analyze", "distances", "clustering");
+
+		const NodeId rootSourceId{ GetNodeId(*GetRoot(graph)) };
+		std::vector<NodeId> order(compressed.GetNodesNum());
+		std::iota(order.begin(), order.end(), 0);
+		ReportOrder("ids", compressed, order, 0.0, rootSourceId, settings.iterations);
+
+		std::shuffle(order.begin(), order.end(), std::mt19937{ settings.web.seed });
+		ReportOrder("random", compressed, order, 0.0, rootSourceId, settings.iterations);
+
+		// The other orders start from the random one, so they owe nothing to the ids being in crawl order
+		const CompressedGraph shuffled{ compressed.Relabel(order) };
+		const NodeId root{ static_cast<NodeId>(std::find(order.begin(), order.end(), rootSourceId) - order.begin()) };
+		const std::pair<const char*, NodeOrder> nodeOrders[]{
+			{ "bfs", NodeOrder::Bfs },
+			{ "degree", NodeOrder::Degree },
+			{ "rcm", NodeOrder::ReverseCuthillMcKee } };
+
+		for (const auto& nodeOrder : nodeOrders)
+		{
+			start = std::chrono::steady_clock::now();
+			order = MakeNodeOrder(shuffled, nodeOrder.second, root);
+			ReportOrder(nodeOrder.first, shuffled, order, SecondsSince(start), rootSourceId, settings.iterations);
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
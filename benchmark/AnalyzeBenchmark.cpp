@@ -0,0 +1,145 @@
+// Time of Analyze on a synthetic power-law web: the separate metrics, each walking the graph on its own,
+// against the one pass kernel of every combination of the analysis options. Both run on the whole graph
+// and on a view with a share of the nodes deleted, the separate metrics should match the default options
+// Usage: ./AnalyzeBenchmark [--pages=N] [--seed=N] [--exponent=X] [--deletion=X] [--iterations=N]
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+
+#include "MockWeb.h"
+#include "Analyze.h"
+#include "Common.h"
+
+struct BenchmarkSettings
+{
+	mock_web::MockWebSettings web;
+	double deletionChance{ 0.3 };
+	size_t iterations{ 5 };
+};
+
+BenchmarkSettings ParseArgs(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.web.pagesNum = 500000;
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(0, valuePos) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "--pages") settings.web.pagesNum = std::stoul(value);
+		else if (name == "--seed") settings.web.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (name == "--exponent") settings.web.powerLawExponent = std::stod(value);
+		else if (name == "--deletion") settings.deletionChance = std::stod(value);
+		else if (name == "--iterations") settings.iterations = std::stoul(value);
+		else throw std::invalid_argument{ "Unknown argument: " + arg };
+	}
+
+	return settings;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+web_graph::WebGraph MakeGraph(const mock_web::MockWeb& web)
+{
+	using namespace web_graph;
+
+	const size_t pagesNum{ web.GetSettings().pagesNum };
+
+	std::vector<Url> urls;
+	urls.reserve(pagesNum);
+	std::vector<IndexedLink> links;
+	links.reserve(web.GetLinksNum());
+	for (size_t page{ 0 }; page < pagesNum; ++page)
+	{
+		urls.push_back("http://mock.web" + mock_web::MockWeb::MakePagePath(page));
+		for (uint32_t target : web.GetPageLinks(page))
+		{
+			links.push_back({ static_cast<NodeId>(page), target });
+		}
+	}
+
+	return BuildWebGraph(std::move(urls), std::move(links), 1);
+}
+
+// The former Analyze
+analyze::GraphAnalysisResult AnalyzeSeparately(const web_graph::GraphView& view)
+{
+	analyze::GraphAnalysisResult result{};
+	result.linksIndex = analyze::CalcLinksIndex(view);
+	result.edgesIndex = analyze::CalcEdgesIndex(view);
+	result.clusteringCoeff = analyze::CalcClusteringCoeff(view);
+	analyze::GetNodesTypesNum(view, result.inductorNum, result.collectorsNum, result.mediatorsNum);
+
+	return result;
+}
+
+// Best time of the iterations
+void Report(const char* name, size_t iterations, const std::function<analyze::GraphAnalysisResult()>& analyze)
+{
+	analyze::GraphAnalysisResult result{};
+	double seconds{ 0.0 };
+	for (size_t i{ 0 }; i < iterations; ++i)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		result = analyze();
+		const double iterationSeconds{ SecondsSince(start) };
+		seconds = i ? std::min(seconds, iterationSeconds) : iterationSeconds;
+	}
+
+	std::printf("%-24s %9.3fs %12.8f %14.10f %12.8f", name, seconds,
+		result.edgesIndex, result.linksIndex, result.clusteringCoeff);
+	// Undirected nodes have no types
+	if (result.options.directed)
+	{
+		std::printf(" %10zu %10zu %10zu\n", result.inductorNum, result.collectorsNum, result.mediatorsNum);
+	}
+	else
+	{
+		std::printf(" %10s %10s %10s\n", "-", "-", "-");
+	}
+}
+
+void ReportView(const char* name, const web_graph::GraphView& view, size_t iterations)
+{
+	std::cout << name << ": " << view.GetNodesNum() << " pages, " << view.GetLinksNum() << " links\n";
+	std::printf("%-24s %10s %12s %14s %12s %10s %10s %10s\n", "analyze", "time", "edges", "links", "clustering",
+		"inductors", "collectors", "mediators");
+
+	Report("separate metrics", iterations, [&] { return AnalyzeSeparately(view); });
+	Report("weighted directed", iterations, [&] { return analyze::Analyze(view, { true, true }); });
+	Report("weighted undirected", iterations, [&] { return analyze::Analyze(view, { true, false }); });
+	Report("unweighted directed", iterations, [&] { return analyze::Analyze(view, { false, true }); });
+	Report("unweighted undirected", iterations, [&] { return analyze::Analyze(view, { false, false }); });
+	std::cout << '\n';
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		const BenchmarkSettings settings{ ParseArgs(argc, argv) };
+		const mock_web::MockWeb web{ settings.web };
+		const web_graph::WebGraph graph{ MakeGraph(web) };
+
+		ReportView("whole graph", common::MakeActiveView(graph), settings.iterations);
+		ReportView("deleted nodes", analyze::SimulateNodesDeletion(graph, settings.deletionChance), settings.iterations);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
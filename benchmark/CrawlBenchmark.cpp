@@ -0,0 +1,289 @@
+// Drives AsyncWebGraphBuilder against a synthetic power-law web and reports
+// throughput and scaling across thread counts.
+// Usage: ./CrawlBenchmark [--pages=N] [--threads=1,2,4,...] [--seed=N] [--latency-us=N]
+//        [--bandwidth=bytes_per_sec] [--error-rate=0..1] [--padding=bytes] [--http]
+//        [--parse-queue-pages=N] [--parse-queue-bytes=N] [--sites=N] [--memory-budget=bytes] [--edge-log]
+//        [--transfers=N]
+// With --sites every thread count is also run crawling N copies of the web one by one
+// and as a single batch sharing the downloaders. With --memory-budget the downloaded pages waiting
+// for parse over the budget are spilled to the temp directory and the spilled amounts are reported.
+// With --edge-log the graph is streamed to a log in the temp directory and converted to graphml after the crawl.
+// With --transfers every thread keeps N downloads in flight on the async downloader instead of one
+
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+#include <filesystem>
+
+#include "MockWeb.h"
+#include "LocalHttpServer.h"
+#include "EdgeLog.h"
+#include "WebGraphBuilder.h"
+#include "CurlWebPageDownloader.h"
+
+struct BenchmarkSettings
+{
+	mock_web::MockWebSettings web;
+	std::vector<size_t> threads{ 1, 2, 4, 8, 16, 32 };
+	bool useHttp{ false };
+	size_t parseQueuePages{ web_graph::AsyncWebGraphBuilder::DefaultParseQueuePages };
+	size_t parseQueueBytes{ web_graph::AsyncWebGraphBuilder::DefaultParseQueueBytes };
+	size_t sitesNum{ 0 };
+	size_t memoryBudget{ 0 };
+	bool useEdgeLog{ false };
+	size_t transfersPerThread{ 0 };
+};
+
+struct RunResult
+{
+	double seconds{ 0.0 };
+	size_t nodesNum{ 0 };
+	size_t linksNum{ 0 };
+	uint64_t edgeLogBytes{ 0 };
+	double graphmlSeconds{ 0.0 };
+	metrics::MetricsSnapshot metrics;
+};
+
+std::vector<size_t> ParseList(const std::string& value)
+{
+	std::vector<size_t> result;
+	std::stringstream stream{ value };
+	std::string item;
+	while (std::getline(stream, item, ','))
+	{
+		result.push_back(std::stoul(item));
+	}
+
+	return result;
+}
+
+BenchmarkSettings ParseArgs(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.web.pagesNum = 2000;
+	settings.web.latency = std::chrono::microseconds{ 2000 };
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(0, valuePos) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "--pages") settings.web.pagesNum = std::stoul(value);
+		else if (name == "--threads") settings.threads = ParseList(value);
+		else if (name == "--seed") settings.web.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (name == "--latency-us") settings.web.latency = std::chrono::microseconds{ std::stol(value) };
+		else if (name == "--bandwidth") settings.web.bandwidth = std::stoul(value);
+		else if (name == "--error-rate") settings.web.errorRate = std::stod(value);
+		else if (name == "--padding") settings.web.paddingBytes = std::stoul(value);
+		else if (name == "--exponent") settings.web.powerLawExponent = std::stod(value);
+		else if (name == "--http") settings.useHttp = true;
+		else if (name == "--parse-queue-pages") settings.parseQueuePages = std::stoul(value);
+		else if (name == "--parse-queue-bytes") settings.parseQueueBytes = std::stoul(value);
+		else if (name == "--sites") settings.sitesNum = std::stoul(value);
+		else if (name == "--memory-budget") settings.memoryBudget = std::stoul(value);
+		else if (name == "--edge-log") settings.useEdgeLog = true;
+		else if (name == "--transfers") settings.transfersPerThread = std::stoul(value);
+		else throw std::invalid_argument{ "Unknown argument: " + arg };
+	}
+
+	return settings;
+}
+
+RunResult Run(
+	const network::IWebPageDownloaderFactory& factory,
+	const BenchmarkSettings& settings,
+	size_t threadsNum,
+	const std::string& rootUrl)
+{
+	const std::filesystem::path tempDir{ std::filesystem::temp_directory_path() };
+	const std::string edgeLogPath{ (tempDir / "crawl-benchmark.edgelog").string() };
+	std::unique_ptr<edge_log::EdgeLogWriter> edgeLog{ settings.useEdgeLog ?
+		std::make_unique<edge_log::EdgeLogWriter>(edgeLogPath) : nullptr };
+
+	web_graph::AsyncWebGraphBuilder builder{ factory, threadsNum };
+	builder.SetParseQueueCapacity(settings.parseQueuePages, settings.parseQueueBytes);
+	builder.SetMemoryBudget(settings.memoryBudget, (tempDir / "crawl-benchmark-spill").string());
+	builder.SetGraphSink(edgeLog.get());
+	builder.SetTransfersPerThread(settings.transfersPerThread);
+
+	auto start = std::chrono::steady_clock::now();
+	auto graph = builder.Start(rootUrl).get();
+
+	RunResult result;
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	result.nodesNum = web_graph::GetNodesNum(*graph);
+	result.linksNum = web_graph::GetLinksNum(*graph);
+
+	builder.Stop();
+	result.metrics = builder.GetMetrics();
+
+	if (edgeLog)
+	{
+		graph.reset();
+		edgeLog->Close();
+		result.edgeLogBytes = edgeLog->GetBytesWritten();
+
+		const std::string graphmlPath{ (tempDir / "crawl-benchmark.graphml").string() };
+		start = std::chrono::steady_clock::now();
+		edge_log::ConvertToGraphml(edgeLogPath, graphmlPath);
+		result.graphmlSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::filesystem::remove(edgeLogPath);
+		std::filesystem::remove(graphmlPath);
+	}
+
+	return result;
+}
+
+std::vector<std::string> MakeSiteUrls(const std::string& rootUrl, size_t sitesNum)
+{
+	// Mock pages link by absolute paths, so every host serves its own copy of the web
+	std::vector<std::string> urls;
+	const size_t hostPos{ rootUrl.find("://") + 3 };
+	for (size_t i{ 0 }; i < sitesNum; ++i)
+	{
+		std::string url{ rootUrl };
+		if (url.compare(hostPos, 9, "127.0.0.1") != 0)
+		{
+			url.insert(hostPos, "site" + std::to_string(i) + ".");
+		}
+
+		urls.push_back(url);
+	}
+
+	return urls;
+}
+
+// Seconds to crawl all the sites one after another and as a batch
+std::pair<double, double> RunSites(
+	const network::IWebPageDownloaderFactory& factory,
+	const BenchmarkSettings& settings,
+	size_t threadsNum,
+	const std::string& rootUrl)
+{
+	const std::vector<std::string> urls{ MakeSiteUrls(rootUrl, settings.sitesNum) };
+
+	auto start = std::chrono::steady_clock::now();
+	for (const std::string& url : urls)
+	{
+		web_graph::AsyncWebGraphBuilder builder{ factory, threadsNum };
+		builder.SetTransfersPerThread(settings.transfersPerThread);
+		builder.Start(url).get();
+		builder.Stop();
+	}
+
+	const double sequential{ std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+
+	start = std::chrono::steady_clock::now();
+	web_graph::AsyncWebGraphBuilder builder{ factory, threadsNum };
+	builder.SetMaxActiveSites(urls.size());
+	builder.SetTransfersPerThread(settings.transfersPerThread);
+	builder.StartBatch(urls, [](const std::string&, std::unique_ptr<web_graph::WebGraph>) {}).get();
+	builder.Stop();
+
+	return { sequential, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() };
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		const BenchmarkSettings settings{ ParseArgs(argc, argv) };
+		const mock_web::MockWeb web{ settings.web };
+
+		std::unique_ptr<mock_web::LocalHttpServer> server;
+		std::unique_ptr<network::IWebPageDownloaderFactory> factory;
+		std::string rootUrl;
+
+		if (settings.useHttp)
+		{
+			server = std::make_unique<mock_web::LocalHttpServer>(web);
+			factory = std::make_unique<network::CurlWebDownloaderFactory>();
+			rootUrl = server->GetRootUrl();
+		}
+		else
+		{
+			factory = std::make_unique<mock_web::MockWebPageDownloaderFactory>(web);
+			rootUrl = "http://mock.web";
+		}
+
+		std::cout
+			<< "mock web: " << settings.web.pagesNum << " pages, " << web.GetLinksNum() << " links, seed "
+			<< settings.web.seed << ", latency " << settings.web.latency.count() << "us, bandwidth "
+			<< settings.web.bandwidth << "B/s, error rate " << settings.web.errorRate
+			<< ", " << std::max<size_t>(settings.transfersPerThread, 1) << " transfers per thread"
+			<< (settings.useHttp ? ", curl over local http\n" : ", in-process downloader\n");
+
+		std::printf("%8s %8s %10s %8s %10s %10s %10s %8s %8s %10s %10s\n",
+			"threads", "nodes", "links", "errors", "seconds", "pages/s", "MB/s", "speedup", "effic.", "lock p99",
+			"pq max");
+
+		double baseRate{ 0.0 };
+		for (size_t threadsNum : settings.threads)
+		{
+			const RunResult result{ Run(*factory, settings, threadsNum, rootUrl) };
+			const double rate{ result.metrics.pagesDownloaded / result.seconds };
+			if (baseRate == 0.0)
+			{
+				baseRate = rate / threadsNum;
+			}
+
+			const metrics::HistogramSnapshot& lockWait =
+				result.metrics.stages[static_cast<size_t>(metrics::Stage::LockWait)];
+
+			std::printf("%8zu %8zu %10zu %8llu %10.3f %10.1f %10.2f %8.2f %8.2f %8lluns %10llu\n",
+				threadsNum,
+				result.nodesNum,
+				result.linksNum,
+				static_cast<unsigned long long>(result.metrics.ErrorsNum()),
+				result.seconds,
+				rate,
+				result.metrics.bytesDownloaded / result.seconds / (1024 * 1024),
+				rate / (baseRate * settings.threads.front()),
+				rate / (baseRate * threadsNum),
+				static_cast<unsigned long long>(lockWait.PercentileNs(0.99)),
+				static_cast<unsigned long long>(result.metrics.parseQueueDepthMax));
+
+			if (settings.memoryBudget)
+			{
+				std::printf("%8s spilled %llu pages, %.2fMB\n", "",
+					static_cast<unsigned long long>(result.metrics.pagesSpilled),
+					result.metrics.bytesSpilled / (1024.0 * 1024.0));
+			}
+
+			if (settings.useEdgeLog)
+			{
+				std::printf("%8s edge log %.2fMB, %.2f bytes per link, graphml written from it in %.3fs\n", "",
+					result.edgeLogBytes / (1024.0 * 1024.0),
+					result.linksNum ? static_cast<double>(result.edgeLogBytes) / result.linksNum : 0.0,
+					result.graphmlSeconds);
+			}
+		}
+
+		if (settings.sitesNum)
+		{
+			std::printf("\n%zu sites\n%8s %12s %12s %8s\n", settings.sitesNum, "threads", "one by one", "batch", "speedup");
+			for (size_t threadsNum : settings.threads)
+			{
+				const auto seconds = RunSites(*factory, settings, threadsNum, rootUrl);
+				std::printf("%8zu %11.3fs %11.3fs %8.2f\n",
+					threadsNum, seconds.first, seconds.second, seconds.first / seconds.second);
+			}
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
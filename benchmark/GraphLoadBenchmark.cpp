@@ -0,0 +1,185 @@
+// Time to load a graphml file of a synthetic power-law web into WebGraph: adding the nodes and the links
+// one by one as the file is read, against the bulk construction on every number of threads up to the given one.
+// Reading the file without parsing it, from the page cache as it is just written, is the floor for the loads.
+// The loaded graphs should have the same checksum
+// Usage: ./GraphLoadBenchmark [--pages=N] [--seed=N] [--threads=N] [--file=path]
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <functional>
+
+#include "MockWeb.h"
+#include "GraphmlSerialization.h"
+
+struct BenchmarkSettings
+{
+	mock_web::MockWebSettings web;
+	size_t threadsNum{ 4 };
+	std::string filePath{ "GraphLoadBenchmark.graphml" };
+};
+
+BenchmarkSettings ParseArgs(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+	settings.web.pagesNum = 500000;
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(0, valuePos) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "--pages") settings.web.pagesNum = std::stoul(value);
+		else if (name == "--seed") settings.web.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (name == "--threads") settings.threadsNum = std::stoul(value);
+		else if (name == "--file") settings.filePath = value;
+		else throw std::invalid_argument{ "Unknown argument: " + arg };
+	}
+
+	return settings;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void WriteGraph(const mock_web::MockWeb& web, const std::string& filePath)
+{
+	const std::string host{ "http://mock.web" };
+	graphml::Writer writer{ filePath };
+	for (size_t page{ 0 }; page < web.GetSettings().pagesNum; ++page)
+	{
+		writer.WriteNode(host + mock_web::MockWeb::MakePagePath(page));
+	}
+
+	for (size_t page{ 0 }; page < web.GetSettings().pagesNum; ++page)
+	{
+		const std::string source{ host + mock_web::MockWeb::MakePagePath(page) };
+		for (uint32_t target : web.GetPageLinks(page))
+		{
+			writer.WriteEdge(source, host + mock_web::MockWeb::MakePagePath(target));
+		}
+	}
+
+	writer.Close();
+}
+
+// The former Deserialize: every edge looks up both urls and increments both link maps
+std::unique_ptr<web_graph::WebGraph> LoadOneByOne(const std::string& filePath)
+{
+	using namespace web_graph;
+
+	std::unique_ptr<WebGraph> graph;
+	graphml::Read(filePath,
+		[&graph](std::string_view url)
+		{
+			if (graph)
+			{
+				AddNode(*graph, Url{ url });
+			}
+			else
+			{
+				graph = std::make_unique<WebGraph>(CreateWebGraph(Url{ url }));
+			}
+		},
+		[&graph](std::string_view fromUrl, std::string_view toUrl)
+		{
+			AddLink(*graph, *GetNode(*graph, toUrl), *GetNode(*graph, fromUrl));
+		});
+
+	return graph;
+}
+
+// Does not depend on the node ids or the iteration order, throws if the inbound links don't match the outbound ones
+size_t GetChecksum(const web_graph::WebGraph& graph)
+{
+	using namespace web_graph;
+
+	const std::hash<std::string> hash;
+	auto getLinkHash = [&hash](const WebPageNode& source, const WebPageNode& target, NodeLinkNum count)
+	{
+		return (hash(GetNodeUrl(source)) ^ (hash(GetNodeUrl(target)) * 31)) * count;
+	};
+
+	size_t outboundChecksum{ 0 };
+	size_t inboundChecksum{ 0 };
+	for (const auto& node : GetNodes(graph))
+	{
+		for (const auto& link : GetOutboundNodeLinks(*node.second))
+		{
+			outboundChecksum += getLinkHash(*node.second, *link.first, link.second);
+		}
+
+		for (const auto& link : GetInboundNodeLinks(*node.second))
+		{
+			inboundChecksum += getLinkHash(*link.first, *node.second, link.second);
+		}
+	}
+
+	if (inboundChecksum != outboundChecksum)
+	{
+		throw std::runtime_error{ "Inbound links don't match the outbound ones" };
+	}
+
+	return outboundChecksum + hash(GetNodeUrl(*GetRoot(graph)));
+}
+
+void Report(const char* name, size_t threadsNum, const std::function<std::unique_ptr<web_graph::WebGraph>()>& load)
+{
+	const auto start = std::chrono::steady_clock::now();
+	const std::unique_ptr<web_graph::WebGraph> graph{ load() };
+	const double seconds{ SecondsSince(start) };
+
+	std::printf("%-12s %8zu %9.3fs %12.1f %10zu %12zu %18zx\n", name, threadsNum, seconds,
+		static_cast<double>(GetLinksNum(*graph)) / seconds / 1e6, GetNodesNum(*graph), GetLinksNum(*graph),
+		GetChecksum(*graph));
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		const BenchmarkSettings settings{ ParseArgs(argc, argv) };
+
+		const mock_web::MockWeb web{ settings.web };
+		WriteGraph(web, settings.filePath);
+
+		auto start = std::chrono::steady_clock::now();
+		std::ifstream file{ settings.filePath, std::ios::binary };
+		std::vector<char> buffer(16 * 1024 * 1024);
+		size_t fileBytes{ 0 };
+		while (file.read(buffer.data(), buffer.size()) || file.gcount())
+		{
+			fileBytes += static_cast<size_t>(file.gcount());
+		}
+
+		const double readSeconds{ SecondsSince(start) };
+		std::cout << "graphml: " << settings.web.pagesNum << " pages, " << web.GetLinksNum() << " links, "
+			<< fileBytes / (1024 * 1024) << " MB, read in " << readSeconds << " s, "
+			<< fileBytes / readSeconds / (1024 * 1024) << " MB/s\n\n";
+
+		std::printf("%-12s %8s %10s %12s %10s %12s %18s\n", "load", "threads", "time", "Mlinks/s", "nodes", "links", "checksum");
+		Report("one by one", 1, [&] { return LoadOneByOne(settings.filePath); });
+		for (size_t threadsNum{ 1 }; threadsNum <= settings.threadsNum; threadsNum *= 2)
+		{
+			Report("bulk", threadsNum, [&] { return graphml::Deserialize(settings.filePath, threadsNum); });
+		}
+
+		std::remove(settings.filePath.c_str());
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
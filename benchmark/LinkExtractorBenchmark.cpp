@@ -0,0 +1,230 @@
+// Throughput of the link extraction on synthetic pages with the markup of a typical site:
+// scripts, styled blocks, images and text around the links. Compares the former <a href> regex
+// with HtmlLinkExtractor at every scan level the cpu supports, then adds the charset detection,
+// the decoding and the normalization of the links
+// Usage: ./LinkExtractorBenchmark [--pages=N] [--links=N] [--seed=N] [--iterations=N]
+
+#include <regex>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <iterator>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "LinkExtractor.h"
+#include "TextDecoding.h"
+#include "UrlNormalizer.h"
+
+struct BenchmarkSettings
+{
+	size_t pagesNum{ 2000 };
+	// Mean links per page
+	size_t linksNum{ 120 };
+	uint32_t seed{ 1 };
+	size_t iterations{ 5 };
+};
+
+BenchmarkSettings ParseArgs(int argc, char** argv)
+{
+	BenchmarkSettings settings;
+
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(0, valuePos) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "--pages") settings.pagesNum = std::stoul(value);
+		else if (name == "--links") settings.linksNum = std::stoul(value);
+		else if (name == "--seed") settings.seed = static_cast<uint32_t>(std::stoul(value));
+		else if (name == "--iterations") settings.iterations = std::stoul(value);
+		else throw std::invalid_argument{ "Unknown argument: " + arg };
+	}
+
+	return settings;
+}
+
+std::string MakePage(std::mt19937& random, size_t linksNum)
+{
+	static const char* const words[]{ "graph", "crawler", "index", "the", "of", "page", "network", "a", "link",
+		"structure", "site", "with", "search", "engine", "archive", "news", "about", "contact", "and", "results" };
+	std::uniform_int_distribution<size_t> word{ 0, std::size(words) - 1 };
+	std::uniform_int_distribution<size_t> percent{ 0, 99 };
+
+	auto appendText = [&](std::string& html, size_t wordsNum)
+	{
+		for (size_t i{ 0 }; i < wordsNum; ++i)
+		{
+			html += words[word(random)];
+			html += ' ';
+		}
+	};
+
+	std::string html{ "<!DOCTYPE html>\n<html lang=\"en\"><head><meta charset=\"utf-8\">\n<title>" };
+	appendText(html, 6);
+	html += "</title>\n<link rel=\"stylesheet\" href=\"/static/site.css?v=3\">\n"
+		"<link rel=\"next\" href=\"/news/page/2\">\n"
+		"<script>window.dataLayer = window.dataLayer || []; if (a < b && c > d) { track('view'); }</script>\n"
+		"<style>.nav > li { display: inline-block; } .card:hover { color: #333; }</style>\n"
+		"</head>\n<body class=\"home\">\n<div id=\"top\" class=\"container\"><ul class=\"nav\">\n";
+
+	for (size_t i{ 0 }; i < linksNum; ++i)
+	{
+		const size_t kind{ percent(random) };
+		const std::string path{ "/" + std::string{ words[word(random)] } + "/" + std::to_string(random() % 100000) };
+
+		if (kind < 70)
+		{
+			html += "<li class=\"item\"><a class=\"link\" title=\"";
+			appendText(html, 3);
+			html += "\" href=\"" + path + "\">";
+			appendText(html, 2);
+			html += "</a></li>\n";
+		}
+		else if (kind < 85)
+		{
+			html += "<div class=\"card\"><img src=\"/img" + path + ".jpg\" alt=\"\" width=\"120\" height=\"80\"><p>";
+			appendText(html, 30);
+			html += "<a href=\"" + path + "\">more</a></p></div>\n";
+		}
+		else if (kind < 92)
+		{
+			html += "<p><span>";
+			appendText(html, 60);
+			html += "</span><a href='" + path + "' rel=\"nofollow\">";
+			appendText(html, 1);
+			html += "</a></p>\n";
+		}
+		else if (kind < 96)
+		{
+			html += "<map name=\"m\"><area shape=\"rect\" coords=\"0,0,10,10\" href=\"" + path + "\"></map>\n";
+		}
+		else if (kind < 98)
+		{
+			html += "<iframe src=\"" + path + "\" width=\"300\" height=\"200\"></iframe>\n";
+		}
+		else
+		{
+			html += "<!-- <a href=\"" + path + "\">old</a> -->\n";
+		}
+	}
+
+	html += "</ul></div>\n<footer><p>";
+	appendText(html, 40);
+	html += "</p></footer>\n<script src=\"/static/app.js\" async></script>\n</body></html>\n";
+	return html;
+}
+
+double SecondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Every pass goes over all the pages and returns the links found
+template<typename Pass>
+void Report(const char* name, size_t bytesNum, size_t iterations, Pass&& pass)
+{
+	size_t linksNum{ 0 };
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t i{ 0 }; i < iterations; ++i)
+	{
+		linksNum = pass();
+	}
+
+	const double seconds{ SecondsSince(start) };
+	std::printf("%-24s %10.3f %12zu\n", name, bytesNum * iterations / seconds / 1e9, linksNum);
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		using namespace web_graph;
+
+		const BenchmarkSettings settings{ ParseArgs(argc, argv) };
+
+		std::mt19937 random{ settings.seed };
+		std::uniform_int_distribution<size_t> linksNum{ settings.linksNum / 2, settings.linksNum * 3 / 2 };
+
+		std::vector<std::string> pages(settings.pagesNum);
+		size_t bytesNum{ 0 };
+		for (std::string& page : pages)
+		{
+			page = MakePage(random, linksNum(random));
+			bytesNum += page.size();
+		}
+
+		std::cout << "pages: " << pages.size() << ", " << bytesNum / (1024 * 1024) << " MB, cpu supports "
+			<< ToString(GetSupportedScanLevel()) << "\n\n";
+		std::printf("%-24s %10s %12s\n", "extractor", "GB/s", "links");
+
+		Report("regex <a href>", bytesNum, 1, [&]
+		{
+			static const std::regex hl_regex{ "<a href=\"(.*?)\"", std::regex_constants::icase };
+
+			size_t found{ 0 };
+			for (const std::string& page : pages)
+			{
+				found += std::distance(std::sregex_iterator{ page.begin(), page.end(), hl_regex }, std::sregex_iterator{});
+			}
+
+			return found;
+		});
+
+		PageLinks pageLinks;
+		for (ScanLevel level : { ScanLevel::Scalar, ScanLevel::Sse42, ScanLevel::Avx2 })
+		{
+			if (level > GetSupportedScanLevel())
+			{
+				continue;
+			}
+
+			const HtmlLinkExtractor extractor{ {}, level };
+			Report(ToString(level), bytesNum, settings.iterations, [&]
+			{
+				size_t found{ 0 };
+				for (const std::string& page : pages)
+				{
+					extractor.Extract(page, pageLinks);
+					found += pageLinks.links.size();
+				}
+
+				return found;
+			});
+		}
+
+		// What the parse thread does for every page
+		const HtmlLinkExtractor extractor;
+		BaseUrl base;
+		ParseBaseUrl("http://example.com/news/index.html", base);
+		std::string decoded;
+		std::string url;
+
+		Report("best + normalization", bytesNum, settings.iterations, [&]
+		{
+			size_t found{ 0 };
+			for (const std::string& page : pages)
+			{
+				const Charset charset{ DetectCharset({}, page) };
+				extractor.Extract(page, pageLinks);
+				for (std::string_view link : pageLinks.links)
+				{
+					found += NormalizeUrl(DecodeAttributeValue(link, charset, decoded), base, url);
+				}
+			}
+
+			return found;
+		});
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,173 @@
+#include "LocalHttpServer.h"
+
+#include <stdexcept>
+
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+namespace mock_web
+{
+
+bool SendAll(int socket, const char* data, size_t size) noexcept
+{
+	while (size)
+	{
+		const ssize_t sent{ send(socket, data, size, MSG_NOSIGNAL) };
+		if (sent <= 0)
+		{
+			return false;
+		}
+
+		data += sent;
+		size -= static_cast<size_t>(sent);
+	}
+
+	return true;
+}
+
+LocalHttpServer::LocalHttpServer(const MockWeb& web)
+	: m_web(web)
+{
+	m_listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+	if (m_listenSocket < 0)
+	{
+		throw std::runtime_error{ "Failed to create socket" };
+	}
+
+	int reuse{ 1 };
+	setsockopt(m_listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	address.sin_port = 0;
+
+	socklen_t addressLength{ sizeof(address) };
+	if (bind(m_listenSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(m_listenSocket, SOMAXCONN) != 0 ||
+		getsockname(m_listenSocket, reinterpret_cast<sockaddr*>(&address), &addressLength) != 0)
+	{
+		close(m_listenSocket);
+		throw std::runtime_error{ "Failed to start local http server" };
+	}
+
+	m_port = ntohs(address.sin_port);
+	m_acceptThread = std::thread{ &LocalHttpServer::AcceptCycle, this };
+}
+
+LocalHttpServer::~LocalHttpServer()
+{
+	m_needsToStop = true;
+	shutdown(m_listenSocket, SHUT_RDWR);
+	m_acceptThread.join();
+	close(m_listenSocket);
+
+	std::lock_guard<std::mutex> l{ m_connectionsMutex };
+	for (auto& connection : m_connections)
+	{
+		shutdown(connection.first, SHUT_RDWR);
+	}
+
+	for (auto& connection : m_connections)
+	{
+		connection.second.join();
+		close(connection.first);
+	}
+}
+
+uint16_t LocalHttpServer::GetPort() const noexcept
+{
+	return m_port;
+}
+
+std::string LocalHttpServer::GetRootUrl() const
+{
+	return "http://127.0.0.1:" + std::to_string(m_port);
+}
+
+void LocalHttpServer::AcceptCycle()
+{
+	while (!m_needsToStop)
+	{
+		const int connection{ accept(m_listenSocket, nullptr, nullptr) };
+		if (connection < 0)
+		{
+			continue;
+		}
+
+		int noDelay{ 1 };
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+		std::lock_guard<std::mutex> l{ m_connectionsMutex };
+		m_connections.emplace_back(connection, std::thread{ &LocalHttpServer::ServeConnection, this, connection });
+	}
+}
+
+void LocalHttpServer::ServeConnection(int socket)
+{
+	const MockWebSettings& settings = m_web.GetSettings();
+
+	std::string request;
+	char buffer[4096];
+
+	while (!m_needsToStop)
+	{
+		auto headersEnd = request.find("\r\n\r\n");
+		if (headersEnd == std::string::npos)
+		{
+			const ssize_t received{ recv(socket, buffer, sizeof(buffer), 0) };
+			if (received <= 0)
+			{
+				break;
+			}
+
+			request.append(buffer, static_cast<size_t>(received));
+			continue;
+		}
+
+		// "GET <path> HTTP/1.1"
+		const size_t pathBegin{ request.find(' ') + 1 };
+		const std::string path{ request.substr(pathBegin, request.find(' ', pathBegin) - pathBegin) };
+		request.erase(0, headersEnd + 4);
+
+		size_t pageId{ 0 };
+		const bool isPage{ path == "/" || MockWeb::ParsePageId(path, pageId) };
+
+		if (settings.latency.count())
+		{
+			std::this_thread::sleep_for(settings.latency);
+		}
+
+		if (isPage && pageId < settings.pagesNum && m_web.IsFailing(pageId))
+		{
+			break;
+		}
+
+		std::string body{ isPage && pageId < settings.pagesNum ? m_web.RenderPage(pageId) : "Not found" };
+		const char* status{ isPage && pageId < settings.pagesNum ? "200 OK" : "404 Not Found" };
+
+		if (settings.bandwidth)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds{ body.size() * 1000000 / settings.bandwidth });
+		}
+
+		std::string response{ std::string{ "HTTP/1.1 " } + status + "\r\n"
+			"Content-Type: text/html\r\n"
+			"Content-Length: " + std::to_string(body.size()) + "\r\n"
+			"Connection: keep-alive\r\n\r\n" };
+		response += body;
+
+		if (!SendAll(socket, response.data(), response.size()))
+		{
+			break;
+		}
+	}
+
+	// The descriptor is closed by the destructor, only signal the client here
+	shutdown(socket, SHUT_RDWR);
+}
+
+}// namespace mock_web
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <string>
+
+#include "MockWeb.h"
+
+namespace mock_web
+{
+
+// Minimal HTTP/1.1 server on 127.0.0.1 serving the mock web, so the real curl
+// downloader can be benchmarked. Every connection is served by its own thread.
+// Failing pages are answered by closing the connection
+class LocalHttpServer
+{
+public:
+	explicit LocalHttpServer(const MockWeb& web);
+	~LocalHttpServer();
+
+	LocalHttpServer(const LocalHttpServer&) = delete;
+	LocalHttpServer& operator=(const LocalHttpServer&) = delete;
+
+	uint16_t GetPort() const noexcept;
+	std::string GetRootUrl() const;
+
+private:
+	void AcceptCycle();
+	void ServeConnection(int socket);
+
+private:
+	const MockWeb& m_web;
+	int m_listenSocket{ -1 };
+	uint16_t m_port{ 0 };
+	std::atomic_bool m_needsToStop{ false };
+
+	std::thread m_acceptThread;
+	std::mutex m_connectionsMutex;
+	std::list<std::pair<int, std::thread>> m_connections;
+};
+
+}// namespace mock_web
@@ -0,0 +1,288 @@
+#include "MockWeb.h"
+
+#include <cmath>
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <stdexcept>
+
+namespace mock_web
+{
+
+static constexpr char PagePathPrefix[]{ "/page/" };
+
+uint64_t Mix(uint64_t value) noexcept
+{
+	// splitmix64 finalizer
+	value += 0x9e3779b97f4a7c15ull;
+	value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	value = (value ^ (value >> 27)) * 0x94d049bb133111ebull;
+	return value ^ (value >> 31);
+}
+
+std::vector<double> MakeZipfCdf(size_t num, double exponent)
+{
+	std::vector<double> cdf(num);
+	double sum{ 0.0 };
+	for (size_t i{ 0 }; i < num; ++i)
+	{
+		sum += 1.0 / std::pow(static_cast<double>(i + 1), exponent - 1.0);
+		cdf[i] = sum;
+	}
+
+	for (double& value : cdf)
+	{
+		value /= sum;
+	}
+
+	return cdf;
+}
+
+MockWeb::MockWeb(const MockWebSettings& settings)
+	: m_settings(settings)
+	, m_links(settings.pagesNum)
+{
+	if (!settings.pagesNum || settings.powerLawExponent <= 1.0 || settings.minLinks > settings.maxLinks)
+	{
+		throw std::invalid_argument{ "Invalid mock web settings" };
+	}
+
+	const std::vector<double> popularityCdf{ MakeZipfCdf(settings.pagesNum, settings.powerLawExponent) };
+
+	// Popularity rank -> page id, so popular pages are spread over the site
+	std::vector<uint32_t> rankToPage(settings.pagesNum);
+	for (uint32_t i{ 0 }; i < rankToPage.size(); ++i)
+	{
+		rankToPage[i] = i;
+	}
+
+	std::mt19937 rng{ settings.seed };
+	std::shuffle(rankToPage.begin(), rankToPage.end(), rng);
+
+	std::uniform_real_distribution<double> uniform{ 0.0, 1.0 };
+	for (size_t page{ 0 }; page < settings.pagesNum; ++page)
+	{
+		std::vector<uint32_t>& links = m_links[page];
+
+		for (size_t child{ 2 * page + 1 }; child <= 2 * page + 2 && child < settings.pagesNum; ++child)
+		{
+			links.push_back(static_cast<uint32_t>(child));
+		}
+
+		// Pareto distributed out-degree
+		const double degree{ settings.minLinks *
+			std::pow(1.0 - uniform(rng), -1.0 / (settings.powerLawExponent - 1.0)) };
+		const size_t linksNum{ std::min(static_cast<size_t>(degree), settings.maxLinks) };
+
+		for (size_t i{ 0 }; i < linksNum; ++i)
+		{
+			auto it = std::lower_bound(popularityCdf.begin(), popularityCdf.end(), uniform(rng));
+			const size_t rank{ std::min(static_cast<size_t>(it - popularityCdf.begin()), settings.pagesNum - 1) };
+			links.push_back(rankToPage[rank]);
+		}
+
+		m_linksNum += links.size();
+	}
+}
+
+const MockWebSettings& MockWeb::GetSettings() const noexcept
+{
+	return m_settings;
+}
+
+size_t MockWeb::GetLinksNum() const noexcept
+{
+	return m_linksNum;
+}
+
+const std::vector<uint32_t>& MockWeb::GetPageLinks(size_t pageId) const noexcept
+{
+	return m_links[pageId];
+}
+
+std::string MockWeb::RenderPage(size_t pageId) const
+{
+	const std::vector<uint32_t>& links = m_links.at(pageId);
+
+	std::string html;
+	html.reserve(links.size() * 40 + m_settings.paddingBytes + 128);
+	html += "<html><head><title>Page ";
+	html += std::to_string(pageId);
+	html += "</title></head><body>\n";
+
+	for (uint32_t link : links)
+	{
+		html += "<p><a href=\"";
+		html += MakePagePath(link);
+		html += "\">link</a></p>\n";
+	}
+
+	html.append(m_settings.paddingBytes, ' ');
+	html += "</body></html>\n";
+	return html;
+}
+
+bool MockWeb::IsFailing(size_t pageId) const noexcept
+{
+	// The root never fails, otherwise the crawl would be empty
+	const double value{ static_cast<double>(Mix(m_settings.seed ^ (pageId << 20)) >> 11) / (1ull << 53) };
+	return pageId && value < m_settings.errorRate;
+}
+
+bool MockWeb::ParsePageId(const std::string& url, size_t& pageId) noexcept
+{
+	auto pos = url.rfind(PagePathPrefix);
+	if (pos == std::string::npos)
+	{
+		// The root url of the site is the first page
+		pageId = 0;
+		return url.find("/", url.find("://") + 3) == std::string::npos || url.back() == '/';
+	}
+
+	pos += sizeof(PagePathPrefix) - 1;
+	if (pos == url.size())
+	{
+		return false;
+	}
+
+	pageId = 0;
+	for (; pos < url.size(); ++pos)
+	{
+		if (url[pos] < '0' || url[pos] > '9')
+		{
+			return false;
+		}
+
+		pageId = pageId * 10 + static_cast<size_t>(url[pos] - '0');
+	}
+
+	return true;
+}
+
+std::string MockWeb::MakePagePath(size_t pageId)
+{
+	return PagePathPrefix + std::to_string(pageId);
+}
+
+//
+
+MockWebPageDownloader::MockWebPageDownloader(const MockWeb& web)
+	: m_web(web)
+{
+}
+
+void MockWebPageDownloader::SetProxy(const network::ProxySettings&)
+{
+}
+
+// Result of the download and the time it takes
+static network::WebPageDownloadResult ServePage(const MockWeb& web, const std::string& url, std::chrono::microseconds& delay)
+{
+	const MockWebSettings& settings = web.GetSettings();
+	network::WebPageDownloadResult result;
+	delay = std::chrono::microseconds{ 0 };
+
+	size_t pageId;
+	if (!MockWeb::ParsePageId(url, pageId) || pageId >= settings.pagesNum)
+	{
+		result.error = "Not found";
+		result.errorType = network::DownloadErrorType::Http;
+		return result;
+	}
+
+	delay = std::chrono::duration_cast<std::chrono::microseconds>(settings.latency);
+	if (web.IsFailing(pageId))
+	{
+		result.error = "Simulated connection failure";
+		result.errorType = network::DownloadErrorType::Connect;
+		return result;
+	}
+
+	result.data = web.RenderPage(pageId);
+	if (settings.bandwidth)
+	{
+		delay += std::chrono::microseconds{ result.data.size() * 1000000 / settings.bandwidth };
+	}
+
+	return result;
+}
+
+network::WebPageDownloadResult MockWebPageDownloader::DownloadPage(const std::string& url)
+{
+	std::chrono::microseconds delay;
+	network::WebPageDownloadResult result{ ServePage(m_web, url, delay) };
+	if (delay.count())
+	{
+		std::this_thread::sleep_for(delay);
+	}
+
+	return result;
+}
+
+//
+
+MockAsyncWebPageDownloader::MockAsyncWebPageDownloader(const MockWeb& web)
+	: m_web(web)
+{
+}
+
+void MockAsyncWebPageDownloader::SetProxy(const network::ProxySettings&)
+{
+}
+
+void MockAsyncWebPageDownloader::StartDownload(const std::string& url, CompletionHandler onCompleted)
+{
+	std::chrono::microseconds delay;
+	network::WebPageDownloadResult result{ ServePage(m_web, url, delay) };
+	m_downloads.push({ std::chrono::steady_clock::now() + delay, m_nextIndex++, std::move(result), std::move(onCompleted) });
+}
+
+size_t MockAsyncWebPageDownloader::Poll(std::chrono::milliseconds timeout)
+{
+	if (m_downloads.empty())
+	{
+		return 0;
+	}
+
+	const auto deadline = std::chrono::steady_clock::now() + timeout;
+	if (m_downloads.top().completionTime > deadline)
+	{
+		std::this_thread::sleep_until(deadline);
+		return m_downloads.size();
+	}
+
+	std::this_thread::sleep_until(m_downloads.top().completionTime);
+
+	const auto now = std::chrono::steady_clock::now();
+	while (!m_downloads.empty() && m_downloads.top().completionTime <= now)
+	{
+		// The top of the queue is const, the download is taken out before the handler starts new ones
+		Download download{ std::move(const_cast<Download&>(m_downloads.top())) };
+		m_downloads.pop();
+		download.onCompleted(std::move(download.result));
+	}
+
+	return m_downloads.size();
+}
+
+void MockAsyncWebPageDownloader::CancelAll()
+{
+	m_downloads = {};
+}
+
+MockWebPageDownloaderFactory::MockWebPageDownloaderFactory(const MockWeb& web)
+	: web(web)
+{
+}
+
+std::unique_ptr<network::IWebPageDownloader> MockWebPageDownloaderFactory::Create() const
+{
+	return std::make_unique<MockWebPageDownloader>(web);
+}
+
+std::unique_ptr<network::IAsyncWebPageDownloader> MockWebPageDownloaderFactory::CreateAsync() const
+{
+	return std::make_unique<MockAsyncWebPageDownloader>(web);
+}
+
+}// namespace mock_web
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <queue>
+#include <tuple>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "IWebPageDownloader.h"
+
+namespace mock_web
+{
+
+struct MockWebSettings
+{
+	size_t pagesNum{ 10000 };
+	uint32_t seed{ 1 };
+	// Pareto exponent of the out-degree and zipf exponent of page popularity
+	double powerLawExponent{ 2.1 };
+	size_t minLinks{ 2 };
+	size_t maxLinks{ 300 };
+	size_t paddingBytes{ 2048 };
+
+	std::chrono::microseconds latency{ 0 };
+	// Bytes per second, 0 for unlimited
+	size_t bandwidth{ 0 };
+	// Share of pages which fail to download, within [0, 1]
+	double errorRate{ 0.0 };
+};
+
+// Deterministic synthetic site: page i links to its "tree children" 2i + 1 and 2i + 2,
+// so every page is reachable from the root, plus a power-law distributed number of
+// links to pages picked by zipf popularity
+class MockWeb
+{
+public:
+	explicit MockWeb(const MockWebSettings& settings);
+
+	const MockWebSettings& GetSettings() const noexcept;
+	size_t GetLinksNum() const noexcept;
+	// Targets of the links of the page in the page order, repeated ones included
+	const std::vector<uint32_t>& GetPageLinks(size_t pageId) const noexcept;
+
+	std::string RenderPage(size_t pageId) const;
+	bool IsFailing(size_t pageId) const noexcept;
+
+	// Id of the page from a ".../page/<id>" url or path, false if the url is not a page url
+	static bool ParsePageId(const std::string& url, size_t& pageId) noexcept;
+	static std::string MakePagePath(size_t pageId);
+
+private:
+	MockWebSettings m_settings;
+	std::vector<std::vector<uint32_t>> m_links;
+	size_t m_linksNum{ 0 };
+};
+
+// Serves pages from memory simulating latency, bandwidth and errors with sleeps
+class MockWebPageDownloader : public network::IWebPageDownloader
+{
+public:
+	explicit MockWebPageDownloader(const MockWeb& web);
+
+	void SetProxy(const network::ProxySettings& proxySettings) override;
+	network::WebPageDownloadResult DownloadPage(const std::string& url) override;
+
+private:
+	const MockWeb& m_web;
+};
+
+// Serves the same pages as MockWebPageDownloader completing them in Poll() once their delay passes
+class MockAsyncWebPageDownloader : public network::IAsyncWebPageDownloader
+{
+public:
+	explicit MockAsyncWebPageDownloader(const MockWeb& web);
+
+	void SetProxy(const network::ProxySettings& proxySettings) override;
+	void StartDownload(const std::string& url, CompletionHandler onCompleted) override;
+	size_t Poll(std::chrono::milliseconds timeout) override;
+	void CancelAll() override;
+
+private:
+	struct Download
+	{
+		std::chrono::steady_clock::time_point completionTime;
+		// Keeps the start order of the downloads completed at the same time
+		uint64_t index;
+		network::WebPageDownloadResult result;
+		CompletionHandler onCompleted;
+
+		bool operator>(const Download& other) const noexcept
+		{
+			return std::tie(completionTime, index) > std::tie(other.completionTime, other.index);
+		}
+	};
+
+	const MockWeb& m_web;
+	std::priority_queue<Download, std::vector<Download>, std::greater<Download>> m_downloads;
+	uint64_t m_nextIndex{ 0 };
+};
+
+struct MockWebPageDownloaderFactory : public network::IWebPageDownloaderFactory
+{
+	explicit MockWebPageDownloaderFactory(const MockWeb& web);
+	std::unique_ptr<network::IWebPageDownloader> Create() const override;
+	std::unique_ptr<network::IAsyncWebPageDownloader> CreateAsync() const override;
+
+	const MockWeb& web;
+};
+
+}// namespace mock_web
@@ -0,0 +1,203 @@
+// Compares the single pass url normalizer with the former multi-pass link pipeline
+// Usage: ./UrlNormalizerBenchmark [links_num] [iterations]
+
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+#include <algorithm>
+
+#include "UrlNormalizer.h"
+
+namespace legacy
+{
+
+// The link processing done by GetValidHyperLinks before the normalizer was introduced
+
+bool IsRootOrInvalid(const std::string& url)
+{
+	static const std::string mailPrefix{ "mailto:" };
+	auto isAlNum = [](char c) { return ('a' <= c && c <= 'z') || ('0' <= c && c <= '9'); };
+
+	return url.empty() || url == "/" || (url.front() != '/' && !isAlNum(url.front())) ||
+		url.compare(0, mailPrefix.size(), mailPrefix) == 0;
+}
+
+bool IsFile(const std::string& url)
+{
+	auto it = url.rfind('.');
+	if (it == std::string::npos)
+	{
+		return false;
+	}
+
+	std::string extension{ url.substr(it) };
+	return extension == ".jpg" || extension == ".png" || extension == ".pdf" || extension == ".css";
+}
+
+bool Process(std::string& url, const std::string& rootUrl, const std::string& strippedRootUrl)
+{
+	std::transform(url.begin(), url.end(), url.begin(), ::tolower);
+	if (IsRootOrInvalid(url) || IsFile(url))
+	{
+		return false;
+	}
+
+	if (url.front() == '/')
+	{
+		url = rootUrl + url;
+	}
+
+	if (url.compare(0, 6, "http:/") != 0 && url.compare(0, 7, "https:/") != 0)
+	{
+		return false;
+	}
+
+	auto pos = url.find(strippedRootUrl);
+	if (pos == std::string::npos || !pos || (url[pos - 1] != '.' && url[pos - 1] != '/'))
+	{
+		return false;
+	}
+
+	for (char c : { '#', ';', '&' })
+	{
+		auto delimPos = url.find(c);
+		if (delimPos != std::string::npos)
+		{
+			url.erase(delimPos);
+		}
+	}
+
+	for (char c : { '"', '\'', '&' })
+	{
+		url.erase(std::remove(url.begin(), url.end(), c), url.end());
+	}
+
+	std::string decoded;
+	for (size_t i{ 0 }; i < url.length(); ++i)
+	{
+		if (url[i] == '%')
+		{
+			int charVal;
+			sscanf(url.substr(i + 1, 2).c_str(), "%x", &charVal);
+			decoded += static_cast<char>(charVal);
+			i += 2;
+		}
+		else
+		{
+			decoded += url[i];
+		}
+	}
+
+	url = decoded;
+	return true;
+}
+
+std::string MakeKey(const std::string& url)
+{
+	std::string key{ url };
+	if (key.back() == '/')
+	{
+		key.pop_back();
+	}
+
+	return key;
+}
+
+}// namespace legacy
+
+std::vector<std::string> GenerateLinks(size_t num)
+{
+	static const std::vector<std::string> templates
+	{
+		"/catalog/section-%d/item%d.html",
+		"http://www.example.com/News/%d/Article%d?utm_source=feed&ref=%d",
+		"https://example.com/a/b/../c/%d/./page%d",
+		"//example.com/path%%20with%%20spaces/%d/%d",
+		"../relative/%d/index%d.php",
+		"/static/img/%d/banner%d.png",
+		"mailto:someone%d@example.com",
+		"/forum/topic%d.html#post%d",
+		"https://other.org/%d/%d",
+		"/Search?q=%%D0%%BF%%D1%%80%d&page=%d"
+	};
+
+	std::mt19937 rng{ 42 };
+	std::vector<std::string> links;
+	links.reserve(num);
+
+	char buffer[256];
+	for (size_t i{ 0 }; i < num; ++i)
+	{
+		const std::string& pattern = templates[rng() % templates.size()];
+		snprintf(buffer, sizeof(buffer), pattern.c_str(), rng() % 1000, rng() % 100000, rng() % 10);
+		links.emplace_back(buffer);
+	}
+
+	return links;
+}
+
+template<typename Func>
+double MeasureNsPerLink(size_t linksNum, size_t iterations, Func&& func)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i{ 0 }; i < iterations; ++i)
+	{
+		func();
+	}
+
+	std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - start };
+	return elapsed.count() / (linksNum * iterations);
+}
+
+int main(int argc, char** argv)
+{
+	const size_t linksNum{ argc > 1 ? std::stoul(argv[1]) : 100000 };
+	const size_t iterations{ argc > 2 ? std::stoul(argv[2]) : 20 };
+
+	const std::vector<std::string> links{ GenerateLinks(linksNum) };
+
+	const std::string rootUrl{ "http://example.com" };
+	const std::string pageUrl{ "http://example.com/catalog/section/page.html" };
+
+	size_t legacyAccepted{ 0 };
+	const double legacyNs{ MeasureNsPerLink(linksNum, iterations, [&]
+	{
+		legacyAccepted = 0;
+		for (const std::string& link : links)
+		{
+			std::string url{ link };
+			if (legacy::Process(url, rootUrl, "example.com"))
+			{
+				legacyAccepted += legacy::MakeKey(url).size() != 0;
+			}
+		}
+	}) };
+
+	web_graph::BaseUrl base;
+	web_graph::ParseBaseUrl(pageUrl, base);
+
+	size_t accepted{ 0 };
+	std::string url;
+	const double normalizerNs{ MeasureNsPerLink(linksNum, iterations, [&]
+	{
+		accepted = 0;
+		for (const std::string& link : links)
+		{
+			if (web_graph::NormalizeUrl(link, base, url) && web_graph::InDomain(url, "example.com"))
+			{
+				++accepted;
+			}
+		}
+	}) };
+
+	std::cout
+		<< "links: " << linksNum << ", iterations: " << iterations << '\n'
+		<< "legacy pipeline:  " << legacyNs << " ns/link, accepted " << legacyAccepted << '\n'
+		<< "single pass:      " << normalizerNs << " ns/link, accepted " << accepted << '\n'
+		<< "speedup:          " << legacyNs / normalizerNs << "x\n";
+
+	return 0;
+}
@@ -1,14 +1,33 @@
 #include <iostream>
 #include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <cctype>
+#include <algorithm>
 
 #include "CurlWebPageDownloader.h"
 #include "WebGraphBuilder.h"
+#include "DistributedCrawl.h"
 #include "GraphmlSerialization.h"
+#include "EdgeLog.h"
+#include "GraphDiff.h"
 #include "Analyze.h"
+#include "AnalysisCache.h"
+#include "AnalysisOutput.h"
+#include "Common.h"
 
 static constexpr auto GraphmlExt = ".graphml";
+static constexpr auto EdgeLogExt = ".edgelog";
 static constexpr auto GraphFileName = "graph.graphml";
+static constexpr auto EdgeLogFileName = "graph.edgelog";
 static constexpr auto AnalysisResultFileName = "analysisResult.txt";
+static constexpr auto AnalysisResultJsonFileName = "analysisResult.json";
+static constexpr auto NodeMetricsFileName = "nodeMetrics.csv";
+static constexpr auto DegreeDistributionFileName = "degreeDistribution.json";
+static constexpr auto GraphDiffFileName = "graphDiff.txt";
+static constexpr auto CrawlMetricsFileName = "crawlMetrics.json";
+// Cached results of other parameters are not reused, the options which are not default are appended
+static constexpr auto AnalysisParams = "view=active";
 
 enum SettingsPos
 {
@@ -16,13 +35,14 @@ enum SettingsPos
 	PosWorkDir,
 	PosAddress,
 	PosDeletionChance = PosAddress,
+	PosGraphFiles = PosAddress,
 	PosProxyAddr,
 	PosProxyPort,
 	PosProxyUserName,
 	PosProxyPassword
 };
 
-enum class WorkMode{ Crawl, CrawlAndAnalyze, ReadAndAnalyze, SimulateAtackAndAnalyze };
+enum class WorkMode{ Crawl, CrawlAndAnalyze, CrawlBatch, CrawlPartition, MergePartitions, FinalizeEdgeLogs, Diff, Merge, ReadAndAnalyze, SimulateAtackAndAnalyze };
 
 WorkMode StrToMode( const std::string& mode)
 {
@@ -34,6 +54,30 @@ WorkMode StrToMode( const std::string& mode)
 	{
 		return  WorkMode::CrawlAndAnalyze;
 	}
+	else if (mode == "crawl_batch")
+	{
+		return  WorkMode::CrawlBatch;
+	}
+	else if (mode == "crawl_partition")
+	{
+		return  WorkMode::CrawlPartition;
+	}
+	else if (mode == "merge_partitions")
+	{
+		return  WorkMode::MergePartitions;
+	}
+	else if (mode == "finalize_edge_logs")
+	{
+		return  WorkMode::FinalizeEdgeLogs;
+	}
+	else if (mode == "diff")
+	{
+		return  WorkMode::Diff;
+	}
+	else if (mode == "merge")
+	{
+		return  WorkMode::Merge;
+	}
 	else if (mode == "read_and_analyze")
 	{
 		return  WorkMode::ReadAndAnalyze;
@@ -56,17 +100,222 @@ struct Settings
 	std::string proxyUser;
 	std::string proxyPassw;
 	double deletionChance;
+	// Graphml files or edge logs of the diff and merge modes
+	std::vector<std::string> graphFiles;
+	unsigned statsInterval{ 0 };
+	std::string traceFile;
+	size_t parseQueuePages{ web_graph::AsyncWebGraphBuilder::DefaultParseQueuePages };
+	size_t parseQueueBytes{ web_graph::AsyncWebGraphBuilder::DefaultParseQueueBytes };
+	web_graph::PreCrawlSettings preCrawl{ true, true };
+	web_graph::DedupSettings dedup;
+	size_t memoryBudget{ 0 };
+	std::string spillDir;
+	bool useEdgeLog{ false };
+	bool refreshAnalysis{ false };
+	bool writeNodeMetrics{ false };
+	bool writeDegreeDistribution{ false };
+	analyze::AnalysisOptions analysisOptions;
+	web_graph::LinkExtractionSettings linkTags;
+	size_t threadsNum{ std::thread::hardware_concurrency() };
+	size_t transfersPerThread{ 0 };
+	size_t maxActiveSites{ web_graph::AsyncWebGraphBuilder::DefaultMaxActiveSites };
+	distributed::PartitionSettings partition;
 };
 
 void PrintUsage()
 {
 	std::cout <<
-		"Usage: ./WebGraphBuilder %mode(crawl/crawl_and_analyze/read_and_analyze/simulate_deletion_and_analyze)"
-		"%input_output_file %url %proxy %proxy_username %proxy_password";
+		"Usage: ./WebGraphBuilder %mode(crawl/crawl_and_analyze/crawl_batch/crawl_partition/merge_partitions/"
+		"finalize_edge_logs/diff/merge/read_and_analyze/simulate_deletion_and_analyze)"
+		"%input_output_file %url %proxy %proxy_username %proxy_password\n"
+		"crawl_batch takes a file with a root url per line instead of the url and writes\n"
+		"the graph of every site into its own subdirectory as soon as the site is crawled\n"
+		"crawl_partition is run once per partition with the same url and socket directory,\n"
+		"every process writes its partial graph, merge_partitions combines them into the graph\n"
+		"finalize_edge_logs writes the graphml of every edge log in the work directory, e.g. of a crashed crawl\n"
+		"diff %work_dir %old_graph %new_graph writes the added and removed pages and links to the work directory,\n"
+		"merge %work_dir %graph... writes the union of the graphs, both take graphml files and edge logs\n"
+		"and use --memory-budget and --spill-dir to stay within the memory\n"
+		"Options:\n"
+		"  --stats-interval=%seconds   print crawl stats periodically\n"
+		"  --trace=%file               write chrome trace of the crawl\n"
+		"  --parse-queue-pages=%num    max downloaded pages waiting for parse\n"
+		"  --parse-queue-bytes=%size   max bytes of pages waiting for parse, K/M/G suffixes allowed\n"
+		"  --ignore-robots             do not fetch and follow robots.txt\n"
+		"  --no-sitemaps               do not seed the crawl from sitemaps\n"
+		"  --threads=%num              number of downloaders or threads reading a graph, hardware threads by default\n"
+		"  --transfers=%num            downloads every downloader keeps in flight over curl multi, without it the\n"
+		"                              downloaders block on one page at a time\n"
+		"  --max-sites=%num            max sites crawled at the same time in a batch\n"
+		"  --dedup                     merge pages with the same body or a canonical link into one node\n"
+		"  --near-dups=%bits           also merge pages whose text SimHash differs in up to 3 bits\n"
+		"  --memory-budget=%size       memory for the downloaded pages waiting for parse or for sorting in diff and merge,\n"
+		"                              the rest is spilled to disk, K/M/G suffixes allowed. The frontier and the graphs\n"
+		"                              of a crawl stay in memory\n"
+		"  --spill-dir=%dir            directory of the spill files, %work_dir/spill by default\n"
+		"  --edge-log                  stream the graph to an edge log while crawling and write the graphml from it\n"
+		"  --refresh-analysis          analyze the graph even if the cached result of read_and_analyze is valid\n"
+		"  --node-metrics              also write the metrics of every page to nodeMetrics.csv, the cache is not used then\n"
+		"  --degrees                   also write the degree distributions with power law fits to degreeDistribution.json,\n"
+		"                              the cache is not used then\n"
+		"  --unweighted                count multiple links between two pages as one link in the analysis\n"
+		"  --undirected                analyze the graph as undirected, links both ways between two pages are one link,\n"
+		"                              the pages are not typed as inductors, collectors and mediators then\n"
+		"  --link-tags=%list           tags the links are taken from, a,area,link,frame,meta,base by default\n"
+		"  --partition=%index/%num     partition crawled by this process, 0/2 and 1/2 for two processes\n"
+		"  --socket-dir=%dir           directory of the sockets the partitions talk over, work directory by default\n";
+}
+
+// Size with an optional K/M/G suffix
+size_t ParseSize(const std::string& value)
+{
+	size_t suffixPos{ 0 };
+	size_t size{ std::stoul(value, &suffixPos) };
+
+	if (suffixPos < value.size())
+	{
+		switch (value[suffixPos])
+		{
+		case 'G': case 'g': size *= 1024;
+		// fall through
+		case 'M': case 'm': size *= 1024;
+		// fall through
+		case 'K': case 'k': size *= 1024; break;
+		default: throw std::invalid_argument{ "Invalid size: " + value };
+		}
+	}
+
+	return size;
+}
+
+// Moves --name=value options out of argv, returns the new argc
+int ParseOptions(int argc, char** argv, Settings& settings)
+{
+	int positionalNum{ 1 };
+	for (int i{ 1 }; i < argc; ++i)
+	{
+		std::string arg{ argv[i] };
+		if (arg.compare(0, 2, "--") != 0)
+		{
+			argv[positionalNum++] = argv[i];
+			continue;
+		}
+
+		auto valuePos = arg.find('=');
+		std::string name{ arg.substr(2, valuePos - 2) };
+		std::string value{ valuePos != std::string::npos ? arg.substr(valuePos + 1) : std::string{} };
+
+		if (name == "stats-interval")
+		{
+			settings.statsInterval = static_cast<unsigned>(std::stoul(value));
+		}
+		else if (name == "trace")
+		{
+			settings.traceFile = value;
+		}
+		else if (name == "parse-queue-pages")
+		{
+			settings.parseQueuePages = std::stoul(value);
+		}
+		else if (name == "parse-queue-bytes")
+		{
+			settings.parseQueueBytes = ParseSize(value);
+		}
+		else if (name == "ignore-robots")
+		{
+			settings.preCrawl.useRobotsTxt = false;
+		}
+		else if (name == "no-sitemaps")
+		{
+			settings.preCrawl.useSitemaps = false;
+		}
+		else if (name == "threads")
+		{
+			settings.threadsNum = std::stoul(value);
+		}
+		else if (name == "transfers")
+		{
+			settings.transfersPerThread = std::stoul(value);
+		}
+		else if (name == "max-sites")
+		{
+			settings.maxActiveSites = std::stoul(value);
+		}
+		else if (name == "dedup")
+		{
+			settings.dedup.exactDuplicates = true;
+			settings.dedup.useCanonicalLinks = true;
+		}
+		else if (name == "near-dups")
+		{
+			settings.dedup.nearDuplicateDistance = static_cast<uint32_t>(std::stoul(value));
+		}
+		else if (name == "memory-budget")
+		{
+			settings.memoryBudget = ParseSize(value);
+		}
+		else if (name == "spill-dir")
+		{
+			settings.spillDir = value;
+		}
+		else if (name == "edge-log")
+		{
+			settings.useEdgeLog = true;
+		}
+		else if (name == "refresh-analysis")
+		{
+			settings.refreshAnalysis = true;
+		}
+		else if (name == "node-metrics")
+		{
+			settings.writeNodeMetrics = true;
+		}
+		else if (name == "degrees")
+		{
+			settings.writeDegreeDistribution = true;
+		}
+		else if (name == "unweighted")
+		{
+			settings.analysisOptions.weighted = false;
+		}
+		else if (name == "undirected")
+		{
+			settings.analysisOptions.directed = false;
+		}
+		else if (name == "link-tags")
+		{
+			settings.linkTags = web_graph::ParseLinkTags(value);
+		}
+		else if (name == "partition")
+		{
+			const size_t separator{ value.find('/') };
+			if (separator == std::string::npos)
+			{
+				throw std::invalid_argument{ "Partition should be %index/%num: " + value };
+			}
+
+			settings.partition.partition = std::stoul(value.substr(0, separator));
+			settings.partition.partitionsNum = std::stoul(value.substr(separator + 1));
+		}
+		else if (name == "socket-dir")
+		{
+			settings.partition.socketDir = value;
+		}
+		else
+		{
+			PrintUsage();
+			throw std::invalid_argument{ "Unknown option: " + arg };
+		}
+	}
+
+	return positionalNum;
 }
 
 Settings ParseArgs(int argc, char** argv)
 {
+	Settings settings;
+	argc = ParseOptions(argc, argv, settings);
+
 	--argc;
 	if (argc < PosWorkDir)
 	{
@@ -74,11 +323,13 @@ Settings ParseArgs(int argc, char** argv)
 		throw std::invalid_argument{ "At least mode and work directory should be provided" };
 	}
 
-	Settings settings;
 	settings.mode = StrToMode(argv[PosMode]);
 	settings.workDir = argv[PosWorkDir];
 
-	if (settings.mode == WorkMode::Crawl || settings.mode == WorkMode::CrawlAndAnalyze)
+	if (settings.mode == WorkMode::Crawl ||
+		settings.mode == WorkMode::CrawlAndAnalyze ||
+		settings.mode == WorkMode::CrawlBatch ||
+		settings.mode == WorkMode::CrawlPartition)
 	{
 		if (argc < PosAddress)
 		{
@@ -122,11 +373,46 @@ Settings ParseArgs(int argc, char** argv)
 
 		settings.deletionChance = std::stod(argv[PosDeletionChance]);
 	}
-	else
+	else if (settings.mode == WorkMode::Diff || settings.mode == WorkMode::Merge)
+	{
+		for (int i{ PosGraphFiles }; i <= argc; ++i)
+		{
+			settings.graphFiles.push_back(argv[i]);
+		}
+
+		if (settings.mode == WorkMode::Diff ? settings.graphFiles.size() != 2 : settings.graphFiles.empty())
+		{
+			PrintUsage();
+			throw std::invalid_argument{ "Diff takes two graph files, merge at least one" };
+		}
+	}
+	else if (settings.mode != WorkMode::ReadAndAnalyze &&
+		settings.mode != WorkMode::MergePartitions &&
+		settings.mode != WorkMode::FinalizeEdgeLogs)
 	{
 		throw std::invalid_argument{ "Unknown workmode" };
 	}
 
+	if (settings.useEdgeLog && settings.mode == WorkMode::CrawlBatch)
+	{
+		throw std::invalid_argument{ "Edge log is written by the single site crawl modes" };
+	}
+
+	if (settings.partition.socketDir.empty())
+	{
+		settings.partition.socketDir = settings.workDir;
+	}
+
+	if (settings.spillDir.empty())
+	{
+		// Partitions may share the work directory
+		settings.spillDir = settings.workDir + "/spill";
+		if (settings.mode == WorkMode::CrawlPartition)
+		{
+			settings.spillDir += "-part-" + std::to_string(settings.partition.partition);
+		}
+	}
+
 	return settings;
 }
 
@@ -153,10 +439,202 @@ void WriteAnalysisResultToFile(const analyze::GraphAnalysisResult& result, const
 	outFile
 		<< "edgesIndex: " << result.edgesIndex << '\n'
 		<< "linksIndex: " << result.linksIndex << '\n'
-		<< "clusteringCoeff: " << result.clusteringCoeff << '\n'
-		<< "inductors: " << result.inductorNum << '\n'
-		<< "collectors: " << result.collectorsNum << '\n'
-		<< "mediators: " << result.mediatorsNum << '\n';
+		<< "clusteringCoeff: " << result.clusteringCoeff << '\n';
+
+	// The nodes of an undirected graph have no types
+	if (result.options.directed)
+	{
+		outFile
+			<< "inductors: " << result.inductorNum << '\n'
+			<< "collectors: " << result.collectorsNum << '\n'
+			<< "mediators: " << result.mediatorsNum << '\n';
+	}
+}
+
+void WriteAnalysisResultToJsonFile(const analyze::GraphAnalysisResult& result, const std::string& fileName)
+{
+	std::ofstream outFile{ fileName };
+	if (!outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	outFile << analyze::ToJson(result);
+}
+
+void WriteAnalysisResult(const analyze::GraphAnalysisResult& result, const Settings& settings)
+{
+	WriteAnalysisResultToFile(result, MakePath(settings.workDir, AnalysisResultFileName));
+	WriteAnalysisResultToJsonFile(result, MakePath(settings.workDir, AnalysisResultJsonFileName));
+}
+
+void WriteDegreeDistributionToFile(const analyze::DegreeDistributions& distributions, const std::string& fileName)
+{
+	std::ofstream outFile{ fileName };
+	if (!outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	outFile << analyze::ToJson(distributions);
+}
+
+std::string MakeAnalysisParams(const analyze::AnalysisOptions& options)
+{
+	std::string result{ AnalysisParams };
+	if (!options.weighted)
+	{
+		result += " unweighted";
+	}
+
+	if (!options.directed)
+	{
+		result += " undirected";
+	}
+
+	return result;
+}
+
+// Writes the metrics of every page and the degree distributions on the way if they are asked for
+analyze::GraphAnalysisResult AnalyzeGraph(const web_graph::GraphView& view, const Settings& settings)
+{
+	const analyze::AnalysisOptions& options = settings.analysisOptions;
+	if (!settings.writeNodeMetrics && !settings.writeDegreeDistribution)
+	{
+		return analyze::Analyze(view, options);
+	}
+
+	const std::vector<analyze::NodeMetrics> nodeMetrics{ analyze::CalcNodeMetrics(view, settings.threadsNum) };
+	if (settings.writeNodeMetrics)
+	{
+		analyze::WriteNodeMetricsCsv(view, nodeMetrics, MakePath(settings.workDir, NodeMetricsFileName), settings.threadsNum);
+	}
+
+	if (settings.writeDegreeDistribution)
+	{
+		WriteDegreeDistributionToFile(analyze::CalcDegreeDistributions(view, nodeMetrics, settings.threadsNum),
+			MakePath(settings.workDir, DegreeDistributionFileName));
+	}
+
+	// The metrics of the pages are counted with the default options only
+	return options.weighted && options.directed ?
+		analyze::Analyze(view, nodeMetrics) : analyze::Analyze(view, options);
+}
+
+void WriteCrawlMetricsToFile(const metrics::MetricsSnapshot& snapshot, const std::string& fileName)
+{
+	std::ofstream outFile{ fileName };
+	if (!outFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	outFile << metrics::ToJson(snapshot);
+}
+
+void ConfigureBuilder(web_graph::AsyncWebGraphBuilder& builder, const Settings& settings)
+{
+	if (!settings.proxyAddr.empty())
+	{
+		builder.SetProxy(
+		{ settings.proxyAddr, settings.proxyPort, settings.proxyUser, settings.proxyPassw });
+	}
+
+	builder.SetStatsOutput(&std::cerr, std::chrono::seconds{ settings.statsInterval });
+	builder.SetTraceFile(settings.traceFile);
+	builder.SetParseQueueCapacity(settings.parseQueuePages, settings.parseQueueBytes);
+	builder.SetPreCrawlSettings(settings.preCrawl);
+	builder.SetDedupSettings(settings.dedup);
+	builder.SetMemoryBudget(settings.memoryBudget, settings.spillDir);
+	builder.SetMaxActiveSites(settings.maxActiveSites);
+	builder.SetTransfersPerThread(settings.transfersPerThread);
+	builder.SetLinkExtractor(std::make_unique<web_graph::HtmlLinkExtractor>(settings.linkTags));
+}
+
+void FinalizeEdgeLog(const std::string& logFileName, const std::string& graphFileName)
+{
+	if (!edge_log::ConvertToGraphml(logFileName, graphFileName))
+	{
+		std::cerr << "Edge log " << logFileName << " is cut short, the graph has the pages found before" << std::endl;
+	}
+}
+
+std::vector<web_graph::Url> ReadRootUrls(const std::string& fileName)
+{
+	std::ifstream inFile{ fileName };
+	if (!inFile.is_open())
+	{
+		throw std::runtime_error{ "Failed to open file" };
+	}
+
+	std::vector<web_graph::Url> urls;
+	std::string line;
+	while (std::getline(inFile, line))
+	{
+		const size_t begin{ line.find_first_not_of(" \t\r") };
+		if (begin != std::string::npos && line[begin] != '#')
+		{
+			urls.push_back(line.substr(begin, line.find_last_not_of(" \t\r") - begin + 1));
+		}
+	}
+
+	return urls;
+}
+
+// Directory of the site within the work directory, made of its host and port
+std::string MakeSiteDirName(const web_graph::Url& rootUrl)
+{
+	const size_t schemeEnd{ rootUrl.find("://") };
+	const size_t hostBegin{ schemeEnd != std::string::npos ? schemeEnd + 3 : 0 };
+
+	std::string name{ rootUrl.substr(hostBegin, rootUrl.find_first_of("/?", hostBegin) - hostBegin) };
+	for (char& c : name)
+	{
+		if (!std::isalnum(static_cast<unsigned char>(c)) && c != '.' && c != '-')
+		{
+			c = '_';
+		}
+	}
+
+	return name;
+}
+
+std::string MakePartitionFileName(const std::string& name, size_t partition, size_t partitionsNum, const std::string& ext)
+{
+	return name + ".part-" + std::to_string(partition) + "-of-" + std::to_string(partitionsNum) + ext;
+}
+
+// Partial graphs of all the partitions, throws if some are missing
+std::vector<std::string> FindPartitionFiles(const std::string& workDir)
+{
+	static const std::string prefix{ "graph.part-" };
+
+	std::vector<std::string> files;
+	size_t partitionsNum{ 0 };
+	for (const auto& entry : std::filesystem::directory_iterator{ workDir })
+	{
+		const std::string name{ entry.path().filename().string() };
+		const size_t numPos{ name.find("-of-") };
+		if (name.compare(0, prefix.size(), prefix) == 0 && numPos != std::string::npos &&
+			entry.path().extension() == GraphmlExt)
+		{
+			partitionsNum = std::stoul(name.substr(numPos + 4));
+			files.push_back(entry.path().string());
+		}
+	}
+
+	if (files.empty() || files.size() != partitionsNum)
+	{
+		throw std::runtime_error{ "Partial graphs of some partitions are missing" };
+	}
+
+	// The partition 0 goes first, its root becomes the root of the graph
+	std::sort(files.begin(), files.end(), [](const std::string& left, const std::string& right)
+	{
+		return left.size() != right.size() ? left.size() < right.size() : left < right;
+	});
+
+	return files;
 }
 
 std::string MakeNameAfterAttack(double deletionChance, size_t iteration)
@@ -174,36 +652,177 @@ int main(int argc, char** argv)
 		Settings settings = ParseArgs(argc, argv);
 
 		std::string graphFileName{ MakePath(settings.workDir, GraphFileName) };
-		std::string analysisFileName{ MakePath(settings.workDir, AnalysisResultFileName) };
 
 		// Create graph if necessary
 		if (settings.mode == WorkMode::Crawl || settings.mode == WorkMode::CrawlAndAnalyze)
 		{
-			network::CurlWebDownloaderFactory factory;
-			web_graph::AsyncWebGraphBuilder builder{ factory, std::thread::hardware_concurrency() };
+			const std::string edgeLogFileName{ MakePath(settings.workDir, EdgeLogFileName) };
+			std::unique_ptr<edge_log::EdgeLogWriter> edgeLog{ settings.useEdgeLog ?
+				std::make_unique<edge_log::EdgeLogWriter>(edgeLogFileName) : nullptr };
 
-			if (!settings.proxyAddr.empty())
-			{
-				builder.SetProxy(
-				{ settings.proxyAddr, settings.proxyPort, settings.proxyUser, settings.proxyPassw });
-			}
+			network::CurlWebDownloaderFactory factory;
+			web_graph::AsyncWebGraphBuilder builder{ factory, settings.threadsNum };
+			ConfigureBuilder(builder, settings);
+			builder.SetGraphSink(edgeLog.get());
 
 			auto future = builder.Start(settings.url);
 			auto graphHandle = future.get();
-			const web_graph::WebGraph& graph = *graphHandle;
 
-			graphml::Serialize(graph, graphFileName);
+			builder.Stop();
+			WriteCrawlMetricsToFile(builder.GetMetrics(), MakePath(settings.workDir, CrawlMetricsFileName));
+
 			if (settings.mode == WorkMode::CrawlAndAnalyze)
 			{
-				WriteAnalysisResultToFile(analyze::Analyze(graph), analysisFileName);
+				WriteAnalysisResult(AnalyzeGraph(common::MakeActiveView(*graphHandle), settings), settings);
+			}
+
+			if (edgeLog)
+			{
+				// The graph is written from the log, so it does not stay in memory meanwhile
+				graphHandle.reset();
+				edgeLog->Close();
+				FinalizeEdgeLog(edgeLogFileName, graphFileName);
+			}
+			else
+			{
+				graphml::Serialize(*graphHandle, graphFileName);
+			}
+		}
+
+		if (settings.mode == WorkMode::CrawlBatch)
+		{
+			network::CurlWebDownloaderFactory factory;
+			web_graph::AsyncWebGraphBuilder builder{ factory, settings.threadsNum };
+			ConfigureBuilder(builder, settings);
+
+			std::mutex logMutex;
+			auto future = builder.StartBatch(ReadRootUrls(settings.url),
+				[&](const web_graph::Url& rootUrl, std::unique_ptr<web_graph::WebGraph> graph)
+			{
+				if (graph)
+				{
+					const std::string siteDir{ MakePath(settings.workDir, MakeSiteDirName(rootUrl)) };
+					std::filesystem::create_directories(siteDir);
+					graphml::Serialize(*graph, MakePath(siteDir, GraphFileName));
+				}
+
+				std::lock_guard<std::mutex> l{ logMutex };
+				std::cerr << "Crawled " << rootUrl << ": "
+					<< (graph ? web_graph::GetNodesNum(*graph) : 0) << " pages" << std::endl;
+			});
+
+			future.get();
+			builder.Stop();
+			WriteCrawlMetricsToFile(builder.GetMetrics(), MakePath(settings.workDir, CrawlMetricsFileName));
+		}
+
+		if (settings.mode == WorkMode::CrawlPartition)
+		{
+			const size_t partition{ settings.partition.partition };
+			const size_t partitionsNum{ settings.partition.partitionsNum };
+
+			const std::string edgeLogFileName{
+				MakePath(settings.workDir, MakePartitionFileName("graph", partition, partitionsNum, EdgeLogExt)) };
+			std::unique_ptr<edge_log::EdgeLogWriter> edgeLog{ settings.useEdgeLog ?
+				std::make_unique<edge_log::EdgeLogWriter>(edgeLogFileName) : nullptr };
+
+			network::CurlWebDownloaderFactory factory;
+			web_graph::AsyncWebGraphBuilder builder{ factory, settings.threadsNum };
+			ConfigureBuilder(builder, settings);
+			builder.SetGraphSink(edgeLog.get());
+
+			auto graph = distributed::CrawlPartition(builder, settings.url, settings.partition);
+			WriteCrawlMetricsToFile(builder.GetMetrics(),
+				MakePath(settings.workDir, MakePartitionFileName("crawlMetrics", partition, partitionsNum, ".json")));
+
+			const std::string partialGraphFileName{
+				MakePath(settings.workDir, MakePartitionFileName("graph", partition, partitionsNum, GraphmlExt)) };
+			if (edgeLog)
+			{
+				graph.reset();
+				edgeLog->Close();
+				FinalizeEdgeLog(edgeLogFileName, partialGraphFileName);
+			}
+			else
+			{
+				graphml::Serialize(*graph, partialGraphFileName);
+			}
+		}
+
+		graph_diff::DiffSettings diffSettings;
+		diffSettings.spillDir = settings.spillDir;
+		if (settings.memoryBudget)
+		{
+			diffSettings.memoryBytes = settings.memoryBudget;
+		}
+
+		if (settings.mode == WorkMode::MergePartitions || settings.mode == WorkMode::Merge)
+		{
+			// Every page is parsed by a single partition, so its links are taken from one partial graph
+			const graph_diff::MergeStats stats{ graph_diff::MergeGraphs(settings.mode == WorkMode::Merge ?
+				settings.graphFiles : FindPartitionFiles(settings.workDir), graphFileName, diffSettings) };
+
+			std::cerr << "Merged graph: " << stats.nodesNum << " pages, " << stats.linksNum << " links" << std::endl;
+		}
+
+		if (settings.mode == WorkMode::Diff)
+		{
+			graph_diff::TextDiffWriter writer{ MakePath(settings.workDir, GraphDiffFileName) };
+			const graph_diff::DiffStats stats{
+				graph_diff::DiffGraphs(settings.graphFiles[0], settings.graphFiles[1], writer, diffSettings) };
+			writer.Close();
+
+			std::cerr << "Pages: +" << stats.nodesAdded << " -" << stats.nodesRemoved
+				<< ", links: +" << stats.linksAdded << " -" << stats.linksRemoved
+				<< " ~" << stats.linksChanged << std::endl;
+		}
+
+		if (settings.mode == WorkMode::FinalizeEdgeLogs)
+		{
+			size_t logsNum{ 0 };
+			for (const auto& entry : std::filesystem::directory_iterator{ settings.workDir })
+			{
+				if (entry.path().extension() == EdgeLogExt)
+				{
+					std::filesystem::path graphPath{ entry.path() };
+					FinalizeEdgeLog(entry.path().string(), graphPath.replace_extension(GraphmlExt).string());
+					++logsNum;
+				}
 			}
+
+			std::cerr << "Finalized " << logsNum << " edge logs" << std::endl;
 		}
 
 		// Analyze graph if necessary
-		if (settings.mode == WorkMode::ReadAndAnalyze || settings.mode == WorkMode::SimulateAtackAndAnalyze)
+		if (settings.mode == WorkMode::ReadAndAnalyze)
+		{
+			// The same graph is analyzed over and over, so the result is kept till the graph changes
+			analyze::AnalysisCache cache{ graphFileName };
+			analyze::GraphAnalysisResult result;
+			// The metrics of the pages and the distributions are not cached, so the graph is read to write them
+			const std::string analysisParams{ MakeAnalysisParams(settings.analysisOptions) };
+			if (cache.Find(analysisParams, result) && !settings.refreshAnalysis &&
+				!settings.writeNodeMetrics && !settings.writeDegreeDistribution)
+			{
+				std::cerr << "Analysis result of the unchanged graph is taken from the cache" << std::endl;
+				// Kept in the params of the cached result only
+				result.options = settings.analysisOptions;
+			}
+			else
+			{
+				auto graph = graphml::Deserialize(graphFileName, settings.threadsNum);
+				result = AnalyzeGraph(common::MakeActiveView(*graph), settings);
+				cache.Store(analysisParams, result);
+			}
+
+			WriteAnalysisResult(result, settings);
+		}
+
+		if (settings.mode == WorkMode::SimulateAtackAndAnalyze)
 		{
-			auto graph = graphml::Deserialize(graphFileName);
-			WriteAnalysisResultToFile(analyze::Analyze(*graph), analysisFileName);
+			auto graph = graphml::Deserialize(graphFileName, settings.threadsNum);
+			WriteAnalysisResult(AnalyzeGraph(analyze::SimulateNodesDeletion(*graph, settings.deletionChance), settings),
+				settings);
 		}
 	}
 	catch (const std::exception& e)